@@ -0,0 +1,55 @@
+#include "app_config.h"
+#include "bench.h"
+
+#include "esp_log.h"
+#include "esp_task.h"
+#include "host_port.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [-f filter] [-o file]\n"
+        "  -f  run only the benchmarks whose name contains `filter`\n"
+        "  -o  write the results to `file` instead of stdout\n",
+        name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+    const char *path = NULL;
+    int opt;
+
+    while((opt = getopt(argc, argv, "f:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f': filter = optarg; break;
+        case 'o': path = optarg; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    host_port_init("main", ESP_TASK_MAIN_PRIO);
+    app_config_init();
+
+    FILE *out = path ? fopen(path, "w") : stdout;
+    if(out == NULL) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    const uint32_t count = bench_run(out, filter);
+
+    if(out != stdout)
+        fclose(out);
+
+    return count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,461 @@
+#include "form_parser.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * form_parser checks: every body is fed whole, split in two at every
+ * offset, split in three at every pair of offsets and byte by byte, and
+ * must give the same fields and status each time.
+ * Then mutated and random bodies: fed whole, at random splits and byte
+ * by byte they must give the same result, and a value never leaves its
+ * buffer.
+*/
+
+#define VALUE_SIZE      32
+#define FIELD_COUNT     3
+
+// bytes after every value buffer that must stay untouched
+#define GUARD_SIZE      16
+#define GUARD_BYTE      0xa5
+
+#define DEFAULT_FUZZ_RUNS   20000
+#define DEFAULT_FUZZ_SEED   1
+#define FUZZ_BODY_MAX       1024
+#define FUZZ_MUTATIONS_MAX  8
+#define FUZZ_SPLITS         4
+
+#define MIN_RANGE(a, b)     ((a) < (b) ? (a) : (b))
+
+#define BOUNDARY        "----aqaBoundary7MA4YWxk"
+#define MULTIPART_TYPE  "multipart/form-data; boundary=" BOUNDARY
+
+typedef struct {
+    char values[FIELD_COUNT][VALUE_SIZE + GUARD_SIZE];
+    form_field_t fields[FIELD_COUNT];
+    form_status_t status;
+} result_t;
+
+typedef struct {
+    const char *name;
+    const char *content_type;   // NULL - urlencoded
+    const char *body;
+    form_status_t status;
+    const char *expected[FIELD_COUNT]; // NULL - not found
+} case_t;
+
+static const char *s_names[FIELD_COUNT] = { "ssid", "pass", "note" };
+
+static const case_t s_cases[] = {
+    {
+        .name = "urlencoded",
+        .body = "ssid=My+Net%21&skip=1&pass=p%40ss%2Fw&x&note=",
+        .status = FORM_OK,
+        .expected = { "My Net!", "p@ss/w", "" },
+    },
+    {
+        .name = "urlencoded, value fills the buffer",
+        .body = "ssid=1234567890123456789012345678901&pass=a",
+        .status = FORM_OK,
+        .expected = { "1234567890123456789012345678901", "a", NULL },
+    },
+    {
+        .name = "urlencoded, value one byte over the buffer",
+        .body = "ssid=12345678901234567890123456789012&pass=a",
+        .status = FORM_ERR_FIELD_TOO_LONG,
+    },
+    {
+        .name = "urlencoded, truncated escape",
+        .body = "ssid=ab%4",
+        .status = FORM_ERR_SYNTAX,
+    },
+    {
+        .name = "multipart",
+        .content_type = MULTIPART_TYPE,
+        .body = "preamble\r\n"
+            "--" BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"ssid\"\r\n"
+            "\r\n"
+            "My Net\r\n"
+            "--" BOUNDARY "\r\n"
+            "content-disposition: form-data; name=\"skip\"\r\n"
+            "Content-Type: text/plain\r\n"
+            "\r\n"
+            "ignored\r\n"
+            "--" BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"pass\"\r\n"
+            "\r\n"
+            "a\r\n------aqaBound\r\n"
+            "--" BOUNDARY "--\r\n"
+            "epilogue",
+        .status = FORM_OK,
+        // a partial delimiter inside a value is data
+        .expected = { "My Net", "a\r\n------aqaBound", NULL },
+    },
+    {
+        .name = "multipart, value fills the buffer",
+        .content_type = MULTIPART_TYPE,
+        .body = "--" BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"note\"\r\n"
+            "\r\n"
+            "1234567890123456789012345678901\r\n"
+            "--" BOUNDARY "--",
+        .status = FORM_OK,
+        .expected = { NULL, NULL, "1234567890123456789012345678901" },
+    },
+    {
+        .name = "multipart, value one byte over the buffer",
+        .content_type = MULTIPART_TYPE,
+        .body = "--" BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"note\"\r\n"
+            "\r\n"
+            "12345678901234567890123456789012\r\n"
+            "--" BOUNDARY "--",
+        .status = FORM_ERR_FIELD_TOO_LONG,
+    },
+    {
+        .name = "multipart, missing final boundary",
+        .content_type = MULTIPART_TYPE,
+        .body = "--" BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"ssid\"\r\n"
+            "\r\n"
+            "My Net\r\n",
+        .status = FORM_ERR_SYNTAX,
+    },
+    {
+        .name = "multipart, final boundary without the closing dashes",
+        .content_type = MULTIPART_TYPE,
+        .body = "--" BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"ssid\"\r\n"
+            "\r\n"
+            "My Net\r\n"
+            "--" BOUNDARY,
+        .status = FORM_ERR_SYNTAX,
+    },
+};
+
+/**
+ * @param cuts offsets the body is split at, ascending
+*/
+static void parse_body(result_t *r, const char *content_type, const char *body, size_t len,
+    const size_t *cuts, size_t cut_count)
+{
+    form_parser_t parser;
+    size_t start = 0;
+
+    memset(r->values, GUARD_BYTE, sizeof(r->values));
+    for(size_t i = 0; i < FIELD_COUNT; i++)
+        r->fields[i] = (form_field_t) { .name = s_names[i], .value = r->values[i], .size = VALUE_SIZE };
+
+    r->status = form_parser_init(&parser, content_type, r->fields, FIELD_COUNT);
+
+    for(size_t i = 0; i <= cut_count && r->status == FORM_OK; i++)
+    {
+        const size_t end = i < cut_count ? cuts[i] : len;
+        r->status = form_parser_feed(&parser, body + start, end - start);
+        start = end;
+    }
+
+    if(r->status == FORM_OK)
+        r->status = form_parser_finish(&parser);
+}
+
+static void parse(result_t *r, const case_t *c, const size_t *cuts, size_t cut_count)
+{
+    parse_body(r, c->content_type, c->body, strlen(c->body), cuts, cut_count);
+}
+
+static void print_cuts(const size_t *cuts, size_t cut_count)
+{
+    fprintf(stderr, "  split at");
+    for(size_t i = 0; i < cut_count; i++)
+        fprintf(stderr, " %zu", cuts[i]);
+    fprintf(stderr, "\n");
+}
+
+/**
+ * @return false if the result differs from the expectation of the case
+*/
+static bool check(const case_t *c, const size_t *cuts, size_t cut_count)
+{
+    result_t r;
+    parse(&r, c, cuts, cut_count);
+
+    if(r.status != c->status) {
+        fprintf(stderr, "%s: status %d, expected %d\n", c->name, r.status, c->status);
+        print_cuts(cuts, cut_count);
+        return false;
+    }
+
+    if(c->status != FORM_OK)
+        return true;
+
+    for(size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        const char *expected = c->expected[i];
+        const form_field_t *f = &r.fields[i];
+
+        if(f->found != (expected != NULL)
+            || (expected && (strcmp(f->value, expected) != 0 || f->len != strlen(expected))))
+        {
+            fprintf(stderr, "%s: %s is \"%s\" (%s), expected \"%s\"\n", c->name, f->name,
+                f->value, f->found ? "found" : "not found", expected ? expected : "(not found)");
+            print_cuts(cuts, cut_count);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @return false if a value left its buffer or its length is wrong
+*/
+static bool bounded(const result_t *r)
+{
+    for(size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        const form_field_t *f = &r->fields[i];
+
+        for(size_t k = VALUE_SIZE; k < VALUE_SIZE + GUARD_SIZE; k++)
+            if((uint8_t)r->values[i][k] != GUARD_BYTE)
+                return false;
+
+        if(f->found && (f->len >= f->size || f->value[f->len] != '\0'))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Same status, and with FORM_OK the same fields
+*/
+static bool same(const result_t *a, const result_t *b)
+{
+    if(a->status != b->status)
+        return false;
+    if(a->status != FORM_OK)
+        return true;
+
+    for(size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        const form_field_t *fa = &a->fields[i], *fb = &b->fields[i];
+        if(fa->found != fb->found
+            || (fa->found && (fa->len != fb->len || memcmp(fa->value, fb->value, fa->len) != 0)))
+            return false;
+    }
+    return true;
+}
+
+static uint32_t s_rand;
+
+static uint32_t next_rand(void)
+{
+    // xorshift32, the same bodies for the same seed
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+/**
+ * @brief A byte the parser has a meaning for, or any byte
+*/
+static char fuzz_byte(void)
+{
+    static const char special[] = "%&=+-\r\n\";:; 0aAfF";
+    const uint32_t r = next_rand();
+    return (r & 1) ? special[(r >> 1) % (sizeof(special) - 1)] : (char)(r >> 8);
+}
+
+/**
+ * @brief Flip, insert, delete, duplicate and truncate bytes of `body`,
+ * or replace it with random bytes
+ * @return length of the body
+*/
+static size_t mutate(char *body, size_t len)
+{
+    const uint32_t mutations = 1 + next_rand() % FUZZ_MUTATIONS_MAX;
+
+    if(next_rand() % 16 == 0) {
+        len = next_rand() % 256;
+        for(size_t i = 0; i < len; i++)
+            body[i] = fuzz_byte();
+        return len;
+    }
+
+    for(uint32_t m = 0; m < mutations; m++)
+    {
+        const size_t pos = len ? next_rand() % (len + 1) : 0;
+
+        switch(next_rand() % 5)
+        {
+        case 0: // flip a byte
+            if(pos < len)
+                body[pos] = fuzz_byte();
+            break;
+        case 1: // insert a byte
+            if(len < FUZZ_BODY_MAX) {
+                memmove(body + pos + 1, body + pos, len - pos);
+                body[pos] = fuzz_byte();
+                len++;
+            }
+            break;
+        case 2: { // delete a range
+            const size_t want = next_rand() % 8 + 1;
+            const size_t n = MIN_RANGE(want, len - pos);
+            memmove(body + pos, body + pos + n, len - pos - n);
+            len -= n;
+            break;
+        }
+        case 3: { // duplicate a range, e.g. a boundary or an escape
+            const size_t want = next_rand() % 48 + 1;
+            const size_t n = MIN_RANGE(want, MIN_RANGE(len - pos, FUZZ_BODY_MAX - len));
+            memmove(body + pos + n, body + pos, len - pos);
+            len += n;
+            break;
+        }
+        default: // truncate
+            len = pos;
+            break;
+        }
+    }
+    return len;
+}
+
+static void print_body(const char *body, size_t len)
+{
+    fprintf(stderr, "  body:");
+    for(size_t i = 0; i < len; i++)
+        fprintf(stderr, (body[i] >= 0x20 && body[i] < 0x7f) ? "%c" : "\\x%02x", (uint8_t)body[i]);
+    fprintf(stderr, "\n");
+}
+
+/**
+ * @return runs that failed
+*/
+static uint32_t fuzz(uint32_t runs, uint32_t seed, uint32_t *statuses)
+{
+    const size_t case_count = sizeof(s_cases) / sizeof(s_cases[0]);
+    static char body[FUZZ_BODY_MAX];
+    static size_t every[FUZZ_BODY_MAX];
+    uint32_t failures = 0;
+
+    s_rand = seed ? seed : DEFAULT_FUZZ_SEED;
+    for(size_t i = 0; i < FUZZ_BODY_MAX; i++)
+        every[i] = i + 1;
+
+    for(uint32_t n = 0; n < runs; n++)
+    {
+        const case_t *c = &s_cases[next_rand() % case_count];
+        size_t len = strlen(c->body);
+
+        memcpy(body, c->body, len);
+        len = mutate(body, len);
+
+        result_t whole, split;
+        parse_body(&whole, c->content_type, body, len, NULL, 0);
+        statuses[whole.status]++;
+
+        bool ok = bounded(&whole);
+
+        // random splits, then byte by byte
+        size_t cuts[FUZZ_SPLITS];
+        for(size_t i = 0; i < FUZZ_SPLITS; i++)
+            cuts[i] = len ? next_rand() % (len + 1) : 0;
+        for(size_t i = 1; i < FUZZ_SPLITS; i++)
+            for(size_t k = i; k > 0 && cuts[k - 1] > cuts[k]; k--) {
+                const size_t t = cuts[k]; cuts[k] = cuts[k - 1]; cuts[k - 1] = t;
+            }
+        parse_body(&split, c->content_type, body, len, cuts, FUZZ_SPLITS);
+        ok = ok && bounded(&split) && same(&whole, &split);
+
+        parse_body(&split, c->content_type, body, len, every, len);
+        ok = ok && bounded(&split) && same(&whole, &split);
+
+        if(!ok) {
+            if(failures++ < 5) {
+                fprintf(stderr, "fuzz run %u from \"%s\": results differ or a value overran\n",
+                    (unsigned)n, c->name);
+                print_body(body, len);
+            }
+        }
+    }
+    return failures;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [-f runs] [-s seed]\n"
+        "  -f  mutated and random bodies, default %d\n"
+        "  -s  seed of the mutations, default %d\n",
+        name, DEFAULT_FUZZ_RUNS, DEFAULT_FUZZ_SEED);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t fuzz_runs = DEFAULT_FUZZ_RUNS;
+    uint32_t seed = DEFAULT_FUZZ_SEED;
+    uint32_t runs = 0, failures = 0;
+    int opt;
+
+    while((opt = getopt(argc, argv, "f:s:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f': fuzz_runs = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 's': seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    for(size_t n = 0; n < sizeof(s_cases) / sizeof(s_cases[0]); n++)
+    {
+        const case_t *c = &s_cases[n];
+        const size_t len = strlen(c->body);
+        uint32_t case_failures = 0;
+        size_t cuts[2];
+
+        runs++;
+        case_failures += !check(c, NULL, 0);
+
+        for(cuts[0] = 0; cuts[0] <= len; cuts[0]++)
+        {
+            runs++;
+            case_failures += !check(c, cuts, 1);
+
+            for(cuts[1] = cuts[0]; cuts[1] <= len; cuts[1]++) {
+                runs++;
+                case_failures += !check(c, cuts, 2);
+            }
+        }
+
+        // byte by byte
+        size_t *every = malloc(len * sizeof(size_t));
+        for(size_t i = 0; i < len; i++)
+            every[i] = i + 1;
+        runs++;
+        case_failures += !check(c, every, len);
+        free(every);
+
+        printf("%-54s: %s\n", c->name, case_failures ? "FAILED" : "ok");
+        failures += case_failures;
+    }
+
+    uint32_t statuses[FORM_ERR_SYNTAX + 1] = { 0 };
+    const uint32_t fuzz_failures = fuzz(fuzz_runs, seed, statuses);
+    printf("%-54s: %s\n", "mutated and random bodies", fuzz_failures ? "FAILED" : "ok");
+    failures += fuzz_failures;
+
+    printf("runs        : %u\n", (unsigned)runs);
+    printf("fuzz        : %u bodies from seed %u: %u ok, %u too long, %u syntax errors\n",
+        (unsigned)fuzz_runs, (unsigned)seed, (unsigned)statuses[FORM_OK],
+        (unsigned)statuses[FORM_ERR_FIELD_TOO_LONG], (unsigned)statuses[FORM_ERR_SYNTAX]);
+    printf("failures    : %u\n", (unsigned)failures);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
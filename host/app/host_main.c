@@ -0,0 +1,405 @@
+#include "app_config.h"
+#include "comfort.h"
+#include "display.h"
+#include "history.h"
+#include "i2c_rec.h"
+#include "main.h"
+#include "measurment.h"
+#include "mem_map.h"
+#include "metrics.h"
+#include "readings.h"
+
+#include "esp_log.h"
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "host_port.h"
+#include "i2c_sim.h"
+#include "sim_devices.h"
+#include "sim_env.h"
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define HOST_DEFAULT_SAMPLES    1000
+#define HOST_REPLAY_WAIT_MS     10000
+
+// samples before the heap has to stay untouched
+#define HOST_WARMUP_SAMPLES     10
+
+/**
+ * Allowed difference between a sample and the environment at the time
+ * it is received: the sensors are read up to a second earlier
+*/
+#define TOLERANCE_TEMPERATURE   0.1f    // °C
+#define TOLERANCE_HUMIDITY      0.3f    // %RH
+#define TOLERANCE_PRESSURE      0.05f   // mmHg
+#define TOLERANCE_ECO2          5       // ppm
+#define TOLERANCE_TVOC          5       // ppb
+
+#define PA_TO_MMHG              0.00750062f
+
+static const char *TAG = "HOST";
+
+MEM_SEMAPHORE(mem_i2c, "i2c");
+MEM_QUEUE(mem_sensors_queue, "sensors", 1, sizeof(sensors_data_t));
+MEM_TASK(mem_meas, "meas", MEM_STACK_MEAS);
+#if HOST_DISPLAY
+MEM_QUEUE(mem_display_queue, "display", 1, sizeof(sensors_data_t));
+MEM_TASK(mem_disp, "disp", MEM_STACK_DISP);
+#endif
+
+typedef struct {
+    float temperature;
+    float humidity;
+    float pressure;
+    int eco2;
+    int tvoc;
+    uint32_t failures;
+} check_t;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [-n samples] [-i interval_ms] [-c n] [-r recording] [-R recording] [-d] [-p] [-t] [-v]\n"
+        "  -n  samples to collect, default %d\n"
+        "  -i  measurement interval, default from app_config\n"
+        "  -c  break the AHT21 CRC of every n-th measurement\n"
+        "  -r  replay an I2C recording to the sensor drivers until it is over,\n"
+        "      the samples are not checked against the simulation\n"
+        "  -R  write the I2C recording to a file at the end\n"
+        "  -d  print the display content at the end\n"
+        "  -p  print every sample\n"
+        "  -t  print the latency histograms at the end\n"
+        "  -v  log everything\n",
+        name, HOST_DEFAULT_SAMPLES);
+}
+
+static inline void track(float *max, float error)
+{
+    error = fabsf(error);
+    if(error > *max)
+        *max = error;
+}
+
+/**
+ * @return false if the sample is too far from the simulated environment
+*/
+static bool check_sample(check_t *check, const sensors_data_t *data)
+{
+    sim_env_t env;
+    sim_env_get(esp_timer_get_time(), &env);
+
+    const float temperature = data->bmp280.temperature - env.temperature;
+    const float humidity = data->aht21.humidity - env.humidity;
+    const float pressure = data->bmp280.pressure - env.pressure * PA_TO_MMHG;
+    const int eco2 = abs((int)data->ens160.eco2 - env.eco2);
+    const int tvoc = abs((int)data->ens160.tvoc - env.tvoc);
+
+    track(&check->temperature, temperature);
+    track(&check->temperature, data->aht21.temperature - env.temperature);
+    track(&check->humidity, humidity);
+    track(&check->pressure, pressure);
+    if(eco2 > check->eco2)
+        check->eco2 = eco2;
+    if(tvoc > check->tvoc)
+        check->tvoc = tvoc;
+
+    const bool ok = fabsf(temperature) <= TOLERANCE_TEMPERATURE
+        && fabsf(data->aht21.temperature - env.temperature) <= TOLERANCE_TEMPERATURE
+        && fabsf(humidity) <= TOLERANCE_HUMIDITY
+        && fabsf(pressure) <= TOLERANCE_PRESSURE
+        && eco2 <= TOLERANCE_ECO2
+        && tvoc <= TOLERANCE_TVOC
+        && abs((int)data->ens160.aqi - env.aqi) <= 1;
+
+    if(!ok) {
+        check->failures++;
+        ESP_LOGE(TAG, "sample off: %.2f/%.2f °C %.2f %% %.2f mmHg %u ppm %u ppb, expected %.2f °C %.2f %% %.2f mmHg %u ppm %u ppb",
+            data->bmp280.temperature, data->aht21.temperature, data->aht21.humidity, 
+            data->bmp280.pressure, data->ens160.eco2, data->ens160.tvoc,
+            env.temperature, env.humidity, env.pressure * PA_TO_MMHG, env.eco2, env.tvoc);
+    }
+
+    return ok;
+}
+
+/**
+ * @brief Sweep the derived readings over the whole sensor range against libm
+ * @return false if one is off by more than its bound in comfort.h
+*/
+static bool check_comfort(void)
+{
+    float dew_point = 0, abs_humidity = 0, altitude = 0;
+
+    for(float t = -40.0f; t <= 85.0f; t += 0.05f)
+        for(float rh = 1.0f; rh <= 100.0f; rh += 0.25f)
+        {
+            track(&dew_point, comfort_dew_point(t, rh) - comfort_dew_point_libm(t, rh));
+            track(&abs_humidity, comfort_absolute_humidity(t, rh) - comfort_absolute_humidity_libm(t, rh));
+        }
+
+    for(float hpa = 300.0f; hpa <= 1100.0f; hpa += 0.01f)
+    {
+        const float mmhg = hpa / COMFORT_MMHG_TO_HPA;
+        track(&altitude, comfort_altitude(mmhg) - comfort_altitude_libm(mmhg));
+    }
+
+    printf("comfort     : max error %.6f °C dew point, %.6f g/m³, %.4f m altitude\n",
+        dew_point, abs_humidity, altitude);
+
+    return dew_point <= COMFORT_DEW_POINT_MAX_ERROR
+        && abs_humidity <= COMFORT_ABS_HUMIDITY_MAX_ERROR
+        && altitude <= COMFORT_ALTITUDE_MAX_ERROR;
+}
+
+static void print_sample(uint32_t index, const sensors_data_t *data)
+{
+    printf("sample %u: %.2f °C %.2f %%RH | %.2f °C %.2f mmHg | AQI %u %u ppb %u ppm status 0x%02x\n",
+        (unsigned)index, data->aht21.temperature, data->aht21.humidity,
+        data->bmp280.temperature, data->bmp280.pressure,
+        data->ens160.aqi, data->ens160.tvoc, data->ens160.eco2, data->ens160.status);
+}
+
+/**
+ * @return the content of `path`, NUL terminated, NULL on failure
+*/
+static char *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if(f == NULL)
+        return NULL;
+
+    char *text = NULL;
+    if(fseek(f, 0, SEEK_END) == 0) {
+        const long size = ftell(f);
+        rewind(f);
+        text = size >= 0 ? malloc(size + 1) : NULL;
+        if(text && fread(text, 1, size, f) == (size_t)size) {
+            text[size] = '\0';
+            *len = size;
+        } else {
+            free(text);
+            text = NULL;
+        }
+    }
+    fclose(f);
+    return text;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = HOST_DEFAULT_SAMPLES;
+    uint32_t interval_ms = 0;
+    uint32_t corrupt_every = 0;
+    bool dump_display = false;
+    bool verbose = false;
+    bool print_trace = false;
+    bool print_samples = false;
+    const char *replay_path = NULL;
+    const char *record_path = NULL;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:i:c:r:R:dptvh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': samples = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'i': interval_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'c': corrupt_every = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'r': replay_path = optarg; break;
+        case 'R': record_path = optarg; break;
+        case 'd': dump_display = true; break;
+        case 'p': print_samples = true; break;
+        case 't': print_trace = true; break;
+        case 'v': verbose = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    esp_log_level_set("*", verbose ? ESP_LOG_VERBOSE : ESP_LOG_WARN);
+
+    host_port_init("main", ESP_TASK_MAIN_PRIO);
+    i2c_sim_attach_board();
+    aht21_sim_corrupt_every(corrupt_every);
+
+    if(replay_path) {
+        size_t len;
+        char *text = read_file(replay_path, &len);
+        esp_err_t err = text ? i2c_replay_load(text, len) : ESP_ERR_NOT_FOUND;
+        free(text);
+        if(err != ESP_OK) {
+            fprintf(stderr, "cannot replay %s: %s\n", replay_path, esp_err_to_name(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the check compares raw physics, calibration would only shift it
+    app_config_init();
+    app_config_t config = *app_config_get();
+    config.aht21_temperature_offset = 0.0f;
+    config.aht21_humidity_gain = 1.0f;
+    config.bmp280_temperature_offset = 0.0f;
+    config.bmp280_pressure_gain = 1.0f;
+    if(interval_ms)
+        config.measurement_interval_ms = interval_ms;
+    if(app_config_set(&config) != ESP_OK) {
+        fprintf(stderr, "invalid interval %u ms\n", (unsigned)interval_ms);
+        return EXIT_FAILURE;
+    }
+
+    SemaphoreHandle_t i2c_smphr = mem_mutex_create(&mem_i2c);
+    QueueHandle_t sensors_queue = mem_queue_create(&mem_sensors_queue);
+
+    assert(i2c_smphr != NULL);
+    assert(sensors_queue != NULL);
+
+    TaskHandle_t task;
+
+#if HOST_DISPLAY
+    QueueHandle_t display_queue = mem_queue_create(&mem_display_queue);
+    assert(display_queue != NULL);
+
+    display_task_config_t display_task_config = {
+        .i2c_smphr = i2c_smphr,
+        .queue = display_queue
+    };
+    mem_task_create(&mem_disp, display_task, (void*) &display_task_config, 
+        ESP_TASK_PRIO_MIN + 2, &task, tskNO_AFFINITY
+    );
+    metrics_register_task(task);
+#endif
+
+    measurment_task_config_t measurment_task_config = {
+        .i2c_smphr = i2c_smphr,
+        .sensors_queue = sensors_queue
+    };
+    mem_task_create(&mem_meas, measurment_task, (void*) &measurment_task_config, 
+        ESP_TASK_PRIO_MIN + 3, &task, tskNO_AFFINITY
+    );
+    metrics_register_task(task);
+    mem_report();
+
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    check_t check = { 0 };
+    sensors_data_t sensors_data;
+    uint32_t alarms = 0;
+    uint32_t collected = 0;
+    uint32_t warm_allocations = 0;
+    // a period, and the time a replay may pause
+    const uint32_t wait_ms = config.measurement_interval_ms + HOST_REPLAY_WAIT_MS;
+
+    for(; collected < samples; collected++)
+    {
+        // the steady state starts once every path has run
+        if(collected == HOST_WARMUP_SAMPLES)
+            warm_allocations = host_heap_allocations();
+
+        // past a recording the simulated parts answer again, but were never set up
+        BaseType_t received;
+        do {
+            received = xQueueReceive(sensors_queue, &sensors_data, pdMS_TO_TICKS(wait_ms));
+        } while(received != pdTRUE && replay_path && i2c_replay_active());
+
+        if(replay_path && !i2c_replay_active())
+            break;
+        if(received != pdTRUE) {
+            // the measurement task is stuck, e.g. on the I2C mutex
+            ESP_LOGE(TAG, "no sample for %u ms", (unsigned)wait_ms);
+            check.failures++;
+            break;
+        }
+        TRACE_STAMP(&sensors_data.trace, TRACE_DISPATCHED);
+
+        readings_publish(&sensors_data);
+        history_add(&sensors_data);
+        if(replay_path == NULL)
+            check_sample(&check, &sensors_data);
+        if(print_samples)
+            print_sample(collected, &sensors_data);
+
+#if HOST_DISPLAY
+        if(xQueueSend(display_queue, &sensors_data, pdMS_TO_TICKS(50)) != pdTRUE)
+            METRICS_INC(g_metrics.queue_overruns[METRICS_QUEUE_DISPLAY]);
+#endif
+
+        const app_config_t *current = app_config_get();
+        if(sensors_data.ens160.aqi > current->alarm_aqi && sensors_data.ens160.eco2 > current->alarm_eco2_ppm)
+            alarms++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+    const uint32_t steady_allocations = collected > HOST_WARMUP_SAMPLES
+        ? host_heap_allocations() - warm_allocations : 0;
+
+    const double wall_s = (double)(wall_end.tv_sec - wall_start.tv_sec)
+        + (double)(wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    const double simulated_s = (double)esp_timer_get_time() / 1e6;
+
+    uint32_t transactions = 0, errors = 0;
+    for(int i = 0; i < METRICS_I2C_COUNT; i++) {
+        transactions += g_metrics.i2c[i].transactions;
+        errors += g_metrics.i2c[i].errors;
+    }
+
+    printf("samples     : %u in %.1f simulated s, %.3f s wall, %.0f samples/s\n",
+        (unsigned)collected, simulated_s, wall_s, wall_s > 0 ? collected / wall_s : 0.0);
+    if(replay_path == NULL)
+        printf("max error   : %.3f °C, %.3f %%RH, %.3f mmHg, %d ppm eCO2, %d ppb TVOC\n",
+            check.temperature, check.humidity, check.pressure, check.eco2, check.tvoc);
+    printf("i2c         : %u transactions, %u errors\n", (unsigned)transactions, (unsigned)errors);
+    if(corrupt_every)
+        printf("aht21 crc   : %u measurements corrupted\n", (unsigned)aht21_sim_corrupted());
+    if(replay_path) {
+        i2c_replay_stats_t replay;
+        i2c_replay_get_stats(&replay);
+        printf("replay      : %u of %u transactions served, %u skipped, %u diverged\n",
+            (unsigned)replay.served, (unsigned)replay.entries,
+            (unsigned)replay.skipped, (unsigned)replay.diverged);
+    }
+    printf("alarms      : %u\n", (unsigned)alarms);
+    printf("memory      : %u bytes static, %u bytes heap, %u heap allocations in the steady state\n",
+        (unsigned)mem_static_bytes(), (unsigned)mem_heap_bytes(), (unsigned)steady_allocations);
+    printf("jitter      : max %u us\n", (unsigned)g_metrics.sample_jitter.jitter_max_us);
+#if HOST_DISPLAY
+    printf("display     : %u frames, %s\n", (unsigned)ssd1306_sim_frames(),
+        ssd1306_sim_is_on() ? "on" : "off");
+    if(dump_display)
+        ssd1306_sim_dump(stdout, 32);
+#else
+    if(dump_display)
+        fprintf(stderr, "built without the display, see HOST_DISPLAY\n");
+#endif
+    if(!check_comfort())
+        check.failures++;
+#if MEM_STATIC_ENABLE == 1
+    // every MEM_* object has its storage reserved
+    if(mem_heap_bytes() != 0) {
+        ESP_LOGE(TAG, "%u bytes of MEM_* objects on the heap", (unsigned)mem_heap_bytes());
+        check.failures++;
+    }
+#endif
+    printf("failures    : %u\n", (unsigned)check.failures);
+    if(print_trace)
+        trace_print(stdout);
+
+    if(record_path) {
+        FILE *f = fopen(record_path, "w");
+        if(f == NULL) {
+            fprintf(stderr, "cannot write %s\n", record_path);
+            return EXIT_FAILURE;
+        }
+        i2c_rec_dump(f);
+        fclose(f);
+    }
+
+    // the other tasks stay parked, there is no scheduler to stop
+    exit(check.failures || errors || steady_allocations ? EXIT_FAILURE : EXIT_SUCCESS);
+}
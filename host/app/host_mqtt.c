@@ -0,0 +1,215 @@
+#include "history.h"
+#include "main.h"
+#include "mem_map.h"
+#include "mqtt_pub.h"
+
+#include "esp_log.h"
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "host_port.h"
+#include "mqtt_sim.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_DEFAULT_SAMPLES    3600
+#define HOST_INTERVAL_MS        1000
+
+// samples before the heap has to stay untouched
+#define HOST_WARMUP_SAMPLES     10
+
+// samples taken while the broker is down, the queue overflows
+#define HOST_OUTAGE_SAMPLES     (MQTT_QUEUE_CAPACITY + 100)
+
+#define HOST_DRAIN_TIMEOUT_MS   60000
+#define HOST_POLL_MS            1
+
+static const char *TAG = "HOST";
+
+static uint32_t s_failures = 0;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [-n samples] [-v]\n"
+        "  -n  samples published while the broker is up, default %d\n"
+        "  -v  log everything\n",
+        name, HOST_DEFAULT_SAMPLES);
+}
+
+static void expect(bool ok, const char *what)
+{
+    if(!ok) {
+        s_failures++;
+        ESP_LOGE(TAG, "failed: %s", what);
+    }
+}
+
+static void make_sample(sensors_data_t *data, uint32_t index)
+{
+    memset(data, 0, sizeof(*data));
+    data->aht21.temperature = 21.0f + (index % 100) * 0.01f;
+    data->aht21.humidity = 45.0f;
+    data->aht21.crc_ok = true;
+    data->bmp280.temperature = data->aht21.temperature;
+    data->bmp280.pressure = 750.0f;
+    data->ens160.aqi = 2;
+    data->ens160.tvoc = 120;
+    data->ens160.eco2 = 650;
+}
+
+/**
+ * @return virtual ms until the queue was empty, -1 on timeout
+*/
+static int64_t drain(void)
+{
+    const int64_t start_us = esp_timer_get_time();
+    mqtt_pub_stats_t stats;
+
+    while(true)
+    {
+        mqtt_pub_get_stats(&stats);
+        if(stats.queued == 0)
+            return (esp_timer_get_time() - start_us) / 1000;
+        if(esp_timer_get_time() - start_us > HOST_DRAIN_TIMEOUT_MS * 1000LL)
+            return -1;
+        vTaskDelay(pdMS_TO_TICKS(HOST_POLL_MS));
+    }
+}
+
+static double cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = HOST_DEFAULT_SAMPLES;
+    bool verbose = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': samples = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'v': verbose = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    esp_log_level_set("*", verbose ? ESP_LOG_VERBOSE : ESP_LOG_WARN);
+
+    host_port_init("main", ESP_TASK_MAIN_PRIO);
+
+    sensors_data_t data;
+    mqtt_pub_stats_t stats;
+    mqtt_sim_stats_t broker;
+
+    // before the client exists nothing is queued, nothing is dropped
+    for(uint32_t i = 0; i < MQTT_QUEUE_CAPACITY * 2; i++) {
+        make_sample(&data, i);
+        mqtt_pub_add(&data);
+    }
+    mqtt_pub_get_stats(&stats);
+    expect(stats.queued == 0 && stats.dropped == 0, "samples queued without a client");
+
+    mqtt_pub_start();
+    vTaskDelay(pdMS_TO_TICKS(MQTT_SIM_CONNECT_MS * 2));
+    mqtt_pub_get_stats(&stats);
+    mqtt_sim_get_stats(&broker);
+    expect(stats.connected && broker.online, "connected and online");
+
+    // live: every sample goes alone as it comes
+    const double cpu_start = cpu_seconds();
+    uint32_t warm_allocations = host_heap_allocations();
+
+    for(uint32_t i = 0; i < samples; i++)
+    {
+        if(i == HOST_WARMUP_SAMPLES)
+            warm_allocations = host_heap_allocations();
+        make_sample(&data, i);
+        mqtt_pub_add(&data);
+        vTaskDelay(pdMS_TO_TICKS(HOST_INTERVAL_MS));
+    }
+    expect(drain() >= 0, "live samples drained");
+
+    const double cpu_live = cpu_seconds() - cpu_start;
+    mqtt_pub_get_stats(&stats);
+    mqtt_sim_get_stats(&broker);
+    const mqtt_sim_stats_t live = broker;
+    expect(broker.records == samples && stats.published == samples, "every live sample published");
+    expect(broker.gaps == 0 && broker.duplicates == 0 && stats.dropped == 0, "live samples in order");
+
+    // outage: the queue keeps the newest MQTT_QUEUE_CAPACITY samples
+    mqtt_sim_set_up(false);
+    vTaskDelay(pdMS_TO_TICKS(HOST_POLL_MS));
+    mqtt_pub_get_stats(&stats);
+    mqtt_sim_get_stats(&broker);
+    expect(!stats.connected && !broker.online, "disconnected, last will published");
+
+    for(uint32_t i = 0; i < HOST_OUTAGE_SAMPLES; i++) {
+        make_sample(&data, i);
+        mqtt_pub_add(&data);
+        vTaskDelay(pdMS_TO_TICKS(HOST_INTERVAL_MS));
+    }
+    mqtt_pub_get_stats(&stats);
+    expect(stats.queued == MQTT_QUEUE_CAPACITY, "queue full during the outage");
+    expect(stats.dropped == HOST_OUTAGE_SAMPLES - MQTT_QUEUE_CAPACITY, "oldest samples dropped");
+
+    // replay: batches of MQTT_BATCH_MAX, one in flight
+    const double cpu_replay_start = cpu_seconds();
+    mqtt_sim_set_up(true);
+    const int64_t replay_ms = drain();
+    const double cpu_replay = cpu_seconds() - cpu_replay_start;
+    expect(replay_ms >= 0, "backlog drained");
+
+    mqtt_sim_get_stats(&broker);
+    const uint32_t replay_messages = broker.messages - live.messages;
+    expect(broker.records - live.records == MQTT_QUEUE_CAPACITY, "backlog published");
+    expect(replay_messages == (MQTT_QUEUE_CAPACITY + MQTT_BATCH_MAX - 1) / MQTT_BATCH_MAX, "backlog batched");
+    expect(broker.gaps == HOST_OUTAGE_SAMPLES - MQTT_QUEUE_CAPACITY, "only the dropped samples missing");
+    expect(broker.duplicates == 0 && broker.online, "online again, no duplicates");
+
+    // a disconnect with a batch in flight: it is sent again, never lost
+    for(uint32_t i = 0; i < MQTT_QUEUE_CAPACITY; i++) {
+        make_sample(&data, i);
+        mqtt_pub_add(&data);
+    }
+    vTaskDelay(pdMS_TO_TICKS(MQTT_SIM_RTT_MS * 4 + 1));
+    mqtt_sim_set_up(false);
+    vTaskDelay(pdMS_TO_TICKS(HOST_INTERVAL_MS));
+    mqtt_sim_set_up(true);
+    expect(drain() >= 0, "drained after the flap");
+
+    const uint32_t gaps_before = broker.gaps;
+    mqtt_sim_get_stats(&broker);
+    expect(broker.gaps == gaps_before, "no sample lost in the flap");
+    expect(broker.duplicates <= MQTT_BATCH_MAX, "at most one batch sent twice");
+
+    const uint32_t steady_allocations = host_heap_allocations() - warm_allocations;
+
+    printf("live        : %u samples in %u messages, %.2f us host CPU per sample\n",
+        (unsigned)live.records, (unsigned)live.messages, samples ? cpu_live * 1e6 / samples : 0.0);
+    printf("replay      : %u samples in %u messages, %lld ms virtual (%.0f samples/s at %d ms RTT), %.2f us host CPU per sample\n",
+        (unsigned)MQTT_QUEUE_CAPACITY, (unsigned)replay_messages, (long long)replay_ms,
+        replay_ms > 0 ? MQTT_QUEUE_CAPACITY * 1000.0 / replay_ms : 0.0, MQTT_SIM_RTT_MS,
+        cpu_replay * 1e6 / MQTT_QUEUE_CAPACITY);
+    printf("broker      : %u connects, %u records, %u bytes, %u gaps, %u duplicates\n",
+        (unsigned)broker.connects, (unsigned)broker.records, (unsigned)broker.bytes,
+        (unsigned)broker.gaps, (unsigned)broker.duplicates);
+    printf("memory      : %u bytes queue, %u bytes static, %u bytes heap, %u heap allocations in the steady state\n",
+        (unsigned)(MQTT_QUEUE_CAPACITY * sizeof(history_record_t)),
+        (unsigned)mem_static_bytes(), (unsigned)mem_heap_bytes(), (unsigned)steady_allocations);
+    printf("failures    : %u\n", (unsigned)s_failures);
+
+    // the other tasks stay parked, there is no scheduler to stop
+    exit(s_failures || steady_allocations ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,251 @@
+#include "main.h"
+#include "metrics.h"
+#include "ota.h"
+
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "flash_sim.h"
+#include "host_port.h"
+#include "mbedtls/sha256.h"
+#include "range_server.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// not a multiple of the range size, the last range is short
+#define HOST_IMAGE_SIZE         (4 * OTA_PULL_RANGE_SIZE + 12345)
+#define HOST_IMAGE_MAGIC        0xe9
+
+// Wi-Fi to a server on the LAN
+#define HOST_LINK_KBPS          4000
+
+#define HOST_POLL_MS            100
+#define HOST_WAIT_MS            600000
+
+// ranges served before the server goes down in the middle of a download
+#define HOST_RANGES_BEFORE_DOWN 2
+
+static const char *TAG = "HOST";
+
+static uint8_t s_image[HOST_IMAGE_SIZE];
+static char s_url[64];
+static char s_sha256[65];
+static volatile bool s_rebooted = false;
+static uint32_t s_failures = 0;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [-v]\n"
+        "  -v  log everything\n",
+        name);
+}
+
+static void expect(bool ok, const char *what)
+{
+    if(!ok) {
+        s_failures++;
+        ESP_LOGE(TAG, "failed: %s", what);
+    }
+}
+
+/**
+ * @brief The device restarts into the new image, here the update just ends
+*/
+void reboot_task(void *arg)
+{
+    (void)arg;
+    s_rebooted = true;
+    ota_release();
+    vTaskDelete(NULL);
+}
+
+static void sha256_hex(const uint8_t *data, size_t len, char *hex)
+{
+    mbedtls_sha256_context ctx;
+    uint8_t digest[32];
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, data, len);
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+
+    for(int i = 0; i < 32; i++)
+        sprintf(hex + 2 * i, "%02x", digest[i]);
+}
+
+static void make_image(uint32_t seed)
+{
+    uint32_t x = seed;
+    for(size_t i = 0; i < sizeof(s_image); i++) {
+        x = x * 1664525u + 1013904223u;
+        s_image[i] = (uint8_t)(x >> 24);
+    }
+    s_image[0] = HOST_IMAGE_MAGIC;
+    sha256_hex(s_image, sizeof(s_image), s_sha256);
+}
+
+/**
+ * @brief Wait until the pull task has ended
+ * @return virtual ms it took, to HOST_POLL_MS
+*/
+static int64_t wait_done(void)
+{
+    const int64_t start_us = esp_timer_get_time();
+
+    while(esp_timer_get_time() - start_us < HOST_WAIT_MS * 1000LL)
+    {
+        vTaskDelay(pdMS_TO_TICKS(HOST_POLL_MS));
+        // the task releases the update when it ends
+        if(ota_acquire()) {
+            ota_release();
+            break;
+        }
+    }
+    return (esp_timer_get_time() - start_us) / 1000;
+}
+
+static void begin(const char *name)
+{
+    ESP_LOGI(TAG, "%s", name);
+    s_rebooted = false;
+    flash_sim_reset();
+    range_server_reset_stats();
+    METRICS_SET(g_metrics.ota_state, OTA_STATE_IDLE);
+}
+
+static bool installed(void)
+{
+    return s_rebooted && flash_sim_boot_partition() != NULL
+        && memcmp(flash_sim_update_data(), s_image, sizeof(s_image)) == 0;
+}
+
+/**
+ * @brief Nothing is left to resume: a resume asks the server for nothing
+*/
+static bool nothing_saved(void)
+{
+    range_server_stats_t before, after;
+
+    range_server_get_stats(&before);
+    ota_pull_resume();
+    wait_done();
+    range_server_get_stats(&after);
+    return after.requests == before.requests;
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'v': verbose = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    esp_log_level_set("*", verbose ? ESP_LOG_VERBOSE : ESP_LOG_WARN);
+
+    host_port_init("main", ESP_TASK_MAIN_PRIO);
+    http_client_sim_set_link_kbps(HOST_LINK_KBPS);
+
+    char abc[65];
+    sha256_hex((const uint8_t *)"abc", 3, abc);
+    expect(strcmp(abc, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") == 0,
+        "SHA-256 of \"abc\"");
+
+    const uint16_t port = range_server_start(s_image, sizeof(s_image));
+    if(port == 0)
+        return EXIT_FAILURE;
+    snprintf(s_url, sizeof(s_url), "http://127.0.0.1:%u/air-quality-alarmer.bin", port);
+
+    range_server_stats_t server;
+    flash_sim_stats_t flash;
+
+    // 206: the server goes down mid-way, the download gives up and keeps its offset
+    begin("206 resume");
+    make_image(1);
+    range_server_set_mode(RANGE_SERVER_PARTIAL, HOST_RANGES_BEFORE_DOWN);
+    expect(ota_pull_start(s_url, s_sha256) == ESP_OK, "pull started");
+    wait_done();
+    range_server_get_stats(&server);
+    expect(METRICS_GET(g_metrics.ota_state) == OTA_STATE_FAILED && !s_rebooted, "gave up while the server is down");
+    expect(server.partial == HOST_RANGES_BEFORE_DOWN && server.refused == OTA_PULL_MAX_RETRIES + 1,
+        "retried before giving up");
+
+    // up again, as on a new IP_EVENT_STA_GOT_IP
+    range_server_reset_stats();
+    range_server_set_mode(RANGE_SERVER_PARTIAL, 0);
+    ota_pull_resume();
+    const int64_t resume_ms = wait_done();
+    range_server_get_stats(&server);
+    expect(server.first_start == HOST_RANGES_BEFORE_DOWN * OTA_PULL_RANGE_SIZE, "resumed from the saved offset");
+    expect(server.full == 0 && server.bytes == sizeof(s_image) - server.first_start, "only the rest fetched, all 206");
+    expect(installed(), "resumed image installed");
+    expect(nothing_saved(), "state cleared after the update");
+    printf("206 resume  : from %u, %u bytes in %u ranges, %lld ms virtual, %u bytes/s\n",
+        (unsigned)server.first_start, (unsigned)server.bytes, (unsigned)server.partial,
+        (long long)resume_ms, (unsigned)(server.bytes * 1000LL / resume_ms));
+
+    // 200 at offset 0: a server without Range support, the image comes whole
+    begin("200 at offset 0");
+    make_image(2);
+    range_server_set_mode(RANGE_SERVER_FULL, 0);
+    expect(ota_pull_start(s_url, s_sha256) == ESP_OK, "pull started");
+    const int64_t full_ms = wait_done();
+    range_server_get_stats(&server);
+    expect(server.requests == 1 && server.full == 1, "one 200 answer");
+    expect(installed(), "whole image installed");
+    printf("200 whole   : %u bytes in 1 answer, %lld ms virtual, %u bytes/s\n",
+        (unsigned)server.bytes, (long long)full_ms, (unsigned)(server.bytes * 1000LL / full_ms));
+
+    // 200 at a non-zero offset: the server lost Range support, the download is dropped
+    begin("200 at an offset");
+    make_image(3);
+    range_server_set_mode(RANGE_SERVER_PARTIAL, 1);
+    expect(ota_pull_start(s_url, s_sha256) == ESP_OK, "pull started");
+    wait_done();
+    range_server_set_mode(RANGE_SERVER_FULL, 0);
+    range_server_reset_stats();
+    ota_pull_resume();
+    wait_done();
+    range_server_get_stats(&server);
+    expect(server.requests == 1 && server.first_start == OTA_PULL_RANGE_SIZE, "resumed with a Range request");
+    expect(METRICS_GET(g_metrics.ota_state) == OTA_STATE_FAILED, "200 at an offset rejected");
+    expect(!s_rebooted && flash_sim_boot_partition() == NULL, "nothing installed");
+    expect(nothing_saved(), "download dropped");
+
+    // SHA-256 mismatch: downloaded in full, never booted
+    begin("sha256 mismatch");
+    make_image(4);
+    s_sha256[0] = s_sha256[0] == '0' ? '1' : '0';
+    range_server_set_mode(RANGE_SERVER_PARTIAL, 0);
+    expect(ota_pull_start(s_url, s_sha256) == ESP_OK, "pull started");
+    wait_done();
+    range_server_get_stats(&server);
+    expect(server.bytes == sizeof(s_image), "image downloaded");
+    expect(METRICS_GET(g_metrics.ota_state) == OTA_STATE_FAILED, "hash mismatch detected");
+    expect(!s_rebooted && flash_sim_boot_partition() == NULL, "nothing installed");
+    expect(nothing_saved(), "download dropped");
+
+    flash_sim_get_stats(&flash);
+    expect(flash.dirty_writes == 0, "every write on erased flash");
+
+    printf("flash       : %u bytes erased, %u written, %u writes over bits not erased\n",
+        (unsigned)flash.erased, (unsigned)flash.written, (unsigned)flash.dirty_writes);
+    printf("failures    : %u\n", (unsigned)s_failures);
+
+    // the other tasks stay parked, there is no scheduler to stop
+    exit(s_failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,244 @@
+#include "main.h"
+#include "readings.h"
+#include "stream.h"
+
+#include "esp_log.h"
+#include "esp_task.h"
+#include "host_port.h"
+#include "httpd_sim.h"
+#include "lwip/sockets.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_DEFAULT_BROADCASTS 1000
+
+// the slow reader has to be evicted within this many samples
+#define HOST_EVICT_BROADCASTS   1000
+#define HOST_SLOW_RCVBUF        1024
+
+#define HOST_READ_SIZE          4096
+
+extern esp_err_t api_stream_get_handler(httpd_req_t *req);
+
+static const char *TAG = "HOST";
+
+typedef struct {
+    int client;             // our end
+    int server;             // the end of the http server
+    uint32_t events;
+    char last;              // an event ends with an empty line
+} reader_t;
+
+static uint32_t s_failures = 0;
+static uint32_t s_seq = 0;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [-n broadcasts] [-v]\n"
+        "  -n  samples broadcast at each client count, default %d\n"
+        "  -v  log everything\n",
+        name, HOST_DEFAULT_BROADCASTS);
+}
+
+static void expect(bool ok, const char *what)
+{
+    if(!ok) {
+        s_failures++;
+        ESP_LOGE(TAG, "failed: %s", what);
+    }
+}
+
+static double cpu_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+/**
+ * @return the status line the client got
+*/
+static const char *subscribe(reader_t *r, int rcvbuf)
+{
+    static char line[HOST_READ_SIZE];
+    httpd_req_t req;
+
+    memset(r, 0, sizeof(*r));
+    r->server = httpd_sim_connect(rcvbuf, &r->client);
+    if(r->server < 0)
+        return "no connection";
+
+    httpd_sim_request(&req, r->server);
+    api_stream_get_handler(&req);
+
+    // the headers and the retry line, or the whole refusal
+    const ssize_t len = recv(r->client, line, sizeof(line) - 1, 0);
+    line[len > 0 ? len : 0] = '\0';
+    r->last = len > 0 ? line[len - 1] : '\0';
+    line[strcspn(line, "\r")] = '\0';
+    return line;
+}
+
+static void leave(reader_t *r)
+{
+    // what the close callback of web.c does
+    stream_forget(r->server);
+    close(r->server);
+    close(r->client);
+}
+
+static void drain(reader_t *r)
+{
+    char buf[HOST_READ_SIZE];
+    ssize_t len;
+
+    while((len = recv(r->client, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+        for(ssize_t i = 0; i < len; i++) {
+            if(buf[i] == '\n' && r->last == '\n')
+                r->events++;
+            r->last = buf[i];
+        }
+    }
+}
+
+static void make_sample(sensors_data_t *data)
+{
+    memset(data, 0, sizeof(*data));
+    data->aht21.temperature = 21.0f + (s_seq % 100) * 0.01f;
+    data->aht21.humidity = 45.0f;
+    data->aht21.crc_ok = true;
+    data->bmp280.temperature = data->aht21.temperature;
+    data->bmp280.pressure = 750.0f;
+    data->ens160.aqi = 2;
+    data->ens160.tvoc = 120;
+    data->ens160.eco2 = 650;
+    s_seq++;
+}
+
+/**
+ * @brief Publish a sample and let the server task send it
+ * @return host CPU of the broadcast, us
+*/
+static double broadcast(void)
+{
+    sensors_data_t data;
+
+    make_sample(&data);
+    readings_publish(&data);
+    stream_notify();
+
+    const double start = cpu_us();
+    httpd_sim_run();
+    return cpu_us() - start;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t broadcasts = HOST_DEFAULT_BROADCASTS;
+    bool verbose = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': broadcasts = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'v': verbose = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    esp_log_level_set("*", verbose ? ESP_LOG_VERBOSE : ESP_LOG_WARN);
+
+    host_port_init("main", ESP_TASK_MAIN_PRIO);
+    if(httpd_sim_start() == NULL)
+        return EXIT_FAILURE;
+
+    reader_t readers[STREAM_MAX_CLIENTS];
+    stream_stats_t stats;
+    uint32_t warm_allocations = 0;
+
+    // the cost of a sample as the clients come
+    printf("%-8s %14s %14s %18s\n", "clients", "last_cost_us", "max_cost_us", "host CPU us/sample");
+    for(uint32_t n = 1; n <= STREAM_MAX_CLIENTS; n++)
+    {
+        reader_t *r = &readers[n - 1];
+        expect(strstr(subscribe(r, 0), " 200 ") != NULL, "client subscribed");
+
+        uint64_t cost_sum = 0;
+        uint32_t cost_max = 0;
+        double cpu_sum = 0;
+
+        for(uint32_t i = 0; i < broadcasts; i++)
+        {
+            if(n == 1 && i == 1)
+                warm_allocations = host_heap_allocations();
+            cpu_sum += broadcast();
+            stream_get_stats(&stats);
+            cost_sum += stats.last_cost_us;
+            if(stats.last_cost_us > cost_max)
+                cost_max = stats.last_cost_us;
+            for(uint32_t k = 0; k < n; k++)
+                drain(&readers[k]);
+        }
+
+        expect(stats.clients == n, "every client in the pool");
+        expect(r->events == broadcasts, "every sample received");
+        printf("%-8u %14.1f %14u %18.2f\n", (unsigned)n,
+            broadcasts ? (double)cost_sum / broadcasts : 0.0, (unsigned)cost_max,
+            broadcasts ? cpu_sum / broadcasts : 0.0);
+    }
+
+    // the pool is full
+    reader_t extra;
+    expect(strstr(subscribe(&extra, 0), " 503 ") != NULL, "client over the cap refused");
+    close(extra.server);
+    close(extra.client);
+
+    // a reader that never reads takes the place of the last one
+    reader_t *slow = &readers[STREAM_MAX_CLIENTS - 1];
+    leave(slow);
+    expect(strstr(subscribe(slow, HOST_SLOW_RCVBUF), " 200 ") != NULL, "slow reader subscribed");
+
+    const uint32_t events_before = readers[0].events;
+    uint32_t sent = 0;
+    do {
+        broadcast();
+        sent++;
+        for(uint32_t k = 0; k < STREAM_MAX_CLIENTS - 1; k++)
+            drain(&readers[k]);
+        stream_get_stats(&stats);
+    } while(stats.evicted == 0 && sent < HOST_EVICT_BROADCASTS);
+
+    httpd_sim_stats_t server;
+    httpd_sim_get_stats(&server);
+    expect(stats.evicted == 1 && server.closes == 1 && server.last_closed == slow->server,
+        "slow reader evicted");
+    expect(stats.clients == STREAM_MAX_CLIENTS - 1, "the others kept");
+    expect(readers[0].events - events_before == sent, "the others kept receiving");
+    close(slow->client);
+
+    // its slot is free again
+    expect(strstr(subscribe(slow, 0), " 200 ") != NULL, "freed slot taken again");
+    for(uint32_t k = 0; k < STREAM_MAX_CLIENTS; k++)
+        leave(&readers[k]);
+    stream_get_stats(&stats);
+    expect(stats.clients == 0, "every client forgotten");
+
+    const uint32_t steady_allocations = host_heap_allocations() - warm_allocations;
+
+    printf("eviction    : slow reader evicted after %u samples, %u strikes in a row\n",
+        (unsigned)sent, STREAM_MAX_STRIKES);
+    printf("memory      : %u heap allocations in the steady state\n", (unsigned)steady_allocations);
+    printf("failures    : %u\n", (unsigned)s_failures);
+
+    exit(s_failures || steady_allocations ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,253 @@
+#include "main.h"
+#include "mem_map.h"
+#include "udp_export.h"
+
+#include "esp_log.h"
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "host_port.h"
+#include "lwip/sockets.h"
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#if UDP_EXPORT_GRAPHITE != 0
+#error "aqa_udp checks the InfluxDB line protocol"
+#endif
+
+#define HOST_DEFAULT_SAMPLES    3600
+#define HOST_INTERVAL_MS        1000
+#define HOST_FLUSH_TIMEOUT_MS   1000
+
+// samples before the heap has to stay untouched
+#define HOST_WARMUP_SAMPLES     10
+
+// every datagram of an hour stays queued if the receiver falls behind
+#define HOST_RCVBUF             (1024 * 1024)
+
+// failed lines logged, the rest are only counted
+#define HOST_LOGGED_FAILURES    10
+
+static const char *TAG = "HOST";
+
+typedef struct {
+    int sock;
+    uint32_t datagrams;
+    uint32_t lines;
+    uint32_t failures;
+    int64_t *epoch_ms;      // of every sample pushed, as the exporter read it
+    uint32_t samples;
+} receiver_t;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "usage: %s [-n samples] [-v]\n"
+        "  -n  samples to push to " UDP_EXPORT_HOST ":%d and receive there, default %d\n"
+        "  -v  log everything\n",
+        name, UDP_EXPORT_PORT, HOST_DEFAULT_SAMPLES);
+}
+
+static float sample_temperature(uint32_t index)
+{
+    return 21.0f + (index % 100) * 0.01f;
+}
+
+static void make_sample(sensors_data_t *data, uint32_t index)
+{
+    memset(data, 0, sizeof(*data));
+    data->aht21.temperature = sample_temperature(index);
+    data->aht21.humidity = 45.0f;
+    data->aht21.crc_ok = true;
+    data->bmp280.temperature = data->aht21.temperature;
+    data->bmp280.pressure = 750.0f;
+    data->ens160.aqi = 2;
+    data->ens160.tvoc = 120;
+    data->ens160.eco2 = 650;
+}
+
+static bool receiver_open(receiver_t *rx, uint32_t samples)
+{
+    const int rcvbuf = HOST_RCVBUF;
+    const struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(UDP_EXPORT_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    memset(rx, 0, sizeof(*rx));
+    rx->samples = samples;
+    rx->epoch_ms = calloc(samples ? samples : 1, sizeof(int64_t));
+    rx->sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if(rx->epoch_ms == NULL || rx->sock < 0
+        || setsockopt(rx->sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) != 0
+        || bind(rx->sock, (const struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        perror("receiver on " UDP_EXPORT_HOST);
+        return false;
+    }
+    return true;
+}
+
+static void line_failed(receiver_t *rx, const char *line, const char *what)
+{
+    if(rx->failures++ < HOST_LOGGED_FAILURES)
+        ESP_LOGE(TAG, "line %u: %s: %s", (unsigned)rx->lines, what, line);
+}
+
+/**
+ * @brief Check a line against the sample it stands for, the lines come in the order
+ * of the samples
+*/
+static void check_line(receiver_t *rx, const char *line)
+{
+    char device[8];
+    float temperature, humidity, pressure, dew_point, absolute_humidity, heat_index, altitude;
+    unsigned aqi, tvoc, eco2;
+    long long ts;
+    int end = 0;
+
+    const int fields = sscanf(line, UDP_EXPORT_MEASUREMENT ",device=%7[0-9a-f] "
+        "temperature=%f,humidity=%f,pressure=%f,aqi=%ui,tvoc=%ui,eco2=%ui,"
+        "dew_point=%f,absolute_humidity=%f,heat_index=%f,altitude=%f %lld%n",
+        device, &temperature, &humidity, &pressure, &aqi, &tvoc, &eco2,
+        &dew_point, &absolute_humidity, &heat_index, &altitude, &ts, &end);
+
+    if(rx->lines >= rx->samples)
+        line_failed(rx, line, "more lines than samples");
+    else if(fields != 12 || line[end] != '\0' || strlen(device) != 6)
+        line_failed(rx, line, "malformed");
+    else if(fabsf(temperature - sample_temperature(rx->lines)) > 0.006f
+        || fabsf(humidity - 45.0f) > 0.006f || fabsf(pressure - 750.0f) > 0.06f
+        || aqi != 2 || tvoc != 120 || eco2 != 650)
+        line_failed(rx, line, "not the sample pushed");
+    else if(!(dew_point < temperature) || !(absolute_humidity > 0.0f) || !isfinite(heat_index)
+        || !isfinite(altitude))
+        line_failed(rx, line, "derived values out of range");
+    else if(ts != rx->epoch_ms[rx->lines] * 1000000LL)
+        line_failed(rx, line, "timestamp");
+
+    rx->lines++;
+}
+
+static void receive(receiver_t *rx)
+{
+    char datagram[UDP_EXPORT_DATAGRAM_SIZE + 1];
+    ssize_t len;
+
+    while((len = recv(rx->sock, datagram, sizeof(datagram) - 1, MSG_DONTWAIT)) > 0)
+    {
+        datagram[len] = '\0';
+        rx->datagrams++;
+
+        char *line = datagram;
+        char *nl;
+        while((nl = strchr(line, '\n')) != NULL) {
+            *nl = '\0';
+            check_line(rx, line);
+            line = nl + 1;
+        }
+        if(*line != '\0')
+            line_failed(rx, line, "no line feed");
+    }
+}
+
+static int64_t epoch_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+static double cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = HOST_DEFAULT_SAMPLES;
+    bool verbose = false;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': samples = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'v': verbose = true; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    esp_log_level_set("*", verbose ? ESP_LOG_VERBOSE : ESP_LOG_WARN);
+
+    host_port_init("main", ESP_TASK_MAIN_PRIO);
+
+    receiver_t rx;
+    if(!receiver_open(&rx, samples))
+        return EXIT_FAILURE;
+
+    udp_export_start();
+
+    sensors_data_t data;
+    uint32_t warm_allocations = host_heap_allocations();
+    double rx_cpu_s = 0;
+    const double cpu_start = cpu_seconds();
+
+    for(uint32_t i = 0; i < samples; i++)
+    {
+        if(i == HOST_WARMUP_SAMPLES)
+            warm_allocations = host_heap_allocations();
+        make_sample(&data, i);
+        // udp_export_add() reads the same virtual clock
+        rx.epoch_ms[i] = epoch_ms();
+        udp_export_add(&data);
+        vTaskDelay(pdMS_TO_TICKS(HOST_INTERVAL_MS));
+
+        const double rx_start = cpu_seconds();
+        receive(&rx);
+        rx_cpu_s += cpu_seconds() - rx_start;
+    }
+    const bool flushed = udp_export_flush(HOST_FLUSH_TIMEOUT_MS);
+    receive(&rx);
+
+    // the receiver is not part of the cost of the exporter
+    const double cpu_s = cpu_seconds() - cpu_start - rx_cpu_s;
+    const uint32_t steady_allocations = host_heap_allocations() - warm_allocations;
+    const double minutes = esp_timer_get_time() / 60e6;
+
+    udp_export_stats_t stats;
+    udp_export_get_stats(&stats);
+
+    const bool ok = flushed && stats.samples == samples
+        && stats.dropped_samples == 0 && stats.dropped_datagrams == 0
+        && rx.datagrams == stats.datagrams && rx.lines == samples && rx.failures == 0;
+
+    printf("samples     : %u pushed in %u datagrams, %u samples and %u datagrams dropped\n",
+        (unsigned)stats.samples, (unsigned)stats.datagrams,
+        (unsigned)stats.dropped_samples, (unsigned)stats.dropped_datagrams);
+    printf("received    : %u lines in %u datagrams, %u lines wrong\n",
+        (unsigned)rx.lines, (unsigned)rx.datagrams, (unsigned)rx.failures);
+    printf("rate        : %.1f datagrams/min, %.1f samples/datagram, batches of up to %d\n",
+        minutes > 0 ? stats.datagrams / minutes : 0.0,
+        stats.datagrams ? (double)stats.samples / stats.datagrams : 0.0, UDP_EXPORT_BATCH_SAMPLES);
+    printf("cpu         : %.2f us host CPU per sample, the whole process but the receiver\n",
+        samples ? cpu_s * 1e6 / samples : 0.0);
+    printf("memory      : %u bytes static, %u bytes heap, %u heap allocations in the steady state\n",
+        (unsigned)mem_static_bytes(), (unsigned)mem_heap_bytes(), (unsigned)steady_allocations);
+    printf("failures    : %u\n", ok ? 0u : 1u);
+
+    // the other tasks stay parked, there is no scheduler to stop
+    exit(!ok || steady_allocations ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,96 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+// the wall clock of the host build starts at 2026-01-01 00:00:00 UTC
+#define HOST_EPOCH_S    1767225600LL
+
+static esp_log_level_t s_level = ESP_LOG_INFO;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:                     return "ESP_OK";
+    case ESP_FAIL:                   return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:             return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:      return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:       return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:          return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:      return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:            return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:   return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:        return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_NVS_NOT_FOUND:      return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    default:                         return "UNKNOWN ERROR";
+    }
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    s_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+
+    if(level > s_level)
+        return;
+
+    // virtual time, as the target prints ticks since boot
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], 
+        (long long)(esp_timer_get_time() / 1000), tag);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    fputc('\n', stderr);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while(len--) {
+        crc ^= *buf++;
+        for(int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1u));
+    }
+    return ~crc;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    static const uint8_t sta[6] = { 0x02, 0x00, 0x00, 0xa1, 0xb2, 0xc3 };
+
+    memcpy(mac, sta, sizeof(sta));
+    mac[5] += (uint8_t)type;
+    return ESP_OK;
+}
+
+/**
+ * gettimeofday() of the objects linked with --wrap=gettimeofday (see
+ * CMakeLists.txt): SNTP has set the clock at boot and it advances with
+ * virtual time, so timestamps match the samples
+*/
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+    const int64_t now_us = esp_timer_get_time();
+
+    tv->tv_sec = (time_t)(HOST_EPOCH_S + now_us / 1000000);
+    tv->tv_usec = (suseconds_t)(now_us % 1000000);
+    return 0;
+}
@@ -0,0 +1,659 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "host_port.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WAKE_NEVER UINT64_MAX
+
+struct host_task {
+    pthread_t thread;
+    pthread_cond_t cv;
+    TaskFunction_t fn;
+    void *arg;
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+
+    bool ready;
+    bool deleted;
+    bool is_static;
+    uint64_t ready_seq;     // round robin among equal priorities
+    uint64_t wake_us;       // when blocked with a timeout
+    const void *waiting;    // queue the task is blocked on
+    uint32_t notified;      // xTaskNotifyGive() count
+
+    void *tls[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
+    TlsDeleteCallbackFunction_t tls_delete[configNUM_THREAD_LOCAL_STORAGE_POINTERS];
+
+    struct host_task *next;
+};
+
+struct host_queue {
+    uint8_t *storage;
+    UBaseType_t item_size;
+    UBaseType_t length;
+    UBaseType_t count;
+    UBaseType_t head;
+    bool is_static;
+};
+
+_Static_assert(sizeof(struct host_task) <= sizeof(StaticTask_t), "StaticTask_t is too small");
+_Static_assert(sizeof(struct host_queue) <= sizeof(StaticQueue_t), "StaticQueue_t is too small");
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct host_task *s_tasks = NULL;
+static struct host_task *s_current = NULL;
+static uint64_t s_ready_seq = 0;
+static uint64_t s_now_us = 0;
+
+static inline TickType_t now_ticks(void)
+{
+    return (TickType_t)(s_now_us / (1000000 / configTICK_RATE_HZ));
+}
+
+static inline uint64_t ticks_to_us(uint64_t ticks)
+{
+    return ticks * (1000000 / configTICK_RATE_HZ);
+}
+
+static inline void make_ready(struct host_task *task)
+{
+    task->ready = true;
+    task->waiting = NULL;
+    task->wake_us = WAKE_NEVER;
+    task->ready_seq = ++s_ready_seq;
+}
+
+static struct host_task *pick_next(void)
+{
+    struct host_task *best = NULL;
+
+    for(struct host_task *t = s_tasks; t; t = t->next)
+    {
+        if(t->deleted || !t->ready)
+            continue;
+        if(best == NULL || t->priority > best->priority
+            || (t->priority == best->priority && t->ready_seq < best->ready_seq))
+            best = t;
+    }
+
+    return best;
+}
+
+/**
+ * @brief Hand the CPU to the best ready task, the clock jumps forward
+ * when there is none. Called with s_lock held by the current task.
+*/
+static void reschedule(void)
+{
+    struct host_task *self = s_current;
+    struct host_task *next = pick_next();
+
+    while(next == NULL)
+    {
+        uint64_t wake_us = WAKE_NEVER;
+        for(struct host_task *t = s_tasks; t; t = t->next)
+            if(!t->deleted && !t->ready && t->wake_us < wake_us)
+                wake_us = t->wake_us;
+
+        if(wake_us == WAKE_NEVER) {
+            fprintf(stderr, "host: deadlock, every task is blocked forever\n");
+            exit(EXIT_FAILURE);
+        }
+
+        s_now_us = wake_us;
+        for(struct host_task *t = s_tasks; t; t = t->next)
+            if(!t->deleted && !t->ready && t->wake_us <= s_now_us)
+                make_ready(t);
+
+        next = pick_next();
+    }
+
+    if(next == self)
+        return;
+
+    s_current = next;
+    pthread_cond_signal(&next->cv);
+
+    if(self->deleted)
+        return;
+
+    while(s_current != self)
+        pthread_cond_wait(&self->cv, &s_lock);
+}
+
+/**
+ * @brief Block the current task until `deadline_us` or until a queue
+ * operation on `waiting` wakes it up
+*/
+static void block(const void *waiting, uint64_t deadline_us)
+{
+    struct host_task *self = s_current;
+
+    self->ready = false;
+    self->waiting = waiting;
+    self->wake_us = deadline_us;
+    reschedule();
+}
+
+/**
+ * @brief Let a woken task of higher priority run, the current one stays ready
+*/
+static void preempt(void)
+{
+    struct host_task *next = pick_next();
+
+    if(next != NULL && next->priority > s_current->priority) {
+        s_current->ready_seq = ++s_ready_seq;
+        reschedule();
+    }
+}
+
+static void wake_waiters(const void *waiting)
+{
+    for(struct host_task *t = s_tasks; t; t = t->next)
+        if(!t->deleted && !t->ready && t->waiting == waiting)
+            make_ready(t);
+}
+
+/**
+ * @brief Set up `task` and put it on the task list. The storage of a static
+ * task may hold a deleted one, it leaves the list first.
+*/
+static void task_init(struct host_task *task, const char *name, UBaseType_t priority)
+{
+    for(struct host_task **t = &s_tasks; *t; t = &(*t)->next)
+        if(*t == task) {
+            assert(task->deleted);
+            *t = task->next;
+            break;
+        }
+
+    memset(task, 0, sizeof(*task));
+    pthread_cond_init(&task->cv, NULL);
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->priority = priority;
+    make_ready(task);
+
+    task->next = s_tasks;
+    s_tasks = task;
+}
+
+static struct host_task *task_alloc(const char *name, UBaseType_t priority)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    assert(task != NULL);
+
+    task_init(task, name, priority);
+    return task;
+}
+
+static void *task_entry(void *arg)
+{
+    struct host_task *self = arg;
+
+    pthread_mutex_lock(&s_lock);
+    while(s_current != self)
+        pthread_cond_wait(&self->cv, &s_lock);
+    pthread_mutex_unlock(&s_lock);
+
+    self->fn(self->arg);
+
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+void host_port_init(const char *name, UBaseType_t priority)
+{
+    pthread_mutex_lock(&s_lock);
+    assert(s_current == NULL);
+    s_current = task_alloc(name, priority);
+    s_current->thread = pthread_self();
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_time_advance_us(uint32_t us)
+{
+    pthread_mutex_lock(&s_lock);
+    s_now_us += us;
+    pthread_mutex_unlock(&s_lock);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    pthread_mutex_lock(&s_lock);
+    const int64_t now = (int64_t)s_now_us;
+    pthread_mutex_unlock(&s_lock);
+    return now;
+}
+
+/**
+ * @brief Start the thread of a task set up by task_init(), called with s_lock held
+*/
+static BaseType_t task_start(struct host_task *task, TaskFunction_t fn, void *arg)
+{
+    task->fn = fn;
+    task->arg = arg;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    const int err = pthread_create(&task->thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+
+    if(err != 0) {
+        task->deleted = true;
+        return pdFAIL;
+    }
+
+    preempt();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+    uint32_t stack_depth, void *arg, UBaseType_t priority,
+    TaskHandle_t *created, BaseType_t core_id)
+{
+    (void)stack_depth;
+    (void)core_id;
+
+    pthread_mutex_lock(&s_lock);
+    assert(s_current != NULL);
+
+    struct host_task *task = task_alloc(name, priority);
+    const BaseType_t ret = task_start(task, fn, arg);
+    if(ret == pdPASS && created)
+        *created = task;
+
+    pthread_mutex_unlock(&s_lock);
+    return ret;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name,
+    uint32_t stack_depth, void *arg, UBaseType_t priority,
+    StackType_t *stack, StaticTask_t *tcb, BaseType_t core_id)
+{
+    (void)stack_depth;
+    (void)stack;
+    (void)core_id;
+
+    pthread_mutex_lock(&s_lock);
+    assert(s_current != NULL);
+
+    struct host_task *task = (struct host_task *)tcb;
+    task_init(task, name, priority);
+    task->is_static = true;
+    const BaseType_t ret = task_start(task, fn, arg);
+
+    pthread_mutex_unlock(&s_lock);
+    return ret == pdPASS ? task : NULL;
+}
+
+/**
+ * @brief Called with s_lock held, the storage may be reused afterwards
+*/
+static void task_free(struct host_task *task)
+{
+    task->deleted = true;
+    for(int i = 0; i < configNUM_THREAD_LOCAL_STORAGE_POINTERS; i++)
+        if(task->tls_delete[i])
+            task->tls_delete[i](i, task->tls[i]);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    pthread_mutex_lock(&s_lock);
+
+    if(task == NULL || task == s_current) {
+        struct host_task *self = s_current;
+        task_free(self);
+        reschedule();
+        pthread_mutex_unlock(&s_lock);
+        pthread_exit(NULL);
+    }
+
+    // its thread stays parked on the condition variable
+    task_free(task);
+    pthread_mutex_unlock(&s_lock);
+}
+
+void vTaskSetThreadLocalStoragePointerAndDelCallback(TaskHandle_t task,
+    BaseType_t index, void *value, TlsDeleteCallbackFunction_t callback)
+{
+    pthread_mutex_lock(&s_lock);
+    if(task == NULL)
+        task = s_current;
+    assert(index >= 0 && index < configNUM_THREAD_LOCAL_STORAGE_POINTERS);
+    task->tls[index] = value;
+    task->tls_delete[index] = callback;
+    pthread_mutex_unlock(&s_lock);
+}
+
+eTaskState eTaskGetState(TaskHandle_t task)
+{
+    pthread_mutex_lock(&s_lock);
+    const eTaskState state = task->deleted ? eDeleted
+        : task == s_current ? eRunning
+        : task->ready ? eReady : eBlocked;
+    pthread_mutex_unlock(&s_lock);
+    return state;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    pthread_mutex_lock(&s_lock);
+    if(ticks == 0) {
+        s_current->ready_seq = ++s_ready_seq;
+        reschedule();
+    } else {
+        block(NULL, ticks_to_us(now_ticks()) + ticks_to_us(ticks));
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+void taskYIELD(void)
+{
+    vTaskDelay(0);
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+    pthread_mutex_lock(&s_lock);
+
+    const TickType_t now = now_ticks();
+    const TickType_t wake = *previous_wake + increment;
+    const bool late = (TickType_t)(now - *previous_wake) >= increment;
+
+    *previous_wake = wake;
+    if(!late)
+        block(NULL, ticks_to_us(now) + ticks_to_us((TickType_t)(wake - now)));
+
+    pthread_mutex_unlock(&s_lock);
+    return late ? pdFALSE : pdTRUE;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    pthread_mutex_lock(&s_lock);
+    const TickType_t ticks = now_ticks();
+    pthread_mutex_unlock(&s_lock);
+    return ticks;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    return (task ? task : s_current)->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    (void)task;
+    return 0;
+}
+
+static uint64_t deadline(TickType_t timeout);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&s_lock);
+    task->notified++;
+    wake_waiters(&task->notified);
+    preempt();
+    pthread_mutex_unlock(&s_lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t timeout)
+{
+    pthread_mutex_lock(&s_lock);
+
+    struct host_task *self = s_current;
+    const uint64_t until = deadline(timeout);
+    while(self->notified == 0) {
+        if(timeout == 0 || s_now_us >= until)
+            break;
+        block(&self->notified, until);
+    }
+
+    const uint32_t value = self->notified;
+    if(value)
+        self->notified = clear_on_exit ? 0 : value - 1;
+
+    pthread_mutex_unlock(&s_lock);
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    if(queue == NULL)
+        return NULL;
+
+    queue->item_size = item_size;
+    queue->length = length;
+    if(item_size != 0) {
+        queue->storage = calloc(length, item_size);
+        if(queue->storage == NULL) {
+            free(queue);
+            return NULL;
+        }
+    }
+
+    return queue;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size,
+    uint8_t *storage, StaticQueue_t *control)
+{
+    struct host_queue *queue = (struct host_queue *)control;
+
+    memset(queue, 0, sizeof(*queue));
+    queue->item_size = item_size;
+    queue->length = length;
+    queue->storage = item_size ? storage : NULL;
+    queue->is_static = true;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if(queue->is_static)
+        return;
+
+    free(queue->storage);
+    free(queue);
+}
+
+static uint64_t deadline(TickType_t timeout)
+{
+    return timeout == portMAX_DELAY ? WAKE_NEVER
+        : ticks_to_us(now_ticks()) + ticks_to_us(timeout);
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t timeout, bool front)
+{
+    pthread_mutex_lock(&s_lock);
+
+    const uint64_t until = deadline(timeout);
+    while(queue->count == queue->length) {
+        if(timeout == 0 || s_now_us >= until) {
+            pthread_mutex_unlock(&s_lock);
+            return pdFALSE;
+        }
+        block(queue, until);
+    }
+
+    UBaseType_t slot;
+    if(front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    if(queue->item_size)
+        memcpy(queue->storage + slot * queue->item_size, item, queue->item_size);
+    queue->count++;
+
+    wake_waiters(queue);
+    preempt();
+
+    pthread_mutex_unlock(&s_lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout)
+{
+    return queue_send(queue, item, timeout, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t timeout)
+{
+    return queue_send(queue, item, timeout, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout)
+{
+    pthread_mutex_lock(&s_lock);
+
+    const uint64_t until = deadline(timeout);
+    while(queue->count == 0) {
+        if(timeout == 0 || s_now_us >= until) {
+            pthread_mutex_unlock(&s_lock);
+            return pdFALSE;
+        }
+        block(queue, until);
+    }
+
+    if(queue->item_size)
+        memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+
+    wake_waiters(queue);
+    preempt();
+
+    pthread_mutex_unlock(&s_lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&s_lock);
+    const UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&s_lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    if(mutex)
+        mutex->count = 1;
+    return mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *control)
+{
+    return xQueueCreateStatic(1, 0, NULL, control);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *control)
+{
+    SemaphoreHandle_t mutex = xQueueCreateStatic(1, 0, NULL, control);
+    mutex->count = 1;
+    return mutex;
+}
+
+struct host_event_group {
+    EventBits_t bits;
+    bool is_static;
+};
+
+_Static_assert(sizeof(struct host_event_group) <= sizeof(StaticEventGroup_t), "StaticEventGroup_t is too small");
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return calloc(1, sizeof(struct host_event_group));
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *control)
+{
+    struct host_event_group *group = (struct host_event_group *)control;
+
+    group->bits = 0;
+    group->is_static = true;
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    if(!group->is_static)
+        free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&s_lock);
+    group->bits |= bits;
+    const EventBits_t now = group->bits;
+    wake_waiters(group);
+    preempt();
+    pthread_mutex_unlock(&s_lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&s_lock);
+    const EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&s_lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&s_lock);
+    const EventBits_t bits = group->bits;
+    pthread_mutex_unlock(&s_lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+    BaseType_t clear_on_exit, BaseType_t wait_for_all, TickType_t timeout)
+{
+    pthread_mutex_lock(&s_lock);
+
+    const uint64_t until = deadline(timeout);
+    EventBits_t now;
+    while(true) {
+        now = group->bits;
+        const bool met = wait_for_all ? (now & bits) == bits : (now & bits) != 0;
+        if(met) {
+            if(clear_on_exit)
+                group->bits &= ~bits;
+            break;
+        }
+        if(timeout == 0 || s_now_us >= until)
+            break;
+        block(group, until);
+    }
+
+    pthread_mutex_unlock(&s_lock);
+    return now;
+}
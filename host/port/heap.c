@@ -0,0 +1,38 @@
+#include "host_port.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/**
+ * The allocators of the objects linked with --wrap=malloc,calloc,realloc
+ * (see CMakeLists.txt) count the calls before going to the C library.
+ * Allocations inside the C library itself are not seen.
+*/
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static atomic_uint s_allocations;
+
+void *__wrap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocations, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocations, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocations, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+uint32_t host_heap_allocations(void)
+{
+    return atomic_load_explicit(&s_allocations, memory_order_relaxed);
+}
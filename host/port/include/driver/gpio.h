@@ -0,0 +1,5 @@
+#pragma once
+
+typedef int gpio_num_t;
+
+#define GPIO_NUM_NC     -1
@@ -0,0 +1,3 @@
+#pragma once
+
+typedef struct spi_device_t *spi_device_handle_t;
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+} esp_mac_type_t;
+
+/**
+ * @brief A fixed address, the same on every run
+*/
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
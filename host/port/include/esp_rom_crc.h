@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief CRC-32/ISO-HDLC, same as the ROM function: the initial value and
+ * the result are inverted inside, so chained calls start with 0
+*/
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
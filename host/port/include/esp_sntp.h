@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdbool.h>
+
+/**
+ * The host clock is already set, SNTP has nothing to do
+*/
+#define SNTP_OPMODE_POLL    0
+
+static inline bool esp_sntp_enabled(void) { return true; }
+static inline void esp_sntp_setoperatingmode(int mode) { (void)mode; }
+static inline void esp_sntp_setservername(int idx, const char *server) { (void)idx; (void)server; }
+static inline void esp_sntp_init(void) { }
@@ -0,0 +1,4 @@
+#pragma once
+
+#define ESP_TASK_PRIO_MIN       0
+#define ESP_TASK_MAIN_PRIO      (ESP_TASK_PRIO_MIN + 1)
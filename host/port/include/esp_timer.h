@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Virtual time since start, see freertos/FreeRTOS.h
+*/
+int64_t esp_timer_get_time(void);
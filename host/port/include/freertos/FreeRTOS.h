@@ -0,0 +1,161 @@
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Host port of the FreeRTOS subset used by main/.
+ * Tasks are threads, but only one of them runs at a time, like on a single
+ * core: a task runs until it blocks, yields or wakes a task of higher priority.
+ * Time is virtual, it jumps to the next wake-up when every task is blocked,
+ * so delays cost nothing and a simulated hour takes a fraction of a second.
+*/
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ          1000
+#define configMAX_TASK_NAME_LEN     16
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS     2
+#define configTHREAD_LOCAL_STORAGE_DELETE_CALLBACKS 1
+
+#define portTICK_PERIOD_MS          ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY               ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)           ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define pdFALSE                     ((BaseType_t)0)
+#define pdTRUE                      ((BaseType_t)1)
+#define pdFAIL                      pdFALSE
+#define pdPASS                      pdTRUE
+
+#define tskNO_AFFINITY              0x7fffffff
+#define tskIDLE_PRIORITY            ((UBaseType_t)0)
+
+/**
+ * Only one task runs at a time, there is nothing to exclude
+*/
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define taskENTER_CRITICAL(mux)         ((void)(mux))
+#define taskEXIT_CRITICAL(mux)          ((void)(mux))
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+
+typedef void (*TaskFunction_t)(void *);
+typedef void (*TlsDeleteCallbackFunction_t)(int index, void *value);
+
+typedef struct host_task *TaskHandle_t;
+typedef struct host_queue *QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+
+/**
+ * Storage of the *Static APIs, stacks are in bytes like on the ESP32.
+ * The control blocks hold the host objects, the stacks stay unused.
+*/
+typedef uint8_t StackType_t;
+
+typedef struct {
+    uint64_t opaque[32];
+} StaticTask_t;
+
+typedef struct {
+    void *opaque[6];
+} StaticQueue_t;
+
+typedef StaticQueue_t StaticSemaphore_t;
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+/* task.h */
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, 
+    uint32_t stack_depth, void *arg, UBaseType_t priority, 
+    TaskHandle_t *created, BaseType_t core_id);
+
+#define xTaskCreate(fn, name, stack_depth, arg, priority, created) \
+    xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, created, tskNO_AFFINITY)
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name,
+    uint32_t stack_depth, void *arg, UBaseType_t priority,
+    StackType_t *stack, StaticTask_t *tcb, BaseType_t core_id);
+
+#define xTaskCreateStatic(fn, name, stack_depth, arg, priority, stack, tcb) \
+    xTaskCreateStaticPinnedToCore(fn, name, stack_depth, arg, priority, stack, tcb, tskNO_AFFINITY)
+
+void vTaskDelete(TaskHandle_t task);
+
+eTaskState eTaskGetState(TaskHandle_t task);
+
+/**
+ * The callbacks run when the task is deleted: there is no idle task,
+ * the task storage is free once vTaskDelete() is entered
+*/
+void vTaskSetThreadLocalStoragePointerAndDelCallback(TaskHandle_t task,
+    BaseType_t index, void *value, TlsDeleteCallbackFunction_t callback);
+
+void vTaskDelay(TickType_t ticks);
+
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment);
+
+TickType_t xTaskGetTickCount(void);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+char *pcTaskGetName(TaskHandle_t task);
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+void taskYIELD(void);
+
+/**
+ * Notifications as a counting semaphore, the only use in main/
+*/
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t timeout);
+
+/* queue.h */
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size,
+    uint8_t *storage, StaticQueue_t *control);
+
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout);
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t timeout);
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout);
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#define xQueueSendToBack xQueueSend
+
+/* semphr.h */
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *control);
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *control);
+
+#define xSemaphoreTake(sem, timeout)    xQueueReceive(sem, NULL, timeout)
+#define xSemaphoreGive(sem)             xQueueSend(sem, NULL, 0)
+#define vSemaphoreDelete(sem)           vQueueDelete(sem)
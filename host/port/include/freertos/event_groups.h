@@ -0,0 +1,34 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+/**
+ * Event groups of the host port, a task may wait for bits
+*/
+typedef uint32_t EventBits_t;
+
+typedef struct host_event_group *EventGroupHandle_t;
+
+typedef struct {
+    EventBits_t opaque[2];
+} StaticEventGroup_t;
+
+#define BIT0    0x00000001
+#define BIT1    0x00000002
+#define BIT2    0x00000004
+#define BIT3    0x00000008
+
+EventGroupHandle_t xEventGroupCreate(void);
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *control);
+
+void vEventGroupDelete(EventGroupHandle_t group);
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+    BaseType_t clear_on_exit, BaseType_t wait_for_all, TickType_t timeout);
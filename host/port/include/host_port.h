@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+/**
+ * @brief Turn the calling thread into the first task, call it once from main()
+*/
+void host_port_init(const char *name, UBaseType_t priority);
+
+/**
+ * @brief Let virtual time pass without blocking, e.g. for a bus transfer
+*/
+void host_time_advance_us(uint32_t us);
+
+/**
+ * @return malloc(), calloc() and realloc() calls of the firmware and the
+ * port so far, the linker routes them through port/heap.c
+*/
+uint32_t host_heap_allocations(void);
@@ -0,0 +1,9 @@
+#pragma once
+
+/**
+ * The BSD socket API of lwIP is the one of the host
+*/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
@@ -0,0 +1,4 @@
+#pragma once
+
+// as on the linux target of ESP-IDF
+#define CONFIG_IDF_TARGET_LINUX 1
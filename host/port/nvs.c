@@ -0,0 +1,154 @@
+#include "nvs.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_MAX_ENTRIES     32
+#define NVS_MAX_HANDLES     8
+#define NVS_KEY_SIZE        16
+
+typedef struct {
+    char namespace_name[NVS_KEY_SIZE];
+    char key[NVS_KEY_SIZE];
+    void *value;
+    size_t length;
+} nvs_entry_t;
+
+typedef struct {
+    char namespace_name[NVS_KEY_SIZE];
+    nvs_open_mode_t mode;
+    bool used;
+} nvs_slot_t;
+
+static nvs_entry_t s_entries[NVS_MAX_ENTRIES];
+static nvs_slot_t s_handles[NVS_MAX_HANDLES];
+
+static nvs_slot_t *slot(nvs_handle_t handle)
+{
+    if(handle == 0 || handle > NVS_MAX_HANDLES || !s_handles[handle - 1].used)
+        return NULL;
+    return &s_handles[handle - 1];
+}
+
+static nvs_entry_t *find(const char *namespace_name, const char *key)
+{
+    for(int i = 0; i < NVS_MAX_ENTRIES; i++)
+        if(s_entries[i].value != NULL
+            && strcmp(s_entries[i].namespace_name, namespace_name) == 0
+            && strcmp(s_entries[i].key, key) == 0)
+            return &s_entries[i];
+    return NULL;
+}
+
+static bool namespace_exists(const char *namespace_name)
+{
+    for(int i = 0; i < NVS_MAX_ENTRIES; i++)
+        if(s_entries[i].value != NULL && strcmp(s_entries[i].namespace_name, namespace_name) == 0)
+            return true;
+    return false;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if(strlen(namespace_name) >= NVS_KEY_SIZE)
+        return ESP_ERR_INVALID_ARG;
+
+    if(open_mode == NVS_READONLY && !namespace_exists(namespace_name))
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    for(int i = 0; i < NVS_MAX_HANDLES; i++)
+    {
+        if(s_handles[i].used)
+            continue;
+
+        s_handles[i].used = true;
+        s_handles[i].mode = open_mode;
+        strcpy(s_handles[i].namespace_name, namespace_name);
+        *out_handle = i + 1;
+        return ESP_OK;
+    }
+
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    nvs_slot_t *s = slot(handle);
+    if(s)
+        s->used = false;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return slot(handle) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    nvs_slot_t *s = slot(handle);
+    if(s == NULL || s->mode != NVS_READWRITE || strlen(key) >= NVS_KEY_SIZE)
+        return ESP_ERR_INVALID_ARG;
+
+    void *copy = malloc(length ? length : 1);
+    if(copy == NULL)
+        return ESP_ERR_NO_MEM;
+    memcpy(copy, value, length);
+
+    nvs_entry_t *entry = find(s->namespace_name, key);
+    for(int i = 0; entry == NULL && i < NVS_MAX_ENTRIES; i++)
+        if(s_entries[i].value == NULL)
+            entry = &s_entries[i];
+
+    if(entry == NULL) {
+        free(copy);
+        return ESP_ERR_NO_MEM;
+    }
+
+    free(entry->value);
+    strcpy(entry->namespace_name, s->namespace_name);
+    strcpy(entry->key, key);
+    entry->value = copy;
+    entry->length = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    nvs_slot_t *s = slot(handle);
+    if(s == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    const nvs_entry_t *entry = find(s->namespace_name, key);
+    if(entry == NULL)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    if(out_value == NULL) {
+        *length = entry->length;
+        return ESP_OK;
+    }
+
+    if(*length < entry->length) {
+        *length = entry->length;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    memcpy(out_value, entry->value, entry->length);
+    *length = entry->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    nvs_slot_t *s = slot(handle);
+    if(s == NULL || s->mode != NVS_READWRITE)
+        return ESP_ERR_INVALID_ARG;
+
+    nvs_entry_t *entry = find(s->namespace_name, key);
+    if(entry == NULL)
+        return ESP_ERR_NVS_NOT_FOUND;
+
+    free(entry->value);
+    entry->value = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,24 @@
+#include "u8g2_esp32_hal.h"
+
+#include "freertos/FreeRTOS.h"
+
+/**
+ * The display talks through cb_i2c_display() of display.c,
+ * only delays are left to the HAL
+*/
+
+void u8g2_esp32_hal_init(u8g2_esp32_hal_t u8g2_esp32_hal_param)
+{
+    (void)u8g2_esp32_hal_param;
+}
+
+uint8_t u8g2_esp32_gpio_and_delay_cb(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr)
+{
+    (void)u8x8;
+    (void)arg_ptr;
+
+    if(msg == U8X8_MSG_DELAY_MILLI)
+        vTaskDelay(pdMS_TO_TICKS(arg_int));
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "i2c_sim.h"
+#include "sim_devices.h"
+#include "sim_env.h"
+
+#include "esp_timer.h"
+
+#include <string.h>
+
+#define AHT21_CMD_STATUS        0x71
+#define AHT21_CMD_INIT          0xBE
+#define AHT21_CMD_TRIGGER       0xAC
+#define AHT21_CMD_SOFTRESET     0xBA
+
+#define AHT21_STATUS_BUSY       0x80
+#define AHT21_STATUS_CAL        0x08
+// calibrated part straight after power-on
+#define AHT21_STATUS_POWER_ON   0x18
+
+#define AHT21_MEASURE_US        80000
+#define AHT21_RESET_US          20000
+
+// status, humidity and temperature, CRC
+#define AHT21_FRAME_SIZE        7
+
+typedef struct {
+    i2c_sim_device_t dev;
+    uint8_t status;
+    int64_t ready_us;       // end of the measurement or the reset in progress
+    uint8_t data[5];        // raw humidity and temperature, 20 bits each
+    uint32_t corrupt_every;
+    uint32_t reads;         // of a whole frame
+    uint32_t corrupted;
+} aht21_sim_t;
+
+static aht21_sim_t s_aht21;
+
+static uint8_t crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xff;
+    for(size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for(int j = 0; j < 8; j++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+    }
+    return crc;
+}
+
+static void measure(aht21_sim_t *s)
+{
+    sim_env_t env;
+    sim_env_get(esp_timer_get_time(), &env);
+
+    float rh = env.humidity < 0 ? 0 : env.humidity > 100 ? 100 : env.humidity;
+    const uint32_t raw_rh = (uint32_t)(rh / 100.0f * (1 << 20));
+    const uint32_t raw_t = (uint32_t)((env.temperature + 50.0f) / 200.0f * (1 << 20));
+
+    const uint32_t h = raw_rh > 0xfffff ? 0xfffff : raw_rh;
+    const uint32_t t = raw_t > 0xfffff ? 0xfffff : raw_t;
+
+    s->data[0] = (uint8_t)(h >> 12);
+    s->data[1] = (uint8_t)(h >> 4);
+    s->data[2] = (uint8_t)((h << 4) | (t >> 16));
+    s->data[3] = (uint8_t)(t >> 8);
+    s->data[4] = (uint8_t)t;
+}
+
+static void update(aht21_sim_t *s)
+{
+    if((s->status & AHT21_STATUS_BUSY) && esp_timer_get_time() >= s->ready_us)
+        s->status &= ~AHT21_STATUS_BUSY;
+}
+
+static esp_err_t aht21_write(i2c_sim_device_t *dev, const uint8_t *data, size_t len)
+{
+    aht21_sim_t *s = (aht21_sim_t *)dev;
+
+    update(s);
+    if(len == 0)
+        return ESP_OK;
+
+    switch (data[0])
+    {
+    case AHT21_CMD_SOFTRESET:
+        s->status = AHT21_STATUS_POWER_ON | AHT21_STATUS_BUSY;
+        s->ready_us = esp_timer_get_time() + AHT21_RESET_US;
+        break;
+
+    case AHT21_CMD_INIT:
+        s->status |= AHT21_STATUS_CAL;
+        break;
+
+    case AHT21_CMD_TRIGGER:
+        // a trigger while busy or with wrong parameters is ignored
+        if(len != 3 || data[1] != 0x33 || data[2] != 0x00 || (s->status & AHT21_STATUS_BUSY))
+            break;
+        measure(s);
+        s->status |= AHT21_STATUS_BUSY;
+        s->ready_us = esp_timer_get_time() + AHT21_MEASURE_US;
+        break;
+
+    case AHT21_CMD_STATUS:
+    default:
+        break;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t aht21_read(i2c_sim_device_t *dev, uint8_t *data, size_t len)
+{
+    aht21_sim_t *s = (aht21_sim_t *)dev;
+    uint8_t frame[AHT21_FRAME_SIZE];
+
+    update(s);
+
+    // while busy the data bytes still hold the previous measurement
+    frame[0] = s->status;
+    memcpy(frame + 1, s->data, 5);
+    frame[6] = crc8(frame, 6);
+
+    if(len >= sizeof(frame) && s->corrupt_every && ++s->reads % s->corrupt_every == 0) {
+        frame[6] ^= 0xff;
+        s->corrupted++;
+    }
+
+    for(size_t i = 0; i < len; i++)
+        data[i] = i < sizeof(frame) ? frame[i] : 0xff;
+
+    return ESP_OK;
+}
+
+void aht21_sim_attach(void)
+{
+    s_aht21 = (aht21_sim_t) {
+        .dev = {
+            .addr = AHT21_SIM_ADDR,
+            .write = aht21_write,
+            .read = aht21_read
+        },
+        .status = AHT21_STATUS_POWER_ON
+    };
+    i2c_sim_attach(&s_aht21.dev);
+}
+
+void aht21_sim_corrupt_every(uint32_t n)
+{
+    s_aht21.corrupt_every = n;
+}
+
+uint32_t aht21_sim_corrupted(void)
+{
+    return s_aht21.corrupted;
+}
@@ -0,0 +1,221 @@
+#include "i2c_sim.h"
+#include "sim_devices.h"
+#include "sim_env.h"
+
+#include "esp_timer.h"
+
+#include <string.h>
+
+#define BMP280_REG_CALIB        0x88
+#define BMP280_REG_CHIP_ID      0xd0
+#define BMP280_REG_RESET        0xe0
+#define BMP280_REG_STATUS       0xf3
+#define BMP280_REG_CTRL_MEAS    0xf4
+#define BMP280_REG_CONFIG       0xf5
+#define BMP280_REG_PRESS_MSB    0xf7
+#define BMP280_REG_TEMP_MSB     0xfa
+
+#define BMP280_CHIP_ID          0x58
+#define BMP280_RESET_WORD       0xb6
+// value of a skipped measurement
+#define BMP280_ADC_SKIPPED      0x80000
+
+#define BMP280_MODE_SLEEP       0x00
+#define BMP280_MODE_NORMAL      0x03
+
+typedef struct {
+    uint16_t T1;
+    int16_t T2, T3;
+    uint16_t P1;
+    int16_t P2, P3, P4, P5, P6, P7, P8, P9;
+} calib_t;
+
+// the example NVM content of the datasheet, section 3.12
+static const calib_t s_calib = {
+    27504, 26435, -1000,
+    36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000
+};
+
+typedef struct {
+    i2c_sim_device_t dev;
+    uint8_t regs[256];
+    uint8_t pointer;
+} bmp280_sim_t;
+
+static bmp280_sim_t s_bmp280;
+
+static int32_t t_fine(int32_t adc_T)
+{
+    const calib_t *c = &s_calib;
+    int32_t var1 = ((((adc_T >> 3) - ((int32_t)c->T1 << 1))) * ((int32_t)c->T2)) >> 11;
+    int32_t var2 = (((((adc_T >> 4) - ((int32_t)c->T1)) * ((adc_T >> 4) - ((int32_t)c->T1))) >> 12)
+        * ((int32_t)c->T3)) >> 14;
+    return var1 + var2;
+}
+
+// datasheet section 8.1, double precision
+static double pressure_pa(int32_t adc_P, int32_t fine)
+{
+    const calib_t *c = &s_calib;
+    double var1 = ((double)fine / 2.0) - 64000.0;
+    double var2 = var1 * var1 * ((double)c->P6) / 32768.0;
+    var2 = var2 + var1 * ((double)c->P5) * 2.0;
+    var2 = (var2 / 4.0) + (((double)c->P4) * 65536.0);
+    var1 = (((double)c->P3) * var1 * var1 / 524288.0 + ((double)c->P2) * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * ((double)c->P1);
+    if(var1 == 0.0)
+        return 0;
+    double p = 1048576.0 - (double)adc_P;
+    p = (p - (var2 / 4096.0)) * 6250.0 / var1;
+    var1 = ((double)c->P9) * p * p / 2147483648.0;
+    var2 = p * ((double)c->P8) / 32768.0;
+    return p + (var1 + var2 + ((double)c->P7)) / 16.0;
+}
+
+/**
+ * @brief ADC values that compensate to the environment, found by bisection:
+ * temperature grows with adc_T, pressure falls with adc_P
+*/
+static void adc_values(const sim_env_t *env, int32_t *adc_T, int32_t *adc_P)
+{
+    // T = (t_fine * 5 + 128) >> 8 in 0.01 °C
+    const int32_t target_fine = (int32_t)(env->temperature * 5120.0f);
+    int32_t lo = 0, hi = 0xfffff;
+    while(lo < hi) {
+        int32_t mid = (lo + hi) / 2;
+        if(t_fine(mid) < target_fine)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *adc_T = lo;
+
+    const int32_t fine = t_fine(lo);
+    lo = 0;
+    hi = 0xfffff;
+    while(lo < hi) {
+        int32_t mid = (lo + hi) / 2;
+        if(pressure_pa(mid, fine) > env->pressure)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *adc_P = lo;
+}
+
+static void store_adc(uint8_t *reg, int32_t adc, uint8_t osrs)
+{
+    if(osrs == 0) {
+        adc = BMP280_ADC_SKIPPED;
+    } else {
+        // 16 bit at x1 oversampling, one more bit per step up to 20
+        const int resolution = osrs > 5 ? 20 : 15 + osrs;
+        adc &= ~((1 << (20 - resolution)) - 1);
+    }
+
+    reg[0] = (uint8_t)(adc >> 12);
+    reg[1] = (uint8_t)(adc >> 4);
+    reg[2] = (uint8_t)((adc & 0x0f) << 4);
+}
+
+static void convert(bmp280_sim_t *s)
+{
+    const uint8_t ctrl = s->regs[BMP280_REG_CTRL_MEAS];
+    sim_env_t env;
+    int32_t adc_T, adc_P;
+
+    sim_env_get(esp_timer_get_time(), &env);
+    adc_values(&env, &adc_T, &adc_P);
+
+    store_adc(&s->regs[BMP280_REG_TEMP_MSB], adc_T, (ctrl >> 5) & 0x07);
+    // the pressure is not measured without the temperature
+    store_adc(&s->regs[BMP280_REG_PRESS_MSB], adc_P,
+        ((ctrl >> 5) & 0x07) ? (ctrl >> 2) & 0x07 : 0);
+}
+
+static void reset(bmp280_sim_t *s)
+{
+    const calib_t *c = &s_calib;
+    const uint16_t words[12] = {
+        c->T1, (uint16_t)c->T2, (uint16_t)c->T3,
+        c->P1, (uint16_t)c->P2, (uint16_t)c->P3, (uint16_t)c->P4, (uint16_t)c->P5,
+        (uint16_t)c->P6, (uint16_t)c->P7, (uint16_t)c->P8, (uint16_t)c->P9
+    };
+
+    memset(s->regs, 0, sizeof(s->regs));
+    for(int i = 0; i < 12; i++) {
+        s->regs[BMP280_REG_CALIB + 2 * i] = (uint8_t)words[i];
+        s->regs[BMP280_REG_CALIB + 2 * i + 1] = (uint8_t)(words[i] >> 8);
+    }
+    s->regs[BMP280_REG_CHIP_ID] = BMP280_CHIP_ID;
+    store_adc(&s->regs[BMP280_REG_PRESS_MSB], 0, 0);
+    store_adc(&s->regs[BMP280_REG_TEMP_MSB], 0, 0);
+}
+
+static void write_register(bmp280_sim_t *s, uint8_t reg, uint8_t value)
+{
+    switch (reg)
+    {
+    case BMP280_REG_RESET:
+        if(value == BMP280_RESET_WORD)
+            reset(s);
+        break;
+
+    case BMP280_REG_CTRL_MEAS:
+        s->regs[reg] = value;
+        // forced mode: one conversion, then back to sleep
+        if((value & 0x03) != BMP280_MODE_SLEEP && (value & 0x03) != BMP280_MODE_NORMAL) {
+            convert(s);
+            s->regs[reg] = value & ~0x03;
+        }
+        break;
+
+    case BMP280_REG_CONFIG:
+        s->regs[reg] = value;
+        break;
+
+    default:
+        // read-only
+        break;
+    }
+}
+
+static esp_err_t bmp280_write(i2c_sim_device_t *dev, const uint8_t *data, size_t len)
+{
+    bmp280_sim_t *s = (bmp280_sim_t *)dev;
+
+    // register address and data pairs, a lone address sets the read pointer
+    if(len == 1)
+        s->pointer = data[0];
+    for(size_t i = 0; i + 1 < len; i += 2)
+        write_register(s, data[i], data[i + 1]);
+
+    return ESP_OK;
+}
+
+static esp_err_t bmp280_read(i2c_sim_device_t *dev, uint8_t *data, size_t len)
+{
+    bmp280_sim_t *s = (bmp280_sim_t *)dev;
+
+    // with the shortest standby time the ADC registers are always fresh
+    if((s->regs[BMP280_REG_CTRL_MEAS] & 0x03) == BMP280_MODE_NORMAL)
+        convert(s);
+
+    for(size_t i = 0; i < len; i++)
+        data[i] = s->regs[(uint8_t)(s->pointer + i)];
+
+    return ESP_OK;
+}
+
+void bmp280_sim_attach(void)
+{
+    s_bmp280 = (bmp280_sim_t) {
+        .dev = {
+            .addr = BMP280_SIM_ADDR,
+            .write = bmp280_write,
+            .read = bmp280_read
+        }
+    };
+    reset(&s_bmp280);
+    i2c_sim_attach(&s_bmp280.dev);
+}
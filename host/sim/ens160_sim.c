@@ -0,0 +1,184 @@
+#include "i2c_sim.h"
+#include "sim_devices.h"
+#include "sim_env.h"
+
+#include "esp_timer.h"
+
+#include <string.h>
+
+#define ENS160_REG_PART_ID      0x00
+#define ENS160_REG_OPMODE       0x10
+#define ENS160_REG_CONFIG       0x11
+#define ENS160_REG_COMMAND      0x12
+#define ENS160_REG_TEMP_IN      0x13
+#define ENS160_REG_RH_IN        0x15
+#define ENS160_REG_STATUS       0x20
+#define ENS160_REG_DATA_AQI     0x21
+#define ENS160_REG_DATA_TVOC    0x22
+#define ENS160_REG_DATA_ECO2    0x24
+#define ENS160_REG_DATA_T       0x30
+#define ENS160_REG_DATA_RH      0x32
+#define ENS160_REG_GPR_WRITE    0x40
+#define ENS160_REG_GPR_READ     0x48
+
+#define ENS160_PART_ID          0x0160
+
+#define ENS160_OPMODE_SLEEP     0x00
+#define ENS160_OPMODE_IDLE      0x01
+#define ENS160_OPMODE_STANDARD  0x02
+#define ENS160_OPMODE_RESET     0xf0
+
+#define ENS160_STATUS_STATAS    0x80
+#define ENS160_STATUS_STATER    0x40
+#define ENS160_STATUS_VALIDITY  0x0c
+#define ENS160_STATUS_NEWDAT    0x02
+#define ENS160_STATUS_NEWGPR    0x01
+
+#define ENS160_VALIDITY_WARMUP  (1 << 2)
+
+#define ENS160_PERIOD_US        1000000
+#define ENS160_WARMUP_US        (180 * 1000000LL)
+
+typedef struct {
+    i2c_sim_device_t dev;
+    uint8_t regs[256];
+    uint8_t pointer;
+    int64_t started_us;     // entry into the standard mode
+    int64_t next_data_us;
+} ens160_sim_t;
+
+static ens160_sim_t s_ens160;
+
+static inline void put16(uint8_t *reg, uint16_t value)
+{
+    reg[0] = (uint8_t)value;
+    reg[1] = (uint8_t)(value >> 8);
+}
+
+static void reset(ens160_sim_t *s)
+{
+    memset(s->regs, 0, sizeof(s->regs));
+    put16(&s->regs[ENS160_REG_PART_ID], ENS160_PART_ID);
+    s->regs[ENS160_REG_OPMODE] = ENS160_OPMODE_SLEEP;
+}
+
+/**
+ * @brief Publish the samples due since the last access
+*/
+static void update(ens160_sim_t *s)
+{
+    if(s->regs[ENS160_REG_OPMODE] != ENS160_OPMODE_STANDARD)
+        return;
+
+    const int64_t now = esp_timer_get_time();
+    if(now < s->next_data_us)
+        return;
+
+    sim_env_t env;
+    sim_env_get(now, &env);
+
+    s->regs[ENS160_REG_DATA_AQI] = env.aqi;
+    put16(&s->regs[ENS160_REG_DATA_TVOC], env.tvoc);
+    put16(&s->regs[ENS160_REG_DATA_ECO2], env.eco2);
+    // the compensation actually used
+    memcpy(&s->regs[ENS160_REG_DATA_T], &s->regs[ENS160_REG_TEMP_IN], 2);
+    memcpy(&s->regs[ENS160_REG_DATA_RH], &s->regs[ENS160_REG_RH_IN], 2);
+
+    uint8_t status = ENS160_STATUS_STATAS | ENS160_STATUS_NEWDAT;
+    if(now - s->started_us < ENS160_WARMUP_US)
+        status |= ENS160_VALIDITY_WARMUP;
+    s->regs[ENS160_REG_STATUS] = status | (s->regs[ENS160_REG_STATUS] & ENS160_STATUS_NEWGPR);
+
+    // samples missed in between are lost, as on the part
+    while(s->next_data_us <= now)
+        s->next_data_us += ENS160_PERIOD_US;
+}
+
+static void set_opmode(ens160_sim_t *s, uint8_t opmode)
+{
+    switch (opmode)
+    {
+    case ENS160_OPMODE_RESET:
+        reset(s);
+        break;
+
+    case ENS160_OPMODE_STANDARD:
+        if(s->regs[ENS160_REG_OPMODE] != ENS160_OPMODE_STANDARD) {
+            s->started_us = esp_timer_get_time();
+            s->next_data_us = s->started_us + ENS160_PERIOD_US;
+        }
+        s->regs[ENS160_REG_OPMODE] = opmode;
+        break;
+
+    case ENS160_OPMODE_SLEEP:
+    case ENS160_OPMODE_IDLE:
+        s->regs[ENS160_REG_OPMODE] = opmode;
+        s->regs[ENS160_REG_STATUS] &= ~(ENS160_STATUS_STATAS | ENS160_STATUS_NEWDAT);
+        break;
+
+    default:
+        // invalid operating mode
+        s->regs[ENS160_REG_STATUS] |= ENS160_STATUS_STATER;
+        break;
+    }
+}
+
+static esp_err_t ens160_write(i2c_sim_device_t *dev, const uint8_t *data, size_t len)
+{
+    ens160_sim_t *s = (ens160_sim_t *)dev;
+
+    update(s);
+    if(len == 0)
+        return ESP_OK;
+
+    // register address, then data with auto-increment
+    s->pointer = data[0];
+    for(size_t i = 1; i < len; i++)
+    {
+        const uint8_t reg = (uint8_t)(data[0] + i - 1);
+
+        if(reg == ENS160_REG_OPMODE)
+            set_opmode(s, data[i]);
+        else if(reg == ENS160_REG_CONFIG || reg == ENS160_REG_COMMAND
+            || (reg >= ENS160_REG_TEMP_IN && reg < ENS160_REG_RH_IN + 2)
+            || (reg >= ENS160_REG_GPR_WRITE && reg < ENS160_REG_GPR_READ))
+            s->regs[reg] = data[i];
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t ens160_read(i2c_sim_device_t *dev, uint8_t *data, size_t len)
+{
+    ens160_sim_t *s = (ens160_sim_t *)dev;
+    bool data_read = false;
+
+    update(s);
+
+    for(size_t i = 0; i < len; i++)
+    {
+        const uint8_t reg = (uint8_t)(s->pointer + i);
+        data[i] = s->regs[reg];
+        if(reg >= ENS160_REG_DATA_AQI && reg < ENS160_REG_DATA_ECO2 + 2)
+            data_read = true;
+    }
+
+    // NEWDAT is cleared by reading the data registers
+    if(data_read)
+        s->regs[ENS160_REG_STATUS] &= ~ENS160_STATUS_NEWDAT;
+
+    return ESP_OK;
+}
+
+void ens160_sim_attach(void)
+{
+    s_ens160 = (ens160_sim_t) {
+        .dev = {
+            .addr = ENS160_SIM_ADDR,
+            .write = ens160_write,
+            .read = ens160_read
+        }
+    };
+    reset(&s_ens160);
+    i2c_sim_attach(&s_ens160.dev);
+}
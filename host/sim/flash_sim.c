@@ -0,0 +1,98 @@
+#include "esp_ota_ops.h"
+#include "flash_sim.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#define IMAGE_MAGIC     0xe9
+
+static const esp_partition_t s_partitions[] = {
+    { .label = "ota_0", .address = 0x10000, .size = FLASH_SIM_PARTITION_SIZE },
+    { .label = "ota_1", .address = 0x10000 + FLASH_SIM_PARTITION_SIZE, .size = FLASH_SIM_PARTITION_SIZE },
+};
+
+static const esp_partition_t *const s_update = &s_partitions[1];
+
+static uint8_t s_data[FLASH_SIM_PARTITION_SIZE];
+static const esp_partition_t *s_boot = NULL;
+static flash_sim_stats_t s_stats;
+
+static bool in_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    return partition == s_update && offset <= partition->size && size <= partition->size - offset;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if(!in_range(partition, offset, size) || offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(s_data + offset, 0xff, size);
+    s_stats.erased += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    const uint8_t *bytes = src;
+    bool dirty = false;
+
+    if(!in_range(partition, dst_offset, size))
+        return ESP_ERR_INVALID_ARG;
+
+    for(size_t i = 0; i < size; i++) {
+        dirty |= (bytes[i] & ~s_data[dst_offset + i]) != 0;
+        s_data[dst_offset + i] &= bytes[i];
+    }
+
+    s_stats.written += size;
+    s_stats.dirty_writes += dirty;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if(!in_range(partition, src_offset, size))
+        return ESP_ERR_INVALID_ARG;
+
+    memcpy(dst, s_data + src_offset, size);
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    (void)start_from;
+    return s_update;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    if(partition != s_update)
+        return ESP_ERR_INVALID_ARG;
+    if(s_data[0] != IMAGE_MAGIC)
+        return ESP_ERR_INVALID_CRC;
+
+    s_boot = partition;
+    return ESP_OK;
+}
+
+const uint8_t *flash_sim_update_data(void)
+{
+    return s_data;
+}
+
+const esp_partition_t *flash_sim_boot_partition(void)
+{
+    return s_boot;
+}
+
+void flash_sim_reset(void)
+{
+    s_boot = NULL;
+    memset(s_data, 0x5a, sizeof(s_data));
+}
+
+void flash_sim_get_stats(flash_sim_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,204 @@
+#include "esp_http_client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+
+#include "host_port.h"
+#include "lwip/sockets.h"
+
+#define HTTP_SIM_URL_MAX        128
+#define HTTP_SIM_HEADER_MAX     512
+#define HTTP_SIM_RANGE_MAX      48
+
+struct esp_http_client {
+    char host[HTTP_SIM_URL_MAX];
+    char path[HTTP_SIM_URL_MAX];
+    uint16_t port;
+    int timeout_ms;
+    http_event_handle_cb handler;
+    char range[HTTP_SIM_RANGE_MAX];
+    int fd;
+    int status;
+    int64_t remaining;      // of the body, -1 until the connection closes
+};
+
+// one download at a time, as on the device
+static struct esp_http_client s_client;
+static bool s_in_use = false;
+static uint32_t s_link_kbps = 0;
+
+static void take_link_time(size_t bytes)
+{
+    if(s_link_kbps)
+        host_time_advance_us((uint32_t)(bytes * 8 * 1000ULL / s_link_kbps));
+}
+
+void http_client_sim_set_link_kbps(uint32_t kbps)
+{
+    s_link_kbps = kbps;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    struct esp_http_client *c = &s_client;
+    unsigned port = 80;
+
+    if(s_in_use)
+        return NULL;
+
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    c->timeout_ms = config->timeout_ms;
+    c->handler = config->event_handler;
+
+    // http://host[:port]/path
+    if(sscanf(config->url, "http://%127[^:/]:%u%127s", c->host, &port, c->path) != 3
+        && sscanf(config->url, "http://%127[^/]%127s", c->host, c->path) != 2)
+        return NULL;
+
+    c->port = (uint16_t)port;
+    s_in_use = true;
+    return c;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    if(strcasecmp(key, "Range") != 0 || strlen(value) >= sizeof(client->range))
+        return ESP_ERR_NOT_SUPPORTED;
+
+    strcpy(client->range, value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(client->port) };
+    struct timeval timeout = { .tv_sec = client->timeout_ms / 1000, .tv_usec = client->timeout_ms % 1000 * 1000 };
+    char request[HTTP_SIM_HEADER_MAX];
+
+    (void)write_len;
+
+    if(inet_pton(AF_INET, client->host, &addr.sin_addr) != 1)
+        return ESP_ERR_INVALID_ARG;
+
+    client->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(client->fd < 0)
+        return ESP_FAIL;
+
+    setsockopt(client->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if(connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+
+    int len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: %s\r\n", client->path, client->host);
+    if(client->range[0])
+        len += snprintf(request + len, sizeof(request) - len, "Range: %s\r\n", client->range);
+    len += snprintf(request + len, sizeof(request) - len, "Connection: close\r\n\r\n");
+
+    if(send(client->fd, request, len, MSG_NOSIGNAL) != len) {
+        esp_http_client_close(client);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    char line[HTTP_SIM_HEADER_MAX];
+    size_t len = 0, total = 0;
+
+    client->status = 0;
+    client->remaining = -1;
+
+    // byte by byte, the body stays in the socket
+    while(true)
+    {
+        char c;
+        if(recv(client->fd, &c, 1, 0) != 1)
+            return -1;
+        total++;
+
+        if(c != '\n') {
+            if(c != '\r' && len < sizeof(line) - 1)
+                line[len++] = c;
+            continue;
+        }
+
+        line[len] = '\0';
+        len = 0;
+        if(line[0] == '\0')
+            break;
+
+        if(client->status == 0) {
+            sscanf(line, "HTTP/1.%*d %d", &client->status);
+            continue;
+        }
+
+        char *colon = strchr(line, ':');
+        if(colon == NULL)
+            continue;
+        *colon = '\0';
+        char *value = colon + 1;
+        while(*value == ' ')
+            value++;
+
+        if(strcasecmp(line, "Content-Length") == 0)
+            client->remaining = strtoll(value, NULL, 10);
+
+        if(client->handler) {
+            esp_http_client_event_t event = {
+                .event_id = HTTP_EVENT_ON_HEADER,
+                .client = client,
+                .header_key = line,
+                .header_value = value,
+            };
+            client->handler(&event);
+        }
+    }
+
+    take_link_time(total);
+    return client->remaining;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if(client->remaining == 0)
+        return 0;
+    if(client->remaining > 0 && len > client->remaining)
+        len = (int)client->remaining;
+
+    const ssize_t got = recv(client->fd, buffer, len, 0);
+    if(got < 0)
+        return -1;
+    if(got == 0)
+        return client->remaining > 0 ? -1 : 0;
+
+    if(client->remaining > 0)
+        client->remaining -= got;
+    take_link_time(got);
+    return (int)got;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if(client->fd >= 0)
+        close(client->fd);
+    client->fd = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    esp_http_client_close(client);
+    s_in_use = false;
+    return ESP_OK;
+}
@@ -0,0 +1,183 @@
+#include "esp_http_server.h"
+#include "httpd_sim.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "host_port.h"
+#include "lwip/sockets.h"
+
+// socket buffer of a connection on the device, CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+#define HTTPD_SIM_SNDBUF        5760
+#define HTTPD_SIM_WORKS         4
+
+typedef struct {
+    httpd_work_fn_t fn;
+    void *arg;
+} work_t;
+
+static int s_listen = -1;
+static struct sockaddr_in s_addr;
+
+static work_t s_works[HTTPD_SIM_WORKS];
+static uint32_t s_work_count = 0;
+static httpd_sim_stats_t s_stats;
+
+// of the sends, below a microsecond of virtual time
+static uint64_t s_carry_ns = 0;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief send() that takes its host time in virtual time as well
+*/
+static int timed_send(int fd, const char *buf, size_t len, int flags)
+{
+    const uint64_t start = now_ns();
+    const ssize_t sent = send(fd, buf, len, flags | MSG_NOSIGNAL);
+
+    s_carry_ns += now_ns() - start;
+    host_time_advance_us((uint32_t)(s_carry_ns / 1000));
+    s_carry_ns %= 1000;
+
+    if(sent >= 0)
+        return (int)sent;
+    return errno == EAGAIN || errno == EWOULDBLOCK ? HTTPD_SOCK_ERR_TIMEOUT : HTTPD_SOCK_ERR_FAIL;
+}
+
+httpd_handle_t httpd_sim_start(void)
+{
+    socklen_t len = sizeof(s_addr);
+
+    s_listen = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&s_addr, 0, sizeof(s_addr));
+    s_addr.sin_family = AF_INET;
+    s_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(s_listen < 0
+        || bind(s_listen, (struct sockaddr *)&s_addr, sizeof(s_addr)) != 0
+        || listen(s_listen, 8) != 0
+        || getsockname(s_listen, (struct sockaddr *)&s_addr, &len) != 0)
+    {
+        perror("httpd_sim");
+        return NULL;
+    }
+    return &s_listen;
+}
+
+int httpd_sim_connect(int rcvbuf, int *client)
+{
+    const int sndbuf = HTTPD_SIM_SNDBUF;
+
+    *client = socket(AF_INET, SOCK_STREAM, 0);
+    if(*client < 0)
+        return -1;
+
+    // before connect(), so the advertised window stays small
+    if(rcvbuf)
+        setsockopt(*client, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if(connect(*client, (struct sockaddr *)&s_addr, sizeof(s_addr)) != 0) {
+        close(*client);
+        return -1;
+    }
+
+    const int fd = accept(s_listen, NULL, NULL);
+    if(fd >= 0)
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    return fd;
+}
+
+void httpd_sim_request(httpd_req_t *req, int fd)
+{
+    *req = (httpd_req_t) { .handle = &s_listen, .fd = fd, .status = "200 OK" };
+}
+
+void httpd_sim_run(void)
+{
+    // work queued by the work itself waits for the next run
+    const uint32_t count = s_work_count;
+    work_t works[HTTPD_SIM_WORKS];
+
+    memcpy(works, s_works, count * sizeof(work_t));
+    s_work_count = 0;
+
+    for(uint32_t i = 0; i < count; i++) {
+        works[i].fn(works[i].arg);
+        s_stats.works++;
+    }
+}
+
+void httpd_sim_get_stats(httpd_sim_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg)
+{
+    (void)handle;
+
+    if(s_work_count == HTTPD_SIM_WORKS)
+        return ESP_FAIL;
+
+    s_works[s_work_count++] = (work_t) { .fn = work, .arg = arg };
+    return ESP_OK;
+}
+
+int httpd_socket_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    (void)hd;
+    return timed_send(sockfd, buf, buf_len, flags);
+}
+
+int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
+{
+    return timed_send(r->fd, buf, buf_len, 0);
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd)
+{
+    (void)handle;
+
+    s_stats.closes++;
+    s_stats.last_closed = sockfd;
+    close(sockfd);
+    return ESP_OK;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return r->fd;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    r->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    (void)r;
+    (void)field;
+    (void)value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str)
+{
+    char head[64];
+    const int len = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\n\r\n", r->status);
+
+    if(timed_send(r->fd, head, len, 0) != len
+        || timed_send(r->fd, str, strlen(str), 0) != (int)strlen(str))
+        return ESP_FAIL;
+    return ESP_OK;
+}
@@ -0,0 +1,183 @@
+#include "i2c_sim.h"
+#include "sim_devices.h"
+
+#include "driver/i2c.h"
+#include "host_port.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CMD_LINK_SIZE       1100
+
+// start, address byte, stop: ~ 1 byte more than the payload
+#define BUS_TIME_US(bytes)  ((uint32_t)((((bytes) + 1) * 9 * 1000000ULL) / I2C_SIM_FREQ_HZ))
+
+typedef struct {
+    uint8_t data[CMD_LINK_SIZE];
+    size_t len;
+    bool started;
+    bool overflow;
+} cmd_link_t;
+
+_Static_assert(sizeof(cmd_link_t) + _Alignof(cmd_link_t) <= I2C_LINK_RECOMMENDED_SIZE(1),
+    "I2C_LINK_RECOMMENDED_SIZE is too small");
+
+static i2c_sim_device_t *s_devices = NULL;
+
+void i2c_sim_attach(i2c_sim_device_t *dev)
+{
+    dev->next = s_devices;
+    s_devices = dev;
+}
+
+void i2c_sim_attach_board(void)
+{
+    aht21_sim_attach();
+    bmp280_sim_attach();
+    ens160_sim_attach();
+    ssd1306_sim_attach();
+}
+
+static i2c_sim_device_t *find(uint8_t addr)
+{
+    for(i2c_sim_device_t *dev = s_devices; dev; dev = dev->next)
+        if(dev->addr == addr)
+            return dev;
+    return NULL;
+}
+
+static esp_err_t bus_write(uint8_t addr, const uint8_t *data, size_t len)
+{
+    i2c_sim_device_t *dev = find(addr);
+
+    host_time_advance_us(BUS_TIME_US(dev ? len : 0));
+    if(dev == NULL)
+        return ESP_FAIL;
+
+    return dev->write(dev, data, len);
+}
+
+static esp_err_t bus_read(uint8_t addr, uint8_t *data, size_t len)
+{
+    i2c_sim_device_t *dev = find(addr);
+
+    host_time_advance_us(BUS_TIME_US(dev ? len : 0));
+    if(dev == NULL)
+        return ESP_FAIL;
+
+    return dev->read(dev, data, len);
+}
+
+esp_err_t i2c_master_write_to_device(i2c_port_t port, uint8_t dev_addr,
+    const uint8_t *data, size_t len, TickType_t timeout)
+{
+    (void)port;
+    (void)timeout;
+    return bus_write(dev_addr, data, len);
+}
+
+esp_err_t i2c_master_read_from_device(i2c_port_t port, uint8_t dev_addr,
+    uint8_t *data, size_t len, TickType_t timeout)
+{
+    (void)port;
+    (void)timeout;
+    return bus_read(dev_addr, data, len);
+}
+
+esp_err_t i2c_master_write_read_device(i2c_port_t port, uint8_t dev_addr,
+    const uint8_t *wdata, size_t wlen, uint8_t *rdata, size_t rlen, TickType_t timeout)
+{
+    (void)port;
+    (void)timeout;
+
+    esp_err_t err = bus_write(dev_addr, wdata, wlen);
+    if(err != ESP_OK)
+        return err;
+
+    return bus_read(dev_addr, rdata, rlen);
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    return calloc(1, sizeof(cmd_link_t));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd)
+{
+    free(cmd);
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size)
+{
+    const uintptr_t align = _Alignof(cmd_link_t);
+    const uintptr_t offset = (align - (uintptr_t)buffer % align) % align;
+
+    if(buffer == NULL || size < offset + sizeof(cmd_link_t))
+        return NULL;
+
+    cmd_link_t *link = (cmd_link_t *)(buffer + offset);
+    memset(link, 0, sizeof(*link));
+    return link;
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd)
+{
+    (void)cmd;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+{
+    cmd_link_t *link = cmd;
+
+    // a repeated start would turn the link into a register read
+    if(link->started)
+        return ESP_ERR_NOT_SUPPORTED;
+
+    link->started = true;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t len, bool ack_en)
+{
+    cmd_link_t *link = cmd;
+    (void)ack_en;
+
+    if(!link->started)
+        return ESP_ERR_INVALID_STATE;
+
+    if(link->len + len > sizeof(link->data)) {
+        link->overflow = true;
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(link->data + link->len, data, len);
+    link->len += len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en)
+{
+    return i2c_master_write(cmd, &data, 1, ack_en);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+{
+    cmd_link_t *link = cmd;
+    return link->started ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t timeout)
+{
+    const cmd_link_t *link = cmd;
+    (void)port;
+    (void)timeout;
+
+    if(link->overflow || link->len == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    // the first byte is the address with the R/W bit, only writes are supported
+    if(link->data[0] & I2C_MASTER_READ)
+        return ESP_ERR_NOT_SUPPORTED;
+
+    return bus_write(link->data[0] >> 1, link->data + 1, link->len - 1);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/**
+ * Legacy I2C master API on top of the simulated bus, see i2c_sim.h
+*/
+
+typedef int i2c_port_t;
+
+#define I2C_NUM_0           0
+#define I2C_NUM_1           1
+
+typedef enum {
+    I2C_MASTER_WRITE = 0,
+    I2C_MASTER_READ
+} i2c_rw_t;
+
+typedef enum {
+    I2C_MASTER_ACK = 0,
+    I2C_MASTER_NACK,
+    I2C_MASTER_LAST_NACK
+} i2c_ack_type_t;
+
+typedef void *i2c_cmd_handle_t;
+
+esp_err_t i2c_master_write_to_device(i2c_port_t port, uint8_t dev_addr, 
+    const uint8_t *data, size_t len, TickType_t timeout);
+
+esp_err_t i2c_master_read_from_device(i2c_port_t port, uint8_t dev_addr, 
+    uint8_t *data, size_t len, TickType_t timeout);
+
+esp_err_t i2c_master_write_read_device(i2c_port_t port, uint8_t dev_addr, 
+    const uint8_t *wdata, size_t wlen, uint8_t *rdata, size_t rlen, TickType_t timeout);
+
+/**
+ * Command links support one write transaction: start, address, data, stop
+*/
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd);
+
+/**
+ * A simulated link holds its bytes, whatever the number of transactions
+*/
+#define I2C_LINK_RECOMMENDED_SIZE(TRANSACTIONS)     1152
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size);
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd);
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd);
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en);
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t len, bool ack_en);
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd);
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t timeout);
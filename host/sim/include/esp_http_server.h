@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "esp_err.h"
+
+/**
+ * The subset of the esp_http_server API used by the stream handler,
+ * served by httpd_sim.c over real loopback sockets, see httpd_sim.h.
+*/
+
+#define HTTPD_SOCK_ERR_FAIL     -1
+#define HTTPD_SOCK_ERR_INVALID  -2
+#define HTTPD_SOCK_ERR_TIMEOUT  -3
+
+typedef void *httpd_handle_t;
+
+typedef void (*httpd_work_fn_t)(void *arg);
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int fd;
+    const char *status;     // set by httpd_resp_set_status()
+} httpd_req_t;
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg);
+
+int httpd_socket_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags);
+
+int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len);
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd);
+
+int httpd_req_to_sockfd(httpd_req_t *r);
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status);
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value);
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "esp_partition.h"
+
+/**
+ * The OTA data of flash_sim.c: the device runs from ota_0 and updates ota_1
+*/
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+
+/**
+ * @brief Only the magic byte of the image is validated
+*/
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
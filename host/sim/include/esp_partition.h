@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * Partitions of the flash model in flash_sim.c, see flash_sim.h
+*/
+
+#define SPI_FLASH_SEC_SIZE  4096
+
+typedef struct {
+    char label[17];
+    uint32_t address;
+    uint32_t size;
+} esp_partition_t;
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_partition.h"
+
+/**
+ * NOR flash behind the partition API: erasing sets whole sectors to
+ * 0xff, writing can only clear bits. A write over bits that were not
+ * erased is counted, the data ends up ANDed as on the part.
+*/
+
+#define FLASH_SIM_PARTITION_SIZE    (1024 * 1024)
+
+typedef struct {
+    uint32_t erased;        // bytes
+    uint32_t written;       // bytes
+    uint32_t dirty_writes;  // writes over bits that were not erased
+} flash_sim_stats_t;
+
+/**
+ * @brief Contents of the update partition
+*/
+const uint8_t *flash_sim_update_data(void);
+
+/**
+ * @return the partition set by esp_ota_set_boot_partition(), NULL if none
+*/
+const esp_partition_t *flash_sim_boot_partition(void);
+
+/**
+ * @brief Forget the boot partition and fill the update partition with
+ * bytes that are not erased
+*/
+void flash_sim_reset(void);
+
+void flash_sim_get_stats(flash_sim_stats_t *stats);
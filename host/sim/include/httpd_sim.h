@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+/**
+ * The http server task of the device: requests and queued work run when
+ * the check calls httpd_sim_run(), sockets are TCP connections on the
+ * loopback. A send lets as much virtual time pass as the send() of the
+ * host took, so esp_timer measures the socket work of a handler.
+*/
+
+typedef struct {
+    uint32_t works;         // queued work run
+    uint32_t closes;        // httpd_sess_trigger_close() calls
+    int last_closed;        // fd of the last one
+} httpd_sim_stats_t;
+
+/**
+ * @brief Listen on a loopback port, call it once
+*/
+httpd_handle_t httpd_sim_start(void);
+
+/**
+ * @brief Open a connection to the server
+ * @param rcvbuf receive buffer of the client, 0 - default
+ * @param client where to store the client end
+ * @return the server end, -1 on error
+*/
+int httpd_sim_connect(int rcvbuf, int *client);
+
+/**
+ * @brief A request received on the server end `fd`
+*/
+void httpd_sim_request(httpd_req_t *req, int fd);
+
+/**
+ * @brief Run the queued work, as the server task would
+*/
+void httpd_sim_run(void);
+
+void httpd_sim_get_stats(httpd_sim_stats_t *stats);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * Simulated I2C bus behind the legacy master API of driver/i2c.h.
+ * A device gets every transaction addressed to it, a transaction to
+ * an address without a device is not acknowledged (ESP_FAIL).
+ * Transfers take virtual time as on a bus clocked at I2C_SIM_FREQ_HZ.
+*/
+
+#define I2C_SIM_FREQ_HZ     400000
+
+typedef struct i2c_sim_device i2c_sim_device_t;
+
+struct i2c_sim_device {
+    uint8_t addr;
+
+    /**
+     * @brief Master writes `data`, the transaction ends with a stop or
+     * a repeated start
+    */
+    esp_err_t (*write)(i2c_sim_device_t *dev, const uint8_t *data, size_t len);
+
+    /**
+     * @brief Master reads `len` bytes
+    */
+    esp_err_t (*read)(i2c_sim_device_t *dev, uint8_t *data, size_t len);
+
+    i2c_sim_device_t *next;
+};
+
+void i2c_sim_attach(i2c_sim_device_t *dev);
+
+/**
+ * @brief Attach the sensors and the display of the board
+*/
+void i2c_sim_attach_board(void);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * The subset of the esp-mqtt client API used by main/, served by the
+ * stand-in broker of mqtt_sim.c. Events are delivered from the task of
+ * the client, as on the target.
+*/
+
+typedef const char *esp_event_base_t;
+
+#define ESP_EVENT_ANY_ID    -1
+
+typedef void (*esp_event_handler_t)(void *handler_args, esp_event_base_t base,
+    int32_t event_id, void *event_data);
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+} esp_mqtt_event_id_t;
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef struct {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    int msg_id;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+typedef struct {
+    struct {
+        struct {
+            const char *uri;
+        } address;
+    } broker;
+    struct {
+        struct {
+            const char *topic;
+            const char *msg;
+            int qos;
+            int retain;
+        } last_will;
+    } session;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+    esp_mqtt_event_id_t event, esp_event_handler_t handler, void *handler_args);
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+
+/**
+ * @return message id, -1 while the client is not connected
+*/
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic,
+    const char *data, int len, int qos, int retain);
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client);
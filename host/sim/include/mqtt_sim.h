@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * A broker on the LAN, like a local mosquitto: it answers the connection
+ * after MQTT_SIM_CONNECT_MS and every QoS 1 message after MQTT_SIM_RTT_MS,
+ * while the link takes MQTT_SIM_LINK_KBPS. It checks the samples topic:
+ * the `seq` of every record must follow the previous one, a repeat is a
+ * duplicate (the acknowledgement was lost), a jump is a gap.
+*/
+
+#define MQTT_SIM_CONNECT_MS     20
+#define MQTT_SIM_RTT_MS         5
+#define MQTT_SIM_LINK_KBPS      2000
+
+typedef struct {
+    uint32_t connects;
+    uint32_t messages;      // on the samples topic
+    uint32_t records;
+    uint32_t bytes;
+    uint32_t duplicates;    // records received again
+    uint32_t gaps;          // records skipped
+    uint32_t next_seq;      // expected next
+    bool online;            // last retained status
+} mqtt_sim_stats_t;
+
+/**
+ * @brief Take the broker down (the client sees a disconnect) or up
+ * (the client connects again)
+*/
+void mqtt_sim_set_up(bool up);
+
+void mqtt_sim_get_stats(mqtt_sim_stats_t *stats);
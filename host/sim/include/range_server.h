@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * An HTTP server on the loopback that serves one image to any GET, like
+ * nginx serving build/air-quality-alarmer.bin. It runs in a thread of
+ * its own, outside the tasks of the port, and closes every connection
+ * after the response.
+*/
+
+typedef enum {
+    RANGE_SERVER_PARTIAL,   // 206 with Content-Range for a Range request
+    RANGE_SERVER_FULL,      // 200 and the whole image, Range is ignored
+    RANGE_SERVER_DOWN,      // 503 to everything
+} range_server_mode_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t partial;       // 206 answers
+    uint32_t full;          // 200 answers
+    uint32_t refused;       // 503 answers
+    uint32_t bytes;         // of image data sent
+    int64_t first_start;    // first byte asked for since the reset, -1 none
+} range_server_stats_t;
+
+/**
+ * @return the port, 0 on error
+*/
+uint16_t range_server_start(const uint8_t *image, size_t size);
+
+/**
+ * @brief Answer in `mode`, and after `requests` more answers go down (0 - never)
+*/
+void range_server_set_mode(range_server_mode_t mode, uint32_t requests);
+
+void range_server_get_stats(range_server_stats_t *stats);
+
+void range_server_reset_stats(void);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Register-level models of the parts on the board.
+ * The sensors follow sim_env_get(), their timing follows the datasheets
+ * in docs/: the AHT21 is busy for 80 ms after a trigger, the BMP280
+ * converts continuously in normal mode, the ENS160 publishes one sample
+ * per second in standard mode.
+*/
+
+#define AHT21_SIM_ADDR      0x38
+#define BMP280_SIM_ADDR     0x76
+#define ENS160_SIM_ADDR     0x53
+#define SSD1306_SIM_ADDR    0x3c
+
+#define SSD1306_SIM_WIDTH   128
+#define SSD1306_SIM_PAGES   8
+
+void aht21_sim_attach(void);
+
+/**
+ * @brief Break the CRC of every n-th measurement read, 0 - never
+*/
+void aht21_sim_corrupt_every(uint32_t n);
+
+/**
+ * @brief Number of measurement reads sent with a broken CRC
+*/
+uint32_t aht21_sim_corrupted(void);
+
+void bmp280_sim_attach(void);
+
+void ens160_sim_attach(void);
+
+void ssd1306_sim_attach(void);
+
+/**
+ * @brief Display RAM, SSD1306_SIM_PAGES pages of SSD1306_SIM_WIDTH
+ * columns, bit 0 of a byte is the top row of its page
+*/
+const uint8_t *ssd1306_sim_framebuffer(void);
+
+/**
+ * @brief Number of times the last column of the last visible page was written
+*/
+uint32_t ssd1306_sim_frames(void);
+
+bool ssd1306_sim_is_on(void);
+
+/**
+ * @brief Print the first `rows` rows of the display RAM as text
+*/
+void ssd1306_sim_dump(FILE *out, uint32_t rows);
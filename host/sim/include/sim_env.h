@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Environment seen by the simulated sensors. It drifts slowly and
+ * deterministically, so a reading can be checked against it.
+*/
+typedef struct {
+    float temperature;  // °C
+    float humidity;     // %RH
+    float pressure;     // Pa
+    uint16_t tvoc;      // ppb
+    uint16_t eco2;      // ppm
+    uint8_t aqi;        // UBA, 1..5
+} sim_env_t;
+
+void sim_env_get(int64_t time_us, sim_env_t *env);
@@ -0,0 +1,240 @@
+#include "mqtt_client.h"
+#include "mqtt_sim.h"
+#include "history.h"
+
+#include <string.h>
+
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "host_port.h"
+
+// the esp-mqtt task runs at priority 5 by default
+#define MQTT_SIM_PRIORITY       (ESP_TASK_PRIO_MIN + 5)
+#define MQTT_SIM_EVENTS         16
+#define MQTT_SIM_MSG_ID_MAX     0xffff
+
+typedef enum {
+    SIM_CONNECT,
+    SIM_DISCONNECT,
+    SIM_ACK,
+} sim_event_type_t;
+
+typedef struct {
+    sim_event_type_t type;
+    int msg_id;
+    uint32_t session;       // an acknowledgement of a lost session is never sent
+    int64_t due_us;
+} sim_event_t;
+
+struct esp_mqtt_client {
+    esp_event_handler_t handler;
+    void *handler_args;
+    bool connected;
+    uint32_t session;
+    int msg_id;
+};
+
+static struct esp_mqtt_client s_client;
+static bool s_up = true;
+static mqtt_sim_stats_t s_stats;
+
+static QueueHandle_t s_events = NULL;
+static StaticQueue_t s_events_control;
+static uint8_t s_events_storage[MQTT_SIM_EVENTS * sizeof(sim_event_t)];
+
+static TaskHandle_t s_task = NULL;
+static StaticTask_t s_task_tcb;
+
+static void post(sim_event_type_t type, int msg_id, uint32_t delay_ms)
+{
+    const sim_event_t event = {
+        .type = type,
+        .msg_id = msg_id,
+        .session = s_client.session,
+        .due_us = esp_timer_get_time() + delay_ms * 1000LL,
+    };
+    xQueueSend(s_events, &event, 0);
+}
+
+static void dispatch(esp_mqtt_event_id_t id, int msg_id)
+{
+    esp_mqtt_event_t event = { .event_id = id, .client = &s_client, .msg_id = msg_id };
+
+    if(s_client.handler)
+        s_client.handler(s_client.handler_args, "MQTT_EVENTS", id, &event);
+}
+
+static bool ends_with(const char *s, const char *suffix)
+{
+    const size_t len = strlen(s), suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(s + len - suffix_len, suffix) == 0;
+}
+
+static void check_seq(uint32_t seq)
+{
+    if(seq == s_stats.next_seq) {
+        s_stats.records++;
+        s_stats.next_seq++;
+    } else if((int32_t)(seq - s_stats.next_seq) < 0) {
+        s_stats.duplicates++;
+    } else {
+        s_stats.gaps += seq - s_stats.next_seq;
+        s_stats.records++;
+        s_stats.next_seq = seq + 1;
+    }
+}
+
+/**
+ * @brief A JSON array of objects with "seq", or packed history records
+*/
+static void receive_samples(const char *data, int len)
+{
+    static const char key[] = "\"seq\":";
+
+    s_stats.messages++;
+    s_stats.bytes += len;
+
+    if(len > 0 && data[0] == '[') {
+        for(int i = 0; i + (int)sizeof(key) - 1 < len; i++)
+        {
+            if(memcmp(data + i, key, sizeof(key) - 1) != 0)
+                continue;
+
+            uint32_t seq = 0;
+            for(i += sizeof(key) - 1; i < len && data[i] >= '0' && data[i] <= '9'; i++)
+                seq = seq * 10 + (data[i] - '0');
+            check_seq(seq);
+        }
+        return;
+    }
+
+    for(int i = 0; i + (int)sizeof(history_record_t) <= len; i += sizeof(history_record_t))
+    {
+        history_record_t record;
+        memcpy(&record, data + i, sizeof(record));
+        check_seq(record.seq);
+    }
+}
+
+static void client_task(void *arg)
+{
+    sim_event_t event;
+
+    while(true)
+    {
+        xQueueReceive(s_events, &event, portMAX_DELAY);
+
+        const int64_t wait_us = event.due_us - esp_timer_get_time();
+        if(wait_us > 0)
+            vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000));
+
+        switch (event.type)
+        {
+        case SIM_CONNECT:
+            if(!s_up || s_client.connected)
+                break;
+            s_client.connected = true;
+            s_stats.connects++;
+            dispatch(MQTT_EVENT_CONNECTED, 0);
+            break;
+        case SIM_DISCONNECT:
+            // the connection is already gone, see mqtt_sim_set_up()
+            dispatch(MQTT_EVENT_DISCONNECTED, 0);
+            break;
+        case SIM_ACK:
+            if(s_client.connected && event.session == s_client.session)
+                dispatch(MQTT_EVENT_PUBLISHED, event.msg_id);
+            break;
+        }
+    }
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    (void)config;
+    memset(&s_client, 0, sizeof(s_client));
+
+    if(s_events == NULL)
+        s_events = xQueueCreateStatic(MQTT_SIM_EVENTS, sizeof(sim_event_t), s_events_storage, &s_events_control);
+
+    return &s_client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+    esp_mqtt_event_id_t event, esp_event_handler_t handler, void *handler_args)
+{
+    (void)event;
+    client->handler = handler;
+    client->handler_args = handler_args;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    (void)client;
+
+    if(s_task == NULL)
+        s_task = xTaskCreateStatic(client_task, "mqtt_client", 0, NULL, MQTT_SIM_PRIORITY, NULL, &s_task_tcb);
+
+    post(SIM_CONNECT, 0, MQTT_SIM_CONNECT_MS);
+    return s_task ? ESP_OK : ESP_FAIL;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char *topic,
+    const char *data, int len, int qos, int retain)
+{
+    (void)retain;
+
+    if(!client->connected)
+        return -1;
+    if(len == 0)
+        len = (int)strlen(data);
+
+    // the socket write
+    host_time_advance_us((uint32_t)(len * 8 * 1000LL / MQTT_SIM_LINK_KBPS));
+
+    if(ends_with(topic, "/samples"))
+        receive_samples(data, len);
+    else if(ends_with(topic, "/status"))
+        s_stats.online = len == 6 && memcmp(data, "online", 6) == 0;
+
+    client->msg_id = client->msg_id % MQTT_SIM_MSG_ID_MAX + 1;
+    if(qos > 0)
+        post(SIM_ACK, client->msg_id, MQTT_SIM_RTT_MS);
+
+    return client->msg_id;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    if(s_task) {
+        vTaskDelete(s_task);
+        s_task = NULL;
+    }
+    client->handler = NULL;
+    client->connected = false;
+    return ESP_OK;
+}
+
+void mqtt_sim_set_up(bool up)
+{
+    s_up = up;
+
+    if(up) {
+        post(SIM_CONNECT, 0, MQTT_SIM_CONNECT_MS);
+    } else if(s_client.connected) {
+        // acknowledgements on their way are lost, the broker publishes the last will
+        s_client.connected = false;
+        s_client.session++;
+        s_stats.online = false;
+        post(SIM_DISCONNECT, 0, 0);
+    }
+}
+
+void mqtt_sim_get_stats(mqtt_sim_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,183 @@
+#include "range_server.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "lwip/sockets.h"
+
+#define RANGE_SERVER_HEADER_MAX 512
+#define RANGE_SERVER_CHUNK      4096
+
+static const uint8_t *s_image;
+static size_t s_size;
+static int s_listen = -1;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static range_server_mode_t s_mode = RANGE_SERVER_PARTIAL;
+static uint32_t s_left = 0;
+static range_server_stats_t s_stats = { .first_start = -1 };
+
+/**
+ * @return the mode of this answer
+*/
+static range_server_mode_t next_answer(void)
+{
+    pthread_mutex_lock(&s_lock);
+    const range_server_mode_t mode = s_mode;
+    if(s_left && --s_left == 0)
+        s_mode = RANGE_SERVER_DOWN;
+    s_stats.requests++;
+    pthread_mutex_unlock(&s_lock);
+    return mode;
+}
+
+static void count(uint32_t *counter, size_t bytes, int64_t start)
+{
+    pthread_mutex_lock(&s_lock);
+    (*counter)++;
+    s_stats.bytes += bytes;
+    if(s_stats.first_start < 0 && start >= 0)
+        s_stats.first_start = start;
+    pthread_mutex_unlock(&s_lock);
+}
+
+static bool send_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while(len > 0) {
+        const ssize_t sent = send(fd, p, len, MSG_NOSIGNAL);
+        if(sent <= 0)
+            return false;
+        p += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+static void serve(int fd)
+{
+    char request[RANGE_SERVER_HEADER_MAX];
+    char head[RANGE_SERVER_HEADER_MAX];
+    size_t len = 0;
+
+    // up to the empty line
+    while(len < sizeof(request) - 1)
+    {
+        const ssize_t got = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+        if(got <= 0)
+            return;
+        len += got;
+        request[len] = '\0';
+        if(strstr(request, "\r\n\r\n"))
+            break;
+    }
+
+    unsigned long first = 0, last = s_size - 1;
+    const char *range = strstr(request, "\r\nRange: bytes=");
+    const bool ranged = range && sscanf(range, "\r\nRange: bytes=%lu-%lu", &first, &last) >= 1;
+    const int64_t asked = ranged ? (int64_t)first : 0;
+    if(last >= s_size)
+        last = s_size - 1;
+
+    const range_server_mode_t mode = next_answer();
+    int head_len;
+
+    if(mode == RANGE_SERVER_DOWN) {
+        count(&s_stats.refused, 0, asked);
+        head_len = snprintf(head, sizeof(head), "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n");
+        send_all(fd, head, head_len);
+        return;
+    }
+
+    if(mode == RANGE_SERVER_FULL || !ranged) {
+        first = 0;
+        last = s_size - 1;
+        head_len = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", s_size);
+    } else if(first >= s_size || first > last) {
+        head_len = snprintf(head, sizeof(head), "HTTP/1.1 416 Range Not Satisfiable\r\n"
+            "Content-Range: bytes */%zu\r\nContent-Length: 0\r\n\r\n", s_size);
+        send_all(fd, head, head_len);
+        return;
+    } else {
+        head_len = snprintf(head, sizeof(head), "HTTP/1.1 206 Partial Content\r\n"
+            "Content-Range: bytes %lu-%lu/%zu\r\nContent-Length: %lu\r\n\r\n",
+            first, last, s_size, last - first + 1);
+    }
+
+    // counted before the client can see the answer
+    count(mode == RANGE_SERVER_FULL || !ranged ? &s_stats.full : &s_stats.partial,
+        last - first + 1, asked);
+
+    if(!send_all(fd, head, head_len))
+        return;
+    for(size_t pos = first; pos <= last; pos += RANGE_SERVER_CHUNK) {
+        const size_t n = MIN(RANGE_SERVER_CHUNK, last + 1 - pos);
+        if(!send_all(fd, s_image + pos, n))
+            return;
+    }
+}
+
+static void *server_thread(void *arg)
+{
+    (void)arg;
+
+    while(true)
+    {
+        const int fd = accept(s_listen, NULL, NULL);
+        if(fd < 0)
+            continue;
+        serve(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+uint16_t range_server_start(const uint8_t *image, size_t size)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    pthread_t thread;
+
+    s_image = image;
+    s_size = size;
+
+    s_listen = socket(AF_INET, SOCK_STREAM, 0);
+    if(s_listen < 0
+        || bind(s_listen, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(s_listen, 4) != 0
+        || getsockname(s_listen, (struct sockaddr *)&addr, &addr_len) != 0
+        || pthread_create(&thread, NULL, server_thread, NULL) != 0)
+    {
+        perror("range_server");
+        return 0;
+    }
+
+    pthread_detach(thread);
+    return ntohs(addr.sin_port);
+}
+
+void range_server_set_mode(range_server_mode_t mode, uint32_t requests)
+{
+    pthread_mutex_lock(&s_lock);
+    s_mode = mode;
+    s_left = requests;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void range_server_get_stats(range_server_stats_t *stats)
+{
+    pthread_mutex_lock(&s_lock);
+    *stats = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void range_server_reset_stats(void)
+{
+    pthread_mutex_lock(&s_lock);
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.first_start = -1;
+    pthread_mutex_unlock(&s_lock);
+}
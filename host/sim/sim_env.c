@@ -0,0 +1,33 @@
+#include "sim_env.h"
+
+#include <math.h>
+
+#define PI_2 6.28318530718
+
+static inline double wave(double t_s, double period_s)
+{
+    return sin(PI_2 * t_s / period_s);
+}
+
+static uint8_t uba_aqi(uint16_t eco2)
+{
+    if(eco2 < 600)  return 1;
+    if(eco2 < 800)  return 2;
+    if(eco2 < 1000) return 3;
+    if(eco2 < 1500) return 4;
+    return 5;
+}
+
+void sim_env_get(int64_t time_us, sim_env_t *env)
+{
+    const double t = (double)time_us / 1e6;
+
+    env->temperature = (float)(22.0 + 3.0 * wave(t, 600.0));
+    env->humidity = (float)(45.0 + 10.0 * wave(t, 900.0));
+    env->pressure = (float)(101325.0 + 200.0 * wave(t, 1200.0));
+
+    // a room filling up and being aired, crosses the alarm thresholds
+    env->eco2 = (uint16_t)(400.0 + 1100.0 * (0.5 - 0.5 * cos(PI_2 * t / 1800.0)));
+    env->tvoc = (uint16_t)(50 + (env->eco2 - 400) / 2);
+    env->aqi = uba_aqi(env->eco2);
+}
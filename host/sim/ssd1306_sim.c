@@ -0,0 +1,202 @@
+#include "i2c_sim.h"
+#include "sim_devices.h"
+
+#include <string.h>
+
+// control byte: Co bit, D/C# bit
+#define SSD1306_CTRL_CO         0x80
+#define SSD1306_CTRL_DATA       0x40
+
+#define SSD1306_ADDR_HORIZONTAL 0x00
+#define SSD1306_ADDR_VERTICAL   0x01
+#define SSD1306_ADDR_PAGE       0x02
+
+typedef struct {
+    i2c_sim_device_t dev;
+    uint8_t ram[SSD1306_SIM_PAGES][SSD1306_SIM_WIDTH];
+    bool on;
+    uint8_t multiplex;      // visible rows - 1
+    uint8_t addressing;
+    uint8_t col, col_start, col_end;
+    uint8_t page, page_start, page_end;
+    uint32_t frames;
+
+    // command being assembled
+    uint8_t cmd[7];
+    uint8_t cmd_len;
+    uint8_t cmd_need;
+} ssd1306_sim_t;
+
+static ssd1306_sim_t s_ssd1306;
+
+/**
+ * @return number of bytes of the command starting with `op`
+*/
+static uint8_t command_length(uint8_t op)
+{
+    switch (op)
+    {
+    case 0x20: case 0x81: case 0x8d: case 0xa8: case 0xd3:
+    case 0xd5: case 0xd8: case 0xd9: case 0xda: case 0xdb:
+        return 2;
+    case 0x21: case 0x22: case 0xa3:
+        return 3;
+    case 0x29: case 0x2a:
+        return 6;
+    case 0x26: case 0x27:
+        return 7;
+    default:
+        return 1;
+    }
+}
+
+static void execute(ssd1306_sim_t *s, const uint8_t *cmd)
+{
+    const uint8_t op = cmd[0];
+
+    if(op == 0xae || op == 0xaf) {
+        s->on = op & 0x01;
+    } else if(op == 0xa8) {
+        s->multiplex = cmd[1] & 0x3f;
+    } else if(op == 0x20) {
+        s->addressing = cmd[1] & 0x03;
+    } else if(op == 0x21) {
+        s->col_start = s->col = cmd[1] & 0x7f;
+        s->col_end = cmd[2] & 0x7f;
+    } else if(op == 0x22) {
+        s->page_start = s->page = cmd[1] & 0x07;
+        s->page_end = cmd[2] & 0x07;
+    } else if(op <= 0x0f) {
+        s->col = (s->col & 0xf0) | op;
+    } else if(op >= 0x10 && op <= 0x1f) {
+        s->col = (uint8_t)(((op & 0x07) << 4) | (s->col & 0x0f));
+    } else if(op >= 0xb0 && op <= 0xb7) {
+        s->page = op & 0x07;
+    }
+    // contrast, charge pump and the like do not change the RAM
+}
+
+static void command_byte(ssd1306_sim_t *s, uint8_t byte)
+{
+    if(s->cmd_len == 0)
+        s->cmd_need = command_length(byte);
+
+    s->cmd[s->cmd_len++] = byte;
+    if(s->cmd_len == s->cmd_need) {
+        execute(s, s->cmd);
+        s->cmd_len = 0;
+    }
+}
+
+static void data_byte(ssd1306_sim_t *s, uint8_t byte)
+{
+    s->ram[s->page][s->col] = byte;
+
+    // the last column of the last visible page completes a frame
+    if(s->page == s->multiplex / 8 && s->col == SSD1306_SIM_WIDTH - 1)
+        s->frames++;
+
+    if(s->addressing == SSD1306_ADDR_PAGE) {
+        if(s->col < SSD1306_SIM_WIDTH - 1)
+            s->col++;
+        return;
+    }
+
+    if(s->addressing == SSD1306_ADDR_VERTICAL) {
+        if(s->page < s->page_end) {
+            s->page++;
+            return;
+        }
+        s->page = s->page_start;
+        s->col = s->col == s->col_end ? s->col_start : s->col + 1;
+        return;
+    }
+
+    if(s->col < s->col_end) {
+        s->col++;
+        return;
+    }
+    s->col = s->col_start;
+    s->page = s->page == s->page_end ? s->page_start : (s->page + 1) & 0x07;
+}
+
+static esp_err_t ssd1306_write(i2c_sim_device_t *dev, const uint8_t *data, size_t len)
+{
+    ssd1306_sim_t *s = (ssd1306_sim_t *)dev;
+    size_t i = 0;
+
+    // control bytes with Co set apply to one byte, the last one to the rest
+    while(i < len)
+    {
+        const uint8_t control = data[i++];
+        const bool last = !(control & SSD1306_CTRL_CO);
+        const size_t end = last ? len : (i < len ? i + 1 : len);
+
+        for(; i < end; i++)
+        {
+            if(control & SSD1306_CTRL_DATA)
+                data_byte(s, data[i]);
+            else
+                command_byte(s, data[i]);
+        }
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t ssd1306_read(i2c_sim_device_t *dev, uint8_t *data, size_t len)
+{
+    ssd1306_sim_t *s = (ssd1306_sim_t *)dev;
+
+    // status byte: bit 6 is set when the display is off
+    for(size_t i = 0; i < len; i++)
+        data[i] = s->on ? 0x00 : 0x40;
+
+    return ESP_OK;
+}
+
+void ssd1306_sim_attach(void)
+{
+    s_ssd1306 = (ssd1306_sim_t) {
+        .dev = {
+            .addr = SSD1306_SIM_ADDR,
+            .write = ssd1306_write,
+            .read = ssd1306_read
+        },
+        .multiplex = SSD1306_SIM_PAGES * 8 - 1,
+        .addressing = SSD1306_ADDR_PAGE,
+        .col_end = SSD1306_SIM_WIDTH - 1,
+        .page_end = SSD1306_SIM_PAGES - 1
+    };
+    i2c_sim_attach(&s_ssd1306.dev);
+}
+
+const uint8_t *ssd1306_sim_framebuffer(void)
+{
+    return &s_ssd1306.ram[0][0];
+}
+
+uint32_t ssd1306_sim_frames(void)
+{
+    return s_ssd1306.frames;
+}
+
+bool ssd1306_sim_is_on(void)
+{
+    return s_ssd1306.on;
+}
+
+void ssd1306_sim_dump(FILE *out, uint32_t rows)
+{
+    if(rows > SSD1306_SIM_PAGES * 8)
+        rows = SSD1306_SIM_PAGES * 8;
+
+    for(uint32_t y = 0; y < rows; y++) {
+        char line[SSD1306_SIM_WIDTH + 2];
+        for(uint32_t x = 0; x < SSD1306_SIM_WIDTH; x++)
+            line[x] = (s_ssd1306.ram[y / 8][x] >> (y % 8)) & 1 ? '#' : ' ';
+        line[SSD1306_SIM_WIDTH] = '\n';
+        line[SSD1306_SIM_WIDTH + 1] = '\0';
+        fputs(line, out);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * Runtime settings, stored as one CRC-protected blob in NVS.
+ * New fields are only appended: a blob of an older version is
+ * migrated by keeping its fields and taking defaults for the rest.
+ * Bump APP_CONFIG_VERSION with every layout change.
+*/
+#define APP_CONFIG_VERSION  1
+
+typedef struct {
+    float aht21_temperature_offset;
+    float aht21_humidity_gain;
+    float bmp280_temperature_offset;
+    float bmp280_pressure_gain;
+    uint32_t measurement_interval_ms;
+    // the buzzer sounds when both thresholds are exceeded
+    uint32_t alarm_aqi;
+    uint32_t alarm_eco2_ppm;
+    uint32_t alarm_duration_ms;
+} app_config_t;
+
+/**
+ * @brief Load the settings from NVS, defaults if there are none.
+ * Call once at boot after NVS is initialized.
+*/
+void app_config_init(void);
+
+/**
+ * @brief Current settings, lock-free. Read the fields right away:
+ * the pointed object is reused by the next but one update.
+*/
+const app_config_t *app_config_get(void);
+
+/**
+ * @brief Validate, store and publish new settings atomically
+ * @return ESP_ERR_INVALID_ARG if a value is out of range
+*/
+esp_err_t app_config_set(const app_config_t *config);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "main.h"
+
+/**
+ * Battery mode: app_main() starts none of the tasks, the display and
+ * the web server. Every wake takes one sample, stores it as a history
+ * record in RTC slow memory and deep-sleeps until the next period; the
+ * ENS160 and the BMP280 sleep meanwhile. The station is brought up only
+ * every BATTERY_UPLOAD_EVERY samples, or at once when the alarm trips,
+ * to hand the stored records to MQTT and UDP.
+*/
+#define BATTERY_MODE_ENABLE         0
+
+#define BATTERY_SAMPLE_PERIOD_S     60
+#define BATTERY_UPLOAD_EVERY        15
+
+/**
+ * Records kept in RTC slow memory (32 bytes each, 4 KB for 128),
+ * the oldest are dropped while the uploads fail
+*/
+#define BATTERY_RTC_CAPACITY        128
+
+/**
+ * Part of the 8 KB of RTC slow memory on the ESP32 the records and their
+ * counters may take, the rest stays for the IDF and the wake stub
+*/
+#define BATTERY_RTC_BUDGET          6144
+
+// the ENS160 delivers the first data about a second after the deep sleep
+#define BATTERY_ENS160_TIMEOUT_MS   3000
+#define BATTERY_ENS160_POLL_MS      100
+
+// for the broker and the collector, after the connection
+#define BATTERY_UPLOAD_TIMEOUT_MS   10000
+
+/**
+ * Energy model of the per-wake report: the measured awake, ENS160 and
+ * radio times times these currents. Typical figures from the datasheets,
+ * replace them with a measurement of the board.
+*/
+#define BATTERY_VOLTAGE_MV          3300
+#define BATTERY_CAPACITY_MAH        2000
+#define BATTERY_CURRENT_CPU_MA      40      // awake, radio off
+#define BATTERY_CURRENT_RADIO_MA    100     // Wi-Fi station, on top of the CPU
+#define BATTERY_CURRENT_ENS160_MA   29      // standard gas sensing
+#define BATTERY_CURRENT_SLEEP_UA    25      // deep sleep, sensors in their sleep modes
+
+/**
+ * @brief Wake the sensors, take a sample and put them back to sleep.
+ * The sample is stored in RTC memory.
+ * @return false if there is no valid sample this time, also on a bus error
+*/
+bool battery_sample(SemaphoreHandle_t i2c_smphr, sensors_data_t *data);
+
+/**
+ * @brief Upload the stored records if due, log the energy of this wake
+ * and deep-sleep until the next period. Does not return.
+ * @param alarm the alarm condition holds for this sample
+*/
+void battery_sleep(bool alarm);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Micro-benchmarks of the hot paths, shared by the firmware and the host build.
+ * The firmware runs them once at boot when BENCH_ENABLE is 1, the host build
+ * as `aqa_bench`. Every result is one JSON object per line:
+ *   {"bench":"aht21_crc","unit":"cycles","per_op":41.0,"ops":262144}
+ * `unit` is CPU cycles on target and nanoseconds on the host,
+ * tools/bench_compare.py diffs two such files.
+*/
+#define BENCH_ENABLE        0
+
+/**
+ * Each benchmark is sized to take at least this long, then repeated
+ * BENCH_REPEATS times; the fastest repetition is reported
+*/
+#define BENCH_MIN_TIME_MS   20
+#define BENCH_REPEATS       5
+
+/**
+ * @brief Run the benchmarks and print their results.
+ * Needs app_config_init(), does not touch the bus.
+ * @param filter run only the benchmarks whose name contains it, NULL for all
+ * @return number of benchmarks run
+*/
+uint32_t bench_run(FILE *out, const char *filter);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "main.h"
+
+/**
+ * Readings derived from the temperature (BMP280, as displayed and stored),
+ * the relative humidity (AHT21) and the pressure (BMP280), computed on the
+ * device with fast_math.h instead of libm.
+ *
+ * The heat index is a polynomial and needs no libm. Largest difference
+ * of the others to the same formulas with libm over -40..85 °C,
+ * 1..100 %RH and 300..1100 hPa, checked by aqa_host:
+*/
+#define COMFORT_DEW_POINT_MAX_ERROR     0.0001f // °C
+#define COMFORT_ABS_HUMIDITY_MAX_ERROR  0.0005f // g/m³
+#define COMFORT_ALTITUDE_MAX_ERROR      0.02f   // m
+
+// ISA sea level, the reference of the pressure altitude
+#define COMFORT_SEA_LEVEL_HPA           1013.25f
+
+#define COMFORT_MMHG_TO_HPA             1.33322368f
+
+/**
+ * @brief Dew point, Magnus formula with the Sonntag constants
+ * @return °C
+*/
+float comfort_dew_point(float temperature, float humidity);
+
+/**
+ * @brief Water vapour per volume of air
+ * @return g/m³
+*/
+float comfort_absolute_humidity(float temperature, float humidity);
+
+/**
+ * @brief NOAA heat index: Rothfusz regression with the Steadman fallback
+ * and the low/high humidity adjustments
+ * @return °C
+*/
+float comfort_heat_index(float temperature, float humidity);
+
+/**
+ * @brief ISA pressure altitude
+ * @param pressure mmHg, as measured
+ * @return m
+*/
+float comfort_altitude(float pressure);
+
+/**
+ * @brief Fill the derived readings of a sample
+*/
+void comfort_compute(sensors_data_t *data);
+
+/**
+ * @brief The same with libm, for the accuracy check and the benchmarks
+*/
+float comfort_dew_point_libm(float temperature, float humidity);
+
+float comfort_absolute_humidity_libm(float temperature, float humidity);
+
+float comfort_altitude_libm(float pressure);
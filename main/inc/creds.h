@@ -1,5 +1,37 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CREDS_MAX_NETWORKS  4
+
+/**
+ * A known network. The BSSID and channel of the last successful
+ * connection are cached for a directed connect without a scan.
+*/
+typedef struct {
+    char ssid[33];
+    char pass[65];
+    uint8_t bssid[6];
+    uint8_t channel;    // 0 - nothing cached
+} wifi_network_t;
+
 void creds_init(void);
+
+/**
+ * @brief Remember the network as the most recent one, 
+ * the oldest one is dropped when the list is full
+*/
 void save_wifi_creds(const char* ssid, const char* pass);
-void load_wifi_creds(char *ssid, char* pass);
+
+/**
+ * @brief Load known networks, the most recently used first
+ * @return number of networks
+*/
+int load_wifi_networks(wifi_network_t *networks, int max);
+
+/**
+ * @brief Cache the access point of a successful connection
+ * and make the network the most recent one
+*/
+void creds_network_connected(const char *ssid, const uint8_t *bssid, uint8_t channel);
@@ -3,11 +3,28 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 
+#include "main.h"
+
 #define SSD1306_DEV_ADDR 0x3c
 
+#define DISPLAY_LINES       4
+#define DISPLAY_LINE_SIZE   64
+
 typedef struct {
     SemaphoreHandle_t i2c_smphr;
     QueueHandle_t queue;
 } display_task_config_t;
 
 void display_task(void* arg);
+
+/**
+ * @brief Text of the measurement screen, one string per line
+*/
+void display_format(const sensors_data_t *data, char lines[DISPLAY_LINES][DISPLAY_LINE_SIZE]);
+
+struct u8g2_struct;
+
+/**
+ * @brief Render the lines into the u8g2 buffer, sending it is left to the caller
+*/
+void display_draw(struct u8g2_struct *u8g2, const char lines[DISPLAY_LINES][DISPLAY_LINE_SIZE]);
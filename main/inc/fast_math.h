@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * logf/expf/powf replacements for the derived readings. The exponent comes
+ * from the float bits, the mantissa goes through a short series:
+ *  - fast_logf: x normal and > 0, absolute error < 1e-7 + 2 ulp of the result
+ *  - fast_expf: x in [-87, 88], relative error < 3e-7
+ *  - fast_powf: exp(y * ln(x)), relative error < 3e-7 + |y ln x| * 1e-7
+ * The series bounds are analytic (see each function), rounding adds a few ulp;
+ * aqa_host sweeps the derived readings against libm.
+*/
+
+#define FAST_LN2    0.69314718f
+
+static inline uint32_t fast_float_bits(float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static inline float fast_bits_float(uint32_t bits)
+{
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/**
+ * x = 2^e * m with m in [sqrt(1/2), sqrt(2)), ln(m) = 2 atanh(t),
+ * t = (m - 1) / (m + 1), |t| < 0.172: four terms leave < 2 t^9 / 9 = 3.5e-8
+*/
+static inline float fast_logf(float x)
+{
+    const uint32_t bits = fast_float_bits(x);
+    int32_t e = (int32_t)((bits >> 23) & 0xff) - 127;
+    float m = fast_bits_float((bits & 0x007fffff) | 0x3f800000);
+
+    if(m > 1.41421356f) {
+        m *= 0.5f;
+        e++;
+    }
+
+    const float t = (m - 1.0f) / (m + 1.0f);
+    const float t2 = t * t;
+    const float series = t * (2.0f + t2 * (2.0f / 3.0f + t2 * (2.0f / 5.0f + t2 * (2.0f / 7.0f))));
+    return (float)e * FAST_LN2 + series;
+}
+
+/**
+ * x = k ln2 + r with |r| <= ln2 / 2, exp(r) by Taylor to r^6:
+ * the rest is < r^7 / 7! * e^r = 1.6e-7 relative
+*/
+static inline float fast_expf(float x)
+{
+    if(x < -87.0f)
+        return 0.0f;
+    if(x > 88.0f)
+        x = 88.0f;
+
+    const float kf = x * (1.0f / FAST_LN2);
+    const int32_t k = (int32_t)(kf < 0 ? kf - 0.5f : kf + 0.5f);
+    // ln2 in two parts keeps r exact for the k of this range
+    const float r = (x - (float)k * 0.693145752f) - (float)k * 1.42860677e-6f;
+
+    const float p = 1.0f + r * (1.0f + r * (1.0f / 2 + r * (1.0f / 6 + r * (1.0f / 24
+        + r * (1.0f / 120 + r * (1.0f / 720))))));
+    return p * fast_bits_float((uint32_t)(k + 127) << 23);
+}
+
+/**
+ * @brief x^y for x > 0
+*/
+static inline float fast_powf(float x, float y)
+{
+    return fast_expf(y * fast_logf(x));
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Single-pass parser for HTML form bodies. The body is fed in arbitrary
+ * chunks, values are decoded straight into the caller's buffers, nothing
+ * is allocated and nothing of the body is kept besides a header line
+ * of a multipart part.
+*/
+
+#define FORM_MAX_NAME       32
+#define FORM_MAX_HDR_LINE   128
+#define FORM_MAX_BOUNDARY   70
+
+typedef enum {
+    FORM_URLENCODED,
+    FORM_MULTIPART
+} form_type_t;
+
+typedef enum {
+    FORM_OK = 0,
+    FORM_ERR_FIELD_TOO_LONG,
+    FORM_ERR_SYNTAX
+} form_status_t;
+
+typedef struct {
+    const char *name;
+    char *value;        // receives the decoded, '\0' terminated value
+    size_t size;        // size of `value` including the terminator
+    size_t len;
+    bool found;
+} form_field_t;
+
+typedef struct {
+    form_type_t type;
+    form_field_t *fields;
+    size_t field_count;
+    form_field_t *current;
+    form_status_t status;
+    int state;
+
+    // urlencoded
+    char name[FORM_MAX_NAME];
+    size_t name_len;
+    bool name_overflow;
+    uint8_t pct_value;
+
+    // multipart
+    char delimiter[FORM_MAX_BOUNDARY + 4];
+    size_t delimiter_len;
+    size_t matched;
+    char line[FORM_MAX_HDR_LINE];
+    size_t line_len;
+} form_parser_t;
+
+/**
+ * @param content_type value of the Content-Type header, the boundary of
+ * a multipart body is taken from it; NULL means urlencoded
+*/
+form_status_t form_parser_init(form_parser_t *p, const char *content_type,
+    form_field_t *fields, size_t field_count);
+
+form_status_t form_parser_feed(form_parser_t *p, const char *data, size_t len);
+
+form_status_t form_parser_finish(form_parser_t *p);
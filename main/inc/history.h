@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "main.h"
+
+/**
+ * One record is kept per period, the ring holds 24 hours of data
+*/
+#define HISTORY_PERIOD_S    60
+#define HISTORY_CAPACITY    1440
+
+/**
+ * Fixed-point record, also the wire format of the binary export
+ * (little endian, packed).
+*/
+typedef struct __attribute__((packed)) {
+    uint32_t seq;           // record number since boot
+    uint32_t time_s;        // seconds since boot
+    int16_t  temperature;   // 0.01 °C
+    uint16_t humidity;      // 0.01 %
+    uint16_t pressure;      // 0.1 mmHg
+    uint16_t tvoc;          // ppb
+    uint16_t eco2;          // ppm
+    uint8_t  aqi;
+    uint8_t  reserved;
+} history_record_t;
+
+typedef struct {
+    uint32_t next;
+    uint32_t end;
+} history_iter_t;
+
+/**
+ * @brief Convert a sample to the fixed-point record, `seq` is left zero
+*/
+void history_pack(history_record_t *record, const sensors_data_t *data, int64_t time_us);
+
+/**
+ * @brief Feed a sample, a record is stored once per HISTORY_PERIOD_S
+*/
+void history_add(const sensors_data_t *data);
+
+/**
+ * @brief Start iterating from the record with sequence number `from_seq`
+ * (or the oldest available one). Records added after this call are not
+ * visited, so the iteration always terminates.
+*/
+void history_iter_init(history_iter_t *it, uint32_t from_seq);
+
+bool history_iter_next(history_iter_t *it, history_record_t *record);
+
+/**
+ * @brief Derived readings of a record, see comfort.h
+*/
+void history_comfort(const history_record_t *record, comfort_data_t *comfort);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * @brief Accumulates output in a small fixed buffer and sends it with
+ * httpd_resp_send_chunk() every time the buffer fills up.
+*/
+typedef struct {
+    httpd_req_t *req;
+    char *buf;
+    size_t size;
+    size_t len;
+    size_t total;
+    esp_err_t err;
+} http_chunk_writer_t;
+
+void http_chunk_init(http_chunk_writer_t *w, httpd_req_t *req, char *buf, size_t size);
+
+void http_chunk_write(http_chunk_writer_t *w, const void *data, size_t len);
+
+void http_chunk_printf(http_chunk_writer_t *w, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Send the rest of the buffer and the terminating chunk
+ * @return first error occured while sending
+*/
+esp_err_t http_chunk_finish(http_chunk_writer_t *w);
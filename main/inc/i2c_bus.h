@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "driver/i2c.h"
+
+/**
+ * Thin wrappers over the legacy i2c master driver.
+ * Every transaction on I2C_MASTER_NUM goes through here, so it can be
+ * timed, accounted and recorded in one place (i2c_rec.h). Callers still
+ * own the bus mutex.
+*/
+
+esp_err_t i2c_bus_write(uint8_t dev_addr, const uint8_t *data, size_t len);
+
+esp_err_t i2c_bus_read(uint8_t dev_addr, uint8_t *data, size_t len);
+
+/**
+ * @brief Write then read with a repeated start (register read)
+*/
+esp_err_t i2c_bus_write_read(uint8_t dev_addr, 
+    const uint8_t *wdata, size_t wlen, uint8_t *rdata, size_t rlen);
+
+/**
+ * @brief Execute a prepared command link addressed to `dev_addr`
+*/
+esp_err_t i2c_bus_cmd_begin(uint8_t dev_addr, i2c_cmd_handle_t cmd);
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_err.h"
+
+/**
+ * I2C transaction recorder and replay.
+ *
+ * i2c_bus records every transaction: device, bytes written and read,
+ * result and duration. The first I2C_REC_HEAD transactions are kept for
+ * good, they hold the initialization of the sensors; the later ones go
+ * to a ring of the last I2C_REC_ENTRIES.
+ *
+ * A recording is text, one transaction per line:
+ *   seq time_us addr op err duration_us wlen rlen write read
+ * op is w, r, wr or cmd; write and read are hex, '-' if empty, and hold
+ * at most I2C_REC_DATA_SIZE bytes together, wlen and rlen are the
+ * lengths on the bus. Lines starting with '#' are comments.
+ *
+ * A loaded replay serves the transactions to the devices found in the
+ * recording from it, in order, without touching the bus; the rest go to
+ * the bus. Display command links are never replayed. The replay ends when
+ * a driver asks for more than the recording holds, the bus takes over.
+*/
+#define I2C_REC_ENABLE          1
+
+#define I2C_REC_HEAD            32
+#define I2C_REC_ENTRIES         128
+#define I2C_REC_DATA_SIZE       32
+
+// display frames would push the sensors out of the ring
+#define I2C_REC_DISPLAY         0
+
+// longest line of i2c_rec_format()
+#define I2C_REC_LINE_SIZE       (64 + 2 * I2C_REC_DATA_SIZE + 2)
+
+typedef enum {
+    I2C_REC_WRITE,
+    I2C_REC_READ,
+    I2C_REC_WRITE_READ,
+    I2C_REC_CMD,
+} i2c_rec_op_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t time_us;           // esp_timer, truncated to 32 bits
+    esp_err_t err;
+    uint16_t duration_us;
+    uint16_t wlen;
+    uint16_t rlen;
+    uint8_t addr;
+    uint8_t op;                 // i2c_rec_op_t
+    uint8_t data[I2C_REC_DATA_SIZE];    // written bytes, then read ones
+} i2c_rec_entry_t;
+
+typedef struct {
+    bool active;
+    uint32_t entries;
+    uint32_t served;            // transactions taken from the recording
+    uint32_t skipped;           // recorded transactions the drivers did not repeat
+    uint32_t diverged;          // written bytes or lengths differ from the recording
+} i2c_replay_stats_t;
+
+/**
+ * @brief Account a transaction, called by i2c_bus
+*/
+void i2c_rec_record(uint8_t addr, i2c_rec_op_t op, const uint8_t *wdata, size_t wlen,
+    const uint8_t *rdata, size_t rlen, esp_err_t err, uint32_t start_us, uint32_t duration_us);
+
+/**
+ * @return number of transactions recorded since boot
+*/
+uint32_t i2c_rec_count(void);
+
+/**
+ * @brief Copy the oldest transaction kept from `*seq` on and move
+ * `*seq` past it. Start with 0 to walk the whole recording.
+ * @return false at the end
+*/
+bool i2c_rec_next(uint32_t *seq, i2c_rec_entry_t *entry);
+
+/**
+ * @brief Forget the recorded transactions
+*/
+void i2c_rec_clear(void);
+
+/**
+ * @brief One line of a recording with the newline
+ * @return length, as snprintf()
+*/
+int i2c_rec_format(const i2c_rec_entry_t *entry, char *line, size_t size);
+
+/**
+ * @brief Parse one line of a recording
+ * @return ESP_ERR_NOT_FOUND for a comment or an empty line,
+ * ESP_ERR_INVALID_ARG if malformed
+*/
+esp_err_t i2c_rec_parse(const char *line, i2c_rec_entry_t *entry);
+
+/**
+ * @brief Write the recording, oldest transaction first
+*/
+void i2c_rec_dump(FILE *out);
+
+/**
+ * @brief Replace the replay with the recording in `text`, it starts at once
+ * @return ESP_ERR_INVALID_ARG with a malformed line, ESP_ERR_NOT_FOUND
+ * if there are no transactions
+*/
+esp_err_t i2c_replay_load(const char *text, size_t len);
+
+void i2c_replay_stop(void);
+
+bool i2c_replay_active(void);
+
+void i2c_replay_get_stats(i2c_replay_stats_t *stats);
+
+/**
+ * @brief Serve a transaction from the replay, called by i2c_bus
+ * @return false if it has to go to the bus
+*/
+bool i2c_replay_serve(uint8_t addr, i2c_rec_op_t op, const uint8_t *wdata, size_t wlen,
+    uint8_t *rdata, size_t rlen, esp_err_t *err);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Minimal JSON serializer writing into a caller provided buffer.
+ * No heap allocations, no snprintf. If the buffer is too small the output
+ * is truncated and `overflow` is set, check json_writer_finish() result.
+*/
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool need_comma;
+    bool overflow;
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size);
+
+/**
+ * @brief Terminate the output with '\0'
+ * @return length of the document, -1 on overflow
+*/
+int json_writer_finish(json_writer_t *w);
+
+/**
+ * @param key member name, NULL for the root object or array elements
+*/
+void json_object_begin(json_writer_t *w, const char *key);
+void json_object_end(json_writer_t *w);
+
+void json_array_begin(json_writer_t *w, const char *key);
+void json_array_end(json_writer_t *w);
+
+void json_add_int(json_writer_t *w, const char *key, int64_t value);
+void json_add_uint(json_writer_t *w, const char *key, uint64_t value);
+void json_add_bool(json_writer_t *w, const char *key, bool value);
+void json_add_string(json_writer_t *w, const char *key, const char *value);
+
+/**
+ * @brief Add a number rounded to the given count of decimal places (0..6),
+ * null for NaN, infinities and magnitudes from 2^64 up
+*/
+void json_add_float(json_writer_t *w, const char *key, float value, uint8_t decimals);
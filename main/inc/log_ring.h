@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+/**
+ * Asynchronous log output. log_ring_init() hooks esp_log_set_vprintf():
+ * ESP_LOGx formats the line into a slot of a RAM ring and returns, the
+ * "logd" task prints the ring to the console every LOG_RING_DRAIN_MS.
+ * Writers never wait: a line that finds the ring full of lines not yet
+ * printed is dropped and counted.
+ *
+ * The ring keeps the last LOG_RING_LINES lines after they were printed,
+ * /api/v1/logs reads them without a serial cable.
+ * Lines still in the ring are lost on a panic; with LOG_RING_ENABLE 0
+ * the console is written synchronously as before.
+*/
+#define LOG_RING_ENABLE         1
+
+#define LOG_RING_LINES          64      // power of 2
+#define LOG_RING_LINE_SIZE      128     // longer lines are truncated
+#define LOG_RING_DRAIN_MS       20
+
+// tags with a level set at runtime that log_ring_get_level() lists
+#define LOG_RING_TAGS           16
+#define LOG_RING_TAG_SIZE       16
+
+_Static_assert((LOG_RING_LINES & (LOG_RING_LINES - 1)) == 0, "LOG_RING_LINES must be a power of 2");
+
+typedef struct {
+    uint32_t lines;             // lines written to the ring since boot
+    uint32_t dropped;           // lines lost because the console lagged behind
+    uint32_t truncated;         // lines cut to LOG_RING_LINE_SIZE
+} log_ring_stats_t;
+
+/**
+ * @brief Start the console task and route the log output to the ring,
+ * call it first in app_main()
+*/
+esp_err_t log_ring_init(void);
+
+void log_ring_get_stats(log_ring_stats_t *stats);
+
+/**
+ * @brief Wait up to `timeout_ms` until the console has printed every line,
+ * e.g. before the deep sleep
+*/
+void log_ring_flush(uint32_t timeout_ms);
+
+/**
+ * @brief Copy the line number `*seq` or, if it was overwritten, the oldest
+ * one after it, and move `*seq` past it. Start with 0 for the oldest line kept.
+ * @return length of the line, 0 if there is none yet
+*/
+uint32_t log_ring_next(uint32_t *seq, char *line, uint32_t size);
+
+/**
+ * @brief Set the level of `tag` ("*" for all tags) with esp_log_level_set()
+ * and remember it for log_ring_get_level()
+ * @return ESP_ERR_NO_MEM if LOG_RING_TAGS tags have a level already
+*/
+esp_err_t log_ring_set_level(const char *tag, esp_log_level_t level);
+
+/**
+ * @brief The `index`th tag with a level set at runtime
+ * @return false past the last one
+*/
+bool log_ring_get_level(uint32_t index, char *tag, uint32_t size, esp_log_level_t *level);
+
+/**
+ * @return "none", "error", "warn", "info", "debug" or "verbose"
+*/
+const char *log_ring_level_name(esp_log_level_t level);
+
+/**
+ * @return ESP_ERR_INVALID_ARG if `name` is none of log_ring_level_name()
+*/
+esp_err_t log_ring_parse_level(const char *name, esp_log_level_t *level);
@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "trace.h"
+
 #define I2C_MASTER_NUM              I2C_NUM_0  
 #define I2C_MASTER_TIMEOUT          (1000 / portTICK_PERIOD_MS)
 
@@ -10,6 +12,14 @@
 
 #define LOG_SENSORS_ENABLE 0
 
+/**
+ * Defaults of the alarm settings, see app_config.h:
+ * the buzzer sounds when both AQI and eCO2 are above the thresholds
+*/
+#define ALARM_AQI                   3
+#define ALARM_ECO2_PPM              1000
+#define ALARM_DURATION_MS           500
+
 #define MIN(a,b) (a < b ? a : b)
 
 typedef struct {
@@ -52,10 +62,24 @@ typedef struct {
     uint16_t eco2;
 } ens160_data_t;
 
+/**
+ * Derived from the readings by comfort_compute()
+*/
+typedef struct {
+    float dew_point;            // °C
+    float absolute_humidity;    // g/m³
+    float heat_index;           // °C
+    float altitude;             // m, ISA pressure altitude
+} comfort_data_t;
+
 typedef struct {
     aht21_data_t aht21;
     bmp280_data_t bmp280;
     ens160_data_t ens160;
+    comfort_data_t comfort;
+#if TRACE_ENABLE == 1
+    trace_t trace;
+#endif
 } sensors_data_t;
 
 
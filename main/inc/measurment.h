@@ -13,6 +13,9 @@
 #define ENS160_DEV_ADDR 0x53
 #define BMP280_DEV_ADDR 0x76
 
+/**
+ * Defaults of the runtime settings, see app_config.h
+*/
 #define INTERVAL_MEASURMENT_MS 1000
 
 #define AHT21_TEMPERATURE_OFFSET -4.0f
@@ -27,3 +30,61 @@ typedef struct {
 } measurment_task_config_t;
 
 void measurment_task(void *arg);
+
+/**
+ * Sensor drivers, the caller holds the I2C mutex
+*/
+
+esp_err_t aht21_init(void);
+esp_err_t aht21_reset(void);
+esp_err_t aht21_read_data(aht21_data_t *result);
+
+esp_err_t ens160_init(void);
+esp_err_t ens160_compensate(aht21_data_t *data);
+ens160_data_t ens160_read(void);
+esp_err_t ens160_reset(void);
+/**
+ * @brief Deep sleep, ens160_init() starts the gas sensing again
+*/
+esp_err_t ens160_sleep(void);
+
+esp_err_t bmp280_init(void);
+esp_err_t bmp280_read(bmp280_data_t *result);
+/**
+ * @brief Stop the conversions, bmp280_init() starts them again
+*/
+esp_err_t bmp280_sleep(void);
+
+/**
+ * Conversions of the drivers, no bus access
+*/
+
+/**
+ * @brief CRC-8 of the first 6 bytes of a measurement frame
+*/
+uint8_t aht21_crc(const uint8_t *data);
+
+/**
+ * @brief Convert a 7 byte measurement frame, calibration included
+*/
+void aht21_parse(const uint8_t *data, aht21_data_t *result);
+
+/**
+ * @brief Load the 24 byte calibration NVM image read from 0x88
+*/
+void bmp280_parse_calibration(const uint8_t *data);
+
+/**
+ * @return °C, also updates the t_fine used by bmp280_compensate_pressure()
+*/
+float bmp280_compensate_temperature(int32_t adc_T);
+
+/**
+ * @return Pa
+*/
+float bmp280_compensate_pressure(int32_t adc_P);
+
+/**
+ * @brief TEMP_IN / RH_IN write: register address and 4 data bytes
+*/
+void ens160_encode_compensation(const aht21_data_t *data, uint8_t *wdata);
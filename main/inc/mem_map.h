@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+/**
+ * Memory map of the firmware: every task, queue, semaphore and event group
+ * is declared with the MEM_* macros below and created through mem_*_create().
+ *
+ * With MEM_STATIC_ENABLE 1 their stacks, control blocks and queue storage
+ * are static arrays and the objects are created with the *Static FreeRTOS
+ * APIs, so the heap only serves ESP-IDF itself (Wi-Fi, lwIP, httpd) and
+ * a few operator actions (a compressed OTA image, an I2C replay).
+ * With 0 (the default) they come from the heap as before.
+ *
+ * The static storage of every task is reserved in .bss for good, also
+ * of the tasks that never run: MQTT and UDP without a broker or collector,
+ * OTA until an update. That is ~39 KB the heap (Wi-Fi, lwIP, httpd, the
+ * gzip inflater of an OTA image) no longer has, so enable it only when
+ * the heap has the room, e.g. for a fragmentation-free long run.
+ *
+ * mem_report() prints the footprint at boot: every object, the static
+ * total against MEM_STATIC_BUDGET and the heap.
+*/
+#ifndef MEM_STATIC_ENABLE
+#define MEM_STATIC_ENABLE   0
+#endif
+
+/**
+ * Task stacks, bytes
+*/
+#define MEM_STACK_MEAS      2048
+#define MEM_STACK_DISP      4096
+#define MEM_STACK_BUZZ      1024
+#define MEM_STACK_ULOG      4096
+#define MEM_STACK_WIFI      4096
+#define MEM_STACK_MQTT      4096
+#define MEM_STACK_UDPX      4096
+#define MEM_STACK_OTAR      3072
+#define MEM_STACK_OTAW      3072
+#define MEM_STACK_OTAP      6144
+#define MEM_STACK_REBOOT    1024
+#define MEM_STACK_LOGD      2560
+
+/**
+ * Stacks, control blocks and queue storage of the objects above
+*/
+#define MEM_STATIC_BUDGET   (48 * 1024)
+
+// objects mem_report() can list
+#define MEM_OBJECTS_MAX     32
+
+/**
+ * A task that deleted itself keeps its TCB on a kernel list until the idle
+ * task frees it. The thread local storage slot below gets a deletion
+ * callback, so mem_task_create() reuses the storage only once it is free.
+*/
+#define MEM_TLS_INDEX           (configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1)
+#define MEM_TASK_FREE_WAIT_MS   1000
+#define MEM_TASK_FREE_POLL_MS   10
+
+typedef struct {
+    const char *name;
+    uint32_t stack_size;
+    StackType_t *stack;         // NULL with MEM_STATIC_ENABLE 0
+    StaticTask_t *tcb;
+    TaskFunction_t fn;          // of the task on the storage
+    void *arg;
+    bool busy;                  // until the kernel has freed the TCB
+    bool accounted;
+} mem_task_t;
+
+typedef struct {
+    const char *name;
+    uint32_t length;
+    uint32_t item_size;
+    uint8_t *storage;           // NULL with MEM_STATIC_ENABLE 0
+    StaticQueue_t *control;
+    bool accounted;
+} mem_queue_t;
+
+typedef struct {
+    const char *name;
+    StaticSemaphore_t *control; // NULL with MEM_STATIC_ENABLE 0
+    bool accounted;
+} mem_semaphore_t;
+
+typedef struct {
+    const char *name;
+    StaticEventGroup_t *control; // NULL with MEM_STATIC_ENABLE 0
+    bool accounted;
+} mem_event_group_t;
+
+#if MEM_STATIC_ENABLE == 1
+
+#define MEM_TASK(var, task_name, size) \
+    static StackType_t var##_stack[size]; \
+    static StaticTask_t var##_tcb; \
+    static mem_task_t var = { .name = task_name, .stack_size = size, \
+        .stack = var##_stack, .tcb = &var##_tcb }
+
+#define MEM_QUEUE(var, queue_name, queue_length, size) \
+    static uint8_t var##_storage[(queue_length) * (size) ? (queue_length) * (size) : 1]; \
+    static StaticQueue_t var##_control; \
+    static mem_queue_t var = { .name = queue_name, .length = queue_length, .item_size = size, \
+        .storage = var##_storage, .control = &var##_control }
+
+#define MEM_SEMAPHORE(var, semaphore_name) \
+    static StaticSemaphore_t var##_control; \
+    static mem_semaphore_t var = { .name = semaphore_name, .control = &var##_control }
+
+#define MEM_EVENT_GROUP(var, group_name) \
+    static StaticEventGroup_t var##_control; \
+    static mem_event_group_t var = { .name = group_name, .control = &var##_control }
+
+#else
+
+#define MEM_TASK(var, task_name, size) \
+    static mem_task_t var = { .name = task_name, .stack_size = size }
+
+#define MEM_QUEUE(var, queue_name, queue_length, size) \
+    static mem_queue_t var = { .name = queue_name, .length = queue_length, .item_size = size }
+
+#define MEM_SEMAPHORE(var, semaphore_name) \
+    static mem_semaphore_t var = { .name = semaphore_name }
+
+#define MEM_EVENT_GROUP(var, group_name) \
+    static mem_event_group_t var = { .name = group_name }
+
+#endif
+
+/**
+ * @brief xTaskCreatePinnedToCore() on the storage of `task`
+ * @return pdFAIL if the task created last on it has not been freed
+ * within MEM_TASK_FREE_WAIT_MS
+*/
+BaseType_t mem_task_create(mem_task_t *task, TaskFunction_t fn, void *arg,
+    UBaseType_t priority, TaskHandle_t *created, BaseType_t core_id);
+
+QueueHandle_t mem_queue_create(mem_queue_t *queue);
+
+SemaphoreHandle_t mem_mutex_create(mem_semaphore_t *semaphore);
+
+SemaphoreHandle_t mem_binary_create(mem_semaphore_t *semaphore);
+
+EventGroupHandle_t mem_event_group_create(mem_event_group_t *group);
+
+/**
+ * @return bytes of the objects created so far, static or from the heap
+*/
+size_t mem_static_bytes(void);
+
+size_t mem_heap_bytes(void);
+
+/**
+ * @brief Log the objects created so far, the static total against
+ * the budget and the state of the heap
+*/
+void mem_report(void);
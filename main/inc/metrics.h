@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * Counters are updated from the hot paths without locks,
+ * readers may observe values of different moments.
+*/
+#define METRICS_INC(counter)        __atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED)
+#define METRICS_ADD(counter, value) __atomic_fetch_add(&(counter), (value), __ATOMIC_RELAXED)
+#define METRICS_SET(gauge, value)   __atomic_store_n(&(gauge), (value), __ATOMIC_RELAXED)
+#define METRICS_GET(value)          __atomic_load_n(&(value), __ATOMIC_RELAXED)
+
+#define METRICS_MAX_TASKS 8
+
+/**
+ * Upper bounds of the I2C latency histogram buckets, microseconds.
+ * The last bucket (+Inf) is implicit.
+*/
+#define METRICS_I2C_BUCKETS_US { 100, 250, 500, 1000, 2500, 5000, 10000, 25000 }
+#define METRICS_I2C_BUCKETS    8
+
+typedef enum {
+    METRICS_I2C_AHT21,
+    METRICS_I2C_BMP280,
+    METRICS_I2C_ENS160,
+    METRICS_I2C_SSD1306,
+    METRICS_I2C_OTHER,
+    METRICS_I2C_COUNT
+} metrics_i2c_device_t;
+
+typedef enum {
+    METRICS_QUEUE_SENSORS,
+    METRICS_QUEUE_DISPLAY,
+    METRICS_QUEUE_LOGGING,
+    METRICS_QUEUE_BUZZER,
+    METRICS_QUEUE_COUNT
+} metrics_queue_t;
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t latency_sum_us;
+    uint32_t buckets[METRICS_I2C_BUCKETS + 1];
+} metrics_i2c_t;
+
+/**
+ * Deviation of the measurement period from the nominal one.
+ * The window part is restarted by metrics_jitter_window_reset()
+ * to capture an interval of interest, e.g. a firmware update.
+*/
+typedef struct {
+    uint32_t samples;
+    uint32_t jitter_sum_us;
+    uint32_t jitter_max_us;
+    uint32_t window_samples;
+    uint32_t window_jitter_sum_us;
+    uint32_t window_jitter_max_us;
+} metrics_jitter_t;
+
+typedef struct {
+    metrics_i2c_t i2c[METRICS_I2C_COUNT];
+    metrics_jitter_t sample_jitter;
+    uint32_t queue_overruns[METRICS_QUEUE_COUNT];
+    uint32_t wifi_reconnects;
+    uint32_t wifi_connected;
+    uint32_t wifi_downtime_ms;
+    uint32_t wifi_ap_fallbacks;
+    uint32_t first_sample_us;   // time from boot to the first sample
+    uint32_t first_ip_us;       // time from boot to the first IP address
+    uint32_t ota_state;
+    uint32_t ota_bytes;
+} metrics_t;
+
+extern metrics_t g_metrics;
+
+/**
+ * @brief Account an I2C transaction, called by the bus wrapper
+*/
+void metrics_i2c_record(metrics_i2c_device_t dev, bool ok, uint32_t latency_us);
+
+/**
+ * @brief Account the period between two measurements, called by the measurement task
+*/
+void metrics_sample_period(int64_t period_us, int64_t nominal_us);
+
+void metrics_jitter_window_reset(void);
+
+/**
+ * @brief Add a task to the stack high-water mark report
+*/
+void metrics_register_task(TaskHandle_t task);
+
+uint32_t metrics_get_tasks(TaskHandle_t *tasks, uint32_t max);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "main.h"
+#include "history.h"
+
+/**
+ * Broker to publish samples to, empty - MQTT is disabled and its buffers
+ * take no RAM. E.g. "mqtt://192.168.1.10:1883", the host build sets it
+ * for its stand-in broker.
+*/
+#ifndef MQTT_BROKER_URI
+#define MQTT_BROKER_URI         ""
+#endif
+
+/**
+ * Samples go to <prefix>/<device id>/samples, the connection state
+ * to <prefix>/<device id>/status (retained, "offline" as last will).
+*/
+#define MQTT_TOPIC_PREFIX       "aqa"
+#define MQTT_QOS                1
+
+/**
+ * 0 - JSON array of samples, 1 - packed history_record_t array (history.h)
+*/
+#define MQTT_PAYLOAD_BINARY     0
+
+/**
+ * Samples are queued in RAM and published in batches of up to
+ * MQTT_BATCH_MAX, so a backlog after an outage is sent in few messages.
+ * When the queue is full the oldest samples are dropped.
+*/
+#define MQTT_QUEUE_CAPACITY     600
+#define MQTT_BATCH_MAX          16
+#define MQTT_ACK_TIMEOUT_MS     10000
+
+typedef struct {
+    uint32_t queued;
+    uint32_t published;     // samples acknowledged by the broker
+    uint32_t messages;
+    uint32_t dropped;
+    uint32_t connected;
+} mqtt_pub_stats_t;
+
+/**
+ * @brief Start the client, call once the network is up.
+ * Does nothing when MQTT_BROKER_URI is empty.
+*/
+void mqtt_pub_start(void);
+
+/**
+ * @brief Queue a sample for publishing, never blocks.
+ * Does nothing until mqtt_pub_start() has created the client.
+*/
+void mqtt_pub_add(const sensors_data_t *data);
+
+/**
+ * @brief Queue a stored sample (battery mode). Its `seq` is kept when the
+ * queue is empty, the following records must continue it.
+*/
+void mqtt_pub_add_record(const history_record_t *record);
+
+/**
+ * @brief Wait until the broker has every queued sample
+ * @return false on timeout or if MQTT is disabled
+*/
+bool mqtt_pub_wait_sent(uint32_t timeout_ms);
+
+void mqtt_pub_get_stats(mqtt_pub_stats_t *stats);
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_partition.h"
+
+/**
+ * Image data is received into one buffer while the other one is being
+ * flashed by the writer task. The speed-up over receiving and writing
+ * in turn was not measured on a device.
+*/
+#define OTA_BUF_SIZE                4096
+#define OTA_BUF_COUNT               2
+
+/**
+ * Sectors ahead of the write position the writer erases while
+ * it waits for the next buffer.
+*/
+#define OTA_ERASE_AHEAD_SECTORS     4
+
+#define OTA_PROGRESS_STEP_PERCENT   10
+
+/**
+ * Flash budget of the writer task, erased plus written bytes per second.
+ * Every erase stalls the flash cache of both cores, spreading them out
+ * keeps the measurement period and the web server responsive.
+ * 160 is a starting point, it was not measured on a device: the sample
+ * period jitter of an update is logged at its end (ota_log_jitter()),
+ * set the rate from runs at a few values.
+*/
+#ifndef OTA_FLASH_RATE_LIMIT_KBPS
+#define OTA_FLASH_RATE_LIMIT_KBPS   160
+#endif
+
+/**
+ * Pull mode: the image is downloaded in Range requests of this size,
+ * the written offset is saved to NVS after every request.
+ * Must be a multiple of the flash sector size.
+*/
+#define OTA_PULL_RANGE_SIZE         (64 * 1024)
+#define OTA_PULL_BUF_SIZE           2048
+#define OTA_PULL_MAX_RETRIES        5
+#define OTA_PULL_RETRY_DELAY_MS     5000
+#define OTA_PULL_URL_MAX            128
+
+typedef enum {
+    OTA_STATE_IDLE,
+    OTA_STATE_RECEIVING,
+    OTA_STATE_VALIDATING,
+    OTA_STATE_DONE,
+    OTA_STATE_FAILED
+} ota_state_t;
+
+typedef struct {
+    ota_state_t state;
+    uint32_t bytes;         // image bytes received
+    uint32_t total;         // image size, 0 until known
+    uint32_t bytes_per_s;   // average rate of this session
+    uint32_t elapsed_s;
+    int32_t eta_s;          // -1 if unknown
+} ota_progress_t;
+
+/**
+ * @brief Only one update may run at a time, push or pull
+ * @return false if another update is in progress
+*/
+bool ota_acquire(void);
+void ota_release(void);
+
+/**
+ * @brief Report the progress of the running update, 
+ * the first call after ota_acquire() sets the starting point of the rate
+*/
+void ota_progress_set(uint32_t bytes, uint32_t total);
+
+void ota_get_progress(ota_progress_t *progress);
+
+/**
+ * @brief Log the sample period jitter since ota_acquire()
+*/
+void ota_log_jitter(void);
+
+typedef struct {
+    int64_t start_us;
+    size_t bytes;
+} ota_throttle_t;
+
+/**
+ * @brief Keep flash work under OTA_FLASH_RATE_LIMIT_KBPS,
+ * sleeps while `flash_bytes` erased or written are ahead of the budget
+*/
+void ota_throttle_init(ota_throttle_t *t);
+void ota_throttle(ota_throttle_t *t, size_t flash_bytes);
+
+/**
+ * @brief Start the writer task for an image of `image_size` bytes
+*/
+esp_err_t ota_writer_begin(const esp_partition_t *partition, size_t image_size);
+
+/**
+ * @brief Get an empty buffer of OTA_BUF_SIZE bytes, blocks while
+ * both buffers are in use
+ * @return NULL if the writer has failed
+*/
+char *ota_writer_get_buffer(void);
+
+/**
+ * @brief Pass a filled buffer to the writer
+*/
+esp_err_t ota_writer_submit(char *buf, size_t len);
+
+/**
+ * @brief Wait until everything is flashed and validate the image
+*/
+esp_err_t ota_writer_end(void);
+
+void ota_writer_abort(void);
+
+/**
+ * @brief Download and install the image from `url` in background.
+ * The download survives reboots and is continued by ota_pull_resume().
+ * @param sha256_hex expected SHA-256 of the image, 64 hex digits
+*/
+esp_err_t ota_pull_start(const char *url, const char *sha256_hex);
+
+/**
+ * @brief Continue an interrupted download, if there is one and no update
+ * is running. Called on every IP_EVENT_STA_GOT_IP.
+*/
+void ota_pull_resume(void);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "main.h"
+
+/**
+ * @brief Store the latest sample produced by the measurment pipeline
+*/
+void readings_publish(const sensors_data_t *data);
+
+/**
+ * @brief Copy the latest sample
+ * @param data where to copy the sample, may be NULL
+ * @param timestamp_us time of publication (esp_timer clock), may be NULL
+ * @return sequence number of the sample, 0 if nothing was published yet
+*/
+uint32_t readings_get_latest(sensors_data_t *data, int64_t *timestamp_us);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_http_server.h"
+
+/**
+ * Server-Sent Events clients are kept open, so they occupy sockets of
+ * the http server permanently. Keep a few sockets for regular requests.
+*/
+#define STREAM_MAX_CLIENTS   4
+
+/**
+ * A client whose socket buffer stays full for this count of samples
+ * in a row is disconnected.
+*/
+#define STREAM_MAX_STRIKES   3
+
+typedef struct {
+    uint32_t clients;
+    uint32_t evicted;
+    uint32_t broadcasts;
+    uint32_t last_cost_us;
+    uint32_t max_cost_us;
+} stream_stats_t;
+
+/**
+ * @brief Schedule sending of the latest sample to all subscribed clients.
+ * The sending itself happens asynchronously in the http server task.
+*/
+void stream_notify(void);
+
+/**
+ * @brief Must be called from the http server close callback
+*/
+void stream_forget(int sockfd);
+
+void stream_get_stats(stream_stats_t *stats);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * End-to-end latency of the samples. A sample carries the time of each
+ * point it passes, from the AHT21 trigger to the display and the buzzer;
+ * every point is accounted in two log2 histograms: against the trigger,
+ * and against the point before it (trace_previous()) for the time spent
+ * in that stage alone.
+ * Histograms are updated with relaxed atomics, readers may see a sample
+ * counted in one stage and not yet in the next.
+ * With TRACE_ENABLE 0 the stamps are compiled out and the samples
+ * do not carry the timestamps.
+*/
+#define TRACE_ENABLE    1
+
+/**
+ * Bucket i counts latencies in [2^i, 2^(i+1)) us, the first one also 0,
+ * the last one everything above
+*/
+#define TRACE_BUCKETS   24
+
+typedef enum {
+    TRACE_TRIGGER,      // AHT21 measurement started
+    TRACE_READ,         // all sensors read
+    TRACE_QUEUED,       // handed to sensors_queue
+    TRACE_DISPATCHED,   // taken from the queue by app_main
+    TRACE_DISPLAYED,    // display buffer sent, after dispatched
+    TRACE_BUZZER,       // buzzer switched on, after dispatched
+    TRACE_POINTS
+} trace_point_t;
+
+typedef struct {
+    uint32_t us[TRACE_POINTS];  // esp_timer, truncated to 32 bits
+} trace_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint32_t buckets[TRACE_BUCKETS];
+} trace_histogram_t;
+
+#if TRACE_ENABLE == 1
+#define TRACE_BEGIN(trace)          trace_begin(trace)
+#define TRACE_STAMP(trace, point)   trace_stamp(trace, point)
+#else
+#define TRACE_BEGIN(trace)          ((void)0)
+#define TRACE_STAMP(trace, point)   ((void)0)
+#endif
+
+/**
+ * @brief Clear the stamps and mark the trigger, use TRACE_BEGIN()
+*/
+void trace_begin(trace_t *trace);
+
+/**
+ * @brief Mark a point and account its latency since the trigger and
+ * since the previous point, use TRACE_STAMP()
+*/
+void trace_stamp(trace_t *trace, trace_point_t point);
+
+const char *trace_point_name(trace_point_t point);
+
+/**
+ * @brief The point a stage starts at: the display and the buzzer both
+ * follow the dispatch, the others the point before them
+*/
+trace_point_t trace_previous(trace_point_t point);
+
+/**
+ * @brief Copy the histogram of a point since the trigger, TRACE_TRIGGER has none
+*/
+void trace_get(trace_point_t point, trace_histogram_t *histogram);
+
+/**
+ * @brief Copy the histogram of a point since trace_previous(point)
+*/
+void trace_get_stage(trace_point_t point, trace_histogram_t *histogram);
+
+/**
+ * @brief Upper bound of the bucket holding the `percent` percentile, 0 if empty
+*/
+uint32_t trace_percentile_us(const trace_histogram_t *histogram, uint32_t percent);
+
+/**
+ * @brief Print the histograms as a table, e.g. to the UART
+*/
+void trace_print(FILE *out);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "main.h"
+#include "history.h"
+
+/**
+ * Collector to push samples to, empty - the exporter is disabled.
+ * E.g. InfluxDB with the UDP listener enabled, or carbon (Graphite).
+ * The host build sets it to the loopback, see tools/udp_listen.py.
+*/
+#ifndef UDP_EXPORT_HOST
+#define UDP_EXPORT_HOST             ""
+#endif
+#ifndef UDP_EXPORT_PORT
+#define UDP_EXPORT_PORT             8089
+#endif
+
+/**
+ * 0 - InfluxDB line protocol, 1 - Graphite plaintext
+*/
+#define UDP_EXPORT_GRAPHITE         0
+
+#define UDP_EXPORT_MEASUREMENT      "aqa"
+
+/**
+ * A datagram is sent when it holds UDP_EXPORT_BATCH_SAMPLES samples,
+ * when the oldest one waits UDP_EXPORT_BATCH_INTERVAL_MS or when the
+ * next one would not fit into UDP_EXPORT_DATAGRAM_SIZE (below the MTU).
+*/
+#ifndef UDP_EXPORT_BATCH_SAMPLES
+#define UDP_EXPORT_BATCH_SAMPLES    10
+#endif
+#define UDP_EXPORT_BATCH_INTERVAL_MS 10000
+#define UDP_EXPORT_DATAGRAM_SIZE    1200
+
+/**
+ * Samples are timestamped with the wall clock, set by SNTP.
+ * Until the clock is set every sample goes alone, without timestamp,
+ * and the collector stamps it on arrival.
+*/
+#define UDP_EXPORT_NTP_SERVER       "pool.ntp.org"
+
+typedef struct {
+    uint32_t samples;
+    uint32_t datagrams;
+    uint32_t dropped_samples;   // the exporter queue was full
+    uint32_t dropped_datagrams; // the network stack refused the datagram
+    uint32_t render_us;         // time spent rendering and sending
+} udp_export_stats_t;
+
+/**
+ * @brief Start the exporter task, call once the network is up.
+ * Does nothing when UDP_EXPORT_HOST is empty.
+*/
+void udp_export_start(void);
+
+/**
+ * @brief Queue a sample, never blocks
+*/
+void udp_export_add(const sensors_data_t *data);
+
+/**
+ * @brief Queue a stored sample with its wall clock time (0 - unknown),
+ * waits up to `timeout_ms` for room (battery mode)
+ * @return false if it was not queued
+*/
+bool udp_export_add_record(const history_record_t *record, int64_t epoch_ms, uint32_t timeout_ms);
+
+/**
+ * @brief Send the queued samples without waiting for a full batch
+ * @return false on timeout or if the exporter is disabled
+*/
+bool udp_export_flush(uint32_t timeout_ms);
+
+void udp_export_get_stats(udp_export_stats_t *stats);
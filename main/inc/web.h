@@ -1,5 +1,16 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "esp_http_server.h"
 
-httpd_handle_t start_webserver(void);
\ No newline at end of file
+#include "main.h"
+#include "json_writer.h"
+
+httpd_handle_t start_webserver(void);
+
+/**
+ * @brief Serialize a sample as a JSON object, shared by the API endpoints
+*/
+void api_serialize_sample(json_writer_t *w, uint32_t seq, 
+    const sensors_data_t *data, int64_t timestamp_us);
\ No newline at end of file
@@ -2,9 +2,37 @@
 
 #include "esp_err.h"
 
-#define WIFI_STA_MAX_RETRY  3
 #define WIFI_STA_CONNECTION_TIMEOUT_MS 15000
 
+/**
+ * The station retries forever, the delay doubles from MIN to MAX
+ * and is randomized by up to a half.
+*/
+#define WIFI_BACKOFF_MIN_MS         1000
+#define WIFI_BACKOFF_MAX_MS         60000
+
+/**
+ * Outage after which the device also starts its own AP,
+ * the AP is stopped as soon as the station is connected again.
+ * At boot the AP starts after WIFI_STA_CONNECTION_TIMEOUT_MS.
+*/
+#define WIFI_AP_FALLBACK_AFTER_MS   (5 * 60 * 1000)
+
+// pause before the next known network of the same round
+#define WIFI_NEXT_CANDIDATE_DELAY_MS 100
+
+#define WIFI_SCAN_MAX_APS           16
+
+/**
+ * Optional static address of the station, empty - DHCP.
+ * With DHCP the last lease is requested again after a reboot
+ * (CONFIG_LWIP_DHCP_RESTORE_LAST_IP).
+*/
+#define WIFI_STATIC_IP              ""
+#define WIFI_STATIC_NETMASK         "255.255.255.0"
+#define WIFI_STATIC_GW              ""
+#define WIFI_STATIC_DNS             ""
+
 #define WIFI_AP_SSID        "ESP_AQA"
 #define WIFI_AP_PASSWORD    "12344321"
 #define WIFI_AP_CHANNEL     5
@@ -12,4 +40,24 @@
 
 #define WIFI_ENA_PIN 13
 
+/**
+ * @brief Start the network in background, returns at once
+*/
 void wifi_start(void);
+
+/**
+ * @brief Connect with the credentials just saved, without a reboot.
+ * An active AP is kept until the station gets an address.
+*/
+esp_err_t wifi_apply_creds(void);
+
+/**
+ * @brief Battery mode: connect the station and start the exporters,
+ * no AP and no web server. Blocks up to WIFI_STA_CONNECTION_TIMEOUT_MS.
+*/
+esp_err_t wifi_connect_sta(void);
+
+/**
+ * @brief Turn the radio off, before the deep sleep
+*/
+void wifi_stop(void);
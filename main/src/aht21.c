@@ -1,4 +1,6 @@
 #include "measurment.h"
+#include "i2c_bus.h"
+#include "app_config.h"
 
 #define AHT21_CMD_STARTUP     0x71
 #define AHT21_CMD_INIT        0xBE
@@ -8,24 +10,17 @@
 esp_err_t aht21_reset(void)
 {   
     uint8_t data = AHT21_CMD_SOFTRESET;
-    esp_err_t ok = i2c_master_write_to_device(
-        I2C_MASTER_NUM, AHT21_DEV_ADDR, 
-        &data, 1, I2C_MASTER_TIMEOUT
-    );
+    esp_err_t ok = i2c_bus_write(AHT21_DEV_ADDR, &data, 1);
     return ok;
 }   
 
 esp_err_t aht21_init(void)
 {
     uint8_t data[3] = {AHT21_CMD_STARTUP, 0x08, 0x00};
-    esp_err_t ok = i2c_master_write_to_device(I2C_MASTER_NUM, 
-        AHT21_DEV_ADDR, data, 1, I2C_MASTER_TIMEOUT
-    );
+    esp_err_t ok = i2c_bus_write(AHT21_DEV_ADDR, data, 1);
     ESP_ERROR_CHECK(ok);
 
-    ok = i2c_master_read_from_device(I2C_MASTER_NUM, 
-        AHT21_DEV_ADDR, data, 1, I2C_MASTER_TIMEOUT
-    );
+    ok = i2c_bus_read(AHT21_DEV_ADDR, data, 1);
     ESP_ERROR_CHECK(ok);
 
     if((data[0] & 0x18) == 0x18)
@@ -33,9 +28,7 @@ esp_err_t aht21_init(void)
 
     data[0] = AHT21_CMD_INIT;
 
-    ok = i2c_master_write_to_device(I2C_MASTER_NUM, 
-        AHT21_DEV_ADDR, data, 3, I2C_MASTER_TIMEOUT
-    );
+    ok = i2c_bus_write(AHT21_DEV_ADDR, data, 3);
     ESP_ERROR_CHECK(ok);
 
     vTaskDelay(pdMS_TO_TICKS(20));
@@ -43,7 +36,7 @@ esp_err_t aht21_init(void)
     return ESP_OK;
 }
 
-static inline uint8_t crc_calculate(uint8_t* data)
+uint8_t aht21_crc(const uint8_t *data)
 {
     uint8_t crc = 0xff;
     for(uint8_t i = 0; i < 6; i++){
@@ -62,23 +55,25 @@ esp_err_t aht21_read_data(aht21_data_t *result)
     uint8_t data[7] = {0};
 
     // starting measurment
-    esp_err_t ok = i2c_master_write_to_device(I2C_MASTER_NUM, 
-        AHT21_DEV_ADDR, trigger_cmd, 3, I2C_MASTER_TIMEOUT
-    );
+    esp_err_t ok = i2c_bus_write(AHT21_DEV_ADDR, trigger_cmd, 3);
     ESP_ERROR_CHECK(ok);
 
     // wait for finish measurment
     vTaskDelay(pdMS_TO_TICKS(100));
 
     // read data
-    ok = i2c_master_read_from_device(I2C_MASTER_NUM, 
-        AHT21_DEV_ADDR, data, sizeof(data), I2C_MASTER_TIMEOUT
-    );
+    ok = i2c_bus_read(AHT21_DEV_ADDR, data, sizeof(data));
     ESP_ERROR_CHECK(ok);
 
-    result->status = data[0];
-    result->crc_ok = (crc_calculate(data) == data[6]);
+    aht21_parse(data, result);
+
+    return ok;
+}
 
+void aht21_parse(const uint8_t *data, aht21_data_t *result)
+{
+    result->status = data[0];
+    result->crc_ok = (aht21_crc(data) == data[6]);
 
     // data converting
     uint32_t raw_humidity = (((uint32_t)data[1]) << 16);
@@ -89,7 +84,7 @@ esp_err_t aht21_read_data(aht21_data_t *result)
     result->humidity = (float) raw_humidity;
     result->humidity *= 100.0;
     result->humidity /= (float)(1 << 20);
-    result->humidity *= AHT21_HUMIDITY_GAIN;
+    result->humidity *= app_config_get()->aht21_humidity_gain;
     
 
     uint32_t raw_temp = (((uint32_t)(data[3] & 0x0F)) << 16);
@@ -100,7 +95,5 @@ esp_err_t aht21_read_data(aht21_data_t *result)
     result->temperature *= 200.0;
     result->temperature /= (float)(1 << 20);
     result->temperature -= 50.0;
-    result->temperature += AHT21_TEMPERATURE_OFFSET;
-
-    return ok;
+    result->temperature += app_config_get()->aht21_temperature_offset;
 }
@@ -0,0 +1,37 @@
+#include "web.h"
+#include "json_writer.h"
+
+#include "esp_timer.h"
+
+void api_serialize_sample(json_writer_t *w, uint32_t seq, 
+    const sensors_data_t *data, int64_t timestamp_us)
+{
+    json_object_begin(w, NULL);
+    json_add_uint(w, "seq", seq);
+    json_add_int(w, "age_ms", (esp_timer_get_time() - timestamp_us) / 1000);
+
+    json_object_begin(w, "aht21");
+    json_add_float(w, "temperature", data->aht21.temperature, 2);
+    json_add_float(w, "humidity", data->aht21.humidity, 2);
+    json_object_end(w);
+
+    json_object_begin(w, "bmp280");
+    json_add_float(w, "temperature", data->bmp280.temperature, 2);
+    json_add_float(w, "pressure", data->bmp280.pressure, 1);
+    json_object_end(w);
+
+    json_object_begin(w, "ens160");
+    json_add_uint(w, "aqi", data->ens160.aqi);
+    json_add_uint(w, "tvoc", data->ens160.tvoc);
+    json_add_uint(w, "eco2", data->ens160.eco2);
+    json_object_end(w);
+
+    json_object_begin(w, "comfort");
+    json_add_float(w, "dew_point", data->comfort.dew_point, 2);
+    json_add_float(w, "absolute_humidity", data->comfort.absolute_humidity, 2);
+    json_add_float(w, "heat_index", data->comfort.heat_index, 2);
+    json_add_float(w, "altitude", data->comfort.altitude, 1);
+    json_object_end(w);
+
+    json_object_end(w);
+}
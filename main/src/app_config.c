@@ -0,0 +1,163 @@
+#include "app_config.h"
+#include "measurment.h"
+#include "mem_map.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs.h"
+
+#define APP_CONFIG_NAMESPACE    "config"
+#define APP_CONFIG_KEY          "app"
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;      // of the payload
+    uint32_t crc;       // of the payload
+    app_config_t config;
+} app_config_blob_t;
+
+static const char *TAG = "CONFIG";
+
+static const app_config_t s_defaults = {
+    .aht21_temperature_offset = AHT21_TEMPERATURE_OFFSET,
+    .aht21_humidity_gain = AHT21_HUMIDITY_GAIN,
+    .bmp280_temperature_offset = BMP280_TEMPERATURE_OFFSET,
+    .bmp280_pressure_gain = BMP280_PRESSURE_GAIN,
+    .measurement_interval_ms = INTERVAL_MEASURMENT_MS,
+    .alarm_aqi = ALARM_AQI,
+    .alarm_eco2_ppm = ALARM_ECO2_PPM,
+    .alarm_duration_ms = ALARM_DURATION_MS,
+};
+
+// readers follow s_current, the writer fills the other buffer and swaps
+static app_config_t s_buffers[2];
+static const app_config_t *s_current = &s_defaults;
+static SemaphoreHandle_t s_write_lock = NULL;
+
+MEM_SEMAPHORE(mem_config_lock, "config");
+
+static inline uint32_t payload_crc(const void *payload, size_t size)
+{
+    return esp_rom_crc32_le(0, payload, size);
+}
+
+static void publish(const app_config_t *config)
+{
+    app_config_t *next = (s_current == &s_buffers[0]) ? &s_buffers[1] : &s_buffers[0];
+    *next = *config;
+    __atomic_store_n(&s_current, next, __ATOMIC_RELEASE);
+}
+
+static esp_err_t store(const app_config_t *config)
+{
+    nvs_handle_t nvs;
+    app_config_blob_t blob = {
+        .version = APP_CONFIG_VERSION,
+        .size = sizeof(app_config_t),
+        .crc = payload_crc(config, sizeof(app_config_t)),
+        .config = *config,
+    };
+
+    esp_err_t err = nvs_open(APP_CONFIG_NAMESPACE, NVS_READWRITE, &nvs);
+    if(err != ESP_OK)
+        return err;
+
+    err = nvs_set_blob(nvs, APP_CONFIG_KEY, &blob, sizeof(blob));
+    if(err == ESP_OK)
+        err = nvs_commit(nvs);
+
+    nvs_close(nvs);
+    return err;
+}
+
+/**
+ * @return true if `config` was filled from NVS
+*/
+static bool load(app_config_t *config)
+{
+    nvs_handle_t nvs;
+    app_config_blob_t blob;
+    size_t size = sizeof(blob);
+
+    *config = s_defaults;
+
+    if(nvs_open(APP_CONFIG_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return false;
+
+    // a blob of a newer layout is bigger, the read fails and defaults are used
+    esp_err_t err = nvs_get_blob(nvs, APP_CONFIG_KEY, &blob, &size);
+    nvs_close(nvs);
+
+    if(err != ESP_OK)
+        return false;
+
+    const size_t header = offsetof(app_config_blob_t, config);
+    if(size < header || blob.size != size - header || blob.size > sizeof(app_config_t)
+        || blob.crc != payload_crc(&blob.config, blob.size))
+    {
+        ESP_LOGW(TAG, "stored settings are corrupted, using defaults");
+        return false;
+    }
+
+    memcpy(config, &blob.config, blob.size);
+
+    if(blob.version != APP_CONFIG_VERSION) {
+        ESP_LOGI(TAG, "migrating settings from version %u", blob.version);
+        store(config);
+    }
+
+    return true;
+}
+
+void app_config_init(void)
+{
+    app_config_t config;
+
+    s_write_lock = mem_mutex_create(&mem_config_lock);
+
+    if(!load(&config))
+        ESP_LOGI(TAG, "no stored settings, using defaults");
+
+    publish(&config);
+}
+
+const app_config_t *app_config_get(void)
+{
+    return __atomic_load_n(&s_current, __ATOMIC_ACQUIRE);
+}
+
+static bool valid(const app_config_t *c)
+{
+    return c->aht21_temperature_offset >= -20.0f && c->aht21_temperature_offset <= 20.0f
+        && c->bmp280_temperature_offset >= -20.0f && c->bmp280_temperature_offset <= 20.0f
+        && c->aht21_humidity_gain >= 0.5f && c->aht21_humidity_gain <= 1.5f
+        && c->bmp280_pressure_gain >= 0.5f && c->bmp280_pressure_gain <= 1.5f
+        && c->measurement_interval_ms >= 500 && c->measurement_interval_ms <= 60000
+        && c->alarm_aqi >= 1 && c->alarm_aqi <= 5
+        && c->alarm_eco2_ppm >= 400 && c->alarm_eco2_ppm <= 65000
+        && c->alarm_duration_ms <= 10000;
+}
+
+esp_err_t app_config_set(const app_config_t *config)
+{
+    if(!valid(config))
+        return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_write_lock, portMAX_DELAY);
+
+    esp_err_t err = store(config);
+    if(err == ESP_OK)
+        publish(config);
+
+    xSemaphoreGive(s_write_lock);
+
+    if(err != ESP_OK)
+        ESP_LOGE(TAG, "cannot store settings: %s", esp_err_to_name(err));
+
+    return err;
+}
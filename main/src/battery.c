@@ -0,0 +1,245 @@
+#include "battery.h"
+#include "comfort.h"
+#include "history.h"
+#include "log_ring.h"
+#include "measurment.h"
+#include "mqtt_pub.h"
+#include "udp_export.h"
+#include "wifi.h"
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+
+// 2020-01-01, anything earlier means the clock is not set yet
+#define WALL_CLOCK_VALID_S      1577836800
+
+// shortest deep sleep, when a wake took the whole period
+#define BATTERY_MIN_SLEEP_MS    1000
+
+#define BATTERY_LOG_FLUSH_MS    200
+
+static const char *TAG = "BATTERY";
+
+typedef struct {
+    history_record_t record;
+    int64_t epoch_ms;       // 0 - the wall clock was not set
+} battery_sample_t;
+
+/**
+ * Kept in the deep sleep, zeroed at power-on and reset.
+ * Sequence numbers: `uploaded` is the oldest record not uploaded yet,
+ * `head` the next one.
+*/
+typedef struct {
+    uint32_t head;
+    uint32_t uploaded;
+    uint32_t attempted;     // head at the last upload attempt
+    bool alarm;             // of the previous sample
+    int64_t clock_us;       // since power-on, at the start of this wake
+    uint32_t wakes;
+    uint32_t uploads;
+    uint32_t failed_uploads;
+    battery_sample_t samples[BATTERY_RTC_CAPACITY];
+} battery_rtc_t;
+
+static RTC_DATA_ATTR battery_rtc_t s_rtc;
+
+_Static_assert(sizeof(s_rtc) <= BATTERY_RTC_BUDGET, "BATTERY_RTC_CAPACITY exceeds BATTERY_RTC_BUDGET");
+
+// of this wake
+static int64_t s_ens160_us = 0;
+static int64_t s_radio_us = 0;
+
+static void store(const sensors_data_t *data)
+{
+    battery_sample_t *sample = &s_rtc.samples[s_rtc.head % BATTERY_RTC_CAPACITY];
+    struct timeval tv;
+
+    history_pack(&sample->record, data, s_rtc.clock_us + esp_timer_get_time());
+    sample->record.seq = s_rtc.head;
+
+    gettimeofday(&tv, NULL);
+    sample->epoch_ms = tv.tv_sec >= WALL_CLOCK_VALID_S ? tv.tv_sec * 1000LL + tv.tv_usec / 1000 : 0;
+
+    s_rtc.head++;
+    if(s_rtc.head - s_rtc.uploaded > BATTERY_RTC_CAPACITY)
+        s_rtc.uploaded = s_rtc.head - BATTERY_RTC_CAPACITY;
+}
+
+bool battery_sample(SemaphoreHandle_t i2c_smphr, sensors_data_t *data)
+{
+    const bool cold = esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER;
+    bool ok = false;
+
+    xSemaphoreTake(i2c_smphr, portMAX_DELAY);
+
+    if(cold) {
+        aht21_reset();
+        ens160_reset();
+        vTaskDelay(pdMS_TO_TICKS(250));
+    }
+
+    // the BMP280 calibration is kept in RAM, so it is read again every wake
+    aht21_init();
+    ens160_init();
+    const int64_t ens160_start_us = esp_timer_get_time();
+    bmp280_init();
+
+    // a bus error skips the sample: a panic would reset and lose the records in RTC memory
+    memset(&data->ens160, 0, sizeof(data->ens160));
+
+    // the AHT21 conversion also covers the first one of the BMP280
+    esp_err_t err = aht21_read_data(&data->aht21);
+    if(err == ESP_OK)
+        err = bmp280_read(&data->bmp280);
+    bmp280_sleep();
+
+    if(err == ESP_OK && data->aht21.crc_ok) {
+        aht21_data_t forcomp = {
+            .temperature = data->bmp280.temperature,
+            .humidity = data->aht21.humidity
+        };
+        err = ens160_compensate(&forcomp);
+    }
+
+    if(err == ESP_OK && data->aht21.crc_ok) {
+        const int64_t deadline_us = ens160_start_us + BATTERY_ENS160_TIMEOUT_MS * 1000LL;
+        do {
+            vTaskDelay(pdMS_TO_TICKS(BATTERY_ENS160_POLL_MS));
+            data->ens160 = ens160_read();
+        } while((data->ens160.status & 0x02) == 0x00 && esp_timer_get_time() < deadline_us);
+
+        ok = (data->ens160.status & 0x02) != 0x00;
+    }
+
+    ens160_sleep();
+    s_ens160_us = esp_timer_get_time() - ens160_start_us;
+
+    xSemaphoreGive(i2c_smphr);
+
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "no sample this wake: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    if(!ok) {
+        ESP_LOGW(TAG, "no sample this wake (CRC %s, ENS160 status 0x%02x)",
+            data->aht21.crc_ok ? "ok" : "failed", data->ens160.status);
+        return false;
+    }
+
+    comfort_compute(data);
+    store(data);
+    return true;
+}
+
+/**
+ * @brief Records stay pending if a configured exporter did not get every one
+*/
+static void upload(void)
+{
+    const int64_t start_us = esp_timer_get_time();
+    bool ok = false;
+
+    s_rtc.attempted = s_rtc.head;
+
+    if(wifi_connect_sta() == ESP_OK)
+    {
+        for(uint32_t seq = s_rtc.uploaded; seq != s_rtc.head; seq++)
+        {
+            const battery_sample_t *sample = &s_rtc.samples[seq % BATTERY_RTC_CAPACITY];
+            if(strlen(MQTT_BROKER_URI) > 0)
+                mqtt_pub_add_record(&sample->record);
+            if(strlen(UDP_EXPORT_HOST) > 0)
+                udp_export_add_record(&sample->record, sample->epoch_ms, BATTERY_UPLOAD_TIMEOUT_MS);
+        }
+
+        ok = true;
+        if(strlen(MQTT_BROKER_URI) > 0 && !mqtt_pub_wait_sent(BATTERY_UPLOAD_TIMEOUT_MS))
+            ok = false;
+        if(strlen(UDP_EXPORT_HOST) > 0 && !udp_export_flush(BATTERY_UPLOAD_TIMEOUT_MS))
+            ok = false;
+    }
+
+    wifi_stop();
+    s_radio_us = esp_timer_get_time() - start_us;
+
+    if(ok) {
+        ESP_LOGI(TAG, "uploaded %u records in %u ms",
+            (unsigned)(s_rtc.head - s_rtc.uploaded), (unsigned)(s_radio_us / 1000));
+        s_rtc.uploaded = s_rtc.head;
+        s_rtc.uploads++;
+    } else {
+        ESP_LOGW(TAG, "upload failed, %u records kept", (unsigned)(s_rtc.head - s_rtc.uploaded));
+        s_rtc.failed_uploads++;
+    }
+}
+
+/**
+ * @brief Charge and energy of this wake from the measured times,
+ * the average current over the period and the battery life it gives
+*/
+static void report(int64_t awake_us, int64_t sleep_us)
+{
+    // mA * ms = µC
+    const uint32_t awake_ms = (uint32_t)(awake_us / 1000);
+    const uint32_t radio_ms = (uint32_t)(s_radio_us / 1000);
+    const uint32_t ens160_ms = (uint32_t)(s_ens160_us / 1000);
+    const uint32_t wake_uc = BATTERY_CURRENT_CPU_MA * awake_ms
+        + BATTERY_CURRENT_RADIO_MA * radio_ms
+        + BATTERY_CURRENT_ENS160_MA * ens160_ms;
+    const uint32_t sleep_uc = (uint32_t)(BATTERY_CURRENT_SLEEP_UA * (sleep_us / 1000) / 1000);
+
+    const int64_t period_ms = (awake_us + sleep_us) / 1000;
+    const uint32_t average_ua = (uint32_t)((wake_uc + sleep_uc) * 1000LL / period_ms);
+
+    ESP_LOGI(TAG, "wake %u: awake %u ms (ENS160 %u ms, radio %u ms), %u uC = %u.%03u mJ",
+        (unsigned)s_rtc.wakes, (unsigned)awake_ms, (unsigned)ens160_ms, (unsigned)radio_ms,
+        (unsigned)wake_uc,
+        (unsigned)(wake_uc * (uint64_t)BATTERY_VOLTAGE_MV / 1000000),
+        (unsigned)(wake_uc * (uint64_t)BATTERY_VOLTAGE_MV / 1000 % 1000));
+    ESP_LOGI(TAG, "average %u uA over %u ms, %u days on %u mAh; %u uploads, %u failed, %u records pending",
+        (unsigned)average_ua, (unsigned)period_ms,
+        (unsigned)(average_ua ? BATTERY_CAPACITY_MAH * 1000ULL / average_ua / 24 : 0),
+        (unsigned)BATTERY_CAPACITY_MAH,
+        (unsigned)s_rtc.uploads, (unsigned)s_rtc.failed_uploads,
+        (unsigned)(s_rtc.head - s_rtc.uploaded));
+}
+
+// keeps the period from wake to wake
+static int64_t sleep_time_us(void)
+{
+    const int64_t sleep_us = BATTERY_SAMPLE_PERIOD_S * 1000000LL - esp_timer_get_time();
+    return sleep_us > BATTERY_MIN_SLEEP_MS * 1000LL ? sleep_us : BATTERY_MIN_SLEEP_MS * 1000LL;
+}
+
+void battery_sleep(bool alarm)
+{
+    const uint32_t pending = s_rtc.head - s_rtc.uploaded;
+    const bool configured = strlen(MQTT_BROKER_URI) > 0 || strlen(UDP_EXPORT_HOST) > 0;
+
+    // a failed upload is tried again BATTERY_UPLOAD_EVERY samples later
+    const bool due = pending >= BATTERY_UPLOAD_EVERY
+        && s_rtc.head - s_rtc.attempted >= BATTERY_UPLOAD_EVERY;
+    const bool tripped = alarm && !s_rtc.alarm;
+
+    s_rtc.alarm = alarm;
+    s_rtc.wakes++;
+
+    if(configured && pending > 0 && (due || tripped))
+        upload();
+
+    report(esp_timer_get_time(), sleep_time_us());
+    log_ring_flush(BATTERY_LOG_FLUSH_MS);
+
+    const int64_t sleep_us = sleep_time_us();
+    s_rtc.clock_us += esp_timer_get_time() + sleep_us;
+
+    esp_sleep_enable_timer_wakeup(sleep_us);
+    esp_deep_sleep_start();
+}
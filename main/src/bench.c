@@ -0,0 +1,304 @@
+#include "bench.h"
+#include "comfort.h"
+#include "display.h"
+#include "form_parser.h"
+#include "measurment.h"
+
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+
+#define BENCH_UNIT "ns"
+
+// 32 bit as on target: wraps after ~4 s, far beyond one measurement
+static inline uint32_t bench_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+static inline uint32_t bench_min_time(void)
+{
+    return BENCH_MIN_TIME_MS * 1000000UL;
+}
+#else
+#include "esp_cpu.h"
+
+#define BENCH_UNIT "cycles"
+
+// 32 bit: wraps after ~26 s at 160 MHz, far beyond one measurement
+static inline uint32_t bench_clock(void)
+{
+    return (uint32_t)esp_cpu_get_cycle_count();
+}
+
+static inline uint32_t bench_min_time(void)
+{
+    return CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000UL * BENCH_MIN_TIME_MS;
+}
+#endif
+
+#if !CONFIG_IDF_TARGET_LINUX || HOST_DISPLAY
+#define BENCH_DISPLAY_DRAW 1
+#include "u8g2.h"
+#endif
+
+typedef struct {
+    const char *name;
+    void (*run)(uint32_t ops);
+} bench_t;
+
+// results go here so that the compiler cannot drop the work
+static volatile uint32_t s_sink;
+
+// example calibration NVM of the BMP280 datasheet, section 3.12
+static const uint8_t s_bmp280_calibration[24] = {
+    0x70, 0x6b, 0x43, 0x67, 0x18, 0xfc,
+    0x7d, 0x8e, 0x43, 0xd6, 0xd0, 0x0b, 0x27, 0x0b,
+    0x8c, 0x00, 0xf9, 0xff, 0x8c, 0x3c, 0xf8, 0xc6, 0x70, 0x17
+};
+
+static const sensors_data_t s_sample = {
+    .aht21 = { .status = 0x1c, .temperature = 23.41f, .humidity = 41.27f, .crc_ok = true },
+    .bmp280 = { .temperature = 22.93f, .pressure = 748.6f },
+    .ens160 = { .status = 0x82, .aqi = 2, .tvoc = 183, .eco2 = 712 }
+};
+
+static const char s_urlencoded[] =
+    "ssid=My%20Home%20Network%202.4G&password=p%40ss%2Fw0rd%21%20with%20spaces";
+
+static const char s_multipart_type[] = "multipart/form-data; boundary=----BenchBoundary7MA4YWxk";
+
+static const char s_multipart[] =
+    "------BenchBoundary7MA4YWxk\r\n"
+    "Content-Disposition: form-data; name=\"ssid\"\r\n"
+    "\r\n"
+    "My Home Network 2.4G\r\n"
+    "------BenchBoundary7MA4YWxk\r\n"
+    "Content-Disposition: form-data; name=\"password\"\r\n"
+    "\r\n"
+    "p@ss/w0rd! with spaces\r\n"
+    "------BenchBoundary7MA4YWxk--\r\n";
+
+static void bench_aht21_crc(uint32_t ops)
+{
+    uint8_t frame[7] = { 0x1c, 0x6a, 0x5b, 0x35, 0xc1, 0x7e, 0x00 };
+    uint32_t acc = 0;
+
+    for(uint32_t i = 0; i < ops; i++) {
+        frame[5] = (uint8_t)i;
+        acc += aht21_crc(frame);
+    }
+    s_sink = acc;
+}
+
+static void bench_aht21_parse(uint32_t ops)
+{
+    uint8_t frame[7] = { 0x1c, 0x6a, 0x5b, 0x35, 0xc1, 0x7e, 0x00 };
+    aht21_data_t data;
+    uint32_t acc = 0;
+
+    for(uint32_t i = 0; i < ops; i++) {
+        frame[5] = (uint8_t)i;
+        aht21_parse(frame, &data);
+        acc += (uint32_t)data.temperature + (uint32_t)data.humidity + data.crc_ok;
+    }
+    s_sink = acc;
+}
+
+static void bench_bmp280_temperature(uint32_t ops)
+{
+    float acc = 0;
+
+    for(uint32_t i = 0; i < ops; i++)
+        acc += bmp280_compensate_temperature(519888 + (int32_t)(i & 0x3ff));
+    s_sink = (uint32_t)acc;
+}
+
+static void bench_bmp280_pressure(uint32_t ops)
+{
+    float acc = 0;
+
+    bmp280_compensate_temperature(519888);
+    for(uint32_t i = 0; i < ops; i++)
+        acc += bmp280_compensate_pressure(415148 + (int32_t)(i & 0x3ff));
+    s_sink = (uint32_t)acc;
+}
+
+static void bench_ens160_encode(uint32_t ops)
+{
+    aht21_data_t data = s_sample.aht21;
+    uint8_t wdata[5];
+    uint32_t acc = 0;
+
+    for(uint32_t i = 0; i < ops; i++) {
+        data.humidity = 30.0f + (float)(i & 0x3f);
+        ens160_encode_compensation(&data, wdata);
+        acc += wdata[1] + wdata[3];
+    }
+    s_sink = acc;
+}
+
+/**
+ * Derived readings, fast_math.h against libm, over the range of a room
+*/
+#define BENCH_COMFORT(name, expr) \
+    static void name(uint32_t ops) \
+    { \
+        float acc = 0; \
+        for(uint32_t i = 0; i < ops; i++) \
+            acc += expr; \
+        s_sink = (uint32_t)acc; \
+    }
+
+static inline float bench_temperature(uint32_t i)
+{
+    return 15.0f + (float)(i & 0xff) * 0.05f;
+}
+
+static inline float bench_humidity(uint32_t i)
+{
+    return 20.0f + (float)(i & 0x3f);
+}
+
+static inline float bench_pressure(uint32_t i)
+{
+    return 720.0f + (float)(i & 0x3ff) * 0.05f;
+}
+
+BENCH_COMFORT(bench_dew_point, comfort_dew_point(bench_temperature(i), bench_humidity(i)))
+BENCH_COMFORT(bench_dew_point_libm, comfort_dew_point_libm(bench_temperature(i), bench_humidity(i)))
+BENCH_COMFORT(bench_abs_humidity, comfort_absolute_humidity(bench_temperature(i), bench_humidity(i)))
+BENCH_COMFORT(bench_abs_humidity_libm, comfort_absolute_humidity_libm(bench_temperature(i), bench_humidity(i)))
+BENCH_COMFORT(bench_heat_index, comfort_heat_index(bench_temperature(i) + 12.0f, bench_humidity(i)))
+BENCH_COMFORT(bench_altitude, comfort_altitude(bench_pressure(i)))
+BENCH_COMFORT(bench_altitude_libm, comfort_altitude_libm(bench_pressure(i)))
+
+static void bench_display_format(uint32_t ops)
+{
+    sensors_data_t data = s_sample;
+    char lines[DISPLAY_LINES][DISPLAY_LINE_SIZE];
+    uint32_t acc = 0;
+
+    for(uint32_t i = 0; i < ops; i++) {
+        data.ens160.eco2 = (uint16_t)(400 + (i & 0x3ff));
+        display_format(&data, lines);
+        acc += (uint8_t)lines[3][8];
+    }
+    s_sink = acc;
+}
+
+#if BENCH_DISPLAY_DRAW
+static void bench_display_draw(uint32_t ops)
+{
+    static u8g2_t u8g2;
+    static bool ready = false;
+    char lines[DISPLAY_LINES][DISPLAY_LINE_SIZE];
+
+    // the buffer is never sent, so the display callbacks can stay idle
+    if(!ready) {
+        u8g2_Setup_ssd1306_i2c_128x32_univision_f(&u8g2, U8G2_R0, u8x8_byte_empty, u8x8_dummy_cb);
+        u8g2_SetFont(&u8g2, u8g2_font_04b_03b_tr);
+        ready = true;
+    }
+
+    display_format(&s_sample, lines);
+    for(uint32_t i = 0; i < ops; i++)
+        display_draw(&u8g2, lines);
+    s_sink = u8g2_GetBufferPtr(&u8g2)[0];
+}
+#endif
+
+static void bench_form(const char *content_type, const char *body, uint32_t ops)
+{
+    char ssid[33], password[65];
+    form_field_t fields[] = {
+        { .name = "ssid",     .value = ssid,     .size = sizeof(ssid) },
+        { .name = "password", .value = password, .size = sizeof(password) },
+    };
+    const size_t len = strlen(body);
+    form_parser_t parser;
+    uint32_t acc = 0;
+
+    for(uint32_t i = 0; i < ops; i++) {
+        fields[0].found = fields[1].found = false;
+        form_parser_init(&parser, content_type, fields, 2);
+        form_parser_feed(&parser, body, len);
+        acc += form_parser_finish(&parser) + fields[1].len;
+    }
+    s_sink = acc;
+}
+
+static void bench_form_urlencoded(uint32_t ops)
+{
+    bench_form(NULL, s_urlencoded, ops);
+}
+
+static void bench_form_multipart(uint32_t ops)
+{
+    bench_form(s_multipart_type, s_multipart, ops);
+}
+
+static const bench_t s_benches[] = {
+    { "aht21_crc",              bench_aht21_crc },
+    { "aht21_parse",            bench_aht21_parse },
+    { "bmp280_temperature",     bench_bmp280_temperature },
+    { "bmp280_pressure",        bench_bmp280_pressure },
+    { "ens160_encode",          bench_ens160_encode },
+    { "dew_point",              bench_dew_point },
+    { "dew_point_libm",         bench_dew_point_libm },
+    { "abs_humidity",           bench_abs_humidity },
+    { "abs_humidity_libm",      bench_abs_humidity_libm },
+    { "heat_index",             bench_heat_index },
+    { "altitude",               bench_altitude },
+    { "altitude_libm",          bench_altitude_libm },
+    { "display_format",         bench_display_format },
+#if BENCH_DISPLAY_DRAW
+    { "display_draw",           bench_display_draw },
+#endif
+    { "form_urlencoded",        bench_form_urlencoded },
+    { "form_multipart",         bench_form_multipart },
+};
+
+static uint32_t measure(const bench_t *bench, uint32_t ops)
+{
+    const uint32_t start = bench_clock();
+    bench->run(ops);
+    return bench_clock() - start;
+}
+
+uint32_t bench_run(FILE *out, const char *filter)
+{
+    uint32_t count = 0;
+
+    bmp280_parse_calibration(s_bmp280_calibration);
+
+    for(size_t i = 0; i < sizeof(s_benches) / sizeof(s_benches[0]); i++)
+    {
+        const bench_t *bench = &s_benches[i];
+        if(filter && strstr(bench->name, filter) == NULL)
+            continue;
+
+        // grow the batch until it is long enough to time
+        uint32_t ops = 16;
+        while(measure(bench, ops) < bench_min_time() && ops < (1UL << 30))
+            ops *= 2;
+
+        uint32_t best = UINT32_MAX;
+        for(int r = 0; r < BENCH_REPEATS; r++) {
+            const uint32_t elapsed = measure(bench, ops);
+            if(elapsed < best)
+                best = elapsed;
+        }
+
+        fprintf(out, "{\"bench\":\"%s\",\"unit\":\"" BENCH_UNIT "\",\"per_op\":%.1f,\"ops\":%u}\n",
+            bench->name, (double)best / ops, (unsigned)ops);
+        count++;
+    }
+
+    return count;
+}
@@ -1,4 +1,6 @@
 #include "measurment.h"
+#include "i2c_bus.h"
+#include "app_config.h"
 
 /* registers */
 #define BMP280_REG_CHIP_ID   0xd0
@@ -7,6 +9,10 @@
 #define BMP280_REG_CONFIG    0xf5
 #define BMP280_REG_PRESS_MSB 0xf7
 
+// temperature x2, pressure x16 oversampling, the mode in the low bits
+#define BMP280_CTRL_MEAS     0x57
+#define BMP280_MODE_MASK     0x03
+
 typedef struct {
     uint16_t T1;
     int16_t T2;
@@ -27,39 +33,17 @@ static calib_data_t calib_data;
 
 static esp_err_t bmp280_read_register(uint8_t reg_addr, uint8_t *data, size_t len)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP280_DEV_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP280_DEV_ADDR << 1) | I2C_MASTER_READ, true);
-    if(len > 1)
-        i2c_master_read(cmd, data, len - 1, I2C_MASTER_ACK);
-    i2c_master_read_byte(cmd, data + len - 1, I2C_MASTER_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t ok = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    return ok;
+    return i2c_bus_write_read(BMP280_DEV_ADDR, &reg_addr, 1, data, len);
 }
 
 static esp_err_t bmp280_write_register(uint8_t reg_addr, uint8_t data)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP280_DEV_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_write_byte(cmd, data, true);
-    i2c_master_stop(cmd);
-    esp_err_t ok = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    return ok;
+    uint8_t wdata[2] = {reg_addr, data};
+    return i2c_bus_write(BMP280_DEV_ADDR, wdata, sizeof(wdata));
 }
 
-static void bmp280_read_calibration_data(void)
+void bmp280_parse_calibration(const uint8_t *data)
 {
-    uint8_t data[24];
-    ESP_ERROR_CHECK(bmp280_read_register(0x88, data, sizeof(data)));
-
     calib_data.T1 = (data[1] << 8) | data[0];
     calib_data.T2 = (data[3] << 8) | data[2];
     calib_data.T3 = (data[5] << 8) | data[4];
@@ -75,7 +59,14 @@ static void bmp280_read_calibration_data(void)
     calib_data.P9 = (data[23] << 8) | data[22];
 }
 
-static float bmp280_compensate_temperature(int32_t adc_T)
+static void bmp280_read_calibration_data(void)
+{
+    uint8_t data[24];
+    ESP_ERROR_CHECK(bmp280_read_register(0x88, data, sizeof(data)));
+    bmp280_parse_calibration(data);
+}
+
+float bmp280_compensate_temperature(int32_t adc_T)
 {
     int32_t var1, var2, T;
 
@@ -88,7 +79,7 @@ static float bmp280_compensate_temperature(int32_t adc_T)
     return (float)T/100.0f;
 }
 
-static float bmp280_compensate_pressure(int32_t adc_P)
+float bmp280_compensate_pressure(int32_t adc_P)
 {
     float var1, var2, p;
 
@@ -125,7 +116,7 @@ esp_err_t bmp280_init(void)
 
     bmp280_read_calibration_data();
 
-    ESP_ERROR_CHECK(bmp280_write_register(BMP280_REG_CTRL_MEAS, 0x57)); 
+    ESP_ERROR_CHECK(bmp280_write_register(BMP280_REG_CTRL_MEAS, BMP280_CTRL_MEAS));
     ESP_ERROR_CHECK(bmp280_write_register(BMP280_REG_CONFIG,    0x00));
 
     return ESP_OK;
@@ -145,8 +136,14 @@ esp_err_t bmp280_read(bmp280_data_t *result)
     result->temperature = bmp280_compensate_temperature(adc_T);
     result->pressure = bmp280_compensate_pressure(adc_P) * 0.00750062f;
 
-    result->temperature += BMP280_TEMPERATURE_OFFSET;
-    result->pressure    *= BMP280_PRESSURE_GAIN;
+    const app_config_t *config = app_config_get();
+    result->temperature += config->bmp280_temperature_offset;
+    result->pressure    *= config->bmp280_pressure_gain;
 
     return ok;
 }
+
+esp_err_t bmp280_sleep(void)
+{
+    return bmp280_write_register(BMP280_REG_CTRL_MEAS, BMP280_CTRL_MEAS & ~BMP280_MODE_MASK);
+}
@@ -0,0 +1,98 @@
+#include "comfort.h"
+#include "fast_math.h"
+
+#include <math.h>
+
+// Magnus formula over water, Sonntag 1990
+#define MAGNUS_HPA      6.112f
+#define MAGNUS_B        17.62f
+#define MAGNUS_C        243.12f     // °C
+
+// g/m³ per hPa/K of water vapour: M_w / R * 100
+#define VAPOUR_DENSITY  216.7f
+
+// ISA troposphere: 44330.77 m * (1 - (p/p0)^(R L / g M))
+#define ISA_HEIGHT_M    44330.77f
+#define ISA_EXPONENT    0.1902632f
+
+// RH of 0 has no dew point, sensors report a little below 1 % at worst
+#define HUMIDITY_MIN    0.1f
+
+static inline float clamp_humidity(float humidity)
+{
+    return humidity < HUMIDITY_MIN ? HUMIDITY_MIN : humidity > 100.0f ? 100.0f : humidity;
+}
+
+float comfort_dew_point(float temperature, float humidity)
+{
+    const float gamma = fast_logf(clamp_humidity(humidity) * 0.01f)
+        + MAGNUS_B * temperature / (MAGNUS_C + temperature);
+    return MAGNUS_C * gamma / (MAGNUS_B - gamma);
+}
+
+float comfort_absolute_humidity(float temperature, float humidity)
+{
+    const float saturation = MAGNUS_HPA * fast_expf(MAGNUS_B * temperature / (MAGNUS_C + temperature));
+    return VAPOUR_DENSITY * saturation * clamp_humidity(humidity) * 0.01f / (273.15f + temperature);
+}
+
+float comfort_heat_index(float temperature, float humidity)
+{
+    const float t = temperature * 1.8f + 32.0f;     // the regression is in °F
+    const float rh = clamp_humidity(humidity);
+
+    float hi = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + rh * 0.094f);
+
+    if((hi + t) * 0.5f >= 80.0f)
+    {
+        hi = -42.379f + 2.04901523f * t + 10.14333127f * rh
+            - 0.22475541f * t * rh - 0.00683783f * t * t
+            - 0.05481717f * rh * rh + 0.00122874f * t * t * rh
+            + 0.00085282f * t * rh * rh - 0.00000199f * t * t * rh * rh;
+
+        if(rh < 13.0f && t >= 80.0f && t <= 112.0f)
+            hi -= (13.0f - rh) * 0.25f * sqrtf((17.0f - fabsf(t - 95.0f)) / 17.0f);
+        else if(rh > 85.0f && t >= 80.0f && t <= 87.0f)
+            hi += (rh - 85.0f) * 0.1f * (87.0f - t) * 0.2f;
+    }
+
+    return (hi - 32.0f) / 1.8f;
+}
+
+float comfort_altitude(float pressure)
+{
+    const float ratio = pressure * COMFORT_MMHG_TO_HPA / COMFORT_SEA_LEVEL_HPA;
+    return ISA_HEIGHT_M * (1.0f - fast_powf(ratio, ISA_EXPONENT));
+}
+
+void comfort_compute(sensors_data_t *data)
+{
+    const float temperature = data->bmp280.temperature;
+    const float humidity = data->aht21.humidity;
+
+    data->comfort = (comfort_data_t) {
+        .dew_point = comfort_dew_point(temperature, humidity),
+        .absolute_humidity = comfort_absolute_humidity(temperature, humidity),
+        .heat_index = comfort_heat_index(temperature, humidity),
+        .altitude = comfort_altitude(data->bmp280.pressure),
+    };
+}
+
+float comfort_dew_point_libm(float temperature, float humidity)
+{
+    const float gamma = logf(clamp_humidity(humidity) * 0.01f)
+        + MAGNUS_B * temperature / (MAGNUS_C + temperature);
+    return MAGNUS_C * gamma / (MAGNUS_B - gamma);
+}
+
+float comfort_absolute_humidity_libm(float temperature, float humidity)
+{
+    const float saturation = MAGNUS_HPA * expf(MAGNUS_B * temperature / (MAGNUS_C + temperature));
+    return VAPOUR_DENSITY * saturation * clamp_humidity(humidity) * 0.01f / (273.15f + temperature);
+}
+
+float comfort_altitude_libm(float pressure)
+{
+    const float ratio = pressure * COMFORT_MMHG_TO_HPA / COMFORT_SEA_LEVEL_HPA;
+    return ISA_HEIGHT_M * (1.0f - powf(ratio, ISA_EXPONENT));
+}
@@ -1,8 +1,16 @@
 #include "creds.h"
+#include "main.h"
+
+#include <string.h>
 
 #include "esp_err.h"
+#include "esp_log.h"
 #include "nvs_flash.h"
 
+#define CREDS_NAMESPACE "storage"
+
+static const char *TAG = "CREDS";
+
 void creds_init(void)
 {
     esp_err_t ret = nvs_flash_init();
@@ -13,32 +21,127 @@ void creds_init(void)
     ESP_ERROR_CHECK(ret);
 }
 
-void save_wifi_creds(const char* ssid, const char* pass)
+static int load_all(wifi_network_t *networks)
 {
     nvs_handle_t nvs;
+    size_t size = sizeof(wifi_network_t) * CREDS_MAX_NETWORKS;
 
-    ESP_ERROR_CHECK(nvs_open("storage", NVS_READWRITE, &nvs));
+    memset(networks, 0, size);
 
-    ESP_ERROR_CHECK(nvs_set_str(nvs, "ssid", ssid));
-    ESP_ERROR_CHECK(nvs_set_str(nvs, "pass", pass));
+    if (nvs_open(CREDS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return 0;
+
+    esp_err_t err = nvs_get_blob(nvs, "networks", networks, &size);
+
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // written by an older firmware: a single network
+        size_t ssid_size = sizeof(networks[0].ssid);
+        size_t pass_size = sizeof(networks[0].pass);
+        if (nvs_get_str(nvs, "ssid", networks[0].ssid, &ssid_size) != ESP_OK
+            || nvs_get_str(nvs, "pass", networks[0].pass, &pass_size) != ESP_OK)
+        {
+            memset(&networks[0], 0, sizeof(networks[0]));
+        }
+    } else if (err != ESP_OK || size != sizeof(wifi_network_t) * CREDS_MAX_NETWORKS) {
+        ESP_LOGW(TAG, "stored networks are unreadable, ignored");
+        memset(networks, 0, sizeof(wifi_network_t) * CREDS_MAX_NETWORKS);
+    }
 
-    ESP_ERROR_CHECK(nvs_commit(nvs));
     nvs_close(nvs);
+
+    int count = 0;
+    while (count < CREDS_MAX_NETWORKS && networks[count].ssid[0] != '\0')
+        count++;
+    return count;
 }
 
-void load_wifi_creds(char *ssid, char* pass)
+static void save_all(const wifi_network_t *networks)
 {
     nvs_handle_t nvs;
 
-    ESP_ERROR_CHECK(nvs_open("storage", NVS_READONLY, &nvs));
+    ESP_ERROR_CHECK(nvs_open(CREDS_NAMESPACE, NVS_READWRITE, &nvs));
 
-    size_t required_size;
-    
-    ESP_ERROR_CHECK(nvs_get_str(nvs, "ssid", NULL, &required_size));
-    ESP_ERROR_CHECK(nvs_get_str(nvs, "ssid", ssid, &required_size));
-
-    ESP_ERROR_CHECK(nvs_get_str(nvs, "pass", NULL, &required_size));
-    ESP_ERROR_CHECK(nvs_get_str(nvs, "pass", pass, &required_size));
+    ESP_ERROR_CHECK(nvs_set_blob(nvs, "networks", networks, 
+        sizeof(wifi_network_t) * CREDS_MAX_NETWORKS));
 
+    ESP_ERROR_CHECK(nvs_commit(nvs));
     nvs_close(nvs);
-}
\ No newline at end of file
+}
+
+static int find_network(const wifi_network_t *networks, const char *ssid)
+{
+    for (int i = 0; i < CREDS_MAX_NETWORKS && networks[i].ssid[0] != '\0'; i++)
+        if (strcmp(networks[i].ssid, ssid) == 0)
+            return i;
+    return -1;
+}
+
+/**
+ * @brief Move the entry at `pos` to the head of the list
+*/
+static wifi_network_t *move_to_front(wifi_network_t *networks, int pos)
+{
+    wifi_network_t entry = networks[pos];
+
+    memmove(&networks[1], &networks[0], sizeof(wifi_network_t) * pos);
+    networks[0] = entry;
+
+    return &networks[0];
+}
+
+void save_wifi_creds(const char* ssid, const char* pass)
+{
+    wifi_network_t networks[CREDS_MAX_NETWORKS];
+
+    const int count = load_all(networks);
+
+    int pos = find_network(networks, ssid);
+    if (pos < 0) {
+        // a new network replaces the least recently used one
+        pos = MIN(count, CREDS_MAX_NETWORKS - 1);
+        memset(&networks[pos], 0, sizeof(networks[pos]));
+        strncpy(networks[pos].ssid, ssid, sizeof(networks[pos].ssid) - 1);
+    }
+
+    wifi_network_t *network = move_to_front(networks, pos);
+    memset(network->pass, 0, sizeof(network->pass));
+    strncpy(network->pass, pass, sizeof(network->pass) - 1);
+    // the password may have changed along with the access point
+    network->channel = 0;
+
+    save_all(networks);
+}
+
+int load_wifi_networks(wifi_network_t *networks, int max)
+{
+    wifi_network_t all[CREDS_MAX_NETWORKS];
+
+    const int count = MIN(load_all(all), max);
+    memcpy(networks, all, sizeof(wifi_network_t) * count);
+
+    return count;
+}
+
+void creds_network_connected(const char *ssid, const uint8_t *bssid, uint8_t channel)
+{
+    wifi_network_t networks[CREDS_MAX_NETWORKS];
+
+    load_all(networks);
+
+    // flash is written only when something has changed
+    if (strcmp(networks[0].ssid, ssid) == 0 && networks[0].channel == channel
+        && memcmp(networks[0].bssid, bssid, sizeof(networks[0].bssid)) == 0)
+    {
+        return;
+    }
+
+    const int pos = find_network(networks, ssid);
+    if (pos < 0)
+        return;
+
+    wifi_network_t *network = move_to_front(networks, pos);
+    memcpy(network->bssid, bssid, sizeof(network->bssid));
+    network->channel = channel;
+
+    save_all(networks);
+}
@@ -1,5 +1,9 @@
 #include "main.h"
 #include "display.h"
+#include "i2c_bus.h"
+#include "mem_map.h"
+
+#include <string.h>
 
 #include "driver/i2c.h"
 #include "esp_log.h"
@@ -7,32 +11,39 @@
 #include "u8g2.h"
 #include "u8g2_esp32_hal.h"
 
+// longest u8x8 transfer, a command or a tile row
+#define DISPLAY_TRANSFER_SIZE 64
+
+static const char *TAG = "DISPLAY";
+
 static SemaphoreHandle_t i2c_smphr = NULL;
 
+/**
+ * @brief u8x8 byte callback: the bytes of a transfer are gathered and sent
+ * with one command link, which is static with MEM_STATIC_ENABLE 1
+*/
 uint8_t cb_i2c_display(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr) 
 {
-    static i2c_cmd_handle_t handle_i2c;
+    static uint8_t data[DISPLAY_TRANSFER_SIZE];
+    static size_t len = 0;
+    static bool overflow = false;
 
     switch (msg)
     {
     case U8X8_MSG_BYTE_SEND:{
-        uint8_t* data_ptr = (uint8_t*)arg_ptr;
-        while (arg_int > 0) 
-        {
-            ESP_ERROR_CHECK(i2c_master_write_byte(handle_i2c, *data_ptr, ACK_CHECK_EN));
-            data_ptr++;
-            arg_int--;
+        if(len + arg_int > sizeof(data)) {
+            overflow = true;
+            break;
         }
+        memcpy(data + len, arg_ptr, arg_int);
+        len += arg_int;
         break;
     }
 
     case U8X8_MSG_BYTE_START_TRANSFER: 
     {
-        uint8_t i2c_address = u8x8_GetI2CAddress(u8x8);
-        handle_i2c = i2c_cmd_link_create();
-        ESP_ERROR_CHECK(i2c_master_start(handle_i2c));
-        ESP_ERROR_CHECK(i2c_master_write_byte(
-            handle_i2c, i2c_address | I2C_MASTER_WRITE, ACK_CHECK_EN));
+        len = 0;
+        overflow = false;
         break;
     }
 
@@ -41,15 +52,35 @@ uint8_t cb_i2c_display(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr
         if(i2c_smphr == NULL)
             break;
 
-        ESP_ERROR_CHECK(i2c_master_stop(handle_i2c));
-
-        if(xSemaphoreTake(i2c_smphr, pdMS_TO_TICKS(50)) == pdFALSE)
+        if(overflow) {
+            ESP_LOGE(TAG, "transfer longer than %d bytes dropped", DISPLAY_TRANSFER_SIZE);
             break;
+        }
+
+        const uint8_t i2c_address = u8x8_GetI2CAddress(u8x8);
+#if MEM_STATIC_ENABLE == 1
+        static uint8_t link[I2C_LINK_RECOMMENDED_SIZE(3)];
+        i2c_cmd_handle_t handle_i2c = i2c_cmd_link_create_static(link, sizeof(link));
+#else
+        i2c_cmd_handle_t handle_i2c = i2c_cmd_link_create();
+#endif
+        ESP_ERROR_CHECK(i2c_master_start(handle_i2c));
+        ESP_ERROR_CHECK(i2c_master_write_byte(
+            handle_i2c, i2c_address | I2C_MASTER_WRITE, ACK_CHECK_EN));
+        if(len > 0)
+            ESP_ERROR_CHECK(i2c_master_write(handle_i2c, data, len, ACK_CHECK_EN));
+        ESP_ERROR_CHECK(i2c_master_stop(handle_i2c));
 
-        ESP_ERROR_CHECK(i2c_master_cmd_begin(I2C_MASTER_NUM, handle_i2c, I2C_MASTER_TIMEOUT));
-        xSemaphoreGive(i2c_smphr);
+        if(xSemaphoreTake(i2c_smphr, pdMS_TO_TICKS(50)) == pdTRUE) {
+            ESP_ERROR_CHECK(i2c_bus_cmd_begin(i2c_address >> 1, handle_i2c));
+            xSemaphoreGive(i2c_smphr);
+        }
 
+#if MEM_STATIC_ENABLE == 1
+        i2c_cmd_link_delete_static(handle_i2c);
+#else
         i2c_cmd_link_delete(handle_i2c);
+#endif
         break;
     }
     
@@ -93,26 +124,24 @@ void display_task(void* arg)
     vTaskDelay(pdMS_TO_TICKS(DISPLAY_LOGO_TIME_MS));
     
     sensors_data_t sdata;
-    char str[256];
+    char lines[DISPLAY_LINES][DISPLAY_LINE_SIZE];
 
     while(1)
     {
         xQueueReceive(config->queue, &sdata, portMAX_DELAY);
 
-        u8g2_ClearBuffer(&u8g2);
-
-        snprintf(str, sizeof(str), "%.2f °C  %.2f %%   %.0f mmhg", sdata.bmp280.temperature, sdata.aht21.humidity, sdata.bmp280.pressure);
-        u8g2_DrawStr(&u8g2, 2, 7, str);
-
-        snprintf(str, sizeof(str), "AQI   : %d", sdata.ens160.aqi);
-        u8g2_DrawStr(&u8g2, 2, 15, str);
-
-        snprintf(str, sizeof(str), "TVOC  : %d ppb", sdata.ens160.tvoc);
-        u8g2_DrawStr(&u8g2, 2, 23, str);
-
-        snprintf(str, sizeof(str), "ECO2  : %d ppm", sdata.ens160.eco2);
-        u8g2_DrawStr(&u8g2, 2, 31, str);
+        display_format(&sdata, lines);
+        display_draw(&u8g2, lines);
 
         u8g2_SendBuffer(&u8g2);
+        TRACE_STAMP(&sdata.trace, TRACE_DISPLAYED);
     }
 }
+
+void display_draw(u8g2_t *u8g2, const char lines[DISPLAY_LINES][DISPLAY_LINE_SIZE])
+{
+    u8g2_ClearBuffer(u8g2);
+
+    for(int i = 0; i < DISPLAY_LINES; i++)
+        u8g2_DrawStr(u8g2, 2, 7 + 8 * i, lines[i]);
+}
@@ -0,0 +1,13 @@
+#include "display.h"
+
+#include <stdio.h>
+
+void display_format(const sensors_data_t *data, char lines[DISPLAY_LINES][DISPLAY_LINE_SIZE])
+{
+    snprintf(lines[0], DISPLAY_LINE_SIZE, "%.2f °C  %.2f %%   %.0f mmhg", 
+        data->bmp280.temperature, data->aht21.humidity, data->bmp280.pressure);
+    snprintf(lines[1], DISPLAY_LINE_SIZE, "AQI   : %d      DEW %.1f °C", 
+        data->ens160.aqi, data->comfort.dew_point);
+    snprintf(lines[2], DISPLAY_LINE_SIZE, "TVOC  : %d ppb", data->ens160.tvoc);
+    snprintf(lines[3], DISPLAY_LINE_SIZE, "ECO2  : %d ppm", data->ens160.eco2);
+}
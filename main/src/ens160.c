@@ -1,4 +1,5 @@
 #include "measurment.h"
+#include "i2c_bus.h"
 
 #define ENS160_ID 0x0160
 
@@ -7,9 +8,7 @@ static inline uint16_t ens160_read_id(void)
 {
     uint8_t wdata = 0x00;
     uint16_t ens160_id = 0x0000;
-    esp_err_t ok = i2c_master_write_read_device(I2C_MASTER_NUM, ENS160_DEV_ADDR, 
-        &wdata, 1, (uint8_t*)&ens160_id, 2, I2C_MASTER_TIMEOUT
-    );
+    esp_err_t ok = i2c_bus_write_read(ENS160_DEV_ADDR, &wdata, 1, (uint8_t*)&ens160_id, 2);
     ESP_ERROR_CHECK(ok);
 
     return ens160_id;
@@ -23,14 +22,12 @@ esp_err_t ens160_init(void)
 
     // set ens160 opmode == 0x02 (standard gas sensing mode)
     uint8_t wdata[2] = {0x10, 0x02};
-    ok = i2c_master_write_to_device(I2C_MASTER_NUM, 
-        ENS160_DEV_ADDR, wdata, 2, I2C_MASTER_TIMEOUT
-    );
+    ok = i2c_bus_write(ENS160_DEV_ADDR, wdata, 2);
     
     return ok;
 }
 
-esp_err_t ens160_compensate(aht21_data_t *data)
+void ens160_encode_compensation(const aht21_data_t *data, uint8_t *wdata)
 {
     float temp = data->temperature + 273.15;
     uint16_t temperature_code = ((uint16_t) temp) * 64UL;
@@ -38,16 +35,19 @@ esp_err_t ens160_compensate(aht21_data_t *data)
     temp = data->humidity * 512.0;
     uint16_t humidity_code = (uint16_t) temp;
 
-    uint8_t wdata[5];
     wdata[0] = 0x13;
     wdata[1] = (uint8_t)temperature_code;
     wdata[2] = (uint8_t)(temperature_code >> 8);
     wdata[3] = (uint8_t)humidity_code;
     wdata[4] = (uint8_t)(humidity_code >> 8);
+}
+
+esp_err_t ens160_compensate(aht21_data_t *data)
+{
+    uint8_t wdata[5];
+    ens160_encode_compensation(data, wdata);
 
-    return i2c_master_write_to_device(I2C_MASTER_NUM, 
-        ENS160_DEV_ADDR, wdata, sizeof(wdata), I2C_MASTER_TIMEOUT
-    );
+    return i2c_bus_write(ENS160_DEV_ADDR, wdata, sizeof(wdata));
 }
 
 ens160_data_t ens160_read(void)
@@ -57,9 +57,7 @@ ens160_data_t ens160_read(void)
     uint8_t wdata = 0x20;
     uint8_t rdata[6] = {0};
     esp_err_t ok = ESP_OK;
-    ok = i2c_master_write_read_device(I2C_MASTER_NUM, ENS160_DEV_ADDR, 
-        &wdata, 1, rdata, sizeof(rdata), I2C_MASTER_TIMEOUT
-    );
+    ok = i2c_bus_write_read(ENS160_DEV_ADDR, &wdata, 1, rdata, sizeof(rdata));
     ESP_ERROR_CHECK(ok);
     readen.status = rdata[0];
     readen.aqi = rdata[1] & 0x07;
@@ -75,9 +73,7 @@ esp_err_t ens160_reset(void)
 
     { // set ens160 opmode == 0xf0 (reset state)
         uint8_t wdata[2] = {0x10, 0xf0};
-        ok = i2c_master_write_to_device(I2C_MASTER_NUM, ENS160_DEV_ADDR, 
-            wdata, 2, I2C_MASTER_TIMEOUT
-        );
+        ok = i2c_bus_write(ENS160_DEV_ADDR, wdata, 2);
         ESP_ERROR_CHECK(ok);
     }
 
@@ -85,13 +81,18 @@ esp_err_t ens160_reset(void)
 
     { // set ens160 opmode == 0x02 (standard gas sensing mode)
         uint8_t wdata[2] = {0x10, 0x02};
-        ok = i2c_master_write_to_device(I2C_MASTER_NUM, ENS160_DEV_ADDR, 
-            wdata, 2, I2C_MASTER_TIMEOUT
-        );
+        ok = i2c_bus_write(ENS160_DEV_ADDR, wdata, 2);
         ESP_ERROR_CHECK(ok);
     }
 
     vTaskDelay(pdMS_TO_TICKS(100));
 
     return ok;
+}
+
+esp_err_t ens160_sleep(void)
+{
+    // set ens160 opmode == 0x00 (deep sleep)
+    uint8_t wdata[2] = {0x10, 0x00};
+    return i2c_bus_write(ENS160_DEV_ADDR, wdata, 2);
 }
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "form_parser.h"
+
+#include <string.h>
+#include <strings.h>
+
+enum {
+    URL_NAME,
+    URL_VALUE,
+    URL_PCT_HI,
+    URL_PCT_LO,
+};
+
+enum {
+    MP_PREAMBLE,
+    MP_DELIM_TAIL,
+    MP_DELIM_END,
+    MP_DELIM_CRLF,
+    MP_HEADERS,
+    MP_VALUE,
+    MP_EPILOGUE,
+};
+
+static inline int hex_value(char c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static form_field_t *find_field(form_parser_t *p, const char *name, size_t len)
+{
+    for(size_t i = 0; i < p->field_count; i++)
+    {
+        if(strlen(p->fields[i].name) == len && memcmp(p->fields[i].name, name, len) == 0)
+            return &p->fields[i];
+    }
+    return NULL;
+}
+
+static inline void field_begin(form_parser_t *p, form_field_t *field)
+{
+    p->current = field;
+    if(field) {
+        field->found = true;
+        field->len = 0;
+        field->value[0] = '\0';
+    }
+}
+
+static inline bool field_put(form_parser_t *p, char c)
+{
+    form_field_t *f = p->current;
+
+    if(f == NULL)
+        return true;
+
+    if(f->len + 1 >= f->size) {
+        p->status = FORM_ERR_FIELD_TOO_LONG;
+        return false;
+    }
+
+    f->value[f->len++] = c;
+    f->value[f->len] = '\0';
+    return true;
+}
+
+static bool urlencoded_char(form_parser_t *p, char c)
+{
+    switch (p->state)
+    {
+    case URL_NAME:
+        if(c == '=') {
+            field_begin(p, p->name_overflow ? NULL : find_field(p, p->name, p->name_len));
+            p->state = URL_VALUE;
+        } else if(c == '&') {
+            p->name_len = 0;
+            p->name_overflow = false;
+        } else if(p->name_len < sizeof(p->name)) {
+            p->name[p->name_len++] = c;
+        } else {
+            p->name_overflow = true;
+        }
+        return true;
+
+    case URL_VALUE:
+        if(c == '&') {
+            p->current = NULL;
+            p->name_len = 0;
+            p->name_overflow = false;
+            p->state = URL_NAME;
+            return true;
+        }
+        if(c == '%') {
+            p->state = URL_PCT_HI;
+            return true;
+        }
+        return field_put(p, c == '+' ? ' ' : c);
+
+    case URL_PCT_HI:
+    case URL_PCT_LO: {
+        const int v = hex_value(c);
+        if(v < 0) {
+            p->status = FORM_ERR_SYNTAX;
+            return false;
+        }
+        if(p->state == URL_PCT_HI) {
+            p->pct_value = (uint8_t)(v << 4);
+            p->state = URL_PCT_LO;
+            return true;
+        }
+        p->state = URL_VALUE;
+        return field_put(p, (char)(p->pct_value | v));
+    }
+
+    default:
+        p->status = FORM_ERR_SYNTAX;
+        return false;
+    }
+}
+
+/**
+ * @brief Pick the field of a part from its Content-Disposition header
+*/
+static void multipart_header(form_parser_t *p)
+{
+    static const char disposition[] = "Content-Disposition:";
+
+    p->line[p->line_len] = '\0';
+
+    if(strncasecmp(p->line, disposition, sizeof(disposition) - 1) != 0)
+        return;
+
+    const char *name = strstr(p->line, " name=\"");
+    if(name == NULL)
+        name = strstr(p->line, ";name=\"");
+    if(name == NULL)
+        return;
+
+    name += 7;
+    const char *end = strchr(name, '"');
+    if(end == NULL)
+        return;
+
+    field_begin(p, find_field(p, name, end - name));
+}
+
+/**
+ * Delimiter is CRLF "--" boundary. It begins with the only CR in it,
+ * so after a mismatch the matching can simply restart at the current
+ * character.
+*/
+static bool multipart_char(form_parser_t *p, char c)
+{
+    switch (p->state)
+    {
+    case MP_PREAMBLE:
+    case MP_VALUE:
+        while(true)
+        {
+            if(c == p->delimiter[p->matched]) {
+                if(++p->matched == p->delimiter_len) {
+                    p->matched = 0;
+                    p->current = NULL;
+                    p->state = MP_DELIM_TAIL;
+                }
+                return true;
+            }
+
+            if(p->matched == 0)
+                return p->state == MP_PREAMBLE ? true : field_put(p, c);
+
+            // the partially matched bytes were data
+            if(p->state == MP_VALUE) {
+                for(size_t i = 0; i < p->matched; i++)
+                    if(!field_put(p, p->delimiter[i]))
+                        return false;
+            }
+            p->matched = 0;
+        }
+
+    case MP_DELIM_TAIL:
+        if(c == '-') {
+            p->state = MP_DELIM_END;
+        } else if(c == '\r') {
+            p->state = MP_DELIM_CRLF;
+        } else if(c != ' ' && c != '\t') {
+            p->status = FORM_ERR_SYNTAX;
+            return false;
+        }
+        return true;
+
+    case MP_DELIM_END:
+        if(c != '-') {
+            p->status = FORM_ERR_SYNTAX;
+            return false;
+        }
+        p->state = MP_EPILOGUE;
+        return true;
+
+    case MP_DELIM_CRLF:
+        if(c != '\n') {
+            p->status = FORM_ERR_SYNTAX;
+            return false;
+        }
+        p->line_len = 0;
+        p->state = MP_HEADERS;
+        return true;
+
+    case MP_HEADERS:
+        if(c == '\n') {
+            if(p->line_len > 0 && p->line[p->line_len - 1] == '\r')
+                p->line_len--;
+
+            if(p->line_len == 0) {
+                p->state = MP_VALUE;
+                return true;
+            }
+
+            multipart_header(p);
+            p->line_len = 0;
+        } else if(p->line_len < sizeof(p->line) - 1) {
+            // longer lines are cut, only the beginning matters
+            p->line[p->line_len++] = c;
+        }
+        return true;
+
+    case MP_EPILOGUE:
+        return true;
+
+    default:
+        p->status = FORM_ERR_SYNTAX;
+        return false;
+    }
+}
+
+form_status_t form_parser_init(form_parser_t *p, const char *content_type,
+    form_field_t *fields, size_t field_count)
+{
+    memset(p, 0, sizeof(*p));
+    p->fields = fields;
+    p->field_count = field_count;
+    p->type = FORM_URLENCODED;
+    p->state = URL_NAME;
+
+    for(size_t i = 0; i < field_count; i++)
+    {
+        fields[i].found = false;
+        fields[i].len = 0;
+        if(fields[i].size > 0)
+            fields[i].value[0] = '\0';
+    }
+
+    if(content_type == NULL || strncasecmp(content_type, "multipart/form-data", 19) != 0)
+        return FORM_OK;
+
+    const char *boundary = strstr(content_type, "boundary=");
+    if(boundary == NULL) {
+        p->status = FORM_ERR_SYNTAX;
+        return p->status;
+    }
+    boundary += 9;
+
+    size_t len;
+    if(*boundary == '"') {
+        boundary++;
+        const char *end = strchr(boundary, '"');
+        len = end ? (size_t)(end - boundary) : 0;
+    } else {
+        len = strcspn(boundary, "; \t");
+    }
+
+    if(len == 0 || len > FORM_MAX_BOUNDARY) {
+        p->status = FORM_ERR_SYNTAX;
+        return p->status;
+    }
+
+    memcpy(p->delimiter, "\r\n--", 4);
+    memcpy(p->delimiter + 4, boundary, len);
+    p->delimiter_len = len + 4;
+
+    // the first delimiter has no preceding CRLF
+    p->type = FORM_MULTIPART;
+    p->state = MP_PREAMBLE;
+    p->matched = 2;
+
+    return FORM_OK;
+}
+
+form_status_t form_parser_feed(form_parser_t *p, const char *data, size_t len)
+{
+    if(p->status != FORM_OK)
+        return p->status;
+
+    if(p->type == FORM_URLENCODED) {
+        for(size_t i = 0; i < len; i++)
+            if(!urlencoded_char(p, data[i]))
+                break;
+    } else {
+        for(size_t i = 0; i < len; i++)
+            if(!multipart_char(p, data[i]))
+                break;
+    }
+
+    return p->status;
+}
+
+form_status_t form_parser_finish(form_parser_t *p)
+{
+    if(p->status != FORM_OK)
+        return p->status;
+
+    if(p->type == FORM_URLENCODED) {
+        if(p->state == URL_PCT_HI || p->state == URL_PCT_LO)
+            p->status = FORM_ERR_SYNTAX;
+    } else if(p->state != MP_EPILOGUE) {
+        p->status = FORM_ERR_SYNTAX;
+    }
+
+    return p->status;
+}
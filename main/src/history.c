@@ -0,0 +1,96 @@
+#include "history.h"
+#include "comfort.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static history_record_t s_ring[HISTORY_CAPACITY];
+
+// sequence number of the next record to be written
+static uint32_t s_head = 0;
+static int64_t s_last_add_us = 0;
+
+static inline int32_t to_fixed(float value, float scale)
+{
+    value *= scale;
+    return (int32_t)(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+void history_pack(history_record_t *record, const sensors_data_t *data, int64_t time_us)
+{
+    *record = (history_record_t) {
+        .seq = 0,
+        .time_s = (uint32_t)(time_us / 1000000),
+        .temperature = (int16_t)to_fixed(data->bmp280.temperature, 100.0f),
+        .humidity = (uint16_t)to_fixed(data->aht21.humidity, 100.0f),
+        .pressure = (uint16_t)to_fixed(data->bmp280.pressure, 10.0f),
+        .tvoc = data->ens160.tvoc,
+        .eco2 = data->ens160.eco2,
+        .aqi = data->ens160.aqi,
+        .reserved = 0
+    };
+}
+
+void history_add(const sensors_data_t *data)
+{
+    const int64_t now = esp_timer_get_time();
+
+    if(s_head != 0 && now - s_last_add_us < HISTORY_PERIOD_S * 1000000LL)
+        return;
+
+    s_last_add_us = now;
+
+    history_record_t record;
+    history_pack(&record, data, now);
+
+    taskENTER_CRITICAL(&s_lock);
+    record.seq = s_head;
+    s_ring[s_head % HISTORY_CAPACITY] = record;
+    s_head++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void history_iter_init(history_iter_t *it, uint32_t from_seq)
+{
+    taskENTER_CRITICAL(&s_lock);
+    const uint32_t oldest = s_head > HISTORY_CAPACITY ? s_head - HISTORY_CAPACITY : 0;
+    it->next = from_seq > oldest ? from_seq : oldest;
+    it->end = s_head;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+bool history_iter_next(history_iter_t *it, history_record_t *record)
+{
+    bool ok = false;
+
+    taskENTER_CRITICAL(&s_lock);
+
+    // skip records overwritten while the reader was slow
+    const uint32_t oldest = s_head > HISTORY_CAPACITY ? s_head - HISTORY_CAPACITY : 0;
+    if(it->next < oldest)
+        it->next = oldest;
+
+    if(it->next < it->end) {
+        *record = s_ring[it->next % HISTORY_CAPACITY];
+        it->next++;
+        ok = true;
+    }
+
+    taskEXIT_CRITICAL(&s_lock);
+
+    return ok;
+}
+
+void history_comfort(const history_record_t *record, comfort_data_t *comfort)
+{
+    sensors_data_t data = {
+        .aht21.humidity = record->humidity / 100.0f,
+        .bmp280.temperature = record->temperature / 100.0f,
+        .bmp280.pressure = record->pressure / 10.0f,
+    };
+
+    comfort_compute(&data);
+    *comfort = data.comfort;
+}
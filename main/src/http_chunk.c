@@ -0,0 +1,84 @@
+#include "http_chunk.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static void flush(http_chunk_writer_t *w)
+{
+    if(w->len == 0 || w->err != ESP_OK)
+        return;
+
+    w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+    w->total += w->len;
+    w->len = 0;
+}
+
+void http_chunk_init(http_chunk_writer_t *w, httpd_req_t *req, char *buf, size_t size)
+{
+    w->req = req;
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->total = 0;
+    w->err = ESP_OK;
+}
+
+void http_chunk_write(http_chunk_writer_t *w, const void *data, size_t len)
+{
+    const char *src = (const char *) data;
+
+    while(len > 0 && w->err == ESP_OK)
+    {
+        if(w->len == w->size)
+            flush(w);
+
+        const size_t n = len < w->size - w->len ? len : w->size - w->len;
+        memcpy(w->buf + w->len, src, n);
+        w->len += n;
+        src += n;
+        len -= n;
+    }
+}
+
+void http_chunk_printf(http_chunk_writer_t *w, const char *fmt, ...)
+{
+    va_list args;
+
+    if(w->err != ESP_OK)
+        return;
+
+    va_start(args, fmt);
+    int n = vsnprintf(w->buf + w->len, w->size - w->len, fmt, args);
+    va_end(args);
+
+    if(n < 0)
+        return;
+
+    if((size_t)n < w->size - w->len) {
+        w->len += n;
+        return;
+    }
+
+    // did not fit: flush and format again into the empty buffer
+    flush(w);
+
+    va_start(args, fmt);
+    n = vsnprintf(w->buf, w->size, fmt, args);
+    va_end(args);
+
+    if(n < 0)
+        return;
+
+    w->len = (size_t)n < w->size ? (size_t)n : w->size - 1;
+}
+
+esp_err_t http_chunk_finish(http_chunk_writer_t *w)
+{
+    flush(w);
+
+    if(w->err == ESP_OK)
+        w->err = httpd_resp_send_chunk(w->req, NULL, 0);
+
+    return w->err;
+}
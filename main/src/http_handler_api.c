@@ -0,0 +1,187 @@
+#include "main.h"
+#include "readings.h"
+#include "stream.h"
+#include "metrics.h"
+#include "ota.h"
+#include "json_writer.h"
+#include "web.h"
+
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_random.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#define API_JSON_BUF_SIZE 512
+#define API_ETAG_SIZE     24
+
+/**
+ * @brief ETag of the sample: boot id + sample sequence number.
+ * The boot id keeps tags from a previous power cycle from matching.
+*/
+static void make_etag(char *etag, uint32_t seq)
+{
+    static uint32_t boot_id = 0;
+    while(boot_id == 0)
+        boot_id = esp_random();
+
+    static const char hex[] = "0123456789abcdef";
+    char *p = etag;
+    *p++ = '"';
+    for(int shift = 28; shift >= 0; shift -= 4)
+        *p++ = hex[(boot_id >> shift) & 0x0f];
+    *p++ = '-';
+    for(int shift = 28; shift >= 0; shift -= 4)
+        *p++ = hex[(seq >> shift) & 0x0f];
+    *p++ = '"';
+    *p = '\0';
+}
+
+static bool etag_matches(httpd_req_t *req, const char *etag)
+{
+    char value[API_ETAG_SIZE + 8];
+
+    if(httpd_req_get_hdr_value_len(req, "If-None-Match") >= sizeof(value))
+        return false;
+
+    if(httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) != ESP_OK)
+        return false;
+
+    return strstr(value, etag) != NULL || strcmp(value, "*") == 0;
+}
+
+static esp_err_t send_json(httpd_req_t *req, json_writer_t *w)
+{
+    const int len = json_writer_finish(w);
+    if(len < 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, w->buf, len);
+}
+
+esp_err_t api_current_get_handler(httpd_req_t *req)
+{
+    sensors_data_t data;
+    int64_t timestamp_us;
+    char etag[API_ETAG_SIZE];
+    char buf[API_JSON_BUF_SIZE];
+
+    const uint32_t seq = readings_get_latest(&data, &timestamp_us);
+    if(seq == 0) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_set_type(req, "application/json");
+        return httpd_resp_sendstr(req, "{\"error\":\"no data yet\"}");
+    }
+
+    make_etag(etag, seq);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    if(etag_matches(req, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+    api_serialize_sample(&w, seq, &data, timestamp_us);
+
+    return send_json(req, &w);
+}
+
+esp_err_t api_status_get_handler(httpd_req_t *req)
+{
+    char buf[API_JSON_BUF_SIZE];
+    wifi_ap_record_t ap_info;
+
+    const uint32_t seq = readings_get_latest(NULL, NULL);
+
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+
+    json_object_begin(&w, NULL);
+    json_add_uint(&w, "uptime_ms", esp_timer_get_time() / 1000);
+    json_add_uint(&w, "seq", seq);
+    json_add_uint(&w, "first_sample_ms", METRICS_GET(g_metrics.first_sample_us) / 1000);
+
+    json_object_begin(&w, "heap");
+    json_add_uint(&w, "free", esp_get_free_heap_size());
+    json_add_uint(&w, "min_free", esp_get_minimum_free_heap_size());
+    json_object_end(&w);
+
+    json_object_begin(&w, "wifi");
+    if(esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        json_add_bool(&w, "connected", true);
+        json_add_int(&w, "rssi", ap_info.rssi);
+    } else {
+        json_add_bool(&w, "connected", false);
+    }
+    json_add_uint(&w, "reconnects", METRICS_GET(g_metrics.wifi_reconnects));
+    json_add_uint(&w, "downtime_ms", METRICS_GET(g_metrics.wifi_downtime_ms));
+    json_add_uint(&w, "ap_fallbacks", METRICS_GET(g_metrics.wifi_ap_fallbacks));
+    json_object_end(&w);
+
+    stream_stats_t stream;
+    stream_get_stats(&stream);
+
+    json_object_begin(&w, "stream");
+    json_add_uint(&w, "clients", stream.clients);
+    json_add_uint(&w, "evicted", stream.evicted);
+    json_add_uint(&w, "broadcasts", stream.broadcasts);
+    json_add_uint(&w, "last_cost_us", stream.last_cost_us);
+    json_add_uint(&w, "max_cost_us", stream.max_cost_us);
+    json_object_end(&w);
+
+    json_object_end(&w);
+
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return send_json(req, &w);
+}
+
+esp_err_t api_ota_get_handler(httpd_req_t *req)
+{
+    static const char *state_names[] = {
+        [OTA_STATE_IDLE]       = "idle",
+        [OTA_STATE_RECEIVING]  = "receiving",
+        [OTA_STATE_VALIDATING] = "validating",
+        [OTA_STATE_DONE]       = "done",
+        [OTA_STATE_FAILED]     = "failed",
+    };
+    char buf[API_JSON_BUF_SIZE];
+    ota_progress_t progress;
+
+    ota_get_progress(&progress);
+
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+
+    json_object_begin(&w, NULL);
+    json_add_string(&w, "state", progress.state <= OTA_STATE_FAILED ? state_names[progress.state] : "unknown");
+    json_add_uint(&w, "bytes", progress.bytes);
+    json_add_uint(&w, "total", progress.total);
+    json_add_uint(&w, "bytes_per_s", progress.bytes_per_s);
+    json_add_uint(&w, "elapsed_s", progress.elapsed_s);
+    json_add_int(&w, "eta_s", progress.eta_s);
+
+    // measurement period jitter since the update started
+    const metrics_jitter_t *jitter = &g_metrics.sample_jitter;
+    const uint32_t samples = METRICS_GET(jitter->window_samples);
+
+    json_object_begin(&w, "sample_jitter");
+    json_add_uint(&w, "samples", samples);
+    json_add_uint(&w, "mean_us", samples ? METRICS_GET(jitter->window_jitter_sum_us) / samples : 0);
+    json_add_uint(&w, "max_us", METRICS_GET(jitter->window_jitter_max_us));
+    json_object_end(&w);
+
+    json_object_end(&w);
+
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return send_json(req, &w);
+}
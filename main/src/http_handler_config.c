@@ -0,0 +1,162 @@
+#include "main.h"
+#include "app_config.h"
+#include "form_parser.h"
+#include "json_writer.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+#define CONFIG_JSON_BUF_SIZE    384
+#define CONFIG_MAX_BODY         512
+#define CONFIG_VALUE_SIZE       16
+
+#define MAX_TIMEOUTS            5
+
+typedef enum {
+    FIELD_FLOAT,
+    FIELD_UINT
+} field_type_t;
+
+typedef struct {
+    const char *name;
+    field_type_t type;
+    size_t offset;
+    uint8_t decimals;
+} config_field_t;
+
+static const char *TAG = "CONFIG";
+
+static const config_field_t s_fields[] = {
+    { "aht21_temperature_offset",  FIELD_FLOAT, offsetof(app_config_t, aht21_temperature_offset), 2 },
+    { "aht21_humidity_gain",       FIELD_FLOAT, offsetof(app_config_t, aht21_humidity_gain), 3 },
+    { "bmp280_temperature_offset", FIELD_FLOAT, offsetof(app_config_t, bmp280_temperature_offset), 2 },
+    { "bmp280_pressure_gain",      FIELD_FLOAT, offsetof(app_config_t, bmp280_pressure_gain), 3 },
+    { "measurement_interval_ms",   FIELD_UINT,  offsetof(app_config_t, measurement_interval_ms), 0 },
+    { "alarm_aqi",                 FIELD_UINT,  offsetof(app_config_t, alarm_aqi), 0 },
+    { "alarm_eco2_ppm",            FIELD_UINT,  offsetof(app_config_t, alarm_eco2_ppm), 0 },
+    { "alarm_duration_ms",         FIELD_UINT,  offsetof(app_config_t, alarm_duration_ms), 0 },
+};
+
+#define FIELD_COUNT (sizeof(s_fields) / sizeof(s_fields[0]))
+
+static esp_err_t send_config(httpd_req_t *req, const app_config_t *config)
+{
+    char buf[CONFIG_JSON_BUF_SIZE];
+    json_writer_t w;
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_object_begin(&w, NULL);
+    json_add_uint(&w, "version", APP_CONFIG_VERSION);
+    for(size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        const void *value = (const uint8_t *)config + s_fields[i].offset;
+        if(s_fields[i].type == FIELD_FLOAT)
+            json_add_float(&w, s_fields[i].name, *(const float *)value, s_fields[i].decimals);
+        else
+            json_add_uint(&w, s_fields[i].name, *(const uint32_t *)value);
+    }
+    json_object_end(&w);
+
+    const int len = json_writer_finish(&w);
+    if(len < 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, buf, len);
+}
+
+esp_err_t api_config_get_handler(httpd_req_t *req)
+{
+    const app_config_t config = *app_config_get();
+    return send_config(req, &config);
+}
+
+/**
+ * @brief POST /api/v1/config, urlencoded. Only the given fields change,
+ * the update is applied at once and survives reboots.
+*/
+esp_err_t api_config_post_handler(httpd_req_t *req)
+{
+    char body[CONFIG_MAX_BODY];
+    char values[FIELD_COUNT][CONFIG_VALUE_SIZE];
+    form_field_t fields[FIELD_COUNT];
+    int received = 0;
+    int timeouts = 0;
+
+    if(req->content_len <= 0 || req->content_len >= sizeof(body)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad request size");
+        return ESP_FAIL;
+    }
+
+    while(received < req->content_len) {
+        int ret = httpd_req_recv(req, body + received, req->content_len - received);
+        if(ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            // a stalled client must not hold the server task
+            if(++timeouts > MAX_TIMEOUTS) {
+                httpd_resp_send_408(req);
+                return ESP_FAIL;
+            }
+            continue;
+        }
+        if(ret <= 0)
+            return ESP_FAIL;
+        received += ret;
+    }
+
+    for(size_t i = 0; i < FIELD_COUNT; i++)
+        fields[i] = (form_field_t) { .name = s_fields[i].name, .value = values[i], .size = CONFIG_VALUE_SIZE };
+
+    form_parser_t parser;
+    form_status_t status = form_parser_init(&parser, NULL, fields, FIELD_COUNT);
+    if(status == FORM_OK)
+        status = form_parser_feed(&parser, body, received);
+    if(status == FORM_OK)
+        status = form_parser_finish(&parser);
+
+    if(status != FORM_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed form");
+        return ESP_FAIL;
+    }
+
+    app_config_t config = *app_config_get();
+
+    for(size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        if(!fields[i].found)
+            continue;
+
+        char *end;
+        void *value = (uint8_t *)&config + s_fields[i].offset;
+
+        if(s_fields[i].type == FIELD_FLOAT)
+            *(float *)value = strtof(values[i], &end);
+        else
+            *(uint32_t *)value = strtoul(values[i], &end, 10);
+
+        if(end == values[i] || *end != '\0') {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, s_fields[i].name);
+            return ESP_FAIL;
+        }
+    }
+
+    esp_err_t err = app_config_set(&config);
+    if(err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Value out of range");
+        return ESP_FAIL;
+    }
+    if(err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "settings updated");
+    return send_config(req, &config);
+}
@@ -0,0 +1,168 @@
+#include "history.h"
+#include "http_chunk.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#define HISTORY_CHUNK_SIZE  512
+#define HISTORY_QUERY_SIZE  128
+
+static const char* TAG = "HISTORY";
+
+typedef enum {
+    HISTORY_FORMAT_CSV,
+    HISTORY_FORMAT_BIN
+} history_format_t;
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    uint32_t res;
+    uint32_t cursor;
+    history_format_t format;
+} history_query_t;
+
+static uint32_t query_uint(const char *query, const char *key, uint32_t def)
+{
+    char value[16];
+
+    if(httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK)
+        return def;
+
+    char *end;
+    unsigned long parsed = strtoul(value, &end, 10);
+    if(end == value || *end != '\0')
+        return def;
+
+    return (uint32_t) parsed;
+}
+
+static void parse_query(httpd_req_t *req, history_query_t *q)
+{
+    char query[HISTORY_QUERY_SIZE] = {0};
+    char format[8];
+
+    q->from = 0;
+    q->to = UINT32_MAX;
+    q->res = 0;
+    q->cursor = 0;
+    q->format = HISTORY_FORMAT_CSV;
+
+    if(httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK)
+        return;
+
+    q->from = query_uint(query, "from", q->from);
+    q->to = query_uint(query, "to", q->to);
+    q->res = query_uint(query, "res", q->res);
+    q->cursor = query_uint(query, "cursor", q->cursor);
+
+    if(httpd_query_key_value(query, "format", format, sizeof(format)) == ESP_OK
+        && strcmp(format, "bin") == 0)
+        q->format = HISTORY_FORMAT_BIN;
+}
+
+static void write_csv_record(http_chunk_writer_t *w, const history_record_t *r)
+{
+    const int t = r->temperature;
+    const unsigned t_abs = t < 0 ? -t : t;
+    comfort_data_t c;
+
+    history_comfort(r, &c);
+
+    http_chunk_printf(w, "%u,%u,%s%u.%02u,%u.%02u,%u.%u,%u,%u,%u,%.2f,%.2f,%.2f,%.1f\n",
+        (unsigned)r->seq, (unsigned)r->time_s,
+        t < 0 ? "-" : "", t_abs / 100, t_abs % 100,
+        r->humidity / 100, r->humidity % 100,
+        r->pressure / 10, r->pressure % 10,
+        r->aqi, r->tvoc, r->eco2,
+        c.dew_point, c.absolute_humidity, c.heat_index, c.altitude
+    );
+}
+
+/**
+ * GET /api/v1/history?from=&to=&res=&cursor=&format=csv|bin
+ *
+ * from, to  : time window, seconds since boot
+ * res       : minimal distance between returned records, seconds
+ * cursor    : first record sequence number; the response header
+ *             X-History-Next holds the cursor of the next download,
+ *             an interrupted download is resumed with the last
+ *             received seq + 1
+ * format    : csv (default) or bin, packed history_record_t records
+*/
+esp_err_t api_history_get_handler(httpd_req_t *req)
+{
+    char buf[HISTORY_CHUNK_SIZE];
+    char next_cursor[12];
+    history_query_t q;
+    history_iter_t it;
+    history_record_t record;
+
+    parse_query(req, &q);
+
+    history_iter_init(&it, q.cursor);
+    snprintf(next_cursor, sizeof(next_cursor), "%u", (unsigned)it.end);
+    httpd_resp_set_hdr(req, "X-History-Next", next_cursor);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    http_chunk_writer_t w;
+    http_chunk_init(&w, req, buf, sizeof(buf));
+
+    if(q.format == HISTORY_FORMAT_BIN) {
+        httpd_resp_set_type(req, "application/octet-stream");
+    } else {
+        httpd_resp_set_type(req, "text/csv");
+        http_chunk_printf(&w, "seq,time_s,temperature,humidity,pressure,aqi,tvoc,eco2,"
+            "dew_point,absolute_humidity,heat_index,altitude\n");
+    }
+
+    const int64_t start_us = esp_timer_get_time();
+    // the allocator keeps the low-water mark, a drop across the export is a new minimum
+    const uint32_t min_heap_before = esp_get_minimum_free_heap_size();
+    uint32_t count = 0;
+    bool emitted = false;
+    uint32_t last_time = 0;
+
+    while(w.err == ESP_OK && history_iter_next(&it, &record))
+    {
+        if(record.time_s < q.from || record.time_s > q.to)
+            continue;
+
+        if(emitted && record.time_s - last_time < q.res)
+            continue;
+
+        emitted = true;
+        last_time = record.time_s;
+
+        if(q.format == HISTORY_FORMAT_BIN)
+            http_chunk_write(&w, &record, sizeof(record));
+        else
+            write_csv_record(&w, &record);
+
+        count++;
+    }
+
+    const esp_err_t err = http_chunk_finish(&w);
+    const int64_t elapsed_us = esp_timer_get_time() - start_us;
+    const uint32_t min_heap_after = esp_get_minimum_free_heap_size();
+
+    if(err != ESP_OK) {
+        ESP_LOGW(TAG, "export aborted after %u bytes: %s", 
+            (unsigned)w.total, esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "exported %u records, %u bytes in %d ms (%u KB/s), minimum free heap %u before, %u after",
+        (unsigned)count, (unsigned)w.total, (int)(elapsed_us / 1000),
+        elapsed_us > 0 ? (unsigned)((uint64_t)w.total * 1000000 / 1024 / elapsed_us) : 0,
+        (unsigned)min_heap_before, (unsigned)min_heap_after
+    );
+
+    return ESP_OK;
+}
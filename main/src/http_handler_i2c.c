@@ -0,0 +1,150 @@
+#include "i2c_rec.h"
+#include "http_chunk.h"
+#include "json_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#define I2C_CHUNK_SIZE      512
+#define I2C_QUERY_SIZE      32
+#define I2C_REPLAY_JSON     192
+
+#define MAX_TIMEOUTS        5
+
+// a full recording with some slack for comments
+#define I2C_REPLAY_MAX_BODY ((I2C_REC_HEAD + I2C_REC_ENTRIES + 8) * I2C_REC_LINE_SIZE)
+
+static bool query_flag(httpd_req_t *req, const char *key)
+{
+    char query[I2C_QUERY_SIZE];
+    char value[4];
+
+    return httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+        && httpd_query_key_value(query, key, value, sizeof(value)) == ESP_OK
+        && value[0] == '1';
+}
+
+/**
+ * @brief GET /api/v1/i2c/recording, the recorded transactions as text,
+ * see i2c_rec.h. `?print=1` also prints them to the UART, `?clear=1`
+ * forgets them once sent.
+*/
+esp_err_t api_i2c_recording_get_handler(httpd_req_t *req)
+{
+    char buf[I2C_CHUNK_SIZE];
+    char line[I2C_REC_LINE_SIZE];
+    http_chunk_writer_t w;
+    i2c_rec_entry_t entry;
+    uint32_t seq = 0;
+
+    if(query_flag(req, "print"))
+        i2c_rec_dump(stdout);
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    http_chunk_init(&w, req, buf, sizeof(buf));
+    http_chunk_printf(&w, "# recorder %s, %u transactions since boot\n",
+        I2C_REC_ENABLE == 1 ? "on" : "off", (unsigned)i2c_rec_count());
+    http_chunk_printf(&w, "# seq time_us addr op err duration_us wlen rlen write read\n");
+
+    while(i2c_rec_next(&seq, &entry))
+    {
+        const int len = i2c_rec_format(&entry, line, sizeof(line));
+        http_chunk_write(&w, line, len);
+    }
+
+    esp_err_t err = http_chunk_finish(&w);
+    if(err == ESP_OK && query_flag(req, "clear"))
+        i2c_rec_clear();
+    return err;
+}
+
+static esp_err_t send_replay_stats(httpd_req_t *req)
+{
+    char buf[I2C_REPLAY_JSON];
+    i2c_replay_stats_t stats;
+    json_writer_t w;
+
+    i2c_replay_get_stats(&stats);
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_object_begin(&w, NULL);
+    json_add_bool(&w, "active", stats.active);
+    json_add_uint(&w, "entries", stats.entries);
+    json_add_uint(&w, "served", stats.served);
+    json_add_uint(&w, "skipped", stats.skipped);
+    json_add_uint(&w, "diverged", stats.diverged);
+    json_object_end(&w);
+
+    const int len = json_writer_finish(&w);
+    if(len < 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, buf, len);
+}
+
+/**
+ * @brief POST /api/v1/i2c/replay, a recording as given by
+ * /api/v1/i2c/recording replaces the sensors until it is over.
+ * An empty body stops the replay. Answers with the replay counters.
+*/
+esp_err_t api_i2c_replay_post_handler(httpd_req_t *req)
+{
+    int received = 0;
+    int timeouts = 0;
+
+    if(req->content_len == 0) {
+        i2c_replay_stop();
+        return send_replay_stats(req);
+    }
+
+    if(req->content_len > I2C_REPLAY_MAX_BODY) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad request size");
+        return ESP_FAIL;
+    }
+
+    char *body = malloc(req->content_len);
+    if(body == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    while(received < req->content_len) {
+        int ret = httpd_req_recv(req, body + received, req->content_len - received);
+        if(ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            // a stalled client must not hold the server task
+            if(++timeouts > MAX_TIMEOUTS) {
+                free(body);
+                httpd_resp_send_408(req);
+                return ESP_FAIL;
+            }
+            continue;
+        }
+        if(ret <= 0) {
+            free(body);
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+
+    esp_err_t err = i2c_replay_load(body, received);
+    free(body);
+
+    if(err == ESP_ERR_NO_MEM) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    if(err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed recording");
+        return ESP_FAIL;
+    }
+
+    return send_replay_stats(req);
+}
@@ -0,0 +1,66 @@
+#include "log_ring.h"
+#include "http_chunk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#define LOGS_CHUNK_SIZE     512
+#define LOGS_QUERY_SIZE     64
+
+/**
+ * @brief GET /api/v1/logs, the log lines kept in the ring as text.
+ * `?since=N` starts at line N, the header gives the next one to ask for.
+ * `?tag=WIFI&level=debug` sets the level of a tag ("*" for all) first.
+*/
+esp_err_t api_logs_get_handler(httpd_req_t *req)
+{
+    char buf[LOGS_CHUNK_SIZE];
+    char line[LOG_RING_LINE_SIZE];
+    char query[LOGS_QUERY_SIZE];
+    char value[LOG_RING_TAG_SIZE];
+    char tag[LOG_RING_TAG_SIZE];
+    http_chunk_writer_t w;
+    log_ring_stats_t stats;
+    esp_log_level_t level;
+    uint32_t seq = 0;
+
+    if(httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK)
+    {
+        if(httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK)
+            seq = (uint32_t)strtoul(value, NULL, 10);
+
+        if(httpd_query_key_value(query, "tag", tag, sizeof(tag)) == ESP_OK) {
+            if(httpd_query_key_value(query, "level", value, sizeof(value)) != ESP_OK
+                || log_ring_parse_level(value, &level) != ESP_OK) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad level");
+                return ESP_FAIL;
+            }
+            if(log_ring_set_level(tag, level) != ESP_OK) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Too many tags");
+                return ESP_FAIL;
+            }
+        }
+    }
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    http_chunk_init(&w, req, buf, sizeof(buf));
+
+    log_ring_get_stats(&stats);
+    http_chunk_printf(&w, "# ring %s, %u lines, %u dropped, %u truncated\n",
+        LOG_RING_ENABLE == 1 ? "on" : "off",
+        (unsigned)stats.lines, (unsigned)stats.dropped, (unsigned)stats.truncated);
+    for(uint32_t i = 0; log_ring_get_level(i, tag, sizeof(tag), &level); i++)
+        http_chunk_printf(&w, "# level %s %s\n", tag, log_ring_level_name(level));
+
+    uint32_t len;
+    while((len = log_ring_next(&seq, line, sizeof(line))) > 0)
+        http_chunk_write(&w, line, len);
+
+    http_chunk_printf(&w, "# next %u\n", (unsigned)seq);
+    return http_chunk_finish(&w);
+}
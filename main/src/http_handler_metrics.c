@@ -0,0 +1,264 @@
+#include "main.h"
+#include "metrics.h"
+#include "readings.h"
+#include "stream.h"
+#include "mqtt_pub.h"
+#include "udp_export.h"
+#include "log_ring.h"
+#include "http_chunk.h"
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#define METRICS_CHUNK_SIZE 512
+
+static const char *i2c_device_names[METRICS_I2C_COUNT] = {
+    [METRICS_I2C_AHT21]   = "aht21",
+    [METRICS_I2C_BMP280]  = "bmp280",
+    [METRICS_I2C_ENS160]  = "ens160",
+    [METRICS_I2C_SSD1306] = "ssd1306",
+    [METRICS_I2C_OTHER]   = "other",
+};
+
+static const char *queue_names[METRICS_QUEUE_COUNT] = {
+    [METRICS_QUEUE_SENSORS] = "sensors",
+    [METRICS_QUEUE_DISPLAY] = "display",
+    [METRICS_QUEUE_LOGGING] = "logging",
+    [METRICS_QUEUE_BUZZER]  = "buzzer",
+};
+
+static void write_header(http_chunk_writer_t *w, 
+    const char *name, const char *type, const char *help)
+{
+    http_chunk_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void write_readings(http_chunk_writer_t *w)
+{
+    sensors_data_t data;
+    int64_t timestamp_us;
+
+    const uint32_t seq = readings_get_latest(&data, &timestamp_us);
+
+    write_header(w, "aqa_samples_total", "counter", "Samples produced since boot");
+    http_chunk_printf(w, "aqa_samples_total %u\n", (unsigned)seq);
+
+    if(seq == 0)
+        return;
+
+    write_header(w, "aqa_temperature_celsius", "gauge", "Air temperature");
+    http_chunk_printf(w, "aqa_temperature_celsius{sensor=\"aht21\"} %.2f\n", data.aht21.temperature);
+    http_chunk_printf(w, "aqa_temperature_celsius{sensor=\"bmp280\"} %.2f\n", data.bmp280.temperature);
+
+    write_header(w, "aqa_humidity_percent", "gauge", "Relative humidity");
+    http_chunk_printf(w, "aqa_humidity_percent %.2f\n", data.aht21.humidity);
+
+    write_header(w, "aqa_pressure_mmhg", "gauge", "Atmospheric pressure");
+    http_chunk_printf(w, "aqa_pressure_mmhg %.1f\n", data.bmp280.pressure);
+
+    write_header(w, "aqa_dew_point_celsius", "gauge", "Dew point");
+    http_chunk_printf(w, "aqa_dew_point_celsius %.2f\n", data.comfort.dew_point);
+
+    write_header(w, "aqa_absolute_humidity_grams_per_cubic_meter", "gauge", "Water vapour per volume of air");
+    http_chunk_printf(w, "aqa_absolute_humidity_grams_per_cubic_meter %.2f\n", data.comfort.absolute_humidity);
+
+    write_header(w, "aqa_heat_index_celsius", "gauge", "NOAA heat index");
+    http_chunk_printf(w, "aqa_heat_index_celsius %.2f\n", data.comfort.heat_index);
+
+    write_header(w, "aqa_pressure_altitude_meters", "gauge", "ISA pressure altitude");
+    http_chunk_printf(w, "aqa_pressure_altitude_meters %.1f\n", data.comfort.altitude);
+
+    write_header(w, "aqa_aqi", "gauge", "UBA air quality index");
+    http_chunk_printf(w, "aqa_aqi %u\n", data.ens160.aqi);
+
+    write_header(w, "aqa_tvoc_ppb", "gauge", "Total volatile organic compounds");
+    http_chunk_printf(w, "aqa_tvoc_ppb %u\n", data.ens160.tvoc);
+
+    write_header(w, "aqa_eco2_ppm", "gauge", "Equivalent CO2");
+    http_chunk_printf(w, "aqa_eco2_ppm %u\n", data.ens160.eco2);
+
+    const metrics_jitter_t *jitter = &g_metrics.sample_jitter;
+
+    write_header(w, "aqa_sample_jitter_us", "summary", 
+        "Deviation of the measurement period from the nominal one, microseconds");
+    http_chunk_printf(w, "aqa_sample_jitter_us_sum %u\naqa_sample_jitter_us_count %u\n",
+        (unsigned)METRICS_GET(jitter->jitter_sum_us), (unsigned)METRICS_GET(jitter->samples));
+
+    write_header(w, "aqa_sample_jitter_max_us", "gauge", "Largest measurement period deviation since boot");
+    http_chunk_printf(w, "aqa_sample_jitter_max_us %u\n", (unsigned)METRICS_GET(jitter->jitter_max_us));
+
+    write_header(w, "aqa_sample_age_seconds", "gauge", "Age of the latest sample");
+    http_chunk_printf(w, "aqa_sample_age_seconds %.3f\n", 
+        (esp_timer_get_time() - timestamp_us) / 1e6);
+}
+
+static void write_system(http_chunk_writer_t *w)
+{
+    TaskHandle_t tasks[METRICS_MAX_TASKS];
+    wifi_ap_record_t ap_info;
+
+    write_header(w, "aqa_uptime_seconds", "counter", "Time since boot");
+    http_chunk_printf(w, "aqa_uptime_seconds %.3f\n", esp_timer_get_time() / 1e6);
+
+    write_header(w, "aqa_boot_to_first_sample_seconds", "gauge", "Time from boot to the first sample");
+    http_chunk_printf(w, "aqa_boot_to_first_sample_seconds %.3f\n", 
+        METRICS_GET(g_metrics.first_sample_us) / 1e6);
+
+    write_header(w, "aqa_boot_to_ip_seconds", "gauge", "Time from boot to the first IP address");
+    http_chunk_printf(w, "aqa_boot_to_ip_seconds %.3f\n", 
+        METRICS_GET(g_metrics.first_ip_us) / 1e6);
+
+    write_header(w, "aqa_heap_free_bytes", "gauge", "Free heap");
+    http_chunk_printf(w, "aqa_heap_free_bytes %u\n", (unsigned)esp_get_free_heap_size());
+
+    write_header(w, "aqa_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+    http_chunk_printf(w, "aqa_heap_min_free_bytes %u\n", (unsigned)esp_get_minimum_free_heap_size());
+
+    write_header(w, "aqa_task_stack_free_bytes", "gauge", "Task stack high-water mark");
+    const uint32_t task_count = metrics_get_tasks(tasks, METRICS_MAX_TASKS);
+    for(uint32_t i = 0; i < task_count; i++)
+    {
+        http_chunk_printf(w, "aqa_task_stack_free_bytes{task=\"%s\"} %u\n",
+            pcTaskGetName(tasks[i]), (unsigned)uxTaskGetStackHighWaterMark(tasks[i]));
+    }
+
+    write_header(w, "aqa_queue_overruns_total", "counter", "Samples dropped because a queue was full");
+    for(int i = 0; i < METRICS_QUEUE_COUNT; i++)
+    {
+        http_chunk_printf(w, "aqa_queue_overruns_total{queue=\"%s\"} %u\n",
+            queue_names[i], (unsigned)METRICS_GET(g_metrics.queue_overruns[i]));
+    }
+
+    write_header(w, "aqa_wifi_reconnects_total", "counter", "Wi-Fi station reconnection attempts");
+    http_chunk_printf(w, "aqa_wifi_reconnects_total %u\n", 
+        (unsigned)METRICS_GET(g_metrics.wifi_reconnects));
+
+    write_header(w, "aqa_wifi_connected", "gauge", "1 if the station has an IP address");
+    http_chunk_printf(w, "aqa_wifi_connected %u\n", 
+        (unsigned)METRICS_GET(g_metrics.wifi_connected));
+
+    write_header(w, "aqa_wifi_downtime_seconds_total", "counter", "Time the station spent without connection");
+    http_chunk_printf(w, "aqa_wifi_downtime_seconds_total %.3f\n", 
+        METRICS_GET(g_metrics.wifi_downtime_ms) / 1e3);
+
+    write_header(w, "aqa_wifi_ap_fallbacks_total", "counter", "Times the fallback AP was started");
+    http_chunk_printf(w, "aqa_wifi_ap_fallbacks_total %u\n", 
+        (unsigned)METRICS_GET(g_metrics.wifi_ap_fallbacks));
+
+    if(esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        write_header(w, "aqa_wifi_rssi_dbm", "gauge", "Signal strength of the access point");
+        http_chunk_printf(w, "aqa_wifi_rssi_dbm %d\n", ap_info.rssi);
+    }
+
+    write_header(w, "aqa_ota_state", "gauge", 
+        "Firmware update state: 0 idle, 1 receiving, 2 validating, 3 done, 4 failed");
+    http_chunk_printf(w, "aqa_ota_state %u\n", (unsigned)METRICS_GET(g_metrics.ota_state));
+
+    write_header(w, "aqa_ota_bytes", "gauge", "Bytes of the firmware image written");
+    http_chunk_printf(w, "aqa_ota_bytes %u\n", (unsigned)METRICS_GET(g_metrics.ota_bytes));
+
+    mqtt_pub_stats_t mqtt;
+    mqtt_pub_get_stats(&mqtt);
+
+    write_header(w, "aqa_mqtt_connected", "gauge", "1 if connected to the MQTT broker");
+    http_chunk_printf(w, "aqa_mqtt_connected %u\n", (unsigned)mqtt.connected);
+
+    write_header(w, "aqa_mqtt_queued_samples", "gauge", "Samples waiting to be published");
+    http_chunk_printf(w, "aqa_mqtt_queued_samples %u\n", (unsigned)mqtt.queued);
+
+    write_header(w, "aqa_mqtt_published_samples_total", "counter", "Samples acknowledged by the broker");
+    http_chunk_printf(w, "aqa_mqtt_published_samples_total %u\n", (unsigned)mqtt.published);
+
+    write_header(w, "aqa_mqtt_messages_total", "counter", "MQTT messages published");
+    http_chunk_printf(w, "aqa_mqtt_messages_total %u\n", (unsigned)mqtt.messages);
+
+    write_header(w, "aqa_mqtt_dropped_samples_total", "counter", "Samples dropped because the queue was full");
+    http_chunk_printf(w, "aqa_mqtt_dropped_samples_total %u\n", (unsigned)mqtt.dropped);
+
+    udp_export_stats_t udp;
+    udp_export_get_stats(&udp);
+
+    write_header(w, "aqa_udp_samples_total", "counter", "Samples pushed by the UDP exporter");
+    http_chunk_printf(w, "aqa_udp_samples_total %u\n", (unsigned)udp.samples);
+
+    write_header(w, "aqa_udp_datagrams_total", "counter", "Datagrams sent by the UDP exporter");
+    http_chunk_printf(w, "aqa_udp_datagrams_total %u\n", (unsigned)udp.datagrams);
+
+    write_header(w, "aqa_udp_dropped_datagrams_total", "counter", "Datagrams the network stack did not accept");
+    http_chunk_printf(w, "aqa_udp_dropped_datagrams_total %u\n", (unsigned)udp.dropped_datagrams);
+
+    write_header(w, "aqa_udp_dropped_samples_total", "counter", "Samples dropped because the exporter queue was full");
+    http_chunk_printf(w, "aqa_udp_dropped_samples_total %u\n", (unsigned)udp.dropped_samples);
+
+    write_header(w, "aqa_udp_cpu_seconds_total", "counter", "Time spent rendering and sending samples");
+    http_chunk_printf(w, "aqa_udp_cpu_seconds_total %.6f\n", udp.render_us / 1e6);
+
+    stream_stats_t stream;
+    stream_get_stats(&stream);
+
+    write_header(w, "aqa_stream_clients", "gauge", "Subscribed event stream clients");
+    http_chunk_printf(w, "aqa_stream_clients %u\n", (unsigned)stream.clients);
+
+    log_ring_stats_t log;
+    log_ring_get_stats(&log);
+
+    write_header(w, "aqa_log_lines_total", "counter", "Log lines written to the ring");
+    http_chunk_printf(w, "aqa_log_lines_total %u\n", (unsigned)log.lines);
+
+    write_header(w, "aqa_log_dropped_lines_total", "counter", "Log lines dropped because the console lagged behind");
+    http_chunk_printf(w, "aqa_log_dropped_lines_total %u\n", (unsigned)log.dropped);
+}
+
+static void write_i2c(http_chunk_writer_t *w)
+{
+    static const uint32_t bounds[METRICS_I2C_BUCKETS] = METRICS_I2C_BUCKETS_US;
+
+    write_header(w, "aqa_i2c_errors_total", "counter", "Failed I2C transactions");
+    for(int dev = 0; dev < METRICS_I2C_COUNT; dev++)
+    {
+        http_chunk_printf(w, "aqa_i2c_errors_total{device=\"%s\"} %u\n",
+            i2c_device_names[dev], (unsigned)METRICS_GET(g_metrics.i2c[dev].errors));
+    }
+
+    write_header(w, "aqa_i2c_latency_us", "histogram", "I2C transaction duration, microseconds");
+    for(int dev = 0; dev < METRICS_I2C_COUNT; dev++)
+    {
+        const metrics_i2c_t *m = &g_metrics.i2c[dev];
+        uint32_t cumulative = 0;
+
+        for(int b = 0; b < METRICS_I2C_BUCKETS; b++)
+        {
+            cumulative += METRICS_GET(m->buckets[b]);
+            http_chunk_printf(w, "aqa_i2c_latency_us_bucket{device=\"%s\",le=\"%u\"} %u\n",
+                i2c_device_names[dev], (unsigned)bounds[b], (unsigned)cumulative);
+        }
+        cumulative += METRICS_GET(m->buckets[METRICS_I2C_BUCKETS]);
+
+        http_chunk_printf(w, "aqa_i2c_latency_us_bucket{device=\"%s\",le=\"+Inf\"} %u\n",
+            i2c_device_names[dev], (unsigned)cumulative);
+        http_chunk_printf(w, "aqa_i2c_latency_us_sum{device=\"%s\"} %u\n",
+            i2c_device_names[dev], (unsigned)METRICS_GET(m->latency_sum_us));
+        http_chunk_printf(w, "aqa_i2c_latency_us_count{device=\"%s\"} %u\n",
+            i2c_device_names[dev], (unsigned)cumulative);
+    }
+}
+
+esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    char buf[METRICS_CHUNK_SIZE];
+    http_chunk_writer_t w;
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    http_chunk_init(&w, req, buf, sizeof(buf));
+
+    write_readings(&w);
+    write_system(&w);
+    write_i2c(&w);
+
+    return http_chunk_finish(&w);
+}
@@ -0,0 +1,85 @@
+#include "main.h"
+#include "form_parser.h"
+#include "ota.h"
+
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+// url + sha256 + field names, urlencoded
+#define OTA_PULL_MAX_BODY   512
+
+#define MAX_TIMEOUTS        5
+
+static const char* TAG = "OTA";
+
+/**
+ * @brief POST /api/v1/ota/pull with `url` and `sha256` form fields.
+ * The device downloads the image itself, see ota_pull.c
+*/
+esp_err_t api_ota_pull_post_handler(httpd_req_t *req)
+{
+    char buf[OTA_PULL_MAX_BODY];
+    char url[OTA_PULL_URL_MAX] = {0};
+    char sha256[65] = {0};
+    int received = 0;
+    int timeouts = 0;
+
+    if (req->content_len <= 0 || req->content_len >= sizeof(buf)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad request size");
+        return ESP_FAIL;
+    }
+
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, buf + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            // a stalled client must not hold the server task
+            if (++timeouts > MAX_TIMEOUTS) {
+                httpd_resp_send_408(req);
+                return ESP_FAIL;
+            }
+            continue;
+        }
+        if (ret <= 0)
+            return ESP_FAIL;
+        received += ret;
+    }
+
+    form_field_t fields[] = {
+        { .name = "url",    .value = url,    .size = sizeof(url) },
+        { .name = "sha256", .value = sha256, .size = sizeof(sha256) },
+    };
+
+    form_parser_t parser;
+    form_status_t status = form_parser_init(&parser, NULL, fields, 2);
+    if (status == FORM_OK)
+        status = form_parser_feed(&parser, buf, received);
+    if (status == FORM_OK)
+        status = form_parser_finish(&parser);
+
+    if (status != FORM_OK || !fields[0].found || !fields[1].found) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "url and sha256 are required");
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = ota_pull_start(url, sha256);
+    switch (err) {
+    case ESP_OK:
+        ESP_LOGI(TAG, "Pull update started: %s", url);
+        httpd_resp_set_status(req, "202 Accepted");
+        httpd_resp_sendstr(req, "Download started");
+        return ESP_OK;
+    case ESP_ERR_INVALID_ARG:
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Bad url or sha256");
+        return ESP_FAIL;
+    case ESP_ERR_INVALID_STATE:
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Another update is in progress");
+        return ESP_FAIL;
+    default:
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+}
@@ -1,10 +1,32 @@
+#include <string.h>
+
 #include "esp_err.h"
 #include "esp_http_server.h"
 
-#include "config_html.h"
+#include "web_assets.h"
+
+#define ETAG_HDR_SIZE 64
+
+extern const char config_html_gz_start[] asm("_binary_config_html_gz_start");
 
 esp_err_t root_get_handler(httpd_req_t *req) 
 {
-    httpd_resp_send(req, config_html, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
-}
\ No newline at end of file
+    char if_none_match[ETAG_HDR_SIZE];
+
+    httpd_resp_set_hdr(req, "ETag", CONFIG_HTML_ETAG);
+    // the page is served from a fixed URL and changes with the firmware,
+    // so browsers have to revalidate it, which costs a 304 without a body
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    if(httpd_req_get_hdr_value_str(req, "If-None-Match", 
+        if_none_match, sizeof(if_none_match)) == ESP_OK
+        && strstr(if_none_match, CONFIG_HTML_ETAG) != NULL)
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, config_html_gz_start, CONFIG_HTML_GZ_LEN);
+}
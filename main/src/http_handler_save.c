@@ -1,47 +1,56 @@
 #include "main.h"
 #include "creds.h"
+#include "mem_map.h"
+#include "wifi.h"
+#include "form_parser.h"
+
+#include <string.h>
 
-#include "ctype.h"
 #include "esp_err.h"
 #include "esp_http_server.h"
 
-static inline bool parse_multipart_form(const char* buf, char* ssid, char* pass);
-static inline bool parse_urlencoded_form(const char* buf, char* ssid, char* pass);
-static inline int read_data_from_request(httpd_req_t *req, char *buf);
+// the form has two short fields, anything bigger is not ours
+#define SAVE_MAX_BODY       1024
+#define SAVE_RECV_BUF_SIZE  128
+
+MEM_TASK(mem_reboot, "rebooting", MEM_STACK_REBOOT);
+
+static inline form_status_t parse_request(httpd_req_t *req, 
+    form_field_t *fields, size_t field_count, int *sock_err);
 
 
 esp_err_t save_post_handler(httpd_req_t *req) 
 {
     char wifi_ssid[32] = {0};
     char wifi_password[64] = {0};
-    bool parse_success = false;
-    char *buf = NULL;
+    int sock_err = 0;
 
-    // allocate a buffer with reserve (+1) for the null terminator
-    buf = malloc(req->content_len + 1);
-    if (!buf) {
-        httpd_resp_send_500(req);
+    if (req->content_len > SAVE_MAX_BODY) {
+        httpd_resp_set_status(req, "413 Content Too Large");
+        httpd_resp_sendstr(req, "Error: request is too large");
         return ESP_FAIL;
     }
 
-    // get request data
-    int ret = read_data_from_request(req, buf);
-    if(ret <= 0) {
-        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+    form_field_t fields[] = {
+        { .name = "ssid",     .value = wifi_ssid,     .size = sizeof(wifi_ssid) },
+        { .name = "password", .value = wifi_password, .size = sizeof(wifi_password) },
+    };
+
+    form_status_t status = parse_request(req, fields, 2, &sock_err);
+
+    if (sock_err < 0) {
+        if (sock_err == HTTPD_SOCK_ERR_TIMEOUT)
             httpd_resp_send_408(req);
-        free(buf);
         return ESP_FAIL;
     }
 
-    // check and parse possible formats
-    if (strstr(buf, "name=\"ssid\"")) // multipart/form-data
-        parse_success = parse_multipart_form(buf, wifi_ssid, wifi_password);
-    else if (strstr(buf, "ssid="))    // application/x-www-form-urlencoded
-        parse_success = parse_urlencoded_form(buf, wifi_ssid, wifi_password);
-
-    free(buf);
+    if (status == FORM_ERR_FIELD_TOO_LONG)
+    {
+        httpd_resp_sendstr(req, "Error: SSID or password is too long");
+        return ESP_FAIL;
+    }
 
-    if (parse_success == false)
+    if (status != FORM_OK || !fields[0].found || !fields[1].found)
     {
         httpd_resp_sendstr(req, "Parse data error");
         return ESP_FAIL;
@@ -60,138 +69,51 @@ esp_err_t save_post_handler(httpd_req_t *req)
     }
 
     save_wifi_creds(wifi_ssid, wifi_password);
-    httpd_resp_sendstr(req, "Settings saved! Rebooting ESP32...");
-
-    xTaskCreate(reboot_task, "rebooting", 1024, NULL, 0, NULL);
 
-    return ESP_OK;
-}
-
-static inline char* url_decode(const char* src) 
-{
-    if (!src) return NULL;
-    
-    size_t src_len = strlen(src);
-    char* decoded = malloc(src_len + 1);
-    if (!decoded) return NULL;
-    
-    char* dst = decoded;
-    
-    while (*src) 
-    {
-        if (*src == '+') 
-        {
-            *dst++ = ' ';
-            src++;
-        }
-        else if (*src == '%' && isxdigit((uint8_t) src[1]) && isxdigit((uint8_t) src[2]))
-        {
-            char hex[3] = {src[1], src[2], 0};
-            *dst++ = (char)strtol(hex, NULL, 16);
-            src += 3;
-        }
-        else 
-        {
-            *dst++ = *src++;
-        }
+    // a reboot would restart the sensors and lose their warm-up
+    if (wifi_apply_creds() == ESP_OK) {
+        httpd_resp_sendstr(req, "Settings saved! Connecting to the network...");
+        return ESP_OK;
     }
-    *dst = '\0';
-    return decoded;
-}
-
-// parser for multipart/form-data
-static inline bool parse_multipart_form(const char* buf, char* ssid, char* pass) 
-{
-    char* fields[] = {"name=\"ssid\"", "name=\"password\""};
-    char* values[] = {ssid, pass};
-    size_t max_lens[] = {32, 64};
 
-    for (int i = 0; i < 2; i++) 
-    {
-        char* section = strstr(buf, fields[i]);
-        if (!section) return false;
-        
-        char* value_start = strstr(section, "\r\n\r\n");
-        if (!value_start) return false;
-        value_start += 4;
-        
-        char* value_end = strstr(value_start, "------");
-        if (!value_end) return false;
-        
-        size_t len = value_end - value_start;
-        while (len > 0 && isspace((unsigned char)value_start[len-1])) len--;
-        
-        // allocate and decode value
-        char* encoded_val = malloc(len + 1);
-        if (!encoded_val) return false;
-        
-        strncpy(encoded_val, value_start, len);
-        encoded_val[len] = '\0';
-        
-        char* decoded_val = url_decode(encoded_val);
-        free(encoded_val);
-        
-        if (!decoded_val) return false;
-        
-        strncpy(values[i], decoded_val, max_lens[i]-1);
-        values[i][max_lens[i]-1] = '\0';
-        free(decoded_val);
-    }
-    return true;
-}
+    httpd_resp_sendstr(req, "Settings saved! Rebooting ESP32...");
 
-// parser for application/x-www-form-urlencoded
-static inline bool parse_urlencoded_form(const char* buf, char* ssid, char* pass) {
-    char* ssid_start = strstr(buf, "ssid=");
-    char* pass_start = strstr(buf, "password=");
-    
-    if (!ssid_start || !pass_start) return false;
-    
-    // temporary buffers for decoding
-    char encoded_ssid[64] = {0};
-    char encoded_pass[64] = {0};
-    
-    if (sscanf(ssid_start, "ssid=%63[^&]", encoded_ssid) != 1) return false;
-    if (sscanf(pass_start, "password=%63[^&]", encoded_pass) != 1) return false;
-    
-    // decoding values
-    char* decoded_ssid = url_decode(encoded_ssid);
-    char* decoded_pass = url_decode(encoded_pass);
-    
-    if (!decoded_ssid || !decoded_pass) 
-    {
-        free(decoded_ssid);
-        free(decoded_pass);
-        return false;
-    }
-    
-    strncpy(ssid, decoded_ssid, 31);
-    strncpy(pass, decoded_pass, 63);
-    
-    ssid[31] = pass[63] = '\0';
-    
-    free(decoded_ssid);
-    free(decoded_pass);
+    mem_task_create(&mem_reboot, reboot_task, NULL, 0, NULL, tskNO_AFFINITY);
 
-    return true;
+    return ESP_OK;
 }
 
-static inline int read_data_from_request(httpd_req_t *req, char *buf)
+/**
+ * @brief Receive the body in small pieces and feed them to the form parser
+*/
+static inline form_status_t parse_request(httpd_req_t *req, 
+    form_field_t *fields, size_t field_count, int *sock_err)
 {
+    char buf[SAVE_RECV_BUF_SIZE];
+    form_parser_t parser;
+    form_status_t status;
     int remaining = req->content_len;
-    int received = 0;
-    int ret = 0;
 
-    while (remaining > 0) 
+    // the content type is read into the receive buffer, it is not needed later
+    const char *content_type = NULL;
+    if (httpd_req_get_hdr_value_str(req, "Content-Type", buf, sizeof(buf)) == ESP_OK)
+        content_type = buf;
+
+    status = form_parser_init(&parser, content_type, fields, field_count);
+
+    while (remaining > 0 && status == FORM_OK) 
     {
-        ret = httpd_req_recv(req, buf + received, MIN(remaining, 1024));
-        if (ret <= 0)
-            break;
-        received += ret;
+        int ret = httpd_req_recv(req, buf, MIN(remaining, sizeof(buf)));
+        if (ret <= 0) {
+            *sock_err = ret == 0 ? HTTPD_SOCK_ERR_FAIL : ret;
+            return status;
+        }
         remaining -= ret;
+        status = form_parser_feed(&parser, buf, ret);
     }
 
-    buf[received] = '\0';
+    if (status == FORM_OK)
+        status = form_parser_finish(&parser);
 
-    return ret;
-}
\ No newline at end of file
+    return status;
+}
@@ -0,0 +1,183 @@
+#include "stream.h"
+#include "readings.h"
+#include "json_writer.h"
+#include "web.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#define STREAM_EVENT_BUF_SIZE 512
+
+typedef struct {
+    int fd;
+    uint8_t strikes;
+} stream_client_t;
+
+static const char* TAG = "STREAM";
+
+static const char stream_headers[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/event-stream\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "retry: 2000\n\n";
+
+// the client table is touched only from the http server task
+static stream_client_t s_clients[STREAM_MAX_CLIENTS];
+static httpd_handle_t s_server = NULL;
+
+// counters are read from other tasks
+static volatile uint32_t s_client_count = 0;
+static volatile uint32_t s_evicted = 0;
+static volatile uint32_t s_broadcasts = 0;
+static volatile uint32_t s_last_cost_us = 0;
+static volatile uint32_t s_max_cost_us = 0;
+static volatile bool s_work_pending = false;
+
+static void remove_client(uint32_t idx)
+{
+    s_clients[idx] = s_clients[--s_client_count];
+}
+
+static void evict_client(uint32_t idx)
+{
+    const int fd = s_clients[idx].fd;
+
+    ESP_LOGW(TAG, "evicting client, fd %d", fd);
+    remove_client(idx);
+    s_evicted++;
+
+    httpd_sess_trigger_close(s_server, fd);
+}
+
+static int format_event(char *buf, size_t size)
+{
+    sensors_data_t data;
+    int64_t timestamp_us;
+
+    const uint32_t seq = readings_get_latest(&data, &timestamp_us);
+    if(seq == 0)
+        return -1;
+
+    static const char prefix[] = "event: sample\ndata: ";
+    const size_t prefix_len = sizeof(prefix) - 1;
+
+    if(size < prefix_len + 3)
+        return -1;
+
+    memcpy(buf, prefix, prefix_len);
+
+    json_writer_t w;
+    json_writer_init(&w, buf + prefix_len, size - prefix_len - 2);
+    api_serialize_sample(&w, seq, &data, timestamp_us);
+
+    const int json_len = json_writer_finish(&w);
+    if(json_len < 0)
+        return -1;
+
+    size_t len = prefix_len + json_len;
+    buf[len++] = '\n';
+    buf[len++] = '\n';
+
+    return len;
+}
+
+static void broadcast_work(void *arg)
+{
+    char buf[STREAM_EVENT_BUF_SIZE];
+
+    s_work_pending = false;
+
+    if(s_client_count == 0)
+        return;
+
+    const int64_t start = esp_timer_get_time();
+
+    const int len = format_event(buf, sizeof(buf));
+    if(len < 0)
+        return;
+
+    for(uint32_t i = 0; i < s_client_count; )
+    {
+        const int sent = httpd_socket_send(
+            s_server, s_clients[i].fd, buf, len, MSG_DONTWAIT);
+
+        if(sent == len) {
+            s_clients[i].strikes = 0;
+            i++;
+            continue;
+        }
+
+        // socket buffer is full: give the client a chance to catch up,
+        // a partially written event or a broken socket can not be resumed
+        if(sent == HTTPD_SOCK_ERR_TIMEOUT && ++s_clients[i].strikes < STREAM_MAX_STRIKES) {
+            i++;
+            continue;
+        }
+
+        evict_client(i);
+    }
+
+    const uint32_t cost = (uint32_t)(esp_timer_get_time() - start);
+    s_last_cost_us = cost;
+    if(cost > s_max_cost_us)
+        s_max_cost_us = cost;
+    s_broadcasts++;
+}
+
+void stream_notify(void)
+{
+    if(s_server == NULL || s_client_count == 0 || s_work_pending)
+        return;
+
+    s_work_pending = true;
+    if(httpd_queue_work(s_server, broadcast_work, NULL) != ESP_OK)
+        s_work_pending = false;
+}
+
+void stream_forget(int sockfd)
+{
+    for(uint32_t i = 0; i < s_client_count; i++)
+    {
+        if(s_clients[i].fd == sockfd) {
+            remove_client(i);
+            return;
+        }
+    }
+}
+
+void stream_get_stats(stream_stats_t *stats)
+{
+    stats->clients = s_client_count;
+    stats->evicted = s_evicted;
+    stats->broadcasts = s_broadcasts;
+    stats->last_cost_us = s_last_cost_us;
+    stats->max_cost_us = s_max_cost_us;
+}
+
+esp_err_t api_stream_get_handler(httpd_req_t *req)
+{
+    if(s_client_count >= STREAM_MAX_CLIENTS) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "10");
+        return httpd_resp_sendstr(req, "Too many stream clients");
+    }
+
+    // the response never ends, so the headers are written by hand
+    if(httpd_send(req, stream_headers, sizeof(stream_headers) - 1) < 0)
+        return ESP_FAIL;
+
+    s_server = req->handle;
+    s_clients[s_client_count].fd = httpd_req_to_sockfd(req);
+    s_clients[s_client_count].strikes = 0;
+    s_client_count++;
+
+    ESP_LOGI(TAG, "client subscribed, fd %d (%d/%d)", 
+        httpd_req_to_sockfd(req), (int)s_client_count, STREAM_MAX_CLIENTS);
+
+    return ESP_OK;
+}
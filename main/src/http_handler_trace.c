@@ -0,0 +1,82 @@
+#include "trace.h"
+#include "json_writer.h"
+
+#include <stdio.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#define TRACE_JSON_BUF_SIZE 4096
+#define TRACE_QUERY_SIZE    32
+
+static void add_histogram(json_writer_t *w, const trace_histogram_t *h)
+{
+    int last = TRACE_BUCKETS - 1;
+    while(last >= 0 && h->buckets[last] == 0)
+        last--;
+
+    json_add_uint(w, "count", h->count);
+    json_add_uint(w, "p50_us", trace_percentile_us(h, 50));
+    json_add_uint(w, "p99_us", trace_percentile_us(h, 99));
+    json_add_uint(w, "max_us", h->max_us);
+    // bucket i: [2^i, 2^(i+1)) us, trailing empty buckets are left out
+    json_array_begin(w, "buckets");
+    for(int i = 0; i <= last; i++)
+        json_add_uint(w, NULL, h->buckets[i]);
+    json_array_end(w);
+}
+
+/**
+ * @brief GET /api/v1/trace, latency histograms of the sample pipeline:
+ * each point since the trigger and, in "stage", since the point before it.
+ * `?print=1` also prints the table to the UART.
+*/
+esp_err_t api_trace_get_handler(httpd_req_t *req)
+{
+    // handlers run one at a time in the server task, too big for its stack
+    static char buf[TRACE_JSON_BUF_SIZE];
+    char query[TRACE_QUERY_SIZE];
+    char value[4];
+    json_writer_t w;
+
+    if(httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+        && httpd_query_key_value(query, "print", value, sizeof(value)) == ESP_OK
+        && value[0] == '1')
+        trace_print(stdout);
+
+    json_writer_init(&w, buf, sizeof(buf));
+    json_object_begin(&w, NULL);
+    json_add_bool(&w, "enabled", TRACE_ENABLE == 1);
+    json_add_string(&w, "from", trace_point_name(TRACE_TRIGGER));
+    json_add_string(&w, "buckets", "log2_us");
+
+    json_array_begin(&w, "points");
+    for(int point = TRACE_READ; point < TRACE_POINTS; point++)
+    {
+        trace_histogram_t h;
+
+        json_object_begin(&w, NULL);
+        json_add_string(&w, "point", trace_point_name(point));
+        trace_get(point, &h);
+        add_histogram(&w, &h);
+
+        json_object_begin(&w, "stage");
+        json_add_string(&w, "from", trace_point_name(trace_previous(point)));
+        trace_get_stage(point, &h);
+        add_histogram(&w, &h);
+        json_object_end(&w);
+        json_object_end(&w);
+    }
+    json_array_end(&w);
+    json_object_end(&w);
+
+    const int len = json_writer_finish(&w);
+    if(len < 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, buf, len);
+}
@@ -4,115 +4,185 @@
 #include "esp_flash_partitions.h"
 #include "esp_partition.h"
 #include "esp_log.h"
+#include "esp_task.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "main.h"
+#include "mem_map.h"
+#include "metrics.h"
+#include "ota.h"
 
-#define OTA_BUF_SIZE 4096
 #define MAX_TIMEOUTS 5
 
-static char ota_buf[OTA_BUF_SIZE + 1];
+#define OTA_RECEIVER_PRIORITY   (ESP_TASK_PRIO_MIN + 1)
 
 static const char* TAG = "OTA";
 
-esp_err_t update_firmware_handler(httpd_req_t *req) 
+MEM_TASK(mem_otar, "otar", MEM_STACK_OTAR);
+
+/**
+ * @brief Fill the buffer up to `len` bytes, tolerating a few timeouts
+ * @return received bytes or a negative HTTPD_SOCK_ERR_*
+*/
+static int receive_block(httpd_req_t *req, char *buf, int len)
 {
-    const int content_length = req->content_len;
-    int remaining = content_length;
-    int timeout_counter = 0;
     int received = 0;
-    esp_ota_handle_t ota_handle;
-    
-    if (content_length <= 0) {
-        ESP_LOGE(TAG, "Invalid content length: %d", content_length);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid content length");
-        return ESP_FAIL;
-    }
+    int timeout_counter = 0;
 
-    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "No OTA partition found");
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA partition not found");
-        return ESP_FAIL;
-    }
+    while (received < len) {
+        int recv_len = httpd_req_recv(req, buf + received, len - received);
 
-    if (content_length > update_partition->size) {
-        ESP_LOGE(TAG, "Firmware too big: %d > %d", content_length, (int)update_partition->size);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Firmware too large");
-        return ESP_FAIL;
+        if (recv_len == HTTPD_SOCK_ERR_TIMEOUT) {
+            if (++timeout_counter > MAX_TIMEOUTS)
+                return HTTPD_SOCK_ERR_TIMEOUT;
+            continue;
+        }
+
+        if (recv_len <= 0)
+            return recv_len < 0 ? recv_len : HTTPD_SOCK_ERR_FAIL;
+
+        received += recv_len;
     }
 
+    return received;
+}
+
+/**
+ * @brief Receive the image and install it, runs in the receiver task.
+ * Sends the response in every case.
+*/
+static esp_err_t receive_image(httpd_req_t *req)
+{
+    const int content_length = req->content_len;
+    int remaining = content_length;
+
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+
     ESP_LOGI(TAG, "Writing to partition subtype %d at offset 0x%x, size %d", 
         update_partition->subtype, (unsigned int)update_partition->address, content_length);
 
-    esp_err_t ret = esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &ota_handle);
+    esp_err_t ret = ota_writer_begin(update_partition, content_length);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(ret));
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA begin failed");
-        return ESP_FAIL;
+        METRICS_SET(g_metrics.ota_state, OTA_STATE_FAILED);
+        return ret;
     }
 
-    ESP_LOGI(TAG, "Receiving: %d/%d bytes", content_length - remaining, content_length);
-
     while (remaining > 0) {
-        int recv_len = httpd_req_recv(req, ota_buf, MIN(remaining, OTA_BUF_SIZE));
+        char *buf = ota_writer_get_buffer();
+        if (buf == NULL) {
+            // the writer has failed, the reason is reported by ota_writer_end()
+            break;
+        }
 
+        int recv_len = receive_block(req, buf, MIN(remaining, OTA_BUF_SIZE));
         if (recv_len < 0) {
-            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT) {
-                if (++timeout_counter > MAX_TIMEOUTS) {
-                    ESP_LOGE(TAG, "Timeout limit reached");
-                    esp_ota_abort(ota_handle);
-                    httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Timeout limit reached");
-                    return ESP_FAIL;
-                }
-                continue;
-            }
-            ESP_LOGE(TAG, "Receive error: %d", recv_len);
-            esp_ota_abort(ota_handle);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Receive error");
+            ESP_LOGE(TAG, "Receive error: %d after %d/%d bytes", 
+                recv_len, content_length - remaining, content_length);
+            ota_writer_abort();
+            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT)
+                httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, "Timeout limit reached");
+            else
+                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Receive error");
             return ESP_FAIL;
         }
 
-        if (esp_ota_write(ota_handle, ota_buf, recv_len) != ESP_OK) {
-            ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(ret));
-            esp_ota_abort(ota_handle);
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "esp_ota_write error");
+        if (ota_writer_submit(buf, recv_len) != ESP_OK)
             break;
-        }
 
-        received  += recv_len;
         remaining -= recv_len;
-
-        ESP_LOGI(TAG, "Receiving: %d/%d bytes", content_length - remaining, content_length);
-    }
-
-    if (received != content_length) {
-        ESP_LOGE(TAG, "Incomplete transfer: %d/%d bytes", received, content_length);
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Incomplete transfer");
-        esp_ota_abort(ota_handle);
-        return ESP_FAIL;
     }
 
-    ret = esp_ota_end(ota_handle);
+    ret = ota_writer_end();
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "OTA end failed: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "OTA failed: %s", esp_err_to_name(ret));
         if (ret == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed - corrupt firmware?");
         }
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA validation failed");
-        return ESP_FAIL;
+        return ret;
     }
 
     ret = esp_ota_set_boot_partition(update_partition);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Set boot partition failed: %s", esp_err_to_name(ret));
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Set boot partition failed");
-        return ESP_FAIL;
+        METRICS_SET(g_metrics.ota_state, OTA_STATE_FAILED);
+        return ret;
     }
 
+    METRICS_SET(g_metrics.ota_state, OTA_STATE_DONE);
     ESP_LOGI(TAG, "Firmware update successful!");
     httpd_resp_sendstr(req, "Firmware update successful! Rebooting...");
 
-    xTaskCreatePinnedToCore(reboot_task, "reboot", 2048, NULL, 0, NULL, tskNO_AFFINITY);
+    return ESP_OK;
+}
+
+/**
+ * @brief Owns the detached request, the server task is free meanwhile
+*/
+static void ota_receiver_task(void *arg)
+{
+    httpd_req_t *req = (httpd_req_t *) arg;
+
+    esp_err_t err = receive_image(req);
+    httpd_req_async_handler_complete(req);
+
+    if (err == ESP_OK)
+        reboot_task(NULL);
+
+    ota_release();
+    vTaskDelete(NULL);
+}
+
+esp_err_t update_firmware_handler(httpd_req_t *req) 
+{
+    const int content_length = req->content_len;
+    httpd_req_t *async_req;
+    
+    if (content_length <= 0) {
+        ESP_LOGE(TAG, "Invalid content length: %d", content_length);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid content length");
+        return ESP_FAIL;
+    }
+
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "No OTA partition found");
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "OTA partition not found");
+        return ESP_FAIL;
+    }
+
+    if (content_length > update_partition->size) {
+        ESP_LOGE(TAG, "Firmware too big: %d > %d", content_length, (int)update_partition->size);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Firmware too large");
+        return ESP_FAIL;
+    }
+
+    if (!ota_acquire()) {
+        ESP_LOGW(TAG, "Another update is in progress");
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Another update is in progress");
+        return ESP_FAIL;
+    }
+
+    // the transfer takes tens of seconds, it must not hold the server task
+    if (httpd_req_async_handler_begin(req, &async_req) != ESP_OK) {
+        ota_release();
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+    if (mem_task_create(&mem_otar, ota_receiver_task, async_req, 
+        OTA_RECEIVER_PRIORITY, NULL, tskNO_AFFINITY) != pdPASS) 
+    {
+        httpd_resp_send_err(async_req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        httpd_req_async_handler_complete(async_req);
+        ota_release();
+        return ESP_FAIL;
+    }
 
     return ESP_OK;
 }
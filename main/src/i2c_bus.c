@@ -0,0 +1,97 @@
+#include "i2c_bus.h"
+#include "i2c_rec.h"
+#include "display.h"
+#include "measurment.h"
+#include "metrics.h"
+
+#include "esp_timer.h"
+
+static inline metrics_i2c_device_t device_index(uint8_t dev_addr)
+{
+    switch (dev_addr)
+    {
+    case AHT21_DEV_ADDR:   return METRICS_I2C_AHT21;
+    case BMP280_DEV_ADDR:  return METRICS_I2C_BMP280;
+    case ENS160_DEV_ADDR:  return METRICS_I2C_ENS160;
+    case SSD1306_DEV_ADDR: return METRICS_I2C_SSD1306;
+    default:               return METRICS_I2C_OTHER;
+    }
+}
+
+static inline void account(uint8_t dev_addr, i2c_rec_op_t op, 
+    const uint8_t *wdata, size_t wlen, const uint8_t *rdata, size_t rlen, 
+    esp_err_t ok, int64_t start)
+{
+    const uint32_t duration = (uint32_t)(esp_timer_get_time() - start);
+
+    metrics_i2c_record(device_index(dev_addr), ok == ESP_OK, duration);
+#if I2C_REC_ENABLE == 1
+    if(I2C_REC_DISPLAY || dev_addr != SSD1306_DEV_ADDR)
+        i2c_rec_record(dev_addr, op, wdata, wlen, rdata, rlen, ok, (uint32_t)start, duration);
+#endif
+}
+
+/**
+ * @return true if the transaction was served by the replay, see i2c_rec.h
+*/
+static inline bool replay(uint8_t dev_addr, i2c_rec_op_t op, 
+    const uint8_t *wdata, size_t wlen, uint8_t *rdata, size_t rlen, esp_err_t *ok)
+{
+#if I2C_REC_ENABLE == 1
+    return i2c_replay_serve(dev_addr, op, wdata, wlen, rdata, rlen, ok);
+#else
+    return false;
+#endif
+}
+
+esp_err_t i2c_bus_write(uint8_t dev_addr, const uint8_t *data, size_t len)
+{
+    esp_err_t ok;
+    if(replay(dev_addr, I2C_REC_WRITE, data, len, NULL, 0, &ok))
+        return ok;
+
+    const int64_t start = esp_timer_get_time();
+    ok = i2c_master_write_to_device(I2C_MASTER_NUM, 
+        dev_addr, data, len, I2C_MASTER_TIMEOUT
+    );
+    account(dev_addr, I2C_REC_WRITE, data, len, NULL, 0, ok, start);
+    return ok;
+}
+
+esp_err_t i2c_bus_read(uint8_t dev_addr, uint8_t *data, size_t len)
+{
+    esp_err_t ok;
+    if(replay(dev_addr, I2C_REC_READ, NULL, 0, data, len, &ok))
+        return ok;
+
+    const int64_t start = esp_timer_get_time();
+    ok = i2c_master_read_from_device(I2C_MASTER_NUM, 
+        dev_addr, data, len, I2C_MASTER_TIMEOUT
+    );
+    account(dev_addr, I2C_REC_READ, NULL, 0, data, len, ok, start);
+    return ok;
+}
+
+esp_err_t i2c_bus_write_read(uint8_t dev_addr, 
+    const uint8_t *wdata, size_t wlen, uint8_t *rdata, size_t rlen)
+{
+    esp_err_t ok;
+    if(replay(dev_addr, I2C_REC_WRITE_READ, wdata, wlen, rdata, rlen, &ok))
+        return ok;
+
+    const int64_t start = esp_timer_get_time();
+    ok = i2c_master_write_read_device(I2C_MASTER_NUM, 
+        dev_addr, wdata, wlen, rdata, rlen, I2C_MASTER_TIMEOUT
+    );
+    account(dev_addr, I2C_REC_WRITE_READ, wdata, wlen, rdata, rlen, ok, start);
+    return ok;
+}
+
+esp_err_t i2c_bus_cmd_begin(uint8_t dev_addr, i2c_cmd_handle_t cmd)
+{
+    // the link is opaque, only its result is recorded and it is never replayed
+    const int64_t start = esp_timer_get_time();
+    esp_err_t ok = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT);
+    account(dev_addr, I2C_REC_CMD, NULL, 0, NULL, 0, ok, start);
+    return ok;
+}
@@ -0,0 +1,240 @@
+#include "i2c_rec.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+static i2c_rec_entry_t s_head[I2C_REC_HEAD];
+static i2c_rec_entry_t s_ring[I2C_REC_ENTRIES];
+static uint32_t s_count = 0;
+static uint32_t s_first = 0;    // oldest sequence number still wanted
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_ops[] = {
+    [I2C_REC_WRITE]      = "w",
+    [I2C_REC_READ]       = "r",
+    [I2C_REC_WRITE_READ] = "wr",
+    [I2C_REC_CMD]        = "cmd",
+};
+
+static inline i2c_rec_entry_t *slot(uint32_t seq)
+{
+    return seq < I2C_REC_HEAD ? &s_head[seq] : &s_ring[(seq - I2C_REC_HEAD) % I2C_REC_ENTRIES];
+}
+
+static inline bool is_kept(uint32_t seq)
+{
+    if(seq >= s_count || seq < s_first)
+        return false;
+    return seq < I2C_REC_HEAD || s_count - seq <= I2C_REC_ENTRIES;
+}
+
+void i2c_rec_record(uint8_t addr, i2c_rec_op_t op, const uint8_t *wdata, size_t wlen,
+    const uint8_t *rdata, size_t rlen, esp_err_t err, uint32_t start_us, uint32_t duration_us)
+{
+    // written bytes first, the read ones in what is left
+    const size_t wcopy = wlen < I2C_REC_DATA_SIZE ? wlen : I2C_REC_DATA_SIZE;
+    const size_t rcopy = rlen < I2C_REC_DATA_SIZE - wcopy ? rlen : I2C_REC_DATA_SIZE - wcopy;
+
+    taskENTER_CRITICAL(&s_lock);
+    i2c_rec_entry_t *e = slot(s_count);
+    e->seq = s_count;
+    e->time_us = start_us;
+    e->err = err;
+    e->duration_us = duration_us > UINT16_MAX ? UINT16_MAX : duration_us;
+    e->wlen = wlen > UINT16_MAX ? UINT16_MAX : wlen;
+    e->rlen = rlen > UINT16_MAX ? UINT16_MAX : rlen;
+    e->addr = addr;
+    e->op = op;
+    if(wcopy)
+        memcpy(e->data, wdata, wcopy);
+    // a failed read leaves nothing worth keeping
+    if(rcopy && err == ESP_OK)
+        memcpy(e->data + wcopy, rdata, rcopy);
+    else if(rcopy)
+        memset(e->data + wcopy, 0xff, rcopy);
+    s_count++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t i2c_rec_count(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    const uint32_t count = s_count;
+    taskEXIT_CRITICAL(&s_lock);
+    return count;
+}
+
+bool i2c_rec_next(uint32_t *seq, i2c_rec_entry_t *entry)
+{
+    taskENTER_CRITICAL(&s_lock);
+    uint32_t next = *seq > s_first ? *seq : s_first;
+    // past the head, skip what the ring has overwritten
+    if(next >= I2C_REC_HEAD && next < s_count && s_count - next > I2C_REC_ENTRIES)
+        next = s_count - I2C_REC_ENTRIES;
+
+    const bool found = is_kept(next);
+    if(found) {
+        *entry = *slot(next);
+        *seq = next + 1;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return found;
+}
+
+void i2c_rec_clear(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_first = s_count;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static char *put_hex(char *p, const uint8_t *data, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    if(len == 0) {
+        *p++ = '-';
+        return p;
+    }
+
+    for(size_t i = 0; i < len; i++) {
+        *p++ = hex[data[i] >> 4];
+        *p++ = hex[data[i] & 0x0f];
+    }
+    return p;
+}
+
+int i2c_rec_format(const i2c_rec_entry_t *entry, char *line, size_t size)
+{
+    char write[2 * I2C_REC_DATA_SIZE + 2];
+    char read[2 * I2C_REC_DATA_SIZE + 2];
+    const size_t wcopy = entry->wlen < I2C_REC_DATA_SIZE ? entry->wlen : I2C_REC_DATA_SIZE;
+    const size_t rcopy = entry->rlen < I2C_REC_DATA_SIZE - wcopy ? entry->rlen : I2C_REC_DATA_SIZE - wcopy;
+
+    *put_hex(write, entry->data, wcopy) = '\0';
+    *put_hex(read, entry->data + wcopy, rcopy) = '\0';
+
+    return snprintf(line, size, "%u %u %02x %s %d %u %u %u %s %s\n",
+        (unsigned)entry->seq, (unsigned)entry->time_us, entry->addr,
+        entry->op <= I2C_REC_CMD ? s_ops[entry->op] : "?", (int)entry->err,
+        (unsigned)entry->duration_us, (unsigned)entry->wlen, (unsigned)entry->rlen, write, read);
+}
+
+static const char *next_token(const char **p, size_t *len)
+{
+    while(**p == ' ' || **p == '\t')
+        (*p)++;
+
+    const char *token = *p;
+    while(**p && !isspace((unsigned char)**p))
+        (*p)++;
+
+    *len = *p - token;
+    return *len ? token : NULL;
+}
+
+static bool parse_number(const char **p, int base, long *value)
+{
+    size_t len;
+    const char *token = next_token(p, &len);
+    char *end;
+
+    if(token == NULL)
+        return false;
+
+    *value = strtol(token, &end, base);
+    return end == token + len;
+}
+
+static int hex_digit(char c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @return bytes stored at `out`, -1 if malformed or longer than `size`
+*/
+static int parse_hex(const char **p, uint8_t *out, size_t size)
+{
+    size_t len;
+    const char *token = next_token(p, &len);
+
+    if(token == NULL || len % 2 != 0 || len / 2 > size)
+        return len == 1 && token[0] == '-' ? 0 : -1;
+
+    for(size_t i = 0; i < len / 2; i++) {
+        const int hi = hex_digit(token[2 * i]);
+        const int lo = hex_digit(token[2 * i + 1]);
+        if(hi < 0 || lo < 0)
+            return -1;
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return len / 2;
+}
+
+esp_err_t i2c_rec_parse(const char *line, i2c_rec_entry_t *entry)
+{
+    const char *p = line;
+    long seq, time_us, addr, err, duration_us, wlen, rlen;
+    size_t len;
+
+    while(*p == ' ' || *p == '\t')
+        p++;
+    if(*p == '#' || *p == '\0' || *p == '\r' || *p == '\n')
+        return ESP_ERR_NOT_FOUND;
+
+    if(!parse_number(&p, 10, &seq) || !parse_number(&p, 10, &time_us)
+        || !parse_number(&p, 16, &addr) || addr < 0 || addr > 0x7f)
+        return ESP_ERR_INVALID_ARG;
+
+    const char *op = next_token(&p, &len);
+    entry->op = I2C_REC_CMD + 1;
+    for(int i = 0; op && i <= I2C_REC_CMD; i++)
+        if(strlen(s_ops[i]) == len && strncmp(op, s_ops[i], len) == 0)
+            entry->op = i;
+    if(entry->op > I2C_REC_CMD)
+        return ESP_ERR_INVALID_ARG;
+
+    if(!parse_number(&p, 10, &err) || !parse_number(&p, 10, &duration_us)
+        || !parse_number(&p, 10, &wlen) || !parse_number(&p, 10, &rlen)
+        || wlen < 0 || wlen > UINT16_MAX || rlen < 0 || rlen > UINT16_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    entry->seq = (uint32_t)seq;
+    entry->time_us = (uint32_t)time_us;
+    entry->addr = (uint8_t)addr;
+    entry->err = (esp_err_t)err;
+    entry->duration_us = duration_us > UINT16_MAX ? UINT16_MAX : (uint16_t)duration_us;
+    entry->wlen = (uint16_t)wlen;
+    entry->rlen = (uint16_t)rlen;
+
+    // the data may be cut short, never longer than the transaction
+    const int wcopy = parse_hex(&p, entry->data, I2C_REC_DATA_SIZE);
+    if(wcopy < 0 || wcopy > wlen)
+        return ESP_ERR_INVALID_ARG;
+    const int rcopy = parse_hex(&p, entry->data + wcopy, I2C_REC_DATA_SIZE - wcopy);
+    if(rcopy < 0 || rcopy > rlen || (rcopy > 0 && wcopy < wlen))
+        return ESP_ERR_INVALID_ARG;
+
+    return ESP_OK;
+}
+
+void i2c_rec_dump(FILE *out)
+{
+    char line[I2C_REC_LINE_SIZE];
+    i2c_rec_entry_t entry;
+    uint32_t seq = 0;
+
+    fprintf(out, "# seq time_us addr op err duration_us wlen rlen write read\n");
+    while(i2c_rec_next(&seq, &entry))
+    {
+        i2c_rec_format(&entry, line, sizeof(line));
+        fputs(line, out);
+    }
+}
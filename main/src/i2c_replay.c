@@ -0,0 +1,214 @@
+#include "i2c_rec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+// devices a recording may hold
+#define REPLAY_DEVICES      8
+
+static const char *TAG = "I2C_REPLAY";
+
+static i2c_rec_entry_t *s_entries = NULL;
+static uint32_t s_len = 0;
+static uint32_t s_cursor = 0;       // next entry to look at
+static uint8_t s_devices[REPLAY_DEVICES];
+static uint32_t s_device_count = 0;
+static i2c_replay_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool has_device(const uint8_t *devices, uint32_t count, uint8_t addr)
+{
+    for(uint32_t i = 0; i < count; i++)
+        if(devices[i] == addr)
+            return true;
+    return false;
+}
+
+/**
+ * @brief Detach the replay, the caller frees the returned entries
+*/
+static i2c_rec_entry_t *detach(void)
+{
+    i2c_rec_entry_t *entries = s_entries;
+
+    s_entries = NULL;
+    s_len = 0;
+    s_cursor = 0;
+    s_device_count = 0;
+    s_stats.active = false;
+    return entries;
+}
+
+esp_err_t i2c_replay_load(const char *text, size_t len)
+{
+    uint8_t devices[REPLAY_DEVICES];
+    uint32_t device_count = 0;
+    uint32_t lines = 1;
+    uint32_t count = 0;
+
+    for(size_t i = 0; i < len; i++)
+        if(text[i] == '\n')
+            lines++;
+
+    i2c_rec_entry_t *entries = calloc(lines, sizeof(i2c_rec_entry_t));
+    if(entries == NULL)
+        return ESP_ERR_NO_MEM;
+
+    for(size_t start = 0, line_no = 1; start < len; line_no++)
+    {
+        char line[I2C_REC_LINE_SIZE];
+        size_t end = start;
+        while(end < len && text[end] != '\n')
+            end++;
+
+        const size_t line_len = end - start;
+        const bool fits = line_len < sizeof(line);
+        if(fits) {
+            memcpy(line, text + start, line_len);
+            line[line_len] = '\0';
+        }
+        start = end + 1;
+
+        esp_err_t err = fits ? i2c_rec_parse(line, &entries[count]) : ESP_ERR_INVALID_ARG;
+        if(err == ESP_ERR_NOT_FOUND)
+            continue;
+        if(err != ESP_OK) {
+            ESP_LOGE(TAG, "line %u is malformed", (unsigned)line_no);
+            free(entries);
+            return err;
+        }
+
+        // display command links are not replayed
+        if(entries[count].op == I2C_REC_CMD)
+            continue;
+
+        if(!has_device(devices, device_count, entries[count].addr)) {
+            if(device_count == REPLAY_DEVICES) {
+                ESP_LOGE(TAG, "line %u: more than %d devices", (unsigned)line_no, REPLAY_DEVICES);
+                free(entries);
+                return ESP_ERR_INVALID_ARG;
+            }
+            devices[device_count++] = entries[count].addr;
+        }
+        count++;
+    }
+
+    if(count == 0) {
+        free(entries);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    i2c_rec_entry_t *old = detach();
+    s_entries = entries;
+    s_len = count;
+    memcpy(s_devices, devices, sizeof(devices[0]) * device_count);
+    s_device_count = device_count;
+    s_stats = (i2c_replay_stats_t) { .active = true, .entries = count };
+    taskEXIT_CRITICAL(&s_lock);
+
+    free(old);
+    ESP_LOGI(TAG, "replaying %u transactions of %u devices", (unsigned)count, (unsigned)device_count);
+    return ESP_OK;
+}
+
+void i2c_replay_stop(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    i2c_rec_entry_t *old = detach();
+    taskEXIT_CRITICAL(&s_lock);
+
+    free(old);
+}
+
+bool i2c_replay_active(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    const bool active = s_stats.active;
+    taskEXIT_CRITICAL(&s_lock);
+    return active;
+}
+
+void i2c_replay_get_stats(i2c_replay_stats_t *stats)
+{
+    taskENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static inline bool same_write(const i2c_rec_entry_t *e, const uint8_t *wdata, size_t wlen)
+{
+    const size_t stored = e->wlen < I2C_REC_DATA_SIZE ? e->wlen : I2C_REC_DATA_SIZE;
+    return e->wlen == wlen && memcmp(e->data, wdata, stored) == 0;
+}
+
+/**
+ * @return the entry to serve: the next one of the device with the same
+ * operation and written bytes, else the next one with the same operation.
+ * Only the measurement task talks to the recorded devices, so one cursor
+ * keeps them in step; after a gap of the ring the drivers skip forward
+ * to where they are in their cycle.
+*/
+static i2c_rec_entry_t *pick(uint8_t addr, i2c_rec_op_t op, const uint8_t *wdata, size_t wlen)
+{
+    i2c_rec_entry_t *first = NULL;
+
+    for(uint32_t i = s_cursor; i < s_len; i++)
+    {
+        i2c_rec_entry_t *e = &s_entries[i];
+        if(e->addr != addr || e->op != op)
+            continue;
+        if(same_write(e, wdata, wlen))
+            return e;
+        if(first == NULL)
+            first = e;
+    }
+    return first;
+}
+
+bool i2c_replay_serve(uint8_t addr, i2c_rec_op_t op, const uint8_t *wdata, size_t wlen,
+    uint8_t *rdata, size_t rlen, esp_err_t *err)
+{
+    i2c_rec_entry_t *finished = NULL;
+    i2c_rec_entry_t *e = NULL;
+
+    if(op == I2C_REC_CMD)
+        return false;
+
+    taskENTER_CRITICAL(&s_lock);
+    if(s_entries && has_device(s_devices, s_device_count, addr))
+    {
+        e = pick(addr, op, wdata, wlen);
+
+        if(e) {
+            const uint32_t index = e - s_entries;
+            s_stats.skipped += index - s_cursor;
+            s_cursor = index + 1;
+
+            const size_t wstored = e->wlen < I2C_REC_DATA_SIZE ? e->wlen : I2C_REC_DATA_SIZE;
+            const size_t rstored = e->rlen < I2C_REC_DATA_SIZE - wstored ? e->rlen : I2C_REC_DATA_SIZE - wstored;
+            const size_t rcopy = rlen < rstored ? rlen : rstored;
+
+            memcpy(rdata, e->data + wstored, rcopy);
+            memset(rdata + rcopy, 0xff, rlen - rcopy);
+            *err = e->err;
+
+            if(!same_write(e, wdata, wlen) || e->rlen != rlen)
+                s_stats.diverged++;
+            s_stats.served++;
+        } else {
+            // the recording is over, the bus takes over
+            finished = detach();
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if(finished) {
+        free(finished);
+        ESP_LOGI(TAG, "replay finished");
+    }
+    return e != NULL;
+}
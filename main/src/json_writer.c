@@ -0,0 +1,200 @@
+#include "json_writer.h"
+
+static inline void put_char(json_writer_t *w, char c)
+{
+    if(w->len + 1 >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = c;
+}
+
+static inline void put_raw(json_writer_t *w, const char *s)
+{
+    while(*s)
+        put_char(w, *s++);
+}
+
+static void put_uint(json_writer_t *w, uint64_t value)
+{
+    char tmp[20];
+    int n = 0;
+
+    do {
+        tmp[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while(value);
+
+    while(n)
+        put_char(w, tmp[--n]);
+}
+
+static void put_uint_padded(json_writer_t *w, uint32_t value, uint8_t width)
+{
+    char tmp[10];
+    int n = 0;
+
+    while(n < width) {
+        tmp[n++] = (char)('0' + value % 10);
+        value /= 10;
+    }
+
+    while(n)
+        put_char(w, tmp[--n]);
+}
+
+static void put_string(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(w, '"');
+    for(; *s; s++)
+    {
+        const uint8_t c = (uint8_t)*s;
+        if(c == '"' || c == '\\') {
+            put_char(w, '\\');
+            put_char(w, (char)c);
+        } else if(c < 0x20) {
+            put_raw(w, "\\u00");
+            put_char(w, hex[c >> 4]);
+            put_char(w, hex[c & 0x0f]);
+        } else {
+            put_char(w, (char)c);
+        }
+    }
+    put_char(w, '"');
+}
+
+static void put_key(json_writer_t *w, const char *key)
+{
+    if(w->need_comma)
+        put_char(w, ',');
+
+    if(key) {
+        put_string(w, key);
+        put_char(w, ':');
+    }
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->need_comma = false;
+    w->overflow = (size == 0);
+}
+
+int json_writer_finish(json_writer_t *w)
+{
+    if(w->size == 0)
+        return -1;
+
+    w->buf[w->len] = '\0';
+    return w->overflow ? -1 : (int)w->len;
+}
+
+void json_object_begin(json_writer_t *w, const char *key)
+{
+    put_key(w, key);
+    put_char(w, '{');
+    w->need_comma = false;
+}
+
+void json_object_end(json_writer_t *w)
+{
+    put_char(w, '}');
+    w->need_comma = true;
+}
+
+void json_array_begin(json_writer_t *w, const char *key)
+{
+    put_key(w, key);
+    put_char(w, '[');
+    w->need_comma = false;
+}
+
+void json_array_end(json_writer_t *w)
+{
+    put_char(w, ']');
+    w->need_comma = true;
+}
+
+void json_add_int(json_writer_t *w, const char *key, int64_t value)
+{
+    put_key(w, key);
+    if(value < 0) {
+        put_char(w, '-');
+        put_uint(w, (uint64_t)(-(value + 1)) + 1);
+    } else {
+        put_uint(w, (uint64_t)value);
+    }
+    w->need_comma = true;
+}
+
+void json_add_uint(json_writer_t *w, const char *key, uint64_t value)
+{
+    put_key(w, key);
+    put_uint(w, value);
+    w->need_comma = true;
+}
+
+void json_add_bool(json_writer_t *w, const char *key, bool value)
+{
+    put_key(w, key);
+    put_raw(w, value ? "true" : "false");
+    w->need_comma = true;
+}
+
+void json_add_string(json_writer_t *w, const char *key, const char *value)
+{
+    put_key(w, key);
+    if(value)
+        put_string(w, value);
+    else
+        put_raw(w, "null");
+    w->need_comma = true;
+}
+
+void json_add_float(json_writer_t *w, const char *key, float value, uint8_t decimals)
+{
+    static const uint32_t scale[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+    // 2^63 and 2^64, exact in a double
+    static const double fixed_limit = 9223372036854775808.0;
+    static const double uint_limit = 18446744073709551616.0;
+
+    put_key(w, key);
+    w->need_comma = true;
+
+    if(decimals > 6)
+        decimals = 6;
+
+    const double magnitude = value < 0 ? -(double)value : (double)value;
+
+    // JSON has no representation for NaN and infinities
+    if(value != value || magnitude >= uint_limit) {
+        put_raw(w, "null");
+        return;
+    }
+
+    if(value < 0)
+        put_char(w, '-');
+
+    // past 2^63 / scale the float is far above 2^24, a whole number: no fraction to round
+    if(magnitude * scale[decimals] >= fixed_limit) {
+        put_uint(w, (uint64_t)magnitude);
+        if(decimals) {
+            put_char(w, '.');
+            put_uint_padded(w, 0, decimals);
+        }
+        return;
+    }
+
+    const uint64_t fixed = (uint64_t)(magnitude * scale[decimals] + 0.5);
+    put_uint(w, fixed / scale[decimals]);
+
+    if(decimals) {
+        put_char(w, '.');
+        put_uint_padded(w, (uint32_t)(fixed % scale[decimals]), decimals);
+    }
+}
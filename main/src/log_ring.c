@@ -0,0 +1,247 @@
+#include "log_ring.h"
+#include "mem_map.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_task.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * Bounded multi-producer queue of fixed slots: `seq` says whose turn
+ * a slot is, pos for the writer of line pos, pos + 1 for the console,
+ * pos + LOG_RING_LINES for the next writer. `stamp` is the line number
+ * + 1 of the text, 0 while it is written, readers check it before and
+ * after copying the text.
+*/
+typedef struct {
+    uint32_t seq;
+    uint32_t stamp;
+    uint32_t len;
+    char text[LOG_RING_LINE_SIZE];
+} log_slot_t;
+
+typedef struct {
+    char tag[LOG_RING_TAG_SIZE];
+    esp_log_level_t level;
+} log_level_t;
+
+static const char *const s_level_names[] = {
+    [ESP_LOG_NONE]    = "none",
+    [ESP_LOG_ERROR]   = "error",
+    [ESP_LOG_WARN]    = "warn",
+    [ESP_LOG_INFO]    = "info",
+    [ESP_LOG_DEBUG]   = "debug",
+    [ESP_LOG_VERBOSE] = "verbose",
+};
+
+static log_slot_t s_slots[LOG_RING_LINES];
+static uint32_t s_head = 0;         // next line to write
+static uint32_t s_tail = 0;         // next line to print, written by the console task only
+static log_ring_stats_t s_stats;
+
+static log_level_t s_levels[LOG_RING_TAGS];
+static uint32_t s_level_count = 0;
+static portMUX_TYPE s_levels_lock = portMUX_INITIALIZER_UNLOCKED;
+
+MEM_TASK(mem_logd, "logd", MEM_STACK_LOGD);
+
+static int ring_vprintf(const char *format, va_list args)
+{
+    uint32_t pos = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    log_slot_t *slot;
+
+    for(;;)
+    {
+        slot = &s_slots[pos % LOG_RING_LINES];
+        const int32_t turn = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if(turn == 0) {
+            if(__atomic_compare_exchange_n(&s_head, &pos, pos + 1, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if(turn < 0) {
+            // the console has not printed the line a ring ago
+            METRICS_INC(s_stats.dropped);
+            return 0;
+        } else {
+            pos = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_store_n(&slot->stamp, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    int len = vsnprintf(slot->text, sizeof(slot->text), format, args);
+    if(len < 0)
+        len = 0;
+    if(len >= (int)sizeof(slot->text)) {
+        len = sizeof(slot->text) - 1;
+        slot->text[len - 1] = '\n';
+        METRICS_INC(s_stats.truncated);
+    }
+    slot->len = len;
+
+    __atomic_store_n(&slot->stamp, pos + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    METRICS_INC(s_stats.lines);
+    return len;
+}
+
+static void log_ring_task(void *arg)
+{
+    char line[LOG_RING_LINE_SIZE];
+
+    while(1)
+    {
+        for(;;)
+        {
+            log_slot_t *slot = &s_slots[s_tail % LOG_RING_LINES];
+            if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != s_tail + 1)
+                break;
+
+            const uint32_t len = slot->len;
+            memcpy(line, slot->text, len);
+
+            // the slot stays readable by log_ring_next() until it is written again
+            __atomic_store_n(&slot->seq, s_tail + LOG_RING_LINES, __ATOMIC_RELEASE);
+            __atomic_store_n(&s_tail, s_tail + 1, __ATOMIC_RELEASE);
+
+            fwrite(line, 1, len, stdout);
+        }
+        fflush(stdout);
+
+        vTaskDelay(pdMS_TO_TICKS(LOG_RING_DRAIN_MS));
+    }
+}
+
+esp_err_t log_ring_init(void)
+{
+#if LOG_RING_ENABLE == 1
+    for(uint32_t i = 0; i < LOG_RING_LINES; i++)
+        s_slots[i].seq = i;
+
+    TaskHandle_t task;
+    if(mem_task_create(&mem_logd, log_ring_task, NULL,
+        ESP_TASK_PRIO_MIN, &task, tskNO_AFFINITY) != pdPASS)
+        return ESP_ERR_NO_MEM;
+
+    metrics_register_task(task);
+    esp_log_set_vprintf(ring_vprintf);
+#endif
+    return ESP_OK;
+}
+
+void log_ring_get_stats(log_ring_stats_t *stats)
+{
+    stats->lines = METRICS_GET(s_stats.lines);
+    stats->dropped = METRICS_GET(s_stats.dropped);
+    stats->truncated = METRICS_GET(s_stats.truncated);
+}
+
+void log_ring_flush(uint32_t timeout_ms)
+{
+#if LOG_RING_ENABLE == 1
+    const TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+
+    while(__atomic_load_n(&s_tail, __ATOMIC_ACQUIRE) != __atomic_load_n(&s_head, __ATOMIC_RELAXED)
+        && (int32_t)(deadline - xTaskGetTickCount()) > 0)
+        vTaskDelay(pdMS_TO_TICKS(LOG_RING_DRAIN_MS));
+    // the line taken last is written after s_tail moves on
+    vTaskDelay(pdMS_TO_TICKS(LOG_RING_DRAIN_MS));
+#endif
+}
+
+uint32_t log_ring_next(uint32_t *seq, char *line, uint32_t size)
+{
+    for(;;)
+    {
+        const uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+        uint32_t pos = *seq;
+
+        // differences, the line numbers wrap around
+        if((int32_t)(head - pos) <= 0)
+            return 0;
+        if(head - pos > LOG_RING_LINES)
+            pos = head - LOG_RING_LINES;
+
+        const log_slot_t *slot = &s_slots[pos % LOG_RING_LINES];
+        if(__atomic_load_n(&slot->stamp, __ATOMIC_ACQUIRE) != pos + 1) {
+            // still written, the lines after it wait
+            if(head - pos <= LOG_RING_LINES)
+                return 0;
+            *seq = pos + 1;
+            continue;
+        }
+
+        uint32_t len = slot->len;
+        if(len >= size)
+            len = size - 1;
+        if(len > sizeof(slot->text))
+            len = sizeof(slot->text);
+        memcpy(line, slot->text, len);
+        line[len] = '\0';
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        *seq = pos + 1;
+        if(__atomic_load_n(&slot->stamp, __ATOMIC_RELAXED) == pos + 1)
+            return len;
+        // written again while copied
+    }
+}
+
+esp_err_t log_ring_set_level(const char *tag, esp_log_level_t level)
+{
+    esp_err_t err = ESP_OK;
+
+    taskENTER_CRITICAL(&s_levels_lock);
+    uint32_t i = 0;
+    while(i < s_level_count && strncmp(s_levels[i].tag, tag, LOG_RING_TAG_SIZE) != 0)
+        i++;
+
+    if(i < LOG_RING_TAGS) {
+        snprintf(s_levels[i].tag, sizeof(s_levels[i].tag), "%s", tag);
+        s_levels[i].level = level;
+        if(i == s_level_count)
+            s_level_count++;
+    } else {
+        err = ESP_ERR_NO_MEM;
+    }
+    taskEXIT_CRITICAL(&s_levels_lock);
+
+    if(err == ESP_OK)
+        esp_log_level_set(tag, level);
+    return err;
+}
+
+bool log_ring_get_level(uint32_t index, char *tag, uint32_t size, esp_log_level_t *level)
+{
+    bool found = false;
+
+    taskENTER_CRITICAL(&s_levels_lock);
+    if(index < s_level_count) {
+        snprintf(tag, size, "%s", s_levels[index].tag);
+        *level = s_levels[index].level;
+        found = true;
+    }
+    taskEXIT_CRITICAL(&s_levels_lock);
+    return found;
+}
+
+const char *log_ring_level_name(esp_log_level_t level)
+{
+    return level <= ESP_LOG_VERBOSE ? s_level_names[level] : "?";
+}
+
+esp_err_t log_ring_parse_level(const char *name, esp_log_level_t *level)
+{
+    for(int i = ESP_LOG_NONE; i <= ESP_LOG_VERBOSE; i++)
+        if(strcasecmp(name, s_level_names[i]) == 0) {
+            *level = (esp_log_level_t)i;
+            return ESP_OK;
+        }
+    return ESP_ERR_INVALID_ARG;
+}
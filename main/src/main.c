@@ -2,12 +2,25 @@
 #include "driver/ledc.h"
 #include "esp_log.h"
 #include "esp_task.h"
+#include "esp_timer.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
 
+#include "app_config.h"
+#include "battery.h"
+#include "bench.h"
+#include "creds.h"
 #include "display.h"
+#include "history.h"
+#include "mem_map.h"
+#include "log_ring.h"
+#include "metrics.h"
 #include "main.h"
 #include "measurment.h"
+#include "mqtt_pub.h"
+#include "udp_export.h"
+#include "readings.h"
+#include "stream.h"
 #include "wifi.h"
 #include "esp_partition.h"
 #include "esp_ota_ops.h"
@@ -22,11 +35,32 @@
 
 static const char *TAG_APP = "APP";
 
+typedef struct {
+    TickType_t duration;
+#if TRACE_ENABLE == 1
+    trace_t trace;
+#endif
+} buzzer_request_t;
+
 static SemaphoreHandle_t i2c_smphr;
 static QueueHandle_t sensors_queue;
 static QueueHandle_t display_queue;
-static QueueHandle_t logging_queue;
 static QueueHandle_t buzzer_queue;
+#if LOG_SENSORS_ENABLE == 1
+static QueueHandle_t logging_queue;
+#endif
+
+MEM_SEMAPHORE(mem_i2c, "i2c");
+MEM_QUEUE(mem_sensors_queue, "sensors", 1, sizeof(sensors_data_t));
+MEM_QUEUE(mem_display_queue, "display", 1, sizeof(sensors_data_t));
+#if LOG_SENSORS_ENABLE == 1
+MEM_QUEUE(mem_logging_queue, "logging", 32, sizeof(sensors_data_t));
+MEM_TASK(mem_ulog, "ulog", MEM_STACK_ULOG);
+#endif
+MEM_QUEUE(mem_buzzer_queue, "buzzer", 8, sizeof(buzzer_request_t));
+MEM_TASK(mem_disp, "disp", MEM_STACK_DISP);
+MEM_TASK(mem_buzz, "buzz", MEM_STACK_BUZZ);
+MEM_TASK(mem_meas, "meas", MEM_STACK_MEAS);
 
 static inline esp_err_t i2c_master_init(void)
 {
@@ -66,25 +100,26 @@ static void uart_log_task(void *arg)
     {
         xQueueReceive(queue, &sensors_data, portMAX_DELAY);
 
-        snprintf(buf, sizeof(buf), "%.2f,%.2f,%.2f,%.2f,%d,%d,%d;", 
+        snprintf(buf, sizeof(buf), "%.2f,%.2f,%.2f,%.2f,%d,%d,%d,%.2f,%.2f,%.2f,%.1f;", 
             sensors_data.aht21.temperature,
             sensors_data.aht21.humidity,
             sensors_data.bmp280.temperature,
             sensors_data.bmp280.pressure,
             sensors_data.ens160.aqi,
             sensors_data.ens160.tvoc,
-            sensors_data.ens160.eco2
+            sensors_data.ens160.eco2,
+            sensors_data.comfort.dew_point,
+            sensors_data.comfort.absolute_humidity,
+            sensors_data.comfort.heat_index,
+            sensors_data.comfort.altitude
         );
         fputs(buf, stdout);
     }
 }
 #endif
 
-static void buzzer_task(void *arg)
+static void buzzer_init(void)
 {
-    const QueueHandle_t queue = (QueueHandle_t) arg;
-    TickType_t duration;
-
     ledc_timer_config_t tcfg = {
         .speed_mode = LEDC_LOW_SPEED_MODE,
         .duty_resolution = LEDC_TIMER_8_BIT,
@@ -103,24 +138,83 @@ static void buzzer_task(void *arg)
         .hpoint = 0
     };
     ESP_ERROR_CHECK(ledc_channel_config(&chcfg));
+}
+
+static void buzzer_set(bool on)
+{
+    ESP_ERROR_CHECK(ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, on ? 128 : 0));
+    ESP_ERROR_CHECK(ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
+}
+
+static void buzzer_task(void *arg)
+{
+    const QueueHandle_t queue = (QueueHandle_t) arg;
+    buzzer_request_t request;
+
+    buzzer_init();
 
     while (1)
     {
-        xQueueReceive(queue, &duration, portMAX_DELAY);
+        xQueueReceive(queue, &request, portMAX_DELAY);
 
-        ESP_ERROR_CHECK(ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 128));
-        ESP_ERROR_CHECK(ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
+        buzzer_set(true);
+        TRACE_STAMP(&request.trace, TRACE_BUZZER);
 
-        vTaskDelay(duration);
+        vTaskDelay(request.duration);
 
-        ESP_ERROR_CHECK(ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0));
-        ESP_ERROR_CHECK(ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
+        buzzer_set(false);
     }
 }
 
+static bool alarm_condition(const sensors_data_t *data)
+{
+    const app_config_t *config = app_config_get();
+    return data->ens160.aqi > config->alarm_aqi && data->ens160.eco2 > config->alarm_eco2_ppm;
+}
+
+/**
+ * @brief Create a task and register it with the metrics, only if it was created
+*/
+static void start_task(mem_task_t *mem, TaskFunction_t fn, void *arg, UBaseType_t priority)
+{
+    TaskHandle_t task;
+
+    if(mem_task_create(mem, fn, arg, priority, &task, tskNO_AFFINITY) != pdPASS) {
+        ESP_LOGE(TAG_APP, "cannot create task %s", mem->name);
+        return;
+    }
+    metrics_register_task(task);
+}
+
+#if BATTERY_MODE_ENABLE == 1
+/**
+ * @brief One sample per wake, see battery.h
+*/
+static void battery_main(void)
+{
+    sensors_data_t sensors_data;
+    bool alarm = false;
+
+    if(battery_sample(i2c_smphr, &sensors_data)) {
+        alarm = alarm_condition(&sensors_data);
+        if(alarm) {
+            buzzer_init();
+            buzzer_set(true);
+            vTaskDelay(pdMS_TO_TICKS(app_config_get()->alarm_duration_ms));
+            buzzer_set(false);
+        }
+    }
+
+    battery_sleep(alarm);
+}
+#endif
+
 
 void app_main(void)
 {
+    // the console is written by a task from now on
+    ESP_ERROR_CHECK(log_ring_init());
+
     const esp_partition_t *boot_partition = esp_ota_get_boot_partition();
     ESP_LOGI("BOOT INFO", "Booted from: %s", boot_partition->label);
 
@@ -135,66 +229,99 @@ void app_main(void)
 
     vTaskDelay(pdMS_TO_TICKS(100));
 
-    i2c_smphr = xSemaphoreCreateMutex();
-    sensors_queue = xQueueCreate(1,  sizeof(sensors_data_t));
-    display_queue = xQueueCreate(1,  sizeof(sensors_data_t));
-    logging_queue = xQueueCreate(32, sizeof(sensors_data_t));
-    buzzer_queue  = xQueueCreate(8,  sizeof(TickType_t));
+    i2c_smphr = mem_mutex_create(&mem_i2c);
+    sensors_queue = mem_queue_create(&mem_sensors_queue);
+    display_queue = mem_queue_create(&mem_display_queue);
+#if LOG_SENSORS_ENABLE == 1
+    logging_queue = mem_queue_create(&mem_logging_queue);
+    assert(logging_queue != 0);
+#endif
+    buzzer_queue  = mem_queue_create(&mem_buzzer_queue);
 
     assert(i2c_smphr != NULL);
     assert(sensors_queue != 0);
     assert(display_queue != 0);
-    assert(logging_queue != 0);
+    assert(buzzer_queue != 0);
+
+    // settings are needed by the sensors, NVS is needed by the settings
+    creds_init();
+    app_config_init();
 
     ESP_LOGI(TAG_APP, "initializing I2C...");
     ESP_ERROR_CHECK(i2c_master_init());
     ESP_LOGI(TAG_APP, "...done");
 
+#if BENCH_ENABLE == 1
+    // before any other task, so nothing preempts the measurements
+    bench_run(stdout, NULL);
+#endif
+
+#if BATTERY_MODE_ENABLE == 1
+    battery_main();
+#endif
+
     display_task_config_t display_task_config = {
         .i2c_smphr = i2c_smphr,
         .queue = display_queue
     };
-    xTaskCreatePinnedToCore(display_task, "disp", 
-        4096, (void*) &display_task_config, 
-        ESP_TASK_PRIO_MIN + 2, NULL, tskNO_AFFINITY
-    );
-
-    wifi_start();
+    start_task(&mem_disp, display_task, (void*) &display_task_config, ESP_TASK_PRIO_MIN + 2);
 
 #if LOG_SENSORS_ENABLE == 1
-    xTaskCreatePinnedToCore(uart_log_task, "ulog", 
-        4096, (void*) logging_queue, 
-        ESP_TASK_PRIO_MIN + 1, NULL, tskNO_AFFINITY
-    );
+    start_task(&mem_ulog, uart_log_task, (void*) logging_queue, ESP_TASK_PRIO_MIN + 1);
 #endif
 
-    xTaskCreatePinnedToCore(buzzer_task, "buzz", 
-        1024, (void*) buzzer_queue, 
-        ESP_TASK_PRIO_MIN + 1, NULL, tskNO_AFFINITY
-    );
+    start_task(&mem_buzz, buzzer_task, (void*) buzzer_queue, ESP_TASK_PRIO_MIN + 1);
 
     measurment_task_config_t measurment_task_config = {
         .i2c_smphr = i2c_smphr,
         .sensors_queue = sensors_queue
     };
-    xTaskCreatePinnedToCore(measurment_task, "meas", 
-        2048, (void*) &measurment_task_config, 
-        ESP_TASK_PRIO_MIN + 3, NULL, tskNO_AFFINITY
-    );
+    start_task(&mem_meas, measurment_task, (void*) &measurment_task_config, ESP_TASK_PRIO_MIN + 3);
+
+    // sensing does not wait for the network
+    wifi_start();
+    mem_report();
 
     sensors_data_t sensors_data;
 
-    const TickType_t buzzer_duration = pdMS_TO_TICKS(500);
+    bool first_sample = true;
 
     while(1)
     {
         xQueueReceive(sensors_queue, &sensors_data, portMAX_DELAY);
+        TRACE_STAMP(&sensors_data.trace, TRACE_DISPATCHED);
+
+        if(first_sample) {
+            first_sample = false;
+            METRICS_SET(g_metrics.first_sample_us, (uint32_t)esp_timer_get_time());
+            ESP_LOGI(TAG_APP, "first sample in %u ms since boot", 
+                (unsigned)(METRICS_GET(g_metrics.first_sample_us) / 1000));
+        }
 
-        xQueueSend(logging_queue, &sensors_data, pdMS_TO_TICKS(50));
-        xQueueSend(display_queue, &sensors_data, pdMS_TO_TICKS(50));
+        readings_publish(&sensors_data);
+        stream_notify();
+        history_add(&sensors_data);
+        mqtt_pub_add(&sensors_data);
+        udp_export_add(&sensors_data);
+
+#if LOG_SENSORS_ENABLE == 1
+        if(xQueueSend(logging_queue, &sensors_data, pdMS_TO_TICKS(50)) != pdTRUE)
+            METRICS_INC(g_metrics.queue_overruns[METRICS_QUEUE_LOGGING]);
+#endif
+        if(xQueueSend(display_queue, &sensors_data, pdMS_TO_TICKS(50)) != pdTRUE)
+            METRICS_INC(g_metrics.queue_overruns[METRICS_QUEUE_DISPLAY]);
+
+        const app_config_t *config = app_config_get();
+        const buzzer_request_t buzzer_request = {
+            .duration = pdMS_TO_TICKS(config->alarm_duration_ms),
+#if TRACE_ENABLE == 1
+            .trace = sensors_data.trace
+#endif
+        };
 
-        if(sensors_data.ens160.aqi > 3 && sensors_data.ens160.eco2 > 1000)
-            xQueueSend(buzzer_queue, &buzzer_duration, pdMS_TO_TICKS(50));
+        if(alarm_condition(&sensors_data))
+            if(xQueueSend(buzzer_queue, &buzzer_request, pdMS_TO_TICKS(50)) != pdTRUE)
+                METRICS_INC(g_metrics.queue_overruns[METRICS_QUEUE_BUZZER]);
     }
 }
 
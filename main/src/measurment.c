@@ -1,22 +1,16 @@
 #include "measurment.h"
+#include "metrics.h"
+#include "app_config.h"
+#include "comfort.h"
 
-esp_err_t aht21_init(void);
-esp_err_t aht21_reset(void);
-esp_err_t aht21_read_data(aht21_data_t *result);
-
-esp_err_t ens160_init(void);
-esp_err_t ens160_compensate(aht21_data_t *data);
-ens160_data_t ens160_read(void);
-esp_err_t ens160_reset(void);
-
-esp_err_t bmp280_init(void);
-esp_err_t bmp280_read(bmp280_data_t *result);
+#include "esp_timer.h"
 
 void measurment_task(void *arg)
 {
     const measurment_task_config_t *config = 
         (measurment_task_config_t*) arg;
     sensors_data_t sensors_data;
+    int64_t last_us = 0;
 
     vTaskDelay(pdMS_TO_TICKS(100));
 
@@ -28,16 +22,30 @@ void measurment_task(void *arg)
     ens160_init();
     bmp280_init();
     xSemaphoreGive(config->i2c_smphr);
+
+    // the period is kept against the wake time, not the end of the previous cycle
+    TickType_t last_wake = xTaskGetTickCount();
     
     while(true)
     {
-        vTaskDelay(pdMS_TO_TICKS(INTERVAL_MEASURMENT_MS));
+        // the interval may be changed at runtime
+        const uint32_t interval_ms = app_config_get()->measurement_interval_ms;
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(interval_ms));
+
+        const int64_t now_us = esp_timer_get_time();
+        if(last_us != 0)
+            metrics_sample_period(now_us - last_us, interval_ms * 1000LL);
+        last_us = now_us;
 
         xSemaphoreTake(config->i2c_smphr, portMAX_DELAY);
         
+        TRACE_BEGIN(&sensors_data.trace);
         ESP_ERROR_CHECK(aht21_read_data(&sensors_data.aht21));    
-        if(sensors_data.aht21.crc_ok == false)
+        if(sensors_data.aht21.crc_ok == false) {
+            // skipping the sample, the bus must not stay locked (aqa_host -c)
+            xSemaphoreGive(config->i2c_smphr);
             continue;
+        }
 
         ESP_ERROR_CHECK(bmp280_read(&sensors_data.bmp280));
 
@@ -53,10 +61,16 @@ void measurment_task(void *arg)
 
         xSemaphoreGive(config->i2c_smphr);
 
+        TRACE_STAMP(&sensors_data.trace, TRACE_READ);
+
         if((sensors_data.ens160.status & 0x02) == 0x00)
             continue;
 
-        xQueueSend(config->sensors_queue, &sensors_data, pdMS_TO_TICKS(50));   
+        comfort_compute(&sensors_data);
+
+        TRACE_STAMP(&sensors_data.trace, TRACE_QUEUED);
+        if(xQueueSend(config->sensors_queue, &sensors_data, pdMS_TO_TICKS(50)) != pdTRUE)
+            METRICS_INC(g_metrics.queue_overruns[METRICS_QUEUE_SENSORS]);
     }
 }
 
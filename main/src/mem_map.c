@@ -0,0 +1,244 @@
+#include "mem_map.h"
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#ifndef CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#endif
+
+// every stack has to fit, with room left for control blocks and queues
+_Static_assert(MEM_STACK_MEAS + MEM_STACK_DISP + MEM_STACK_BUZZ + MEM_STACK_ULOG
+    + MEM_STACK_WIFI + MEM_STACK_MQTT + MEM_STACK_UDPX + MEM_STACK_OTAR
+    + MEM_STACK_OTAW + MEM_STACK_OTAP + MEM_STACK_REBOOT + MEM_STACK_LOGD <= MEM_STATIC_BUDGET,
+    "task stacks exceed MEM_STATIC_BUDGET");
+
+#if MEM_STATIC_ENABLE == 1 && !configTHREAD_LOCAL_STORAGE_DELETE_CALLBACKS
+#error "static task storage is reused from the TLS deletion callback, enable CONFIG_FREERTOS_TLSP_DELETION_CALLBACKS"
+#endif
+
+typedef enum {
+    MEM_KIND_TASK,
+    MEM_KIND_QUEUE,
+    MEM_KIND_SEMAPHORE,
+    MEM_KIND_EVENT_GROUP,
+} mem_kind_t;
+
+typedef struct {
+    const char *name;
+    uint8_t kind;
+    bool is_static;
+    uint32_t bytes;
+} mem_object_t;
+
+static const char *TAG = "MEM";
+
+static const char *const s_kinds[] = {
+    [MEM_KIND_TASK]        = "task",
+    [MEM_KIND_QUEUE]       = "queue",
+    [MEM_KIND_SEMAPHORE]   = "semaphore",
+    [MEM_KIND_EVENT_GROUP] = "event group",
+};
+
+static mem_object_t s_objects[MEM_OBJECTS_MAX];
+static uint32_t s_object_count = 0;
+static size_t s_static_bytes = 0;
+static size_t s_heap_bytes = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#ifndef CONFIG_IDF_TARGET_LINUX
+// DRAM sections of the linker script
+extern int _data_start, _data_end, _bss_start, _bss_end;
+#endif
+
+/**
+ * @brief Account an object the first time its storage is used
+*/
+static void account(bool *accounted, const char *name, mem_kind_t kind, bool is_static, size_t bytes)
+{
+    taskENTER_CRITICAL(&s_lock);
+    const bool first = !*accounted;
+    *accounted = true;
+
+    if(first) {
+        if(is_static)
+            s_static_bytes += bytes;
+        else
+            s_heap_bytes += bytes;
+
+        if(s_object_count < MEM_OBJECTS_MAX)
+            s_objects[s_object_count++] = (mem_object_t) {
+                .name = name, .kind = kind, .is_static = is_static, .bytes = bytes
+            };
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// called by the kernel when it frees the TCB, the storage may be reused
+static void task_freed(int index, void *value)
+{
+    mem_task_t *task = value;
+    __atomic_store_n(&task->busy, false, __ATOMIC_RELEASE);
+}
+
+static void task_entry(void *arg)
+{
+    mem_task_t *task = arg;
+
+    // before the task can delete itself
+    vTaskSetThreadLocalStoragePointerAndDelCallback(NULL, MEM_TLS_INDEX, task, task_freed);
+    task->fn(task->arg);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Take the storage for a new task, one-shot tasks (OTA, reboot)
+ * are started again on it once the previous one is freed
+*/
+static bool task_claim(mem_task_t *task)
+{
+    for(uint32_t waited = 0; ; waited += MEM_TASK_FREE_POLL_MS)
+    {
+        taskENTER_CRITICAL(&s_lock);
+        const bool claimed = !__atomic_load_n(&task->busy, __ATOMIC_ACQUIRE);
+        task->busy = true;
+        taskEXIT_CRITICAL(&s_lock);
+
+        if(claimed)
+            return true;
+        if(waited >= MEM_TASK_FREE_WAIT_MS)
+            return false;
+        vTaskDelay(pdMS_TO_TICKS(MEM_TASK_FREE_POLL_MS));
+    }
+}
+
+BaseType_t mem_task_create(mem_task_t *task, TaskFunction_t fn, void *arg,
+    UBaseType_t priority, TaskHandle_t *created, BaseType_t core_id)
+{
+    TaskHandle_t handle = NULL;
+
+    if(task->stack) {
+        if(!task_claim(task)) {
+            ESP_LOGE(TAG, "%s: the previous task is not freed yet", task->name);
+            return pdFAIL;
+        }
+
+        task->fn = fn;
+        task->arg = arg;
+        handle = xTaskCreateStaticPinnedToCore(task_entry, task->name, task->stack_size,
+            task, priority, task->stack, task->tcb, core_id);
+        if(handle == NULL)
+            __atomic_store_n(&task->busy, false, __ATOMIC_RELEASE);
+    } else {
+        if(xTaskCreatePinnedToCore(fn, task->name, task->stack_size,
+            arg, priority, &handle, core_id) != pdPASS)
+            handle = NULL;
+    }
+
+    if(handle == NULL)
+        return pdFAIL;
+
+    account(&task->accounted, task->name, MEM_KIND_TASK, task->stack != NULL,
+        task->stack_size + sizeof(StaticTask_t));
+    if(created)
+        *created = handle;
+    return pdPASS;
+}
+
+QueueHandle_t mem_queue_create(mem_queue_t *queue)
+{
+    QueueHandle_t handle = queue->control
+        ? xQueueCreateStatic(queue->length, queue->item_size, queue->storage, queue->control)
+        : xQueueCreate(queue->length, queue->item_size);
+
+    if(handle)
+        account(&queue->accounted, queue->name, MEM_KIND_QUEUE, queue->control != NULL,
+            queue->length * queue->item_size + sizeof(StaticQueue_t));
+    return handle;
+}
+
+SemaphoreHandle_t mem_mutex_create(mem_semaphore_t *semaphore)
+{
+    SemaphoreHandle_t handle = semaphore->control
+        ? xSemaphoreCreateMutexStatic(semaphore->control)
+        : xSemaphoreCreateMutex();
+
+    if(handle)
+        account(&semaphore->accounted, semaphore->name, MEM_KIND_SEMAPHORE,
+            semaphore->control != NULL, sizeof(StaticSemaphore_t));
+    return handle;
+}
+
+SemaphoreHandle_t mem_binary_create(mem_semaphore_t *semaphore)
+{
+    SemaphoreHandle_t handle = semaphore->control
+        ? xSemaphoreCreateBinaryStatic(semaphore->control)
+        : xSemaphoreCreateBinary();
+
+    if(handle)
+        account(&semaphore->accounted, semaphore->name, MEM_KIND_SEMAPHORE,
+            semaphore->control != NULL, sizeof(StaticSemaphore_t));
+    return handle;
+}
+
+EventGroupHandle_t mem_event_group_create(mem_event_group_t *group)
+{
+    EventGroupHandle_t handle = group->control
+        ? xEventGroupCreateStatic(group->control)
+        : xEventGroupCreate();
+
+    if(handle)
+        account(&group->accounted, group->name, MEM_KIND_EVENT_GROUP,
+            group->control != NULL, sizeof(StaticEventGroup_t));
+    return handle;
+}
+
+size_t mem_static_bytes(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    const size_t bytes = s_static_bytes;
+    taskEXIT_CRITICAL(&s_lock);
+    return bytes;
+}
+
+size_t mem_heap_bytes(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    const size_t bytes = s_heap_bytes;
+    taskEXIT_CRITICAL(&s_lock);
+    return bytes;
+}
+
+void mem_report(void)
+{
+    mem_object_t objects[MEM_OBJECTS_MAX];
+
+    taskENTER_CRITICAL(&s_lock);
+    const uint32_t count = s_object_count;
+    const size_t static_bytes = s_static_bytes;
+    const size_t heap_bytes = s_heap_bytes;
+    for(uint32_t i = 0; i < count; i++)
+        objects[i] = s_objects[i];
+    taskEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "%-12s %-12s %-7s %s", "object", "kind", "memory", "bytes");
+    for(uint32_t i = 0; i < count; i++)
+        ESP_LOGI(TAG, "%-12s %-12s %-7s %u", objects[i].name, s_kinds[objects[i].kind],
+            objects[i].is_static ? "static" : "heap", (unsigned)objects[i].bytes);
+
+    ESP_LOGI(TAG, "objects: %u bytes static of %u budgeted, %u bytes heap",
+        (unsigned)static_bytes, (unsigned)MEM_STATIC_BUDGET, (unsigned)heap_bytes);
+    if(static_bytes > MEM_STATIC_BUDGET)
+        ESP_LOGE(TAG, "static objects are %u bytes over the budget",
+            (unsigned)(static_bytes - MEM_STATIC_BUDGET));
+
+#ifndef CONFIG_IDF_TARGET_LINUX
+    ESP_LOGI(TAG, "DRAM: .data %u bytes, .bss %u bytes",
+        (unsigned)((char *)&_data_end - (char *)&_data_start),
+        (unsigned)((char *)&_bss_end - (char *)&_bss_start));
+    ESP_LOGI(TAG, "heap: %u bytes free, %u minimum, %u largest block",
+        (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+        (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+#endif
+}
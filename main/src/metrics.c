@@ -0,0 +1,74 @@
+#include "metrics.h"
+
+metrics_t g_metrics;
+
+static const uint32_t s_i2c_buckets_us[METRICS_I2C_BUCKETS] = METRICS_I2C_BUCKETS_US;
+
+static TaskHandle_t s_tasks[METRICS_MAX_TASKS];
+static uint32_t s_task_count = 0;
+
+void metrics_i2c_record(metrics_i2c_device_t dev, bool ok, uint32_t latency_us)
+{
+    metrics_i2c_t *m = &g_metrics.i2c[dev];
+
+    uint32_t bucket = 0;
+    while(bucket < METRICS_I2C_BUCKETS && latency_us > s_i2c_buckets_us[bucket])
+        bucket++;
+
+    METRICS_INC(m->transactions);
+    METRICS_ADD(m->latency_sum_us, latency_us);
+    METRICS_INC(m->buckets[bucket]);
+    if(!ok)
+        METRICS_INC(m->errors);
+}
+
+static void update_max(uint32_t *max, uint32_t value)
+{
+    uint32_t current = METRICS_GET(*max);
+    while(value > current 
+        && !__atomic_compare_exchange_n(max, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void metrics_sample_period(int64_t period_us, int64_t nominal_us)
+{
+    metrics_jitter_t *m = &g_metrics.sample_jitter;
+    const int64_t deviation = period_us - nominal_us;
+    const uint32_t jitter_us = (uint32_t)(deviation < 0 ? -deviation : deviation);
+
+    METRICS_INC(m->samples);
+    METRICS_ADD(m->jitter_sum_us, jitter_us);
+    update_max(&m->jitter_max_us, jitter_us);
+
+    METRICS_INC(m->window_samples);
+    METRICS_ADD(m->window_jitter_sum_us, jitter_us);
+    update_max(&m->window_jitter_max_us, jitter_us);
+}
+
+void metrics_jitter_window_reset(void)
+{
+    metrics_jitter_t *m = &g_metrics.sample_jitter;
+
+    METRICS_SET(m->window_samples, 0);
+    METRICS_SET(m->window_jitter_sum_us, 0);
+    METRICS_SET(m->window_jitter_max_us, 0);
+}
+
+void metrics_register_task(TaskHandle_t task)
+{
+    if(task == NULL || s_task_count >= METRICS_MAX_TASKS)
+        return;
+
+    s_tasks[s_task_count] = task;
+    METRICS_SET(s_task_count, s_task_count + 1);
+}
+
+uint32_t metrics_get_tasks(TaskHandle_t *tasks, uint32_t max)
+{
+    const uint32_t count = METRICS_GET(s_task_count);
+    uint32_t i;
+
+    for(i = 0; i < count && i < max; i++)
+        tasks[i] = s_tasks[i];
+
+    return i;
+}
@@ -0,0 +1,324 @@
+#include "mqtt_pub.h"
+#include "history.h"
+#include "json_writer.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+#include "mem_map.h"
+
+#define MQTT_TOPIC_SIZE     48
+
+// without a broker the buffers below shrink to a single element
+#define MQTT_ENABLED        (sizeof(MQTT_BROKER_URI) > 1)
+#define MQTT_QUEUE_SLOTS    (MQTT_ENABLED ? MQTT_QUEUE_CAPACITY : 1)
+#define MQTT_BATCH_SLOTS    (MQTT_ENABLED ? MQTT_BATCH_MAX : 1)
+
+// a JSON sample takes up to ~200 bytes
+#define MQTT_PAYLOAD_SIZE   (MQTT_ENABLED ? MQTT_BATCH_MAX * 204 + 2 : 1)
+
+#define MQTT_WAIT_POLL_MS   50
+
+#define CONNECTED_BIT       BIT0
+#define ACK_BIT             BIT1
+
+static const char *TAG = "MQTT";
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// sequence numbers: s_tail is the oldest queued sample, s_head the next one
+static history_record_t s_queue[MQTT_QUEUE_SLOTS];
+static uint32_t s_head = 0;
+static uint32_t s_tail = 0;
+static uint32_t s_dropped = 0;
+
+static uint32_t s_published = 0;
+static uint32_t s_messages = 0;
+
+static esp_mqtt_client_handle_t s_client = NULL;
+static TaskHandle_t s_task = NULL;
+static EventGroupHandle_t s_events = NULL;
+static volatile int s_acked_msg_id = -1;
+
+MEM_TASK(mem_mqtt, "mqtt", MEM_STACK_MQTT);
+MEM_EVENT_GROUP(mem_mqtt_events, "mqtt");
+
+static char s_topic_samples[MQTT_TOPIC_SIZE];
+static char s_topic_status[MQTT_TOPIC_SIZE];
+static char s_payload[MQTT_PAYLOAD_SIZE];
+
+static void queue_push(history_record_t *record, bool keep_seq)
+{
+    taskENTER_CRITICAL(&s_lock);
+    if(keep_seq && s_head == s_tail)
+        s_head = s_tail = record->seq;
+    record->seq = s_head;
+    s_queue[s_head % MQTT_QUEUE_SLOTS] = *record;
+    s_head++;
+    if(s_head - s_tail > MQTT_QUEUE_SLOTS) {
+        s_tail++;
+        s_dropped++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    if(s_task)
+        xTaskNotifyGive(s_task);
+}
+
+void mqtt_pub_add(const sensors_data_t *data)
+{
+    history_record_t record;
+
+    // nothing would ever publish it
+    if(s_client == NULL)
+        return;
+
+    history_pack(&record, data, esp_timer_get_time());
+    queue_push(&record, false);
+}
+
+void mqtt_pub_add_record(const history_record_t *record)
+{
+    history_record_t copy = *record;
+
+    if(s_client == NULL)
+        return;
+
+    queue_push(&copy, true);
+}
+
+bool mqtt_pub_wait_sent(uint32_t timeout_ms)
+{
+    const TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+
+    if(s_client == NULL)
+        return false;
+
+    while(true)
+    {
+        taskENTER_CRITICAL(&s_lock);
+        const bool empty = s_head == s_tail;
+        taskEXIT_CRITICAL(&s_lock);
+
+        if(empty)
+            return true;
+        if((int32_t)(deadline - xTaskGetTickCount()) <= 0)
+            return false;
+        vTaskDelay(pdMS_TO_TICKS(MQTT_WAIT_POLL_MS));
+    }
+}
+
+/**
+ * @brief Copy up to `max` oldest samples without removing them
+*/
+static uint32_t queue_peek(history_record_t *records, uint32_t max)
+{
+    uint32_t n = 0;
+
+    taskENTER_CRITICAL(&s_lock);
+    for(uint32_t seq = s_tail; seq != s_head && n < max; seq++)
+        records[n++] = s_queue[seq % MQTT_QUEUE_SLOTS];
+    taskEXIT_CRITICAL(&s_lock);
+
+    return n;
+}
+
+/**
+ * @brief Remove samples up to `end_seq`, some may have been dropped meanwhile
+*/
+static void queue_release(uint32_t end_seq)
+{
+    taskENTER_CRITICAL(&s_lock);
+    if((int32_t)(end_seq - s_tail) > 0)
+        s_tail = end_seq;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static int serialize(const history_record_t *records, uint32_t count)
+{
+#if MQTT_PAYLOAD_BINARY == 1
+    memcpy(s_payload, records, count * sizeof(history_record_t));
+    return count * sizeof(history_record_t);
+#else
+    json_writer_t w;
+    json_writer_init(&w, s_payload, sizeof(s_payload));
+
+    json_array_begin(&w, NULL);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const history_record_t *r = &records[i];
+
+        json_object_begin(&w, NULL);
+        json_add_uint(&w, "seq", r->seq);
+        json_add_uint(&w, "t", r->time_s);
+        json_add_float(&w, "temperature", r->temperature / 100.0f, 2);
+        json_add_float(&w, "humidity", r->humidity / 100.0f, 2);
+        json_add_float(&w, "pressure", r->pressure / 10.0f, 1);
+        json_add_uint(&w, "aqi", r->aqi);
+        json_add_uint(&w, "tvoc", r->tvoc);
+        json_add_uint(&w, "eco2", r->eco2);
+
+        comfort_data_t c;
+        history_comfort(r, &c);
+        json_add_float(&w, "dew_point", c.dew_point, 2);
+        json_add_float(&w, "absolute_humidity", c.absolute_humidity, 2);
+        json_add_float(&w, "heat_index", c.heat_index, 2);
+        json_add_float(&w, "altitude", c.altitude, 1);
+        json_object_end(&w);
+    }
+    json_array_end(&w);
+
+    return json_writer_finish(&w);
+#endif
+}
+
+/**
+ * @brief Publish one batch from the queue head
+ * @return false if nothing was sent
+*/
+static bool publish_batch(void)
+{
+    static history_record_t records[MQTT_BATCH_SLOTS];
+
+    const uint32_t count = queue_peek(records, MQTT_BATCH_SLOTS);
+    if(count == 0)
+        return false;
+
+    const int len = serialize(records, count);
+    if(len < 0) {
+        ESP_LOGE(TAG, "payload buffer is too small");
+        return false;
+    }
+
+    xEventGroupClearBits(s_events, ACK_BIT);
+
+    const int msg_id = esp_mqtt_client_publish(s_client, s_topic_samples, s_payload, len, MQTT_QOS, 0);
+    if(msg_id < 0)
+        return false;
+
+#if MQTT_QOS > 0
+    // one batch in flight keeps the order and bounds the memory of the client
+    const TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(MQTT_ACK_TIMEOUT_MS);
+    while(s_acked_msg_id != msg_id)
+    {
+        const TickType_t now = xTaskGetTickCount();
+        if((int32_t)(deadline - now) <= 0 || !(xEventGroupGetBits(s_events) & CONNECTED_BIT))
+            return false;
+        xEventGroupWaitBits(s_events, ACK_BIT, pdTRUE, pdFALSE, deadline - now);
+    }
+#endif
+
+    queue_release(records[count - 1].seq + 1);
+    METRICS_ADD(s_published, count);
+    METRICS_INC(s_messages);
+
+    return true;
+}
+
+static void mqtt_task(void *arg)
+{
+    while(true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while((xEventGroupGetBits(s_events) & CONNECTED_BIT) && publish_batch());
+    }
+}
+
+static void mqtt_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    const esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t) event_data;
+
+    switch(event_id)
+    {
+    case MQTT_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "connected to the broker");
+        esp_mqtt_client_publish(s_client, s_topic_status, "online", 0, 1, 1);
+        xEventGroupSetBits(s_events, CONNECTED_BIT);
+        // replay what was queued meanwhile
+        xTaskNotifyGive(s_task);
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        ESP_LOGW(TAG, "disconnected from the broker");
+        xEventGroupClearBits(s_events, CONNECTED_BIT);
+        // wake up a publisher waiting for an acknowledgement
+        xEventGroupSetBits(s_events, ACK_BIT);
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        s_acked_msg_id = event->msg_id;
+        xEventGroupSetBits(s_events, ACK_BIT);
+        break;
+    default:
+        break;
+    }
+}
+
+void mqtt_pub_start(void)
+{
+    uint8_t mac[6];
+
+    if(!MQTT_ENABLED || s_client != NULL)
+        return;
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(s_topic_samples, sizeof(s_topic_samples), MQTT_TOPIC_PREFIX "/%02x%02x%02x/samples", 
+        mac[3], mac[4], mac[5]);
+    snprintf(s_topic_status, sizeof(s_topic_status), MQTT_TOPIC_PREFIX "/%02x%02x%02x/status", 
+        mac[3], mac[4], mac[5]);
+
+    s_events = mem_event_group_create(&mem_mqtt_events);
+
+    const esp_mqtt_client_config_t config = {
+        .broker.address.uri = MQTT_BROKER_URI,
+        .session.last_will = {
+            .topic = s_topic_status,
+            .msg = "offline",
+            .qos = 1,
+            .retain = 1,
+        },
+    };
+
+    s_client = esp_mqtt_client_init(&config);
+    if(s_client == NULL || s_events == NULL) {
+        ESP_LOGE(TAG, "init failed");
+        return;
+    }
+
+    TaskHandle_t task;
+    if(mem_task_create(&mem_mqtt, mqtt_task, NULL, 
+        ESP_TASK_PRIO_MIN + 1, &task, tskNO_AFFINITY) != pdPASS)
+    {
+        ESP_LOGE(TAG, "cannot create task");
+        esp_mqtt_client_destroy(s_client);
+        s_client = NULL;
+        return;
+    }
+    s_task = task;
+    metrics_register_task(s_task);
+
+    esp_mqtt_client_register_event(s_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    esp_mqtt_client_start(s_client);
+
+    ESP_LOGI(TAG, "publishing to %s at %s", s_topic_samples, MQTT_BROKER_URI);
+}
+
+void mqtt_pub_get_stats(mqtt_pub_stats_t *stats)
+{
+    taskENTER_CRITICAL(&s_lock);
+    stats->queued = s_head - s_tail;
+    stats->dropped = s_dropped;
+    taskEXIT_CRITICAL(&s_lock);
+
+    stats->published = METRICS_GET(s_published);
+    stats->messages = METRICS_GET(s_messages);
+    stats->connected = s_events && (xEventGroupGetBits(s_events) & CONNECTED_BIT) ? 1 : 0;
+}
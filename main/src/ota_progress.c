@@ -0,0 +1,117 @@
+#include "ota.h"
+#include "metrics.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char* TAG = "OTA";
+
+static bool s_busy = false;
+
+// progress of the running update, shared by push and pull mode
+static portMUX_TYPE s_progress_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_progress_bytes;
+static uint32_t s_progress_base;
+static uint32_t s_progress_total;
+static int64_t s_progress_start_us;
+static bool s_progress_started;
+
+void ota_throttle_init(ota_throttle_t *t)
+{
+    t->start_us = esp_timer_get_time();
+    t->bytes = 0;
+}
+
+void ota_throttle(ota_throttle_t *t, size_t flash_bytes)
+{
+    t->bytes += flash_bytes;
+
+    const int64_t due_us = (int64_t)t->bytes * 1000000 / (OTA_FLASH_RATE_LIMIT_KBPS * 1024);
+    const int64_t ahead_us = due_us - (esp_timer_get_time() - t->start_us);
+    const TickType_t ticks = ahead_us / (portTICK_PERIOD_MS * 1000);
+
+    if(ticks > 0)
+        vTaskDelay(ticks);
+}
+
+bool ota_acquire(void)
+{
+    if(__atomic_exchange_n(&s_busy, true, __ATOMIC_ACQUIRE))
+        return false;
+
+    portENTER_CRITICAL(&s_progress_mux);
+    s_progress_bytes = 0;
+    s_progress_total = 0;
+    s_progress_started = false;
+    portEXIT_CRITICAL(&s_progress_mux);
+
+    // sample jitter is reported for the time of the update
+    metrics_jitter_window_reset();
+
+    return true;
+}
+
+void ota_release(void)
+{
+    __atomic_store_n(&s_busy, false, __ATOMIC_RELEASE);
+}
+
+void ota_progress_set(uint32_t bytes, uint32_t total)
+{
+    const int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_progress_mux);
+    if(!s_progress_started) {
+        s_progress_started = true;
+        s_progress_base = bytes;
+        s_progress_start_us = now_us;
+    }
+    s_progress_bytes = bytes;
+    s_progress_total = total;
+    portEXIT_CRITICAL(&s_progress_mux);
+}
+
+void ota_get_progress(ota_progress_t *progress)
+{
+    uint32_t base;
+    int64_t start_us;
+    bool started;
+
+    portENTER_CRITICAL(&s_progress_mux);
+    progress->bytes = s_progress_bytes;
+    progress->total = s_progress_total;
+    base = s_progress_base;
+    start_us = s_progress_start_us;
+    started = s_progress_started;
+    portEXIT_CRITICAL(&s_progress_mux);
+
+    progress->state = METRICS_GET(g_metrics.ota_state);
+    progress->bytes_per_s = 0;
+    progress->elapsed_s = 0;
+    progress->eta_s = -1;
+
+    if(!started)
+        return;
+
+    const int64_t elapsed_us = esp_timer_get_time() - start_us;
+    progress->elapsed_s = elapsed_us / 1000000;
+
+    if(elapsed_us > 0)
+        progress->bytes_per_s = (uint64_t)(progress->bytes - base) * 1000000 / elapsed_us;
+
+    if(progress->state == OTA_STATE_RECEIVING && progress->total && progress->bytes_per_s)
+        progress->eta_s = (progress->total - progress->bytes) / progress->bytes_per_s;
+}
+
+void ota_log_jitter(void)
+{
+    const metrics_jitter_t *jitter = &g_metrics.sample_jitter;
+    const uint32_t samples = METRICS_GET(jitter->window_samples);
+
+    ESP_LOGI(TAG, "sample period jitter during the update: max %u us, mean %u us over %u samples",
+        (unsigned)METRICS_GET(jitter->window_jitter_max_us),
+        samples ? (unsigned)(METRICS_GET(jitter->window_jitter_sum_us) / samples) : 0,
+        (unsigned)samples);
+}
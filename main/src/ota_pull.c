@@ -0,0 +1,401 @@
+#include "ota.h"
+#include "main.h"
+#include "mem_map.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_task.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+
+#define OTA_PULL_NVS_NAMESPACE  "ota_pull"
+
+/**
+ * Download state, persisted in NVS so it survives a reboot
+*/
+typedef struct {
+    char url[OTA_PULL_URL_MAX];
+    uint8_t sha256[32];
+    char partition[17];
+    uint32_t offset;    // bytes written to the partition, sector aligned
+    uint32_t total;     // image size, 0 until the server told it
+} ota_pull_state_t;
+
+static const char* TAG = "OTA_PULL";
+
+MEM_TASK(mem_otap, "otap", MEM_STACK_OTAP);
+
+static ota_pull_state_t s_state;
+static ota_throttle_t s_throttle;
+static char s_buf[OTA_PULL_BUF_SIZE];
+
+// total size announced by the Content-Range of the last response
+static uint32_t s_range_total;
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    if(evt->event_id == HTTP_EVENT_ON_HEADER 
+        && strcasecmp(evt->header_key, "Content-Range") == 0)
+    {
+        const char *slash = strchr(evt->header_value, '/');
+        s_range_total = (slash && slash[1] != '*') ? strtoul(slash + 1, NULL, 10) : 0;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t state_save(void)
+{
+    nvs_handle_t nvs;
+
+    esp_err_t err = nvs_open(OTA_PULL_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if(err != ESP_OK)
+        return err;
+
+    err = nvs_set_blob(nvs, "state", &s_state, sizeof(s_state));
+    if(err == ESP_OK)
+        err = nvs_commit(nvs);
+
+    nvs_close(nvs);
+    return err;
+}
+
+static bool state_load(ota_pull_state_t *state)
+{
+    nvs_handle_t nvs;
+    size_t size = sizeof(*state);
+
+    if(nvs_open(OTA_PULL_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+        return false;
+
+    esp_err_t err = nvs_get_blob(nvs, "state", state, &size);
+    nvs_close(nvs);
+
+    return err == ESP_OK && size == sizeof(*state) && state->url[0] != '\0';
+}
+
+static void state_clear(void)
+{
+    nvs_handle_t nvs;
+
+    memset(&s_state, 0, sizeof(s_state));
+
+    if(nvs_open(OTA_PULL_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+        return;
+
+    nvs_erase_key(nvs, "state");
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static bool parse_sha256(const char *hex, uint8_t *out)
+{
+    if(strlen(hex) != 64)
+        return false;
+
+    for(int i = 0; i < 32; i++)
+    {
+        char byte[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+        char *end;
+        out[i] = (uint8_t) strtoul(byte, &end, 16);
+        if(*end != '\0')
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Fetch one Range request and write it to the partition
+*/
+static esp_err_t fetch_range(esp_http_client_handle_t client, const esp_partition_t *partition)
+{
+    char range[48];
+    uint32_t last = s_state.offset + OTA_PULL_RANGE_SIZE - 1;
+    if(s_state.total && last >= s_state.total)
+        last = s_state.total - 1;
+
+    snprintf(range, sizeof(range), "bytes=%u-%u", (unsigned)s_state.offset, (unsigned)last);
+    esp_http_client_set_header(client, "Range", range);
+
+    s_range_total = 0;
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if(err != ESP_OK)
+        return err;
+
+    const int64_t length = esp_http_client_fetch_headers(client);
+    const int status = esp_http_client_get_status_code(client);
+
+    if(status == 200 && s_state.offset != 0) {
+        ESP_LOGE(TAG, "server does not support Range requests");
+        err = ESP_ERR_NOT_SUPPORTED;
+        goto out;
+    }
+
+    if(status == 200) {
+        s_state.total = length > 0 ? (uint32_t)length : 0;
+    } else if(status == 206) {
+        if(s_range_total == 0) {
+            err = ESP_ERR_INVALID_RESPONSE;
+            goto out;
+        }
+        s_state.total = s_range_total;
+    } else {
+        ESP_LOGE(TAG, "unexpected HTTP status %d", status);
+        err = ESP_ERR_INVALID_RESPONSE;
+        goto out;
+    }
+
+    if(s_state.total == 0 || s_state.total > partition->size) {
+        ESP_LOGE(TAG, "bad image size %u", (unsigned)s_state.total);
+        err = ESP_ERR_INVALID_SIZE;
+        goto out;
+    }
+
+    uint32_t offset = s_state.offset;
+    uint32_t erased = s_state.offset;
+
+    while(true)
+    {
+        const int len = esp_http_client_read(client, s_buf, sizeof(s_buf));
+        if(len < 0) {
+            err = ESP_FAIL;
+            goto out;
+        }
+        if(len == 0)
+            break;
+
+        if(offset + len > s_state.total) {
+            err = ESP_ERR_INVALID_SIZE;
+            goto out;
+        }
+
+        while(erased < offset + len) {
+            err = esp_partition_erase_range(partition, erased, SPI_FLASH_SEC_SIZE);
+            if(err != ESP_OK)
+                goto out;
+            erased += SPI_FLASH_SEC_SIZE;
+            ota_throttle(&s_throttle, SPI_FLASH_SEC_SIZE);
+        }
+
+        err = esp_partition_write(partition, offset, s_buf, len);
+        if(err != ESP_OK)
+            goto out;
+
+        offset += len;
+        METRICS_SET(g_metrics.ota_bytes, offset);
+        ota_progress_set(offset, s_state.total);
+        ota_throttle(&s_throttle, len);
+    }
+
+    if(offset != last + 1 && offset != s_state.total) {
+        ESP_LOGW(TAG, "short range: %u of %u bytes", 
+            (unsigned)(offset - s_state.offset), (unsigned)(last + 1 - s_state.offset));
+        // keep only complete sectors, the rest is fetched again
+        offset &= ~(SPI_FLASH_SEC_SIZE - 1);
+        err = ESP_ERR_INVALID_SIZE;
+    }
+
+    if(offset > s_state.offset) {
+        s_state.offset = offset;
+        state_save();
+    }
+
+out:
+    esp_http_client_close(client);
+    return err;
+}
+
+static esp_err_t verify_image(const esp_partition_t *partition)
+{
+    mbedtls_sha256_context ctx;
+    uint8_t digest[32];
+    esp_err_t err = ESP_OK;
+
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+
+    for(uint32_t pos = 0; pos < s_state.total; pos += sizeof(s_buf))
+    {
+        const size_t len = MIN(sizeof(s_buf), s_state.total - pos);
+        err = esp_partition_read(partition, pos, s_buf, len);
+        if(err != ESP_OK)
+            break;
+        mbedtls_sha256_update(&ctx, (const unsigned char *)s_buf, len);
+    }
+
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+
+    if(err == ESP_OK && memcmp(digest, s_state.sha256, sizeof(digest)) != 0)
+        err = ESP_ERR_INVALID_CRC;
+
+    return err;
+}
+
+static void ota_pull_task(void *arg)
+{
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    esp_err_t err = ESP_OK;
+    int retries = 0;
+
+    if(partition == NULL || strcmp(partition->label, s_state.partition) != 0) {
+        ESP_LOGE(TAG, "update partition changed, download dropped");
+        err = ESP_ERR_NOT_FOUND;
+        goto done;
+    }
+
+    esp_http_client_config_t config = {
+        .url = s_state.url,
+        .timeout_ms = 10000,
+        .keep_alive_enable = true,
+        .event_handler = http_event_handler,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if(client == NULL) {
+        err = ESP_ERR_NO_MEM;
+        goto done;
+    }
+
+    METRICS_SET(g_metrics.ota_state, OTA_STATE_RECEIVING);
+    ota_progress_set(s_state.offset, s_state.total);
+    ota_throttle_init(&s_throttle);
+    ESP_LOGI(TAG, "downloading %s from offset %u", s_state.url, (unsigned)s_state.offset);
+
+    while(s_state.total == 0 || s_state.offset < s_state.total)
+    {
+        const uint32_t before = s_state.offset;
+
+        err = fetch_range(client, partition);
+        if(err == ESP_OK) {
+            retries = 0;
+            ESP_LOGI(TAG, "%u/%u bytes", (unsigned)s_state.offset, (unsigned)s_state.total);
+            continue;
+        }
+
+        // resuming would only fail the same way on every connection
+        if(err == ESP_ERR_NOT_SUPPORTED) {
+            esp_http_client_cleanup(client);
+            goto done;
+        }
+
+        if(s_state.offset == before && ++retries > OTA_PULL_MAX_RETRIES)
+            break;
+
+        ESP_LOGW(TAG, "range failed (%s), retrying", esp_err_to_name(err));
+        vTaskDelay(pdMS_TO_TICKS(OTA_PULL_RETRY_DELAY_MS));
+    }
+
+    esp_http_client_cleanup(client);
+
+    if(err != ESP_OK) {
+        // the state is kept: the download continues after a reboot
+        ESP_LOGE(TAG, "download stopped at %u bytes: %s", 
+            (unsigned)s_state.offset, esp_err_to_name(err));
+        METRICS_SET(g_metrics.ota_state, OTA_STATE_FAILED);
+        ota_release();
+        vTaskDelete(NULL);
+        return;
+    }
+
+    METRICS_SET(g_metrics.ota_state, OTA_STATE_VALIDATING);
+
+    err = verify_image(partition);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "image hash mismatch, download dropped");
+        goto done;
+    }
+
+    // validates the image structure as well
+    err = esp_ota_set_boot_partition(partition);
+
+done:
+    state_clear();
+
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "update failed: %s", esp_err_to_name(err));
+        METRICS_SET(g_metrics.ota_state, OTA_STATE_FAILED);
+        ota_release();
+        vTaskDelete(NULL);
+        return;
+    }
+
+    METRICS_SET(g_metrics.ota_state, OTA_STATE_DONE);
+    ota_progress_t progress;
+    ota_get_progress(&progress);
+    // rate and time since the last resume
+    ESP_LOGI(TAG, "update successful, %u KB/s over %u s",
+        (unsigned)(progress.bytes_per_s / 1024), (unsigned)progress.elapsed_s);
+    ota_log_jitter();
+    reboot_task(NULL);
+}
+
+static esp_err_t start_task(void)
+{
+    if(mem_task_create(&mem_otap, ota_pull_task, NULL, 
+        ESP_TASK_PRIO_MIN + 1, NULL, tskNO_AFFINITY) != pdPASS)
+    {
+        ota_release();
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_pull_start(const char *url, const char *sha256_hex)
+{
+    uint8_t sha256[32];
+
+    if(strlen(url) >= OTA_PULL_URL_MAX || !parse_sha256(sha256_hex, sha256))
+        return ESP_ERR_INVALID_ARG;
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if(partition == NULL)
+        return ESP_ERR_NOT_FOUND;
+
+    if(!ota_acquire())
+        return ESP_ERR_INVALID_STATE;
+
+    // the same image again: keep what is already downloaded
+    if(!state_load(&s_state) || strcmp(s_state.url, url) != 0 
+        || memcmp(s_state.sha256, sha256, sizeof(sha256)) != 0
+        || strcmp(s_state.partition, partition->label) != 0)
+    {
+        memset(&s_state, 0, sizeof(s_state));
+        strcpy(s_state.url, url);
+        memcpy(s_state.sha256, sha256, sizeof(sha256));
+        strcpy(s_state.partition, partition->label);
+    }
+
+    esp_err_t err = state_save();
+    if(err != ESP_OK) {
+        ota_release();
+        return err;
+    }
+
+    return start_task();
+}
+
+void ota_pull_resume(void)
+{
+    ota_pull_state_t state;
+
+    // s_state belongs to a running download until ota_acquire()
+    if(!state_load(&state))
+        return;
+
+    if(!ota_acquire())
+        return;
+
+    s_state = state;
+
+    ESP_LOGI(TAG, "resuming interrupted download");
+    start_task();
+}
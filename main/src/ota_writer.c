@@ -0,0 +1,443 @@
+#include "ota.h"
+#include "mem_map.h"
+#include "metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_app_format.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_rom_crc.h"
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp32/rom/miniz.h"
+
+// below the measurement task, flash work must not delay a sample
+#define OTA_WRITER_PRIORITY   (ESP_TASK_PRIO_MIN + 2)
+
+#define GZIP_HEADER_SIZE      10
+#define GZIP_TRAILER_SIZE     8
+#define GZIP_FLAG_FHCRC       0x02
+#define GZIP_FLAG_FEXTRA      0x04
+#define GZIP_FLAG_FNAME       0x08
+#define GZIP_FLAG_FCOMMENT    0x10
+
+typedef struct {
+    char *buf;
+    size_t len;     // 0 - no more data
+} ota_chunk_t;
+
+/**
+ * Inflate state of a gzip image: the decompressor and its 32 KiB
+ * circular window, allocated only for the time of the update.
+*/
+typedef struct {
+    tinfl_decompressor inflator;
+    uint8_t dict[TINFL_LZ_DICT_SIZE];
+    size_t dict_ofs;
+    bool stream_done;
+    uint8_t trailer[GZIP_TRAILER_SIZE];
+    size_t trailer_len;
+    uint32_t crc;
+} ota_gzip_t;
+
+static const char* TAG = "OTA";
+
+static char s_bufs[OTA_BUF_COUNT][OTA_BUF_SIZE];
+
+static QueueHandle_t s_free_queue = NULL;
+static QueueHandle_t s_full_queue = NULL;
+static SemaphoreHandle_t s_done = NULL;
+
+MEM_TASK(mem_otaw, "otaw", MEM_STACK_OTAW);
+MEM_QUEUE(mem_ota_free, "ota free", OTA_BUF_COUNT, sizeof(char*));
+MEM_QUEUE(mem_ota_full, "ota full", OTA_BUF_COUNT + 1, sizeof(ota_chunk_t));
+MEM_SEMAPHORE(mem_ota_done, "ota done");
+
+static const esp_partition_t *s_partition;
+static esp_ota_handle_t s_handle;
+static size_t s_image_size;
+static size_t s_consumed;
+static size_t s_written;
+static ota_gzip_t *s_gzip = NULL;
+static size_t s_erased;
+static volatile esp_err_t s_err;
+static volatile bool s_abort;
+static int64_t s_start_us;
+static ota_throttle_t s_throttle;
+
+static esp_err_t erase_sector(void)
+{
+    esp_err_t err = esp_partition_erase_range(s_partition, s_erased, SPI_FLASH_SEC_SIZE);
+    if(err != ESP_OK)
+        return err;
+
+    s_erased += SPI_FLASH_SEC_SIZE;
+    ota_throttle(&s_throttle, SPI_FLASH_SEC_SIZE);
+    return ESP_OK;
+}
+
+/**
+ * @brief Flash `len` bytes of the plain image at the write position
+*/
+static esp_err_t write_data(const uint8_t *data, size_t len)
+{
+    esp_err_t err;
+
+    if(s_written == 0 && data[0] != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "not an application image");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+
+    if(s_written + len > s_partition->size)
+        return ESP_ERR_INVALID_SIZE;
+
+    while(s_erased < s_written + len) {
+        err = erase_sector();
+        if(err != ESP_OK)
+            return err;
+    }
+
+    err = esp_ota_write_with_offset(s_handle, data, len, s_written);
+    if(err != ESP_OK)
+        return err;
+
+    s_written += len;
+    METRICS_SET(g_metrics.ota_bytes, s_written);
+    ota_throttle(&s_throttle, len);
+
+    return ESP_OK;
+}
+
+/**
+ * @return size of the gzip header, 0 if it is not complete or invalid
+*/
+static size_t gzip_header_size(const uint8_t *data, size_t len)
+{
+    if(len < GZIP_HEADER_SIZE || data[2] != 8 /* deflate */)
+        return 0;
+
+    const uint8_t flags = data[3];
+    size_t pos = GZIP_HEADER_SIZE;
+
+    if(flags & GZIP_FLAG_FEXTRA) {
+        if(pos + 2 > len)
+            return 0;
+        pos += 2 + (data[pos] | (data[pos + 1] << 8));
+    }
+
+    for(uint8_t flag = GZIP_FLAG_FNAME; flag <= GZIP_FLAG_FCOMMENT; flag <<= 1)
+    {
+        if((flags & flag) == 0)
+            continue;
+        while(pos < len && data[pos] != 0)
+            pos++;
+        pos++;
+    }
+
+    if(flags & GZIP_FLAG_FHCRC)
+        pos += 2;
+
+    return pos <= len ? pos : 0;
+}
+
+static esp_err_t gzip_begin(const uint8_t *data, size_t len, size_t *header_size)
+{
+    *header_size = gzip_header_size(data, len);
+    if(*header_size == 0) {
+        ESP_LOGE(TAG, "unsupported gzip header");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    s_gzip = malloc(sizeof(ota_gzip_t));
+    if(s_gzip == NULL)
+        return ESP_ERR_NO_MEM;
+
+    tinfl_init(&s_gzip->inflator);
+    s_gzip->dict_ofs = 0;
+    s_gzip->stream_done = false;
+    s_gzip->trailer_len = 0;
+    s_gzip->crc = 0;
+
+    ESP_LOGI(TAG, "compressed image, inflating");
+    return ESP_OK;
+}
+
+static void gzip_end(void)
+{
+    free(s_gzip);
+    s_gzip = NULL;
+}
+
+static esp_err_t gzip_write(const uint8_t *data, size_t len)
+{
+    ota_gzip_t *gz = s_gzip;
+
+    while(!gz->stream_done)
+    {
+        size_t in_bytes = len;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - gz->dict_ofs;
+
+        tinfl_status status = tinfl_decompress(&gz->inflator, 
+            data, &in_bytes, 
+            gz->dict, gz->dict + gz->dict_ofs, &out_bytes, 
+            TINFL_FLAG_HAS_MORE_INPUT
+        );
+
+        data += in_bytes;
+        len -= in_bytes;
+
+        if(out_bytes > 0) {
+            esp_err_t err = write_data(gz->dict + gz->dict_ofs, out_bytes);
+            if(err != ESP_OK)
+                return err;
+
+            gz->crc = esp_rom_crc32_le(gz->crc, gz->dict + gz->dict_ofs, out_bytes);
+            gz->dict_ofs = (gz->dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if(status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "inflate failed: %d", status);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        if(status == TINFL_STATUS_DONE)
+            gz->stream_done = true;
+        else if(status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0)
+            break;
+    }
+
+    // the rest is the trailer: CRC32 and size of the plain image
+    while(len > 0) {
+        if(gz->trailer_len == GZIP_TRAILER_SIZE)
+            return ESP_ERR_INVALID_SIZE;
+        gz->trailer[gz->trailer_len++] = *data++;
+        len--;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t gzip_finish(void)
+{
+    ota_gzip_t *gz = s_gzip;
+
+    if(!gz->stream_done || gz->trailer_len != GZIP_TRAILER_SIZE) {
+        ESP_LOGE(TAG, "compressed image is truncated");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const uint32_t crc = gz->trailer[0] | (gz->trailer[1] << 8) 
+        | (gz->trailer[2] << 16) | ((uint32_t)gz->trailer[3] << 24);
+    const uint32_t size = gz->trailer[4] | (gz->trailer[5] << 8) 
+        | (gz->trailer[6] << 16) | ((uint32_t)gz->trailer[7] << 24);
+
+    if(crc != gz->crc || size != s_written) {
+        ESP_LOGE(TAG, "inflated image does not match: crc %08x/%08x, size %u/%u",
+            (unsigned)gz->crc, (unsigned)crc, (unsigned)s_written, (unsigned)size);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t write_chunk(const ota_chunk_t *chunk)
+{
+    const uint8_t *data = (const uint8_t *) chunk->buf;
+    size_t len = chunk->len;
+    esp_err_t err;
+
+    if(s_consumed + len > s_image_size)
+        return ESP_ERR_INVALID_SIZE;
+
+    const int percent_before = s_consumed * 100 / s_image_size / OTA_PROGRESS_STEP_PERCENT;
+
+    if(s_consumed == 0 && len >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+        size_t header_size;
+        err = gzip_begin(data, len, &header_size);
+        if(err != ESP_OK)
+            return err;
+        data += header_size;
+        len -= header_size;
+    }
+
+    err = s_gzip ? gzip_write(data, len) : write_data(data, len);
+    if(err != ESP_OK)
+        return err;
+
+    s_consumed += chunk->len;
+    ota_progress_set(s_consumed, s_image_size);
+
+    const int percent_after = s_consumed * 100 / s_image_size / OTA_PROGRESS_STEP_PERCENT;
+    if(percent_after != percent_before)
+        ESP_LOGI(TAG, "received %d%% (%u/%u bytes)", 
+            percent_after * OTA_PROGRESS_STEP_PERCENT,
+            (unsigned)s_consumed, (unsigned)s_image_size);
+
+    return ESP_OK;
+}
+
+static void ota_writer_task(void *arg)
+{
+    ota_chunk_t chunk;
+
+    while(true)
+    {
+        const bool erase_ahead = s_err == ESP_OK 
+            && s_erased < s_partition->size
+            && s_erased < s_written + OTA_ERASE_AHEAD_SECTORS * SPI_FLASH_SEC_SIZE;
+
+        // while the receiver fills the next buffer prepare flash for it
+        if(xQueueReceive(s_full_queue, &chunk, erase_ahead ? 0 : portMAX_DELAY) != pdTRUE) {
+            esp_err_t err = erase_sector();
+            if(err != ESP_OK)
+                s_err = err;
+            continue;
+        }
+
+        if(chunk.len == 0)
+            break;
+
+        if(s_err == ESP_OK && !s_abort)
+            s_err = write_chunk(&chunk);
+
+        xQueueSend(s_free_queue, &chunk.buf, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_writer_begin(const esp_partition_t *partition, size_t image_size)
+{
+    if(s_free_queue == NULL) {
+        s_free_queue = mem_queue_create(&mem_ota_free);
+        s_full_queue = mem_queue_create(&mem_ota_full);
+        s_done = mem_binary_create(&mem_ota_done);
+        if(!s_free_queue || !s_full_queue || !s_done)
+            return ESP_ERR_NO_MEM;
+    }
+
+    xQueueReset(s_free_queue);
+    xQueueReset(s_full_queue);
+    for(int i = 0; i < OTA_BUF_COUNT; i++)
+    {
+        char *buf = s_bufs[i];
+        xQueueSend(s_free_queue, &buf, 0);
+    }
+
+    // flash is erased by the writer just ahead of the data
+    esp_err_t err = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &s_handle);
+    if(err != ESP_OK)
+        return err;
+
+    s_partition = partition;
+    s_image_size = image_size;
+    s_consumed = 0;
+    s_written = 0;
+    s_erased = 0;
+    ota_throttle_init(&s_throttle);
+    s_err = ESP_OK;
+    s_abort = false;
+    s_start_us = esp_timer_get_time();
+
+    if(mem_task_create(&mem_otaw, ota_writer_task, NULL, 
+        OTA_WRITER_PRIORITY, NULL, tskNO_AFFINITY) != pdPASS)
+    {
+        esp_ota_abort(s_handle);
+        return ESP_ERR_NO_MEM;
+    }
+
+    METRICS_SET(g_metrics.ota_state, OTA_STATE_RECEIVING);
+    METRICS_SET(g_metrics.ota_bytes, 0);
+    ota_progress_set(0, image_size);
+
+    return ESP_OK;
+}
+
+char *ota_writer_get_buffer(void)
+{
+    char *buf = NULL;
+
+    if(s_err != ESP_OK)
+        return NULL;
+
+    xQueueReceive(s_free_queue, &buf, portMAX_DELAY);
+
+    return s_err == ESP_OK ? buf : NULL;
+}
+
+esp_err_t ota_writer_submit(char *buf, size_t len)
+{
+    ota_chunk_t chunk = { .buf = buf, .len = len };
+
+    if(len == 0)
+        return ESP_ERR_INVALID_SIZE;
+
+    xQueueSend(s_full_queue, &chunk, portMAX_DELAY);
+
+    return s_err;
+}
+
+static void stop_writer(void)
+{
+    ota_chunk_t chunk = { .buf = NULL, .len = 0 };
+
+    xQueueSend(s_full_queue, &chunk, portMAX_DELAY);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+}
+
+esp_err_t ota_writer_end(void)
+{
+    stop_writer();
+
+    esp_err_t err = s_err;
+    if(err == ESP_OK && s_consumed != s_image_size)
+        err = ESP_ERR_INVALID_SIZE;
+
+    const bool compressed = s_gzip != NULL;
+    if(err == ESP_OK && compressed)
+        err = gzip_finish();
+    gzip_end();
+
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "writing failed: %s", esp_err_to_name(err));
+        esp_ota_abort(s_handle);
+        METRICS_SET(g_metrics.ota_state, OTA_STATE_FAILED);
+        return err;
+    }
+
+    METRICS_SET(g_metrics.ota_state, OTA_STATE_VALIDATING);
+
+    err = esp_ota_end(s_handle);
+    if(err != ESP_OK) {
+        METRICS_SET(g_metrics.ota_state, OTA_STATE_FAILED);
+        return err;
+    }
+
+    const int64_t elapsed_us = esp_timer_get_time() - s_start_us;
+    ESP_LOGI(TAG, "%u bytes received, %u bytes written in %d ms, %u KB/s",
+        (unsigned)s_consumed, (unsigned)s_written, (int)(elapsed_us / 1000),
+        elapsed_us > 0 ? (unsigned)((uint64_t)s_consumed * 1000000 / 1024 / elapsed_us) : 0
+    );
+    ota_log_jitter();
+    if(compressed)
+        ESP_LOGI(TAG, "compression saved %u bytes on air (%u%%)",
+            (unsigned)(s_written - s_consumed),
+            (unsigned)((uint64_t)(s_written - s_consumed) * 100 / s_written));
+
+    return ESP_OK;
+}
+
+void ota_writer_abort(void)
+{
+    s_abort = true;
+    stop_writer();
+    gzip_end();
+    esp_ota_abort(s_handle);
+    METRICS_SET(g_metrics.ota_state, OTA_STATE_FAILED);
+}
@@ -0,0 +1,36 @@
+#include "readings.h"
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static sensors_data_t s_latest;
+static int64_t s_timestamp_us;
+static uint32_t s_seq = 0;
+
+void readings_publish(const sensors_data_t *data)
+{
+    const int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&s_lock);
+    s_latest = *data;
+    s_timestamp_us = now;
+    s_seq++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t readings_get_latest(sensors_data_t *data, int64_t *timestamp_us)
+{
+    uint32_t seq;
+
+    taskENTER_CRITICAL(&s_lock);
+    seq = s_seq;
+    if(data)
+        *data = s_latest;
+    if(timestamp_us)
+        *timestamp_us = s_timestamp_us;
+    taskEXIT_CRITICAL(&s_lock);
+
+    return seq;
+}
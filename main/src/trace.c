@@ -0,0 +1,137 @@
+#include "trace.h"
+#include "metrics.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+
+static trace_histogram_t s_histograms[TRACE_POINTS];
+static trace_histogram_t s_stages[TRACE_POINTS];
+
+static const char *const s_names[TRACE_POINTS] = {
+    [TRACE_TRIGGER]    = "trigger",
+    [TRACE_READ]       = "read",
+    [TRACE_QUEUED]     = "queued",
+    [TRACE_DISPATCHED] = "dispatched",
+    [TRACE_DISPLAYED]  = "displayed",
+    [TRACE_BUZZER]     = "buzzer",
+};
+
+static const trace_point_t s_previous[TRACE_POINTS] = {
+    [TRACE_TRIGGER]    = TRACE_TRIGGER,
+    [TRACE_READ]       = TRACE_TRIGGER,
+    [TRACE_QUEUED]     = TRACE_READ,
+    [TRACE_DISPATCHED] = TRACE_QUEUED,
+    [TRACE_DISPLAYED]  = TRACE_DISPATCHED,
+    [TRACE_BUZZER]     = TRACE_DISPATCHED,
+};
+
+static inline uint32_t now_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static inline uint32_t bucket_of(uint32_t latency_us)
+{
+    if(latency_us == 0)
+        return 0;
+
+    const uint32_t bucket = 31 - __builtin_clz(latency_us);
+    return bucket < TRACE_BUCKETS ? bucket : TRACE_BUCKETS - 1;
+}
+
+void trace_begin(trace_t *trace)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->us[TRACE_TRIGGER] = now_us();
+}
+
+static void account(trace_histogram_t *h, uint32_t latency)
+{
+    METRICS_INC(h->count);
+    METRICS_INC(h->buckets[bucket_of(latency)]);
+
+    uint32_t max = METRICS_GET(h->max_us);
+    while(latency > max
+        && !__atomic_compare_exchange_n(&h->max_us, &max, latency, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void trace_stamp(trace_t *trace, trace_point_t point)
+{
+    const uint32_t now = now_us();
+
+    trace->us[point] = now;
+
+    account(&s_histograms[point], now - trace->us[TRACE_TRIGGER]);
+    account(&s_stages[point], now - trace->us[s_previous[point]]);
+}
+
+const char *trace_point_name(trace_point_t point)
+{
+    return point < TRACE_POINTS ? s_names[point] : "?";
+}
+
+trace_point_t trace_previous(trace_point_t point)
+{
+    return point < TRACE_POINTS ? s_previous[point] : TRACE_TRIGGER;
+}
+
+static void copy(const trace_histogram_t *h, trace_histogram_t *histogram)
+{
+    histogram->count = METRICS_GET(h->count);
+    histogram->max_us = METRICS_GET(h->max_us);
+    for(int i = 0; i < TRACE_BUCKETS; i++)
+        histogram->buckets[i] = METRICS_GET(h->buckets[i]);
+}
+
+void trace_get(trace_point_t point, trace_histogram_t *histogram)
+{
+    copy(&s_histograms[point], histogram);
+}
+
+void trace_get_stage(trace_point_t point, trace_histogram_t *histogram)
+{
+    copy(&s_stages[point], histogram);
+}
+
+uint32_t trace_percentile_us(const trace_histogram_t *histogram, uint32_t percent)
+{
+    uint32_t total = 0;
+    for(int i = 0; i < TRACE_BUCKETS; i++)
+        total += histogram->buckets[i];
+
+    if(total == 0)
+        return 0;
+
+    const uint64_t rank = ((uint64_t)total * percent + 99) / 100;
+    uint64_t seen = 0;
+    for(int i = 0; i < TRACE_BUCKETS - 1; i++) {
+        seen += histogram->buckets[i];
+        if(seen >= rank) {
+            const uint32_t upper = (2u << i) - 1;
+            return upper < histogram->max_us ? upper : histogram->max_us;
+        }
+    }
+
+    return histogram->max_us;
+}
+
+void trace_print(FILE *out)
+{
+    trace_histogram_t h;
+
+    fprintf(out, "%-13s %10s %10s %10s %10s   %-11s %10s %10s %10s\n", "since trigger", "count",
+        "p50 us", "p99 us", "max us", "stage from", "p50 us", "p99 us", "max us");
+    for(int point = TRACE_READ; point < TRACE_POINTS; point++)
+    {
+        trace_histogram_t stage;
+
+        trace_get(point, &h);
+        trace_get_stage(point, &stage);
+        fprintf(out, "%-13s %10u %10u %10u %10u   %-11s %10u %10u %10u\n", trace_point_name(point),
+            (unsigned)h.count, (unsigned)trace_percentile_us(&h, 50),
+            (unsigned)trace_percentile_us(&h, 99), (unsigned)h.max_us,
+            trace_point_name(trace_previous(point)), (unsigned)trace_percentile_us(&stage, 50),
+            (unsigned)trace_percentile_us(&stage, 99), (unsigned)stage.max_us);
+    }
+}
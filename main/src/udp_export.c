@@ -0,0 +1,321 @@
+#include "udp_export.h"
+#include "history.h"
+#include "mem_map.h"
+#include "metrics.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_sntp.h"
+#include "esp_task.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+
+#define UDP_EXPORT_QUEUE_LEN    (UDP_EXPORT_BATCH_SAMPLES * 2)
+
+// a rendered sample takes up to ~400 bytes (Graphite)
+#define UDP_EXPORT_LINE_MAX     512
+
+// 2020-01-01, anything earlier means the clock is not set yet
+#define WALL_CLOCK_VALID_S      1577836800
+
+#define UDP_EXPORT_FLUSH_POLL_MS 10
+
+typedef struct {
+    history_record_t record;
+    int64_t epoch_ms;       // 0 - unknown
+    bool flush;             // no sample, send the batch at once
+} udp_sample_t;
+
+static const char *TAG = "UDP_EXPORT";
+
+static QueueHandle_t s_queue = NULL;
+static char s_device[8];
+static char s_datagram[UDP_EXPORT_DATAGRAM_SIZE];
+
+MEM_TASK(mem_udpx, "udpx", MEM_STACK_UDPX);
+MEM_QUEUE(mem_udpx_queue, "udpx", UDP_EXPORT_QUEUE_LEN, sizeof(udp_sample_t));
+
+static udp_export_stats_t s_stats;
+static uint32_t s_flushes = 0;
+
+void udp_export_add(const sensors_data_t *data)
+{
+    udp_sample_t sample;
+    struct timeval tv;
+
+    if(s_queue == NULL)
+        return;
+
+    history_pack(&sample.record, data, esp_timer_get_time());
+
+    gettimeofday(&tv, NULL);
+    sample.epoch_ms = tv.tv_sec >= WALL_CLOCK_VALID_S ? tv.tv_sec * 1000LL + tv.tv_usec / 1000 : 0;
+
+    sample.flush = false;
+
+    if(xQueueSend(s_queue, &sample, 0) != pdTRUE)
+        METRICS_INC(s_stats.dropped_samples);
+}
+
+bool udp_export_add_record(const history_record_t *record, int64_t epoch_ms, uint32_t timeout_ms)
+{
+    const udp_sample_t sample = {
+        .record = *record,
+        .epoch_ms = epoch_ms,
+    };
+
+    if(s_queue == NULL)
+        return false;
+
+    if(xQueueSend(s_queue, &sample, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        METRICS_INC(s_stats.dropped_samples);
+        return false;
+    }
+    return true;
+}
+
+bool udp_export_flush(uint32_t timeout_ms)
+{
+    const udp_sample_t marker = { .flush = true };
+    const TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+
+    if(s_queue == NULL)
+        return false;
+
+    const uint32_t done = METRICS_GET(s_flushes) + 1;
+    if(xQueueSend(s_queue, &marker, pdMS_TO_TICKS(timeout_ms)) != pdTRUE)
+        return false;
+
+    // the task handles one marker at a time, in the order they were queued
+    while((int32_t)(METRICS_GET(s_flushes) - done) < 0)
+    {
+        if((int32_t)(deadline - xTaskGetTickCount()) <= 0)
+            return false;
+        vTaskDelay(pdMS_TO_TICKS(UDP_EXPORT_FLUSH_POLL_MS));
+    }
+    return true;
+}
+
+static int render(char *buf, size_t size, const udp_sample_t *sample)
+{
+    const history_record_t *r = &sample->record;
+    const int whole_temperature = r->temperature / 100;
+    const int frac_temperature = (r->temperature < 0 ? -r->temperature : r->temperature) % 100;
+    const char *sign = r->temperature < 0 && whole_temperature == 0 ? "-" : "";
+    comfort_data_t c;
+
+    history_comfort(r, &c);
+
+#if UDP_EXPORT_GRAPHITE == 1
+    char ts[16] = "-1";
+    if(sample->epoch_ms)
+        snprintf(ts, sizeof(ts), "%lld", (long long)(sample->epoch_ms / 1000));
+
+    return snprintf(buf, size,
+        UDP_EXPORT_MEASUREMENT ".%s.temperature %s%d.%02d %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.humidity %u.%02u %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.pressure %u.%u %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.aqi %u %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.tvoc %u %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.eco2 %u %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.dew_point %.2f %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.absolute_humidity %.2f %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.heat_index %.2f %s\n"
+        UDP_EXPORT_MEASUREMENT ".%s.altitude %.1f %s\n",
+        s_device, sign, whole_temperature, frac_temperature, ts,
+        s_device, r->humidity / 100, r->humidity % 100, ts,
+        s_device, r->pressure / 10, r->pressure % 10, ts,
+        s_device, r->aqi, ts,
+        s_device, r->tvoc, ts,
+        s_device, r->eco2, ts,
+        s_device, c.dew_point, ts,
+        s_device, c.absolute_humidity, ts,
+        s_device, c.heat_index, ts,
+        s_device, c.altitude, ts);
+#else
+    char ts[24] = "";
+    if(sample->epoch_ms)
+        snprintf(ts, sizeof(ts), " %lld000000", (long long)sample->epoch_ms);
+
+    return snprintf(buf, size,
+        UDP_EXPORT_MEASUREMENT ",device=%s "
+        "temperature=%s%d.%02d,humidity=%u.%02u,pressure=%u.%u,aqi=%ui,tvoc=%ui,eco2=%ui,"
+        "dew_point=%.2f,absolute_humidity=%.2f,heat_index=%.2f,altitude=%.1f%s\n",
+        s_device, sign, whole_temperature, frac_temperature,
+        r->humidity / 100, r->humidity % 100,
+        r->pressure / 10, r->pressure % 10,
+        r->aqi, r->tvoc, r->eco2,
+        c.dew_point, c.absolute_humidity, c.heat_index, c.altitude, ts);
+#endif
+}
+
+static bool resolve(struct sockaddr_in *addr)
+{
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *res = NULL;
+
+    if(getaddrinfo(UDP_EXPORT_HOST, NULL, &hints, &res) != 0 || res == NULL) {
+        ESP_LOGW(TAG, "cannot resolve " UDP_EXPORT_HOST);
+        return false;
+    }
+
+    memcpy(addr, res->ai_addr, sizeof(*addr));
+    addr->sin_port = htons(UDP_EXPORT_PORT);
+    freeaddrinfo(res);
+
+    return true;
+}
+
+typedef struct {
+    int sock;
+    struct sockaddr_in addr;
+    bool resolved;
+    size_t len;
+    uint32_t samples;
+    TickType_t start;
+} udp_batch_t;
+
+static void flush(udp_batch_t *batch)
+{
+    if(batch->samples == 0)
+        return;
+
+    if(!batch->resolved)
+        batch->resolved = resolve(&batch->addr);
+
+    // never wait for the network stack, a lost datagram is counted instead
+    if(!batch->resolved || sendto(batch->sock, s_datagram, batch->len, MSG_DONTWAIT, 
+        (struct sockaddr *)&batch->addr, sizeof(batch->addr)) < 0) 
+    {
+        METRICS_INC(s_stats.dropped_datagrams);
+        batch->resolved = false;
+    } else {
+        METRICS_INC(s_stats.datagrams);
+    }
+
+    batch->len = 0;
+    batch->samples = 0;
+}
+
+// arg - the socket, created by udp_export_start()
+static void udp_export_task(void *arg)
+{
+    udp_batch_t batch = { .sock = (int)(intptr_t)arg };
+    char line[UDP_EXPORT_LINE_MAX];
+    udp_sample_t sample;
+
+    while(true)
+    {
+        TickType_t wait = portMAX_DELAY;
+        if(batch.samples) {
+            const TickType_t age = xTaskGetTickCount() - batch.start;
+            const TickType_t limit = pdMS_TO_TICKS(UDP_EXPORT_BATCH_INTERVAL_MS);
+            wait = age < limit ? limit - age : 0;
+        }
+
+        if(xQueueReceive(s_queue, &sample, wait) != pdTRUE) {
+            // the oldest sample of the batch waited long enough
+            const int64_t start_us = esp_timer_get_time();
+            flush(&batch);
+            METRICS_ADD(s_stats.render_us, (uint32_t)(esp_timer_get_time() - start_us));
+            continue;
+        }
+
+        const int64_t start_us = esp_timer_get_time();
+
+        if(sample.flush) {
+            flush(&batch);
+            METRICS_INC(s_flushes);
+            continue;
+        }
+
+        const int len = render(line, sizeof(line), &sample);
+        if(len <= 0 || len >= (int)sizeof(line)) {
+            ESP_LOGE(TAG, "line buffer is too small");
+            continue;
+        }
+
+        if(batch.len + len > sizeof(s_datagram))
+            flush(&batch);
+
+        if(batch.samples == 0)
+            batch.start = xTaskGetTickCount();
+        memcpy(s_datagram + batch.len, line, len);
+        batch.len += len;
+        batch.samples++;
+        METRICS_INC(s_stats.samples);
+
+        // without the wall clock batched samples would get the same arrival time
+        const uint32_t batch_max = sample.epoch_ms ? UDP_EXPORT_BATCH_SAMPLES : 1;
+        if(batch.samples >= batch_max)
+            flush(&batch);
+
+        METRICS_ADD(s_stats.render_us, (uint32_t)(esp_timer_get_time() - start_us));
+    }
+}
+
+void udp_export_start(void)
+{
+    uint8_t mac[6];
+
+    if(strlen(UDP_EXPORT_HOST) == 0 || s_queue != NULL)
+        return;
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(s_device, sizeof(s_device), "%02x%02x%02x", mac[3], mac[4], mac[5]);
+
+    if(!esp_sntp_enabled()) {
+        esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
+        esp_sntp_setservername(0, UDP_EXPORT_NTP_SERVER);
+        esp_sntp_init();
+    }
+
+    const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if(sock < 0) {
+        ESP_LOGE(TAG, "cannot create socket");
+        return;
+    }
+
+    s_queue = mem_queue_create(&mem_udpx_queue);
+    if(s_queue == NULL) {
+        close(sock);
+        return;
+    }
+
+    // s_queue stays NULL unless the task runs, so nothing is queued for nobody
+    TaskHandle_t task;
+    if(mem_task_create(&mem_udpx, udp_export_task, (void *)(intptr_t)sock, 
+        ESP_TASK_PRIO_MIN + 1, &task, tskNO_AFFINITY) != pdPASS)
+    {
+        ESP_LOGE(TAG, "cannot create task");
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        close(sock);
+        return;
+    }
+    metrics_register_task(task);
+
+    ESP_LOGI(TAG, "pushing to " UDP_EXPORT_HOST ":%d", UDP_EXPORT_PORT);
+}
+
+void udp_export_get_stats(udp_export_stats_t *stats)
+{
+    stats->samples = METRICS_GET(s_stats.samples);
+    stats->datagrams = METRICS_GET(s_stats.datagrams);
+    stats->dropped_samples = METRICS_GET(s_stats.dropped_samples);
+    stats->dropped_datagrams = METRICS_GET(s_stats.dropped_datagrams);
+    stats->render_us = METRICS_GET(s_stats.render_us);
+}
@@ -1,13 +1,63 @@
 #include "web.h"
+#include "stream.h"
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "lwip/sockets.h"
 
 static const char* TAG = "WEB";
 
+/**
+ * Stream clients keep their sockets, the 4 others serve regular requests;
+ * past them a new connection is refused rather than a stream closed.
+ * lwIP needs 3 more for the server itself (CONFIG_LWIP_MAX_SOCKETS),
+ * plus the MQTT, UDP export and OTA pull sockets.
+*/
+#define WEB_MAX_OPEN_SOCKETS    (STREAM_MAX_CLIENTS + 4)
+
 extern esp_err_t save_post_handler(httpd_req_t *req);
 extern esp_err_t root_get_handler(httpd_req_t *req);
 extern esp_err_t update_firmware_handler(httpd_req_t *req);
+extern esp_err_t api_current_get_handler(httpd_req_t *req);
+extern esp_err_t api_status_get_handler(httpd_req_t *req);
+extern esp_err_t api_stream_get_handler(httpd_req_t *req);
+extern esp_err_t api_history_get_handler(httpd_req_t *req);
+extern esp_err_t metrics_get_handler(httpd_req_t *req);
+extern esp_err_t api_ota_pull_post_handler(httpd_req_t *req);
+extern esp_err_t api_ota_get_handler(httpd_req_t *req);
+extern esp_err_t api_config_get_handler(httpd_req_t *req);
+extern esp_err_t api_config_post_handler(httpd_req_t *req);
+extern esp_err_t api_trace_get_handler(httpd_req_t *req);
+extern esp_err_t api_i2c_recording_get_handler(httpd_req_t *req);
+extern esp_err_t api_i2c_replay_post_handler(httpd_req_t *req);
+extern esp_err_t api_logs_get_handler(httpd_req_t *req);
+
+static const httpd_uri_t s_handlers[] = {
+    { .uri = "/", .method = HTTP_GET, .handler = root_get_handler },
+    { .uri = "/save", .method = HTTP_POST, .handler = save_post_handler },
+    { .uri = "/update", .method = HTTP_POST, .handler = update_firmware_handler },
+    { .uri = "/api/v1/current", .method = HTTP_GET, .handler = api_current_get_handler },
+    { .uri = "/api/v1/status", .method = HTTP_GET, .handler = api_status_get_handler },
+    { .uri = "/api/v1/stream", .method = HTTP_GET, .handler = api_stream_get_handler },
+    { .uri = "/api/v1/history", .method = HTTP_GET, .handler = api_history_get_handler },
+    { .uri = "/metrics", .method = HTTP_GET, .handler = metrics_get_handler },
+    { .uri = "/api/v1/ota/pull", .method = HTTP_POST, .handler = api_ota_pull_post_handler },
+    { .uri = "/api/v1/ota", .method = HTTP_GET, .handler = api_ota_get_handler },
+    { .uri = "/api/v1/config", .method = HTTP_GET, .handler = api_config_get_handler },
+    { .uri = "/api/v1/config", .method = HTTP_POST, .handler = api_config_post_handler },
+    { .uri = "/api/v1/trace", .method = HTTP_GET, .handler = api_trace_get_handler },
+    { .uri = "/api/v1/i2c/recording", .method = HTTP_GET, .handler = api_i2c_recording_get_handler },
+    { .uri = "/api/v1/i2c/replay", .method = HTTP_POST, .handler = api_i2c_replay_post_handler },
+    { .uri = "/api/v1/logs", .method = HTTP_GET, .handler = api_logs_get_handler },
+};
+
+#define HANDLER_COUNT (sizeof(s_handlers) / sizeof(s_handlers[0]))
+
+static void close_session(httpd_handle_t hd, int sockfd)
+{
+    stream_forget(sockfd);
+    close(sockfd);
+}
 
 httpd_handle_t start_webserver(void)
 {
@@ -15,36 +65,23 @@ httpd_handle_t start_webserver(void)
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
+    config.max_uri_handlers = HANDLER_COUNT;
+    config.max_open_sockets = WEB_MAX_OPEN_SOCKETS;
+    // no LRU purge: stream sockets never send another request, they would go first
+    config.lru_purge_enable = false;
+    config.close_fn = close_session;
 
     httpd_handle_t server = NULL;
 
-     if (httpd_start(&server, &config) == ESP_OK) {
-        httpd_uri_t root = {
-            .uri = "/",
-            .method = HTTP_GET,
-            .handler = root_get_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &root);
-
-        httpd_uri_t save = {
-            .uri = "/save",
-            .method = HTTP_POST,
-            .handler = save_post_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &save);
-
-        httpd_uri_t updfirm = {
-            .uri = "/update",
-            .method = HTTP_POST,
-            .handler = update_firmware_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &updfirm);
+    if (httpd_start(&server, &config) == ESP_OK) {
+        for (size_t i = 0; i < HANDLER_COUNT; i++) {
+            esp_err_t err = httpd_register_uri_handler(server, &s_handlers[i]);
+            if (err != ESP_OK)
+                ESP_LOGE(TAG, "cannot register %s: %s", s_handlers[i].uri, esp_err_to_name(err));
+        }
     }
 
     ESP_LOGI(TAG, "...done");
 
     return server;
-}
\ No newline at end of file
+}
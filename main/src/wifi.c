@@ -1,64 +1,369 @@
 #include "creds.h"
 #include "wifi.h"
 #include "web.h"
+#include "mem_map.h"
+#include "metrics.h"
+#include "ota.h"
+#include "mqtt_pub.h"
+#include "udp_export.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "esp_log.h"
+#include "esp_random.h"
+#include "esp_task.h"
+#include "esp_timer.h"
 #include "esp_netif.h"
 #include "esp_wifi.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 
 static const char *TAG = "WIFI";
 
 static EventGroupHandle_t s_wifi_event_group;
 
 #define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT      BIT1
 
-static int s_retry_num = 0;
+/**
+ * Connection manager state, changed from the default event loop
+ * and, once at boot, from the wifi task
+*/
+static SemaphoreHandle_t s_lock = NULL;
+static esp_timer_handle_t s_retry_timer = NULL;
+static esp_netif_t *s_ap_netif = NULL;
+static uint32_t s_attempt = 0;
+static int64_t s_down_since_us = 0;   // 0 - connected
+static bool s_ap_fallback = false;
+static bool s_got_ip_once = false;
+
+// scan results, only read by on_scan_done() in the event loop
+static wifi_ap_record_t s_scan_records[WIFI_SCAN_MAX_APS];
+
+MEM_TASK(mem_wifi, "wifi", MEM_STACK_WIFI);
+MEM_EVENT_GROUP(mem_wifi_events, "wifi");
+MEM_SEMAPHORE(mem_wifi_lock, "wifi");
+
+/**
+ * Known networks and the candidates of the current connection round,
+ * ordered by signal strength. A candidate seen by the scan (or cached 
+ * from the last connection) is connected to directly by its BSSID.
+*/
+typedef struct {
+    int network;
+    uint8_t bssid[6];
+    uint8_t channel;    // 0 - no directed connect
+} wifi_candidate_t;
+
+static wifi_network_t s_networks[CREDS_MAX_NETWORKS];
+static int s_network_count = 0;
+static wifi_candidate_t s_candidates[CREDS_MAX_NETWORKS];
+static int s_candidate_count = 0;
+static int s_candidate_pos = 0;
+static bool s_cached_round = false;
+
+static void start_ap(wifi_mode_t mode)
+{
+    if(s_ap_netif == NULL) {
+        s_ap_netif = esp_netif_create_default_wifi_ap();
+        assert(s_ap_netif);
+    }
+
+    wifi_config_t wifi_config = {
+        .ap = {
+            .ssid = WIFI_AP_SSID,
+            .password = WIFI_AP_PASSWORD,
+            .ssid_len = strlen(WIFI_AP_SSID),
+            .channel = WIFI_AP_CHANNEL,
+            .authmode = WIFI_AUTH_WPA2_PSK,
+            .max_connection = WIFI_AP_MAX_CONN,
+            .pmf_cfg = {
+                .required = false,
+            },
+        },
+    };
+
+    if(strlen(WIFI_AP_PASSWORD) == 0)
+        wifi_config.ap.authmode = WIFI_AUTH_OPEN;
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(mode));
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_AP, &wifi_config));
+
+    // the log is readable over HTTP, the password stays out of it
+    ESP_LOGI(TAG, "WIFI AP started: %s (%s)", WIFI_AP_SSID,
+        wifi_config.ap.authmode == WIFI_AUTH_OPEN ? "open" : "password protected");
+}
+
+/**
+ * @brief Delay before the next connection attempt: exponential backoff
+ * with jitter, so devices behind one router do not retry in lockstep
+*/
+static uint32_t backoff_ms(uint32_t attempt)
+{
+    uint32_t delay = WIFI_BACKOFF_MAX_MS;
+
+    if(attempt < 16)
+        delay = MIN((uint32_t)WIFI_BACKOFF_MIN_MS << attempt, (uint32_t)WIFI_BACKOFF_MAX_MS);
+
+    // random in [delay / 2, delay]
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+static void connect_candidate(const wifi_candidate_t *candidate)
+{
+    const wifi_network_t *network = &s_networks[candidate->network];
+
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = "",
+            .password = "",
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .pmf_cfg = {
+                .capable = true,
+                .required = false
+            },
+        },
+    };
+
+    strncpy((char*)wifi_config.sta.ssid, network->ssid, sizeof(wifi_config.sta.ssid));
+    strncpy((char*)wifi_config.sta.password, network->pass, sizeof(wifi_config.sta.password));
+
+    if(candidate->channel != 0) {
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, candidate->bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = candidate->channel;
+    }
+
+    ESP_LOGI(TAG, "connecting to %s%s", network->ssid, candidate->channel ? " (directed)" : "");
+
+    esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+    esp_wifi_connect();
+}
+
+/**
+ * @brief Try the next candidate, start a new round with a scan when all failed
+*/
+static void connect_next(void)
+{
+    if(s_candidate_pos < s_candidate_count) {
+        connect_candidate(&s_candidates[s_candidate_pos++]);
+        return;
+    }
+
+    s_cached_round = false;
+
+    esp_err_t err = esp_wifi_scan_start(NULL, false);
+    if(err != ESP_OK) {
+        ESP_LOGW(TAG, "scan failed: %s", esp_err_to_name(err));
+        esp_timer_start_once(s_retry_timer, backoff_ms(s_attempt++) * 1000ULL);
+    }
+}
+
+/**
+ * @brief Order the known networks by the signal strength seen by the scan,
+ * networks not seen (e.g. hidden) are tried last with a regular connect
+*/
+static void on_scan_done(void)
+{
+    uint16_t count = 0;
+    esp_wifi_scan_get_ap_num(&count);
+    count = MIN(count, WIFI_SCAN_MAX_APS);
+
+    wifi_ap_record_t *records = s_scan_records;
+    esp_wifi_scan_get_ap_records(&count, records);
+
+    int8_t rssi[CREDS_MAX_NETWORKS];
+
+    s_candidate_count = 0;
+    for(int n = 0; n < s_network_count; n++)
+    {
+        wifi_candidate_t *candidate = &s_candidates[s_candidate_count++];
+        candidate->network = n;
+        candidate->channel = 0;
+        rssi[n] = INT8_MIN;
+
+        for(int r = 0; r < count; r++)
+        {
+            if(strcmp((const char*)records[r].ssid, s_networks[n].ssid) != 0 || records[r].rssi <= rssi[n])
+                continue;
+            rssi[n] = records[r].rssi;
+            memcpy(candidate->bssid, records[r].bssid, sizeof(candidate->bssid));
+            candidate->channel = records[r].primary;
+        }
+    }
+
+    // insertion sort, a handful of entries
+    for(int i = 1; i < s_candidate_count; i++)
+    {
+        const wifi_candidate_t c = s_candidates[i];
+        int j = i;
+        for(; j > 0 && rssi[s_candidates[j - 1].network] < rssi[c.network]; j--)
+            s_candidates[j] = s_candidates[j - 1];
+        s_candidates[j] = c;
+    }
+
+    s_candidate_pos = 0;
+    connect_next();
+}
+
+static void retry_timer_cb(void *arg)
+{
+    METRICS_INC(g_metrics.wifi_reconnects);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    connect_next();
+    xSemaphoreGive(s_lock);
+}
+
+static void on_disconnected(void)
+{
+    const int64_t now_us = esp_timer_get_time();
+
+    if(s_down_since_us == 0) {
+        s_down_since_us = now_us;
+        METRICS_SET(g_metrics.wifi_connected, 0);
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    }
+
+    // a long outage: make the device reachable through its own AP meanwhile
+    if(!s_ap_fallback && now_us - s_down_since_us >= WIFI_AP_FALLBACK_AFTER_MS * 1000LL) {
+        ESP_LOGW(TAG, "no connection for %d s, starting fallback AP",
+            (int)((now_us - s_down_since_us) / 1000000));
+        start_ap(WIFI_MODE_APSTA);
+        s_ap_fallback = true;
+        METRICS_INC(g_metrics.wifi_ap_fallbacks);
+    }
+
+    // the next candidate at once, a new round after a backoff
+    uint32_t delay = WIFI_NEXT_CANDIDATE_DELAY_MS;
+    if(s_candidate_pos >= s_candidate_count && !s_cached_round) {
+        delay = backoff_ms(s_attempt++);
+        ESP_LOGI(TAG, "retry to connect to the AP in %u ms (attempt %u)",
+            (unsigned)delay, (unsigned)s_attempt);
+    }
+
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, delay * 1000ULL);
+}
+
+static void on_connected(void)
+{
+    wifi_ap_record_t ap_info;
+
+    if(!s_got_ip_once) {
+        s_got_ip_once = true;
+        METRICS_SET(g_metrics.first_ip_us, (uint32_t)esp_timer_get_time());
+        ESP_LOGI(TAG, "boot to IP in %u ms", (unsigned)(METRICS_GET(g_metrics.first_ip_us) / 1000));
+    }
+
+    // remember the access point for a directed connect next time
+    if(esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        creds_network_connected((const char*)ap_info.ssid, ap_info.bssid, ap_info.primary);
+        s_network_count = load_wifi_networks(s_networks, CREDS_MAX_NETWORKS);
+    }
+    s_candidate_count = 0;
+    s_candidate_pos = 0;
+
+    if(s_down_since_us != 0) {
+        const int64_t down_ms = (esp_timer_get_time() - s_down_since_us) / 1000;
+        METRICS_ADD(g_metrics.wifi_downtime_ms, (uint32_t)down_ms);
+        ESP_LOGI(TAG, "connected after %d ms offline, %u attempts", (int)down_ms, (unsigned)s_attempt);
+    }
+
+    s_down_since_us = 0;
+    s_attempt = 0;
+    METRICS_SET(g_metrics.wifi_connected, 1);
+
+    if(s_ap_fallback) {
+        ESP_LOGI(TAG, "station is back, stopping fallback AP");
+        esp_wifi_set_mode(WIFI_MODE_STA);
+        s_ap_fallback = false;
+    }
+
+    xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+}
 
 static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
 {
     if(event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START){
-        ESP_ERROR_CHECK(esp_wifi_connect());
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        connect_next();
+        xSemaphoreGive(s_lock);
+    }
+
+    else if(event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE)
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        on_scan_done();
+        xSemaphoreGive(s_lock);
     }
 
     else if(event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
     {
-        if (s_retry_num < WIFI_STA_MAX_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP (%d/%d)", s_retry_num, WIFI_STA_MAX_RETRY);
-        } else {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        }
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        on_disconnected();
+        xSemaphoreGive(s_lock);
     }
 
-    else if(event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) 
+    else if(event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        on_connected();
+        xSemaphoreGive(s_lock);
+
+        // on every connection: a download may have given up during an outage
+        ota_pull_resume();
     }
 }
 
+static void set_static_ip(esp_netif_t *netif)
+{
+    esp_netif_ip_info_t ip_info = {0};
+    esp_netif_dns_info_t dns = {0};
+
+    esp_netif_str_to_ip4(WIFI_STATIC_IP, &ip_info.ip);
+    esp_netif_str_to_ip4(WIFI_STATIC_NETMASK, &ip_info.netmask);
+    esp_netif_str_to_ip4(WIFI_STATIC_GW, &ip_info.gw);
+
+    ESP_ERROR_CHECK(esp_netif_dhcpc_stop(netif));
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(netif, &ip_info));
+
+    if(esp_netif_str_to_ip4(WIFI_STATIC_DNS, &dns.ip.u_addr.ip4) == ESP_OK) {
+        dns.ip.type = ESP_IPADDR_TYPE_V4;
+        esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns);
+    }
+
+    ESP_LOGI(TAG, "static IP " WIFI_STATIC_IP);
+}
+
 esp_err_t wifi_init_sta(void)
 {
-    s_wifi_event_group = xEventGroupCreate();
+    s_wifi_event_group = mem_event_group_create(&mem_wifi_events);
+    s_lock = mem_mutex_create(&mem_wifi_lock);
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    
+
     esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
     assert(sta_netif);
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
+    if(strlen(WIFI_STATIC_IP) > 0)
+        set_static_ip(sta_netif);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = retry_timer_cb,
+        .name = "wifi_retry",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_retry_timer));
+
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         WIFI_EVENT,
         ESP_EVENT_ANY_ID,
@@ -75,82 +380,122 @@ esp_err_t wifi_init_sta(void)
         NULL
     ));
 
-    char saved_ssid[32] = {0};
-    char saved_pass[64] = {0};
-    load_wifi_creds(saved_ssid, saved_pass);
-
-    if(strlen(saved_ssid) <= 0)
+    // without credentials the station is started later by wifi_apply_creds()
+    s_network_count = load_wifi_networks(s_networks, CREDS_MAX_NETWORKS);
+    if(s_network_count == 0)
         return ESP_ERR_FLASH_BASE;
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = "",
-            .password = "",
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-            .pmf_cfg = {
-                .capable = true,
-                .required = false
-            },
-        },
-    };
+    // the first round is the access point of the last connection, without a scan
+    s_candidate_count = 0;
+    s_candidate_pos = 0;
+    if(s_networks[0].channel != 0) {
+        s_candidates[0].network = 0;
+        memcpy(s_candidates[0].bssid, s_networks[0].bssid, sizeof(s_candidates[0].bssid));
+        s_candidates[0].channel = s_networks[0].channel;
+        s_candidate_count = 1;
+        s_cached_round = true;
+    }
 
-    strncpy((char*)wifi_config.sta.ssid, saved_ssid, sizeof(saved_ssid));
-    strncpy((char*)wifi_config.sta.password, saved_pass, sizeof(saved_pass));
+    s_down_since_us = esp_timer_get_time();
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    ESP_LOGI(TAG, "trying to connect to saved WIFI: %s : %s", saved_ssid, saved_pass);
+    ESP_LOGI(TAG, "trying to connect to %d saved networks", s_network_count);
 
     EventBits_t bits = xEventGroupWaitBits(
         s_wifi_event_group,
-        WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+        WIFI_CONNECTED_BIT,
         pdFALSE,
         pdFALSE,
         pdMS_TO_TICKS(WIFI_STA_CONNECTION_TIMEOUT_MS)
     );
 
-    if(bits & WIFI_CONNECTED_BIT) 
+    if(bits & WIFI_CONNECTED_BIT)
     {
-        ESP_LOGI(TAG, "connected to AP SSID: %s", saved_ssid);
+        ESP_LOGI(TAG, "connected to the saved WiFi");
         return ESP_OK;
-    } 
+    }
 
+    // the station keeps retrying in background
     ESP_LOGI(TAG, "failed to connect saved WiFi");
     return ESP_ERR_WIFI_BASE;
 }
 
-void wifi_init_ap(void){
-    
-    esp_netif_t *ap_netif = esp_netif_create_default_wifi_ap();
-    assert(ap_netif);
+esp_err_t wifi_apply_creds(void)
+{
+    wifi_mode_t mode;
+
+    if(s_lock == NULL || esp_wifi_get_mode(&mode) != ESP_OK)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    s_network_count = load_wifi_networks(s_networks, CREDS_MAX_NETWORKS);
+
+    // the new network first, a full round follows at once if it fails
+    s_candidates[0].network = 0;
+    s_candidates[0].channel = 0;
+    s_candidate_count = s_network_count > 0 ? 1 : 0;
+    s_candidate_pos = 0;
+    s_cached_round = true;
+    s_attempt = 0;
+    esp_timer_stop(s_retry_timer);
+
+    esp_err_t err = ESP_OK;
+
+    if(mode == WIFI_MODE_AP) {
+        // the AP stays until the station gets an address, STA_START connects
+        s_ap_fallback = true;
+        s_down_since_us = esp_timer_get_time();
+        err = esp_wifi_set_mode(WIFI_MODE_APSTA);
+    } else if(s_down_since_us == 0) {
+        // connected: the disconnect event moves on to the new network
+        err = esp_wifi_disconnect();
+    } else {
+        connect_next();
+    }
 
-    wifi_config_t wifi_config = {
-        .ap = {
-            .ssid = WIFI_AP_SSID,
-            .password = WIFI_AP_PASSWORD,
-            .ssid_len = strlen(WIFI_AP_SSID),
-            .channel = WIFI_AP_CHANNEL,
-            .authmode = WIFI_AUTH_WPA2_PSK,
-            .max_connection = WIFI_AP_MAX_CONN,
-            .pmf_cfg = {
-                .required = false,
-            },
-        },
-    };
+    xSemaphoreGive(s_lock);
 
-    if(strlen(WIFI_AP_PASSWORD) == 0)
-        wifi_config.ap.authmode = WIFI_AUTH_OPEN;
+    ESP_LOGI(TAG, "new credentials applied: %s", esp_err_to_name(err));
+    return err;
+}
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_AP, &wifi_config));
+void wifi_init_ap(void){
+    start_ap(WIFI_MODE_AP);
     ESP_ERROR_CHECK(esp_wifi_start());
+}
 
-    ESP_LOGI(TAG, "WIFI AP started: %s : %s", WIFI_AP_SSID, WIFI_AP_PASSWORD);
+/**
+ * @brief Bring the network up without holding the caller,
+ * connecting to the saved AP may take up to WIFI_STA_CONNECTION_TIMEOUT_MS
+*/
+static void wifi_task(void *arg)
+{
+    esp_err_t err = wifi_init_sta();
+    if(err == ESP_ERR_WIFI_BASE) {
+        // the AP is kept until the station connects
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if(s_down_since_us != 0 && !s_ap_fallback) {
+            start_ap(WIFI_MODE_APSTA);
+            s_ap_fallback = true;
+            METRICS_INC(g_metrics.wifi_ap_fallbacks);
+        }
+        xSemaphoreGive(s_lock);
+    } else if(err != ESP_OK) {
+        wifi_init_ap();
+    }
+
+    start_webserver();
+    mqtt_pub_start();
+    udp_export_start();
+
+    ESP_LOGI(TAG, "network is up in %d ms since boot", (int)(esp_timer_get_time() / 1000));
+    vTaskDelete(NULL);
 }
 
-void wifi_start(void)
+static bool wifi_enabled(void)
 {
     gpio_config_t io_conf = {};
     io_conf.mode = GPIO_MODE_DEF_INPUT;
@@ -164,15 +509,40 @@ void wifi_start(void)
 
     if(wifi_ena == 0){
         ESP_LOGI(TAG, "wifi support is disabled");
-        return;
+        return false;
     }
 
     ESP_LOGI(TAG, "wifi support is enabled");
-        
-    creds_init();
+    return true;
+}
 
-    if(wifi_init_sta() != ESP_OK)
-        wifi_init_ap();
+void wifi_start(void)
+{
+    if(!wifi_enabled())
+        return;
 
-    start_webserver();
-}
\ No newline at end of file
+    mem_task_create(&mem_wifi, wifi_task, NULL,
+        ESP_TASK_PRIO_MIN + 1, NULL, tskNO_AFFINITY
+    );
+}
+
+esp_err_t wifi_connect_sta(void)
+{
+    if(!wifi_enabled())
+        return ESP_ERR_NOT_SUPPORTED;
+
+    esp_err_t err = wifi_init_sta();
+    if(err != ESP_OK)
+        return err;
+
+    mqtt_pub_start();
+    udp_export_start();
+    return ESP_OK;
+}
+
+void wifi_stop(void)
+{
+    if(s_retry_timer)
+        esp_timer_stop(s_retry_timer);
+    esp_wifi_stop();
+}
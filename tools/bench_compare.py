@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""
+Compares two benchmark result files written by bench_run() (aqa_bench on
+the host or the UART log of a firmware built with BENCH_ENABLE 1) and
+fails when a benchmark got slower than the threshold.
+
+usage: bench_compare.py <base.jsonl> <new.jsonl> [threshold_percent, default 10]
+"""
+
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            # a UART log has other lines around the results
+            start = line.find('{"bench"')
+            if start < 0:
+                continue
+            result = json.loads(line[start:].strip())
+            results[result["bench"]] = result
+    return results
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        sys.exit(__doc__)
+
+    base = load(sys.argv[1])
+    new = load(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) == 4 else 10.0
+    regressions = 0
+
+    print("%-22s %12s %12s %8s" % ("bench", "base", "new", "change"))
+    for name in sorted(set(base) | set(new)):
+        if name not in base or name not in new:
+            print("%-22s %s" % (name, "only in " + (sys.argv[1] if name in base else sys.argv[2])))
+            continue
+
+        if base[name]["unit"] != new[name]["unit"]:
+            print("%-22s units differ: %s / %s" % (name, base[name]["unit"], new[name]["unit"]))
+            continue
+
+        old, cur = base[name]["per_op"], new[name]["per_op"]
+        change = 100.0 * (cur - old) / old if old else 0.0
+        mark = ""
+        if change > threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+
+        print("%-22s %12.1f %12.1f %+7.1f%%%s" % (name, old, cur, change, mark))
+
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
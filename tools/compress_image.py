@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+"""
+Produces a gzip-compressed copy of the application image, which can be
+uploaded to /update instead of the plain .bin.
+
+usage: compress_image.py <image.bin> <image.bin.gz>
+"""
+
+import gzip
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+
+    with open(sys.argv[1], "rb") as f:
+        image = f.read()
+
+    # no file name and a fixed timestamp in the header: reproducible output
+    packed = gzip.compress(image, compresslevel=9, mtime=0)
+
+    with open(sys.argv[2], "wb") as f:
+        f.write(packed)
+
+    print("%s: %d -> %d bytes (%.1f%%)" % (
+        sys.argv[2], len(image), len(packed), 100.0 * len(packed) / len(image)))
+
+
+if __name__ == "__main__":
+    main()
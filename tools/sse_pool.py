@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+Exercises the Server-Sent Events client pool of a running device:
+STREAM_MAX_CLIENTS - 1 readers and one slow reader that never reads fill
+the pool, one more client must get 503, regular requests must still be
+served, the slow reader must be evicted after STREAM_MAX_STRIKES full
+socket buffers and its slot must be free again. Prints the broadcast
+cost (last_cost_us/max_cost_us of /api/v1/status) along the way.
+
+usage: sse_pool.py <device address> [timeout_s, default 300] [max_clients, default 4]
+"""
+
+import json
+import select
+import socket
+import sys
+import time
+
+PORT = 80
+POLL_S = 2
+
+
+def status(host):
+    with socket.create_connection((host, PORT), timeout=5) as s:
+        s.sendall(b"GET /api/v1/status HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n" % host.encode())
+        data = b""
+        while True:
+            chunk = s.recv(4096)
+            if not chunk:
+                break
+            data += chunk
+    head, _, body = data.partition(b"\r\n\r\n")
+    if not head.startswith(b"HTTP/1.1 200"):
+        raise RuntimeError("status: " + head.split(b"\r\n")[0].decode())
+    return json.loads(body)
+
+
+def subscribe(host, rcvbuf=None):
+    """Returns the socket and the status line of the response"""
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    if rcvbuf:
+        # before connect(), so the advertised window stays small
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, rcvbuf)
+    s.settimeout(5)
+    s.connect((host, PORT))
+    s.sendall(b"GET /api/v1/stream HTTP/1.1\r\nHost: %s\r\nAccept: text/event-stream\r\n\r\n" % host.encode())
+    line = b""
+    while not line.endswith(b"\r\n"):
+        chunk = s.recv(1)
+        if not chunk:
+            break
+        line += chunk
+    s.setblocking(False)
+    return s, line.decode(errors="replace").strip()
+
+
+def drain(readers):
+    """Reads what the readers got, returns the events seen"""
+    events = 0
+    ready, _, _ = select.select(readers, [], [], 0)
+    for s in ready:
+        try:
+            data = s.recv(65536)
+        except BlockingIOError:
+            continue
+        events += data.count(b"event: sample")
+    return events
+
+
+def main():
+    if len(sys.argv) not in (2, 3, 4):
+        sys.exit(__doc__)
+
+    host = sys.argv[1]
+    timeout_s = float(sys.argv[2]) if len(sys.argv) >= 3 else 300.0
+    max_clients = int(sys.argv[3]) if len(sys.argv) == 4 else 4
+    failures = 0
+
+    def check(ok, what):
+        nonlocal failures
+        print("%-4s %s" % ("ok" if ok else "FAIL", what))
+        if not ok:
+            failures += 1
+
+    before = status(host)["stream"]
+    check(before["clients"] == 0, "no stream clients at start (%d)" % before["clients"])
+
+    readers = []
+    for i in range(max_clients - 1):
+        s, line = subscribe(host)
+        check(" 200 " in line + " ", "reader %d subscribed: %s" % (i, line))
+        readers.append(s)
+
+    slow, line = subscribe(host, rcvbuf=1024)
+    check(" 200 " in line + " ", "slow reader subscribed: %s" % line)
+
+    extra, line = subscribe(host)
+    check(" 503 " in line + " ", "client over the cap refused: %s" % line)
+    extra.close()
+
+    # the pool holds STREAM_MAX_CLIENTS sockets, the server must still answer
+    stream = status(host)["stream"]
+    check(stream["clients"] == max_clients, "regular request served with %d stream clients" % stream["clients"])
+
+    events = 0
+    evicted = False
+    start = time.monotonic()
+    while time.monotonic() - start < timeout_s:
+        time.sleep(POLL_S)
+        events += drain(readers)
+        stream = status(host)["stream"]
+        print("     %5.0f s: %d clients, %d evicted, %d broadcasts, cost %d us last, %d us max, %d events read" % (
+            time.monotonic() - start, stream["clients"], stream["evicted"], stream["broadcasts"],
+            stream["last_cost_us"], stream["max_cost_us"], events))
+        if stream["evicted"] > before["evicted"]:
+            evicted = True
+            break
+
+    check(evicted, "slow reader evicted after %.0f s" % (time.monotonic() - start))
+    check(events > 0, "readers kept receiving (%d events)" % events)
+    slow.close()
+
+    again, line = subscribe(host)
+    check(" 200 " in line + " ", "freed slot taken again: %s" % line)
+    again.close()
+    for s in readers:
+        s.close()
+
+    stream = status(host)["stream"]
+    print("broadcast cost: %d us last, %d us max over %d broadcasts" % (
+        stream["last_cost_us"], stream["max_cost_us"], stream["broadcasts"]))
+
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
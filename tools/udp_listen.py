@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+Receives the UDP push of the device (InfluxDB line protocol or Graphite
+plaintext, see main/inc/udp_export.h) in place of the collector and
+reports datagrams and samples per minute of sample time. With the device
+address it also reads /metrics before and after and reports the CPU time
+the exporter spent per sample (aqa_udp_cpu_seconds_total).
+
+usage: udp_listen.py <port> [duration_s, default 600] [device address]
+"""
+
+import re
+import socket
+import sys
+import time
+import urllib.request
+
+# Graphite sends one line per field, see render() in udp_export.c
+GRAPHITE_FIELDS = 10
+
+METRICS = ("aqa_udp_samples_total", "aqa_udp_datagrams_total",
+           "aqa_udp_dropped_samples_total", "aqa_udp_dropped_datagrams_total",
+           "aqa_udp_cpu_seconds_total")
+
+
+def metrics(device):
+    with urllib.request.urlopen("http://%s/metrics" % device, timeout=5) as r:
+        text = r.read().decode()
+    values = {}
+    for name in METRICS:
+        m = re.search(r"^%s (\S+)$" % name, text, re.MULTILINE)
+        values[name] = float(m.group(1)) if m else 0.0
+    return values
+
+
+def timestamp_s(line):
+    """Of a line, None when the collector stamps it on arrival"""
+    parts = line.split(" ")
+    if "," in parts[0] and len(parts) == 3:
+        return int(parts[2]) / 1e9      # line protocol, ns
+    if len(parts) == 3 and parts[2] != "-1":
+        return float(parts[2])          # Graphite, s
+    return None
+
+
+def main():
+    if len(sys.argv) not in (2, 3, 4):
+        sys.exit(__doc__)
+
+    port = int(sys.argv[1])
+    duration_s = float(sys.argv[2]) if len(sys.argv) >= 3 else 600.0
+    device = sys.argv[3] if len(sys.argv) == 4 else None
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.bind(("0.0.0.0", port))
+    sock.settimeout(1.0)
+
+    before = metrics(device) if device else None
+
+    datagrams = lines = size = 0
+    graphite = False
+    first_ts = last_ts = None
+    start = time.monotonic()
+
+    while time.monotonic() - start < duration_s:
+        try:
+            data, _ = sock.recvfrom(65536)
+        except socket.timeout:
+            continue
+
+        datagrams += 1
+        size += len(data)
+        for line in data.decode(errors="replace").splitlines():
+            if not line:
+                continue
+            lines += 1
+            graphite = graphite or "," not in line.split(" ")[0]
+            ts = timestamp_s(line)
+            if ts is not None:
+                first_ts = ts if first_ts is None else min(first_ts, ts)
+                last_ts = ts if last_ts is None else max(last_ts, ts)
+
+    samples = lines // GRAPHITE_FIELDS if graphite else lines
+    print("received    : %d datagrams, %d samples, %d bytes (%.0f bytes/datagram)" % (
+        datagrams, samples, size, size / datagrams if datagrams else 0))
+
+    if first_ts is not None and last_ts > first_ts and samples > 1:
+        # samples span (n - 1) intervals
+        minutes = (last_ts - first_ts) / 60.0 * samples / (samples - 1)
+        print("rate        : %.1f datagrams/min, %.1f samples/min of sample time" % (
+            datagrams / minutes, samples / minutes))
+
+    if device:
+        after = metrics(device)
+        delta = {name: after[name] - before[name] for name in METRICS}
+        pushed = delta["aqa_udp_samples_total"]
+        cpu_us = delta["aqa_udp_cpu_seconds_total"] * 1e6
+        print("device      : %d samples, %d datagrams, %d samples and %d datagrams dropped" % (
+            pushed, delta["aqa_udp_datagrams_total"],
+            delta["aqa_udp_dropped_samples_total"], delta["aqa_udp_dropped_datagrams_total"]))
+        print("cpu         : %.0f us in total, %.1f us per sample, %.1f ms per minute" % (
+            cpu_us, cpu_us / pushed if pushed else 0.0, cpu_us / 1000.0 / (duration_s / 60.0)))
+        if pushed != samples:
+            print("lost        : %d samples pushed but not received" % (pushed - samples))
+
+
+if __name__ == "__main__":
+    main()
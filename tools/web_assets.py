@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+Prepares web assets for embedding into the firmware.
+
+Every asset is minified (indentation, trailing spaces and empty lines
+are dropped, line breaks are kept so inline scripts stay valid), then
+gzip-compressed with a fixed timestamp so the output is reproducible.
+A header with the compressed length and a content hash based ETag of
+every asset is generated next to the compressed files.
+
+usage: web_assets.py <output dir> <asset> [<asset> ...]
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+
+def minify(text):
+    lines = (line.strip() for line in text.splitlines())
+    return "\n".join(line for line in lines if line) + "\n"
+
+
+def symbol_name(file_name):
+    return re.sub(r"[^0-9A-Za-z]", "_", file_name).upper()
+
+
+def write_if_changed(path, data):
+    if os.path.exists(path):
+        with open(path, "rb") as f:
+            if f.read() == data:
+                return
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+
+    out_dir = sys.argv[1]
+    os.makedirs(out_dir, exist_ok=True)
+
+    header = ["#pragma once", "", "/* generated by tools/web_assets.py, do not edit */", ""]
+
+    for asset in sys.argv[2:]:
+        name = os.path.basename(asset)
+        with open(asset, "r", encoding="utf-8") as f:
+            raw = f.read()
+
+        packed = gzip.compress(minify(raw).encode("utf-8"), compresslevel=9, mtime=0)
+        etag = hashlib.sha256(packed).hexdigest()[:16]
+
+        write_if_changed(os.path.join(out_dir, name + ".gz"), packed)
+
+        symbol = symbol_name(name)
+        header.append("#define %s_GZ_LEN %d" % (symbol, len(packed)))
+        header.append("#define %s_ETAG \"\\\"%s\\\"\"" % (symbol, etag))
+        header.append("")
+
+        print("%s: %d -> %d bytes, etag %s" % (name, len(raw.encode("utf-8")), len(packed), etag))
+
+    write_if_changed(os.path.join(out_dir, "web_assets.h"), "\n".join(header).encode("utf-8"))
+
+
+if __name__ == "__main__":
+    main()